@@ -29,14 +29,15 @@
 #include <deque>
 #include <functional>
 #include <memory>
+#include <optional>
 #include <string>
-#include <unordered_map>
 #include <utility>
 
 #include "world.h"
 #include "player.h"
 #include "position.h"
 #include "game_position.h"
+#include "slot_map.h"
 
 class OutgoingPacket;
 
@@ -92,6 +93,9 @@ class GameEngine
   void removeItem(common::CreatureId creature_id, const common::ItemPosition& position, int count);
   void addItem(common::CreatureId creature_id, const common::GamePosition& position, const common::Item& item, int count);
 
+  // Takes the next step of the player's walk intent, and queues a task for the following step
+  void walk(common::CreatureId creature_id);
+
   // This structure holds all player data that shouldn't go into Player
   struct PlayerData
   {
@@ -103,19 +107,32 @@ class GameEngine
 
     Player player;
     PlayerCtrl* player_ctrl;
+
+    // Input slots, only the newest walk intent and the newest turn are kept, so that
+    // repeated inputs overwrite the slot instead of queueing more tasks
+    // The walk intent is either a single step (move) or a path (movePath)
     std::deque<common::Direction> queued_moves;
+    bool queued_moves_is_path = false;
+    bool walk_task_queued = false;
+    std::optional<common::Direction> queued_turn;
   };
 
-  // Use these instead of the unordered_map directly
+  // Use these instead of the SlotMap directly
   PlayerData& getPlayerData(common::CreatureId creature_id) { return m_player_data.at(creature_id); }
   const PlayerData& getPlayerData(common::CreatureId creature_id) const { return m_player_data.at(creature_id); }
 
-  std::unordered_map<common::CreatureId, PlayerData> m_player_data;
+  // Also used to allocate CreatureIds, a CreatureId is not reused until its slot generation wraps
+  // PlayerData is never moved, World keeps pointers to the Player
+  utils::SlotMap<PlayerData, common::CreatureId> m_player_data;
   std::unique_ptr<ItemManager> m_item_manager;
   std::unique_ptr<world::World> m_world;
   GameEngineQueue* m_game_engine_queue{nullptr};
   std::string m_login_message;
   std::unique_ptr<ContainerManager> m_container_manager;
+
+#ifdef UNITTEST
+  friend class GameEngineTest;
+#endif
 };
 
 }  // namespace gameengine
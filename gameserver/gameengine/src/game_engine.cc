@@ -43,26 +43,6 @@
 #include "logger.h"
 #include "tick.h"
 
-namespace
-{
-
-struct RecursiveTask
-{
-  explicit RecursiveTask(std::function<void(const RecursiveTask&, gameengine::GameEngine* game_engine)> func)
-    : func(std::move(func))
-  {
-  }
-
-  void operator()(gameengine::GameEngine* game_engine) const
-  {
-    func(*this, game_engine);
-  }
-
-  std::function<void(const RecursiveTask&, gameengine::GameEngine* game_engine)> func;
-};
-
-}  // namespace
-
 namespace gameengine
 {
 
@@ -109,15 +89,17 @@ bool GameEngine::init(GameEngineQueue* game_engine_queue,
 bool GameEngine::spawn(const std::string& name, PlayerCtrl* player_ctrl)
 {
   // Create the Player
-  // TODO(simon): need this static for other types of creatures as well
-  static common::CreatureId next_creature_id = 0x4713;
-  const auto creature_id = next_creature_id++;
+  // TODO(simon): other types of creatures needs to get their CreatureId from the same SlotMap
+  const auto creature_id = m_player_data.newKey();
+  if (creature_id == common::Creature::INVALID_ID)
+  {
+    LOG_ERROR("%s: could not allocate a new CreatureId", __func__);
+    return false;
+  }
   Player new_player(creature_id, name);
 
   // Store the Player and the PlayerCtrl
-  m_player_data.emplace(std::piecewise_construct,
-                      std::forward_as_tuple(creature_id),
-                      std::forward_as_tuple(std::move(new_player), player_ctrl));
+  m_player_data.emplace(creature_id, std::move(new_player), player_ctrl);
 
   // Get the Player again, since newPlayed is moved from
   auto& player = getPlayerData(creature_id).player;
@@ -164,68 +146,78 @@ void GameEngine::move(common::CreatureId creature_id, common::Direction directio
 {
   LOG_DEBUG("%s: creature id: %d", __func__, creature_id);
 
-  auto* player_ctrl = getPlayerData(creature_id).player_ctrl;
+  // Replace the current walk intent, if the player may not move yet then the queued walk
+  // task takes this step instead
+  auto& player_data = getPlayerData(creature_id);
+  player_data.queued_moves.assign(1, direction);
+  player_data.queued_moves_is_path = false;
 
-  auto rc = m_world->creatureMove(creature_id, direction);
-  if (rc == world::ReturnCode::MAY_NOT_MOVE_YET)
+  if (!player_data.walk_task_queued)
   {
-    LOG_DEBUG("%s: player move delayed, creature id: %d", __func__, creature_id);
-    const auto tick = getPlayerData(creature_id).player.getNextWalkTick() - utils::Tick::now();
+    walk(creature_id);
+  }
+}
 
-    // Remove all previous tasks for this player
-    // Not sure if this is correct, should be fine for now as there are only walk tasks at the moment
-    m_game_engine_queue->cancelAllTasks(creature_id);
+void GameEngine::movePath(common::CreatureId creature_id, std::deque<common::Direction>&& path)
+{
+  // Same as move, but with more steps
+  auto& player_data = getPlayerData(creature_id);
+  player_data.queued_moves = std::move(path);
+  player_data.queued_moves_is_path = true;
 
-    m_game_engine_queue->addTask(creature_id,
-                                 tick,
-                                 [this, creature_id, direction](GameEngine* game_engine)
-    {
-      (void)game_engine;
-      move(creature_id, direction);
-    });
-  }
-  else if (rc == world::ReturnCode::THERE_IS_NO_ROOM)
+  if (!player_data.walk_task_queued)
   {
-    player_ctrl->sendCancel("There is no room.");
+    walk(creature_id);
   }
 }
 
-void GameEngine::movePath(common::CreatureId creature_id, std::deque<common::Direction>&& path)
+void GameEngine::walk(common::CreatureId creature_id)
 {
-  getPlayerData(creature_id).queued_moves = std::move(path);
+  auto& player_data = getPlayerData(creature_id);
 
-  const auto task = RecursiveTask([this, creature_id](const RecursiveTask& task, GameEngine* game_engine)
+  // Make sure that the queued moves hasn't been canceled
+  if (player_data.queued_moves.empty())
   {
-    (void)game_engine;
-
-    auto& player_data = getPlayerData(creature_id);
+    return;
+  }
 
-    // Make sure that the queued moves hasn't been canceled
-    if (!player_data.queued_moves.empty())
+  const auto rc = m_world->creatureMove(creature_id, player_data.queued_moves.front());
+  if (rc == world::ReturnCode::OK)
+  {
+    // Player moved, pop the move from the queue
+    player_data.queued_moves.pop_front();
+  }
+  else if (rc != world::ReturnCode::MAY_NOT_MOVE_YET)
+  {
+    // If we neither got OK nor MAY_NOT_MOVE_YET: stop here and cancel all queued moves
+    if (player_data.queued_moves_is_path)
     {
-      const auto rc = m_world->creatureMove(creature_id, player_data.queued_moves.front());
-
-      if (rc == world::ReturnCode::OK)
-      {
-        // Player moved, pop the move from the queue
-        player_data.queued_moves.pop_front();
-      }
-      else if (rc != world::ReturnCode::MAY_NOT_MOVE_YET)
-      {
-        // If we neither got OK nor MAY_NOT_MOVE_YET: stop here and cancel all queued moves
-        cancelMove(creature_id);
-      }
-
-      if (!player_data.queued_moves.empty())
+      cancelMove(creature_id);
+    }
+    else
+    {
+      player_data.queued_moves.clear();
+      if (rc == world::ReturnCode::THERE_IS_NO_ROOM)
       {
-        // If there are more queued moves, e.g. we moved but there are more moves or we were not allowed
-        // to move yet, add a new task
-        m_game_engine_queue->addTask(creature_id, player_data.player.getNextWalkTick() - utils::Tick::now(), task);
+        player_data.player_ctrl->sendCancel("There is no room.");
       }
     }
-  });
+  }
 
-  task(this);
+  if (!player_data.queued_moves.empty())
+  {
+    // If there are more queued moves, e.g. we moved but there are more moves or we were not allowed
+    // to move yet, add a new task
+    player_data.walk_task_queued = true;
+    m_game_engine_queue->addTask(creature_id,
+                                 player_data.player.getNextWalkTick() - utils::Tick::now(),
+                                 [this, creature_id](GameEngine* game_engine)
+    {
+      (void)game_engine;
+      getPlayerData(creature_id).walk_task_queued = false;
+      walk(creature_id);
+    });
+  }
 }
 
 void GameEngine::cancelMove(common::CreatureId creature_id)
@@ -245,7 +237,24 @@ void GameEngine::cancelMove(common::CreatureId creature_id)
 void GameEngine::turn(common::CreatureId creature_id, common::Direction direction)
 {
   LOG_DEBUG("%s: Player turn, creature id: %d", __func__, creature_id);
-  m_world->creatureTurn(creature_id, direction);
+
+  // Only turn once per tick, to the newest direction
+  auto& player_data = getPlayerData(creature_id);
+  const auto turn_task_queued = player_data.queued_turn.has_value();
+  player_data.queued_turn = direction;
+  if (turn_task_queued)
+  {
+    return;
+  }
+
+  m_game_engine_queue->addTask(creature_id, [this, creature_id](GameEngine* game_engine)
+  {
+    (void)game_engine;
+    auto& player_data = getPlayerData(creature_id);
+    const auto direction = *player_data.queued_turn;
+    player_data.queued_turn.reset();
+    m_world->creatureTurn(creature_id, direction);
+  });
 }
 
 void GameEngine::say(common::CreatureId creature_id,
@@ -385,7 +394,15 @@ void GameEngine::moveItem(common::CreatureId creature_id,
   }
   auto* item = getItem(creature_id, from_position);
 
-  // TODO(simon): verify that Item is movable
+  // Shared items are never movable (see ItemManager::createStaticItem), moving one would
+  // move it on every tile that has it
+  if (item->getItemType().is_ground ||
+      item->getItemType().is_immovable ||
+      m_item_manager->isSharedItem(item->getItemUniqueId()))
+  {
+    player_data.player_ctrl->sendCancel("You cannot move this object.");
+    return;
+  }
 
   // TODO(simon): check if to_position points to a container item, and in that case change to_position
   //              to point inside that container (if applicable)
@@ -23,7 +23,11 @@
 
 #include "item_manager.h"
 
+#include <cstdlib>
+
 #include "logger.h"
+#include "position.h"
+#include "world.h"
 
 namespace gameengine
 {
@@ -54,35 +58,171 @@ common::ItemUniqueId ItemManager::createItem(common::ItemTypeId item_type_id)
     return common::Item::INVALID_UNIQUE_ID;
   }
 
-  const auto item_unique_id = m_next_item_unique_id;
-  ++m_next_item_unique_id;
-
-  m_items.emplace(item_unique_id, ItemImpl(item_unique_id, &m_item_types[item_type_id]));
+  const auto item_unique_id = m_items.newKey();
+  if (!m_items.emplace(item_unique_id, item_unique_id, &m_item_types[item_type_id], false))
+  {
+    LOG_ERROR("%s: could not allocate a new ItemUniqueId", __func__);
+    return common::Item::INVALID_UNIQUE_ID;
+  }
   LOG_DEBUG("%s: created Item with item_unique_id: %lu, item_type_id: %d", __func__, item_unique_id, item_type_id);
 
   return item_unique_id;
 }
 
+common::ItemUniqueId ItemManager::createStaticItem(common::ItemTypeId item_type_id)
+{
+  if (item_type_id < m_item_types_id_first || item_type_id > m_item_types_id_last)
+  {
+    LOG_ERROR("%s: item_type_id: %d out of range", __func__, item_type_id);
+    return common::Item::INVALID_UNIQUE_ID;
+  }
+
+  if (!canShare(m_item_types[item_type_id]))
+  {
+    return createItem(item_type_id);
+  }
+
+  auto& shared_item_unique_id = m_shared_items[item_type_id];
+  if (shared_item_unique_id == common::Item::INVALID_UNIQUE_ID)
+  {
+    const auto item_unique_id = m_items.newKey();
+    if (!m_items.emplace(item_unique_id, item_unique_id, &m_item_types[item_type_id], true))
+    {
+      LOG_ERROR("%s: could not allocate a new ItemUniqueId", __func__);
+      return common::Item::INVALID_UNIQUE_ID;
+    }
+
+    LOG_DEBUG("%s: created shared Item with item_unique_id: %lu, item_type_id: %d",
+              __func__,
+              item_unique_id,
+              item_type_id);
+    shared_item_unique_id = item_unique_id;
+  }
+
+  return shared_item_unique_id;
+}
+
+bool ItemManager::isSharedItem(common::ItemUniqueId item_unique_id) const
+{
+  const auto* item = m_items.get(item_unique_id);
+  return item && item->isShared();
+}
+
+common::ItemUniqueId ItemManager::promoteItem(common::ItemUniqueId item_unique_id)
+{
+  const auto* item = m_items.get(item_unique_id);
+  if (!item)
+  {
+    LOG_ERROR("%s: could not find Item with item_unique_id: %lu", __func__, item_unique_id);
+    return common::Item::INVALID_UNIQUE_ID;
+  }
+
+  if (!item->isShared())
+  {
+    return item_unique_id;
+  }
+
+  return createItem(item->getItemTypeId());
+}
+
+common::Item* ItemManager::promoteTileItem(world::World* world, const common::Position& position, int stackpos)
+{
+  const auto* tile = static_cast<const world::World*>(world)->getTile(position);
+  if (!tile)
+  {
+    LOG_ERROR("%s: no tile found at position: %s", __func__, position.toString().c_str());
+    return nullptr;
+  }
+
+  const auto num_things = static_cast<int>(tile->getNumberOfThings());
+  const auto* item = (stackpos >= 0 && stackpos < num_things) ? tile->getItem(stackpos) : nullptr;
+  if (!item)
+  {
+    LOG_ERROR("%s: no item at stackpos: %d at position: %s", __func__, stackpos, position.toString().c_str());
+    return nullptr;
+  }
+
+  if (!isSharedItem(item->getItemUniqueId()))
+  {
+    return getItem(item->getItemUniqueId());
+  }
+
+  const auto item_unique_id = promoteItem(item->getItemUniqueId());
+  if (item_unique_id == common::Item::INVALID_UNIQUE_ID)
+  {
+    return nullptr;
+  }
+
+  auto* promoted_item = getItem(item_unique_id);
+  if (world->replaceItem(*promoted_item, position, stackpos) != world::ReturnCode::OK)
+  {
+    LOG_ERROR("%s: could not replace shared item at stackpos: %d at position: %s",
+              __func__,
+              stackpos,
+              position.toString().c_str());
+    destroyItem(item_unique_id);
+    return nullptr;
+  }
+
+  LOG_DEBUG("%s: promoted shared item at position: %s to item_unique_id: %lu",
+            __func__,
+            position.toString().c_str(),
+            item_unique_id);
+  return promoted_item;
+}
+
 void ItemManager::destroyItem(common::ItemUniqueId item_unique_id)
 {
-  if (m_items.count(item_unique_id) == 0)
+  if (isSharedItem(item_unique_id))
+  {
+    LOG_ERROR("%s: can not destroy shared Item with item_unique_id: %lu", __func__, item_unique_id);
+    return;
+  }
+
+  if (!m_items.erase(item_unique_id))
   {
     LOG_ERROR("%s: could not find Item with item_unique_id: %lu", __func__, item_unique_id);
     return;
   }
 
-  LOG_DEBUG("%s: destroying Item with item_unique_id: %lu", __func__, item_unique_id);
-  m_items.erase(item_unique_id);
+  LOG_DEBUG("%s: destroyed Item with item_unique_id: %lu", __func__, item_unique_id);
 }
 
 common::Item* ItemManager::getItem(common::ItemUniqueId item_unique_id)
 {
-  if (m_items.count(item_unique_id) == 0)
+  return m_items.get(item_unique_id);
+}
+
+void ItemManager::ItemImpl::setCount(std::uint8_t count)
+{
+  if (m_shared)
   {
-    return nullptr;
+    // Modifying a shared item would modify it on every tile, see promoteTileItem
+    LOG_ERROR("%s: can not modify shared Item with item_unique_id: %lu, use promoteTileItem",
+              __func__,
+              m_item_unique_id);
+    return;
+  }
+
+  m_count = count;
+}
+
+bool ItemManager::canShare(const common::ItemType& item_type)
+{
+  // Only items without any state of their own
+  if (item_type.is_container ||
+      item_type.is_stackable ||
+      item_type.is_fluid_container ||
+      item_type.is_splash ||
+      item_type.is_writable ||
+      item_type.is_writable_once ||
+      item_type.is_rotateable)
+  {
+    return false;
   }
 
-  return &m_items.at(item_unique_id);
+  // Grounds, and items that can't be picked up or moved
+  return item_type.is_ground || item_type.is_immovable;
 }
 
 }  // namespace gameengine
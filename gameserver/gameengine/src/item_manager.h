@@ -28,10 +28,20 @@
 #include <cstdint>
 #include <array>
 #include <string>
-#include <unordered_map>
 
 #include "item.h"
 #include "data_loader.h"
+#include "slot_map.h"
+
+namespace common
+{
+class Position;
+}
+
+namespace world
+{
+class World;
+}
 
 namespace gameengine
 {
@@ -40,8 +50,7 @@ class ItemManager
 {
  public:
   ItemManager()
-    : m_next_item_unique_id(1),
-      m_item_types_id_first(0),
+    : m_item_types_id_first(0),
       m_item_types_id_last(0)
   {
   }
@@ -51,16 +60,32 @@ class ItemManager
   common::ItemUniqueId createItem(common::ItemTypeId item_type_id);
   void destroyItem(common::ItemUniqueId item_unique_id);
 
+  // Same as createItem, but items that can never change, e.g. grounds and immovable
+  // decorations, share one immutable instance per ItemTypeId instead of getting their own
+  // Shared items can't be destroyed or modified, calling setCount on them only logs an error
+  common::ItemUniqueId createStaticItem(common::ItemTypeId item_type_id);
+  bool isSharedItem(common::ItemUniqueId item_unique_id) const;
+
+  // Returns item_unique_id if it's a unique item, or a new unique item of the same type if it's
+  // a shared item. The returned item must then replace the shared item, see promoteTileItem
+  common::ItemUniqueId promoteItem(common::ItemUniqueId item_unique_id);
+
+  // Returns the item at position and stackpos so that it can be modified. If it's a shared item
+  // it is first promoted and replaced on the tile by its new unique item
+  // Returns nullptr if there is no item at position and stackpos
+  common::Item* promoteTileItem(world::World* world, const common::Position& position, int stackpos);
+
   common::Item* getItem(common::ItemUniqueId item_unique_id);
 
  private:
   class ItemImpl : public common::Item
   {
    public:
-    ItemImpl(common::ItemUniqueId item_unique_id, const common::ItemType* item_type)
+    ItemImpl(common::ItemUniqueId item_unique_id, const common::ItemType* item_type, bool shared)
       : m_item_unique_id(item_unique_id),
         m_itemType(item_type),
-        m_count(1)
+        m_count(1),
+        m_shared(shared)
     {
     }
 
@@ -70,20 +95,34 @@ class ItemManager
     const common::ItemType& getItemType() const override { return *m_itemType; }
 
     std::uint8_t getCount() const override { return m_count; }
-    void setCount(std::uint8_t count) override { m_count = count; }
+    void setCount(std::uint8_t count) override;
+
+    bool isShared() const { return m_shared; }
 
    private:
     common::ItemUniqueId m_item_unique_id;
     const common::ItemType* m_itemType;
     std::uint8_t m_count;
+    bool m_shared;  // Fits in the padding after m_count
   };
 
-  std::unordered_map<common::ItemUniqueId, ItemImpl> m_items;
-  common::ItemUniqueId m_next_item_unique_id{1};
+  static bool canShare(const common::ItemType& item_type);
+
+  // Items are allocated in pages that are never moved, so Item pointers are stable
+  // The ItemUniqueId is the SlotMap key, lower 32 bits are the slot and upper 32 bits are
+  // the generation, so that ids of destroyed items are never valid again
+  utils::SlotMap<ItemImpl, common::ItemUniqueId, 32> m_items;
+
+  // The shared instance per ItemTypeId, created on first use, see createStaticItem
+  std::array<common::ItemUniqueId, utils::data_loader::MAX_ITEM_TYPES> m_shared_items{};
 
   utils::data_loader::ItemTypes  m_item_types;
   common::ItemTypeId m_item_types_id_first{0};
   common::ItemTypeId m_item_types_id_last{0};
+
+#ifdef UNITTEST
+  friend class ItemManagerTest;
+#endif
 };
 
 }  // namespace gameengine
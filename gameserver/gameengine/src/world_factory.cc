@@ -44,9 +44,10 @@ namespace gameengine
 std::unique_ptr<world::World> WorldFactory::createWorld(const std::string& world_filename,
                                                         ItemManager* item_manager)
 {
+  // Most items in the world file are grounds and decorations that never change
   const auto create_item = [&item_manager](common::ItemTypeId item_type_id)
   {
-    return item_manager->createItem(item_type_id);
+    return item_manager->createStaticItem(item_type_id);
   };
 
   const auto get_item = [&item_manager](common::ItemUniqueId item_unique_id)
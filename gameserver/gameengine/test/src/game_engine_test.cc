@@ -0,0 +1,212 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "game_engine.h"
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#include <asio.hpp>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include "container_manager.h"
+#include "game_engine_queue.h"
+#include "item_manager.h"
+#include "player_ctrl_mock.h"
+#include "position.h"
+#include "tick.h"
+#include "tile.h"
+#include "world.h"
+
+namespace gameengine
+{
+
+using ::testing::_;
+using ::testing::NiceMock;
+using ::testing::ReturnRef;
+using ::testing::SaveArg;
+
+namespace
+{
+
+class ItemStub : public common::Item
+{
+ public:
+  explicit ItemStub(bool is_blocking)
+  {
+    m_item_type.id = is_blocking ? 101 : 100;
+    m_item_type.is_ground = true;
+    m_item_type.is_blocking = is_blocking;
+  }
+
+  common::ItemUniqueId getItemUniqueId() const override { return m_item_type.id; }
+  common::ItemTypeId getItemTypeId() const override { return m_item_type.id; }
+  const common::ItemType& getItemType() const override { return m_item_type; }
+  std::uint8_t getCount() const override { return 1U; }
+  void setCount(std::uint8_t) override {}
+
+ private:
+  common::ItemType m_item_type;
+};
+
+}  // namespace
+
+class GameEngineTest : public ::testing::Test
+{
+ protected:
+  GameEngineTest()
+    : gameEngineQueue(&gameEngine, &ioContext),
+      ground(false),
+      wall(true)
+  {
+    // Players spawn at (222, 222, 7), so the world is (192, 192, 7) to (223, 223, 7)
+    // with a wall north of the spawn position
+    std::vector<world::Tile> tiles;
+    for (auto x = 0; x < 32; x++)
+    {
+      for (auto y = 0; y < 32; y++)
+      {
+        tiles.emplace_back((x == 30 && y == 29) ? &wall : &ground);
+      }
+    }
+
+    gameEngine.m_world = std::make_unique<world::World>(32, 32, std::move(tiles));
+    gameEngine.m_game_engine_queue = &gameEngineQueue;
+    gameEngine.m_container_manager = std::make_unique<ContainerManager>();
+    gameEngine.m_item_manager = std::make_unique<ItemManager>();
+
+    containerIds.fill(common::Item::INVALID_UNIQUE_ID);
+    ON_CALL(playerCtrl, getContainerIds()).WillByDefault(ReturnRef(containerIds));
+    EXPECT_CALL(playerCtrl, setPlayerId(_)).WillOnce(SaveArg<0>(&playerId));
+    EXPECT_TRUE(gameEngine.spawn("Player", &playerCtrl));
+  }
+
+  ~GameEngineTest() override
+  {
+    gameEngine.despawn(playerId);
+  }
+
+  // The player may not move until the walk task that is queued now runs
+  void delayNextWalk()
+  {
+    gameEngine.getPlayerData(playerId).player.setNextWalkTick(utils::Tick::now() + 20);
+  }
+
+  common::Direction getDirection() const
+  {
+    return gameEngine.getPlayerData(playerId).player.getDirection();
+  }
+
+  const common::Position& getPosition() const
+  {
+    return *gameEngine.getWorld()->getCreaturePosition(playerId);
+  }
+
+  // Runs the queued tasks, until there are none left
+  void runTasks()
+  {
+    ioContext.restart();
+    ioContext.run();
+  }
+
+  asio::io_context ioContext;
+  GameEngine gameEngine;
+  GameEngineQueue gameEngineQueue;
+  ItemStub ground;
+  ItemStub wall;
+  NiceMock<PlayerCtrlMock> playerCtrl;
+  std::array<common::ItemUniqueId, 64> containerIds;
+  common::CreatureId playerId = common::Creature::INVALID_ID;
+};
+
+TEST_F(GameEngineTest, MoveOverwritesPendingWalk)
+{
+  // The first move can't be made yet, so it is queued, and the second move replaces it
+  delayNextWalk();
+  EXPECT_CALL(playerCtrl, onCreatureMove(_, _, _, common::Position(223, 222, 7)));
+  gameEngine.move(playerId, common::Direction::NORTH);
+  gameEngine.move(playerId, common::Direction::EAST);
+  EXPECT_EQ(common::Position(222, 222, 7), getPosition());
+
+  runTasks();
+  EXPECT_EQ(common::Position(223, 222, 7), getPosition());
+}
+
+TEST_F(GameEngineTest, MoveAfterCancelMove)
+{
+  // The walk task is still queued after cancelMove, and takes the new move
+  delayNextWalk();
+  EXPECT_CALL(playerCtrl, cancelMove());
+  gameEngine.move(playerId, common::Direction::NORTH);
+  gameEngine.cancelMove(playerId);
+
+  EXPECT_CALL(playerCtrl, onCreatureMove(_, _, _, common::Position(221, 222, 7)));
+  gameEngine.move(playerId, common::Direction::WEST);
+  runTasks();
+  EXPECT_EQ(common::Position(221, 222, 7), getPosition());
+
+  // And the player can walk when nothing is queued
+  EXPECT_CALL(playerCtrl, onCreatureMove(_, _, _, common::Position(221, 223, 7)));
+  gameEngine.move(playerId, common::Direction::SOUTH);
+  runTasks();
+  EXPECT_EQ(common::Position(221, 223, 7), getPosition());
+}
+
+TEST_F(GameEngineTest, RepeatedTurnsInOneTick)
+{
+  // Only the newest turn is made, and broadcasted once
+  EXPECT_CALL(playerCtrl, onCreatureTurn(_, _, _)).Times(1);
+  gameEngine.turn(playerId, common::Direction::NORTH);
+  gameEngine.turn(playerId, common::Direction::EAST);
+  gameEngine.turn(playerId, common::Direction::WEST);
+  runTasks();
+  EXPECT_EQ(common::Direction::WEST, getDirection());
+}
+
+TEST_F(GameEngineTest, BlockedStep)
+{
+  // Both moves end up in the same walk task, so the player is only told once
+  delayNextWalk();
+  EXPECT_CALL(playerCtrl, onCreatureMove(_, _, _, _)).Times(0);
+  EXPECT_CALL(playerCtrl, sendCancel("There is no room.")).Times(1);
+  gameEngine.move(playerId, common::Direction::NORTH);
+  gameEngine.move(playerId, common::Direction::NORTH);
+  runTasks();
+  EXPECT_EQ(common::Position(222, 222, 7), getPosition());
+}
+
+TEST_F(GameEngineTest, MoveGround)
+{
+  const common::ItemPosition from(common::GamePosition(common::Position(221, 222, 7)), 100U, 0);
+  const common::GamePosition to(common::Position(220, 222, 7));
+  EXPECT_CALL(playerCtrl, sendCancel("You cannot move this object."));
+  gameEngine.moveItem(playerId, from, to, 1);
+  EXPECT_EQ(&ground, gameEngine.getWorld()->getTile(common::Position(221, 222, 7))->getItem(0));
+  EXPECT_EQ(1U, gameEngine.getWorld()->getTile(common::Position(220, 222, 7))->getNumberOfThings());
+}
+
+}  // namespace gameengine
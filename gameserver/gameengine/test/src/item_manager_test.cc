@@ -0,0 +1,179 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "item_manager.h"
+#include "position.h"
+#include "tile.h"
+#include "world.h"
+
+namespace gameengine
+{
+
+class ItemManagerTest : public ::testing::Test
+{
+ protected:
+  ItemManagerTest()
+  {
+    // Item types 100 to 104
+    for (common::ItemTypeId id = 100; id <= 104; id++)
+    {
+      itemManager.m_item_types[id].id = id;
+    }
+    itemManager.m_item_types[100].is_ground = true;
+    itemManager.m_item_types[101].is_immovable = true;
+    itemManager.m_item_types[102].is_immovable = true;
+    itemManager.m_item_types[102].is_container = true;
+    itemManager.m_item_types[103].is_stackable = true;
+    itemManager.m_item_types_id_first = 100;
+    itemManager.m_item_types_id_last = 104;
+  }
+
+  bool canShare(common::ItemTypeId item_type_id) const
+  {
+    return ItemManager::canShare(itemManager.m_item_types[item_type_id]);
+  }
+
+  ItemManager itemManager;
+};
+
+TEST_F(ItemManagerTest, CanShare)
+{
+  EXPECT_TRUE(canShare(100));   // Ground
+  EXPECT_TRUE(canShare(101));   // Immovable
+  EXPECT_FALSE(canShare(102));  // Immovable, but container
+  EXPECT_FALSE(canShare(103));  // Stackable
+  EXPECT_FALSE(canShare(104));  // Movable
+}
+
+TEST_F(ItemManagerTest, OneSharedItemPerItemType)
+{
+  const auto groundOne = itemManager.createStaticItem(100);
+  const auto groundTwo = itemManager.createStaticItem(100);
+  ASSERT_NE(common::Item::INVALID_UNIQUE_ID, groundOne);
+  EXPECT_EQ(groundOne, groundTwo);
+  EXPECT_TRUE(itemManager.isSharedItem(groundOne));
+  EXPECT_EQ(100, itemManager.getItem(groundOne)->getItemTypeId());
+
+  const auto immovable = itemManager.createStaticItem(101);
+  EXPECT_NE(groundOne, immovable);
+  EXPECT_TRUE(itemManager.isSharedItem(immovable));
+
+  // Items that can't be shared get their own item
+  const auto containerOne = itemManager.createStaticItem(102);
+  const auto containerTwo = itemManager.createStaticItem(102);
+  EXPECT_NE(containerOne, containerTwo);
+  EXPECT_FALSE(itemManager.isSharedItem(containerOne));
+
+  // And createItem never returns a shared item
+  const auto ground = itemManager.createItem(100);
+  EXPECT_NE(groundOne, ground);
+  EXPECT_FALSE(itemManager.isSharedItem(ground));
+
+  EXPECT_EQ(common::Item::INVALID_UNIQUE_ID, itemManager.createStaticItem(105));
+}
+
+TEST_F(ItemManagerTest, DestroyItem)
+{
+  // Shared items can't be destroyed
+  const auto shared = itemManager.createStaticItem(100);
+  itemManager.destroyItem(shared);
+  EXPECT_NE(nullptr, itemManager.getItem(shared));
+  EXPECT_EQ(shared, itemManager.createStaticItem(100));
+
+  const auto unique = itemManager.createItem(100);
+  itemManager.destroyItem(unique);
+  EXPECT_EQ(nullptr, itemManager.getItem(unique));
+}
+
+TEST_F(ItemManagerTest, PromoteItem)
+{
+  // Unique items are not promoted
+  const auto unique = itemManager.createItem(104);
+  EXPECT_EQ(unique, itemManager.promoteItem(unique));
+
+  const auto shared = itemManager.createStaticItem(100);
+  const auto promoted = itemManager.promoteItem(shared);
+  ASSERT_NE(common::Item::INVALID_UNIQUE_ID, promoted);
+  EXPECT_NE(shared, promoted);
+  EXPECT_FALSE(itemManager.isSharedItem(promoted));
+  EXPECT_EQ(100, itemManager.getItem(promoted)->getItemTypeId());
+
+  // The shared item is still there for everyone else
+  EXPECT_TRUE(itemManager.isSharedItem(shared));
+
+  EXPECT_EQ(common::Item::INVALID_UNIQUE_ID, itemManager.promoteItem(common::Item::INVALID_UNIQUE_ID));
+}
+
+TEST_F(ItemManagerTest, PromoteTileItem)
+{
+  // Two tiles with the same shared ground item
+  const auto shared = itemManager.createStaticItem(100);
+  std::vector<world::Tile> tiles;
+  tiles.emplace_back(itemManager.getItem(shared));
+  tiles.emplace_back(itemManager.getItem(shared));
+  world::World world(1, 2, std::move(tiles));
+  const auto& cworld = world;
+
+  const common::Position position(192, 192, 7);
+  const auto version = cworld.getTile(position)->getVersion();
+
+  auto* item = itemManager.promoteTileItem(&world, position, 0);
+  ASSERT_NE(nullptr, item);
+  EXPECT_NE(shared, item->getItemUniqueId());
+  EXPECT_FALSE(itemManager.isSharedItem(item->getItemUniqueId()));
+  EXPECT_EQ(item, cworld.getTile(position)->getItem(0));
+  EXPECT_NE(version, cworld.getTile(position)->getVersion());
+
+  // The promoted item can be modified
+  item->setCount(2);
+  EXPECT_EQ(2, item->getCount());
+
+  // The other tile still has the shared item
+  const common::Position other_position(192, 193, 7);
+  EXPECT_EQ(shared, cworld.getTile(other_position)->getItem(0)->getItemUniqueId());
+  EXPECT_EQ(1, cworld.getTile(other_position)->getItem(0)->getCount());
+
+  // Already unique, so nothing changes
+  const auto promoted_version = cworld.getTile(position)->getVersion();
+  EXPECT_EQ(item, itemManager.promoteTileItem(&world, position, 0));
+  EXPECT_EQ(promoted_version, cworld.getTile(position)->getVersion());
+
+  // No item
+  EXPECT_EQ(nullptr, itemManager.promoteTileItem(&world, position, 1));
+  EXPECT_EQ(nullptr, itemManager.promoteTileItem(&world, common::Position(100, 100, 7), 0));
+}
+
+TEST_F(ItemManagerTest, SetCountOnSharedItem)
+{
+  // Ignored, as it would modify the item on every tile
+  auto* item = itemManager.getItem(itemManager.createStaticItem(100));
+  item->setCount(2);
+  EXPECT_EQ(1U, item->getCount());
+}
+
+}  // namespace gameengine
@@ -181,6 +181,7 @@ int main()
 
   // Read [server] settings
   const auto server_port = config.getInteger("server", "port", 7171);
+  const auto acceptor_threads = config.getInteger("server", "acceptor_threads", 1);
   const auto ws_server_port = server_port + 1000;
 
   // Read [login] settings
@@ -204,6 +205,7 @@ int main()
   printf("LoginServer configuration\n");
   printf("--------------------------------------------------------------------------------\n");
   printf("Server port:               %d\n", server_port);
+  printf("Acceptor threads:          %d\n", acceptor_threads);
   printf("Websocket server port:     %d\n", ws_server_port);
   printf("\n");
   printf("Accounts filename:         %s\n", accounts_filename.c_str());
@@ -228,10 +230,21 @@ int main()
   }
 
   // Create Server
-  server = network::ServerFactory::createServer(&io_context, server_port, &onClientConnected);
+  // With more than one acceptor thread the port is opened once per thread using SO_REUSEPORT
+  if (acceptor_threads > 1)
+  {
+    server = network::ServerFactory::createMultiAcceptorServer(&io_context,
+                                                               server_port,
+                                                               acceptor_threads,
+                                                               &onClientConnected);
+  }
+  else
+  {
+    server = network::ServerFactory::createServer(&io_context, server_port, &onClientConnected);
+  }
 
   // Create websocket server
-  websocket_server = network::ServerFactory::createWebsocketServer(&io_context, ws_server_port, &onClientConnected);
+  websocket_server = network::ServerFactory::createWebsocketServer(&io_context, ws_server_port, 0U, &onClientConnected);
 
   LOG_INFO("LoginServer started!");
 
@@ -0,0 +1,314 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Echo benchmark for the server backends. Starts an echo server using the given
+// backend on one thread and opens many client connections to it on another thread.
+// Each client sends a packet, waits for it to be echoed back and then sends the next,
+// so the result shows how the backend behaves with many mostly idle connections
+// that each have a single packet in flight.
+//
+// Usage: network_benchmark <asio|io_uring> [connections] [seconds] [payload size]
+//
+// Remember to raise the open file limit (ulimit -n) when using many connections.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <asio.hpp>
+
+// utils
+#include "logger.h"
+
+// network
+#include "connection.h"
+#include "server.h"
+#include "server_factory.h"
+
+namespace
+{
+
+constexpr int PORT = 7373;
+
+using Clock = std::chrono::steady_clock;
+
+class Client
+{
+ public:
+  Client(asio::io_context* io_context, std::size_t payload_size, const std::atomic<bool>* measuring)
+    : m_socket(*io_context),
+      m_buffer(2U + payload_size),
+      m_measuring(measuring)
+  {
+    m_buffer[0] = static_cast<std::uint8_t>(payload_size);
+    m_buffer[1] = static_cast<std::uint8_t>(payload_size >> 8);
+  }
+
+  bool connect()
+  {
+    std::error_code error;
+    m_socket.connect(asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), PORT), error);
+    if (error)
+    {
+      LOG_ERROR("%s: could not connect: %s", __func__, error.message().c_str());
+      return false;
+    }
+    m_socket.set_option(asio::ip::tcp::no_delay(true));
+    return true;
+  }
+
+  void start()
+  {
+    send();
+  }
+
+  void stop()
+  {
+    std::error_code error;
+    m_socket.close(error);
+  }
+
+  const std::vector<std::uint32_t>& getLatencies() const { return m_latencies_us; }
+
+ private:
+  void send()
+  {
+    m_sent = Clock::now();
+    asio::async_write(m_socket,
+                      asio::buffer(m_buffer),
+                      [this](const std::error_code& error, std::size_t)
+                      {
+                        if (!error)
+                        {
+                          receive();
+                        }
+                      });
+  }
+
+  void receive()
+  {
+    asio::async_read(m_socket,
+                     asio::buffer(m_buffer),
+                     [this](const std::error_code& error, std::size_t)
+                     {
+                       if (error)
+                       {
+                         return;
+                       }
+
+                       if (m_measuring->load(std::memory_order_relaxed))
+                       {
+                         const auto latency = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - m_sent);
+                         m_latencies_us.push_back(static_cast<std::uint32_t>(latency.count()));
+                       }
+                       send();
+                     });
+  }
+
+  asio::ip::tcp::socket m_socket;
+  std::vector<std::uint8_t> m_buffer;
+  const std::atomic<bool>* m_measuring;
+  Clock::time_point m_sent;
+  std::vector<std::uint32_t> m_latencies_us;
+};
+
+void printUsage(const char* program)
+{
+  fprintf(stderr, "Usage: %s <asio|io_uring> [connections] [seconds] [payload size]\n", program);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+  if (argc < 2)
+  {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  const std::string backend = argv[1];
+  const auto num_connections = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 2000UL;
+  const auto seconds = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 10UL;
+  const auto payload_size = argc > 4 ? std::strtoul(argv[4], nullptr, 10) : 64UL;
+  if ((backend != "asio" && backend != "io_uring") ||
+      num_connections == 0U ||
+      seconds == 0U ||
+      payload_size == 0U ||
+      payload_size > 0xFFFFU)
+  {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  // Logging each packet would dominate the benchmark
+  utils::Logger::setLevel("network", "ERROR");
+
+  // Server: echo each packet back to the client
+  // The packet header is added here instead of by the connection, so that each
+  // response is sent with a single write
+  asio::io_context server_io_context;
+  auto server_work = asio::make_work_guard(server_io_context);
+  std::unique_ptr<network::Server> server;
+  std::vector<std::unique_ptr<network::Connection>> connections;
+  std::size_t num_disconnected = 0U;
+  bool stopping = false;
+
+  // Stops the server thread once all clients have disconnected
+  const auto stop_server = [&]()
+  {
+    if (stopping && num_disconnected == connections.size())
+    {
+      server.reset();
+      server_work.reset();
+    }
+  };
+
+  const auto on_client_connected = [&](std::unique_ptr<network::Connection>&& connection)
+  {
+    auto* connection_ptr = connection.get();
+    network::Connection::Callbacks callbacks;
+    callbacks.on_packet_received = [connection_ptr](network::IncomingPacket* packet)
+    {
+      const auto length = packet->bytesLeft();
+      network::OutgoingPacket response(2U + length);
+      response.addU16(static_cast<std::uint16_t>(length));
+      const auto bytes = packet->getBytes(static_cast<int>(length));
+      response.addRawData(bytes.data(), bytes.size());
+      connection_ptr->sendPacket(std::move(response));
+    };
+    callbacks.on_disconnected = [&]()
+    {
+      num_disconnected += 1U;
+      stop_server();
+    };
+    connection->init(callbacks, true);
+    connections.push_back(std::move(connection));
+  };
+
+  if (backend == "asio")
+  {
+    server = network::ServerFactory::createServer(&server_io_context, PORT, on_client_connected);
+  }
+  else
+  {
+    server = network::ServerFactory::createIoUringServer(&server_io_context, PORT, on_client_connected);
+  }
+
+  if (!server)
+  {
+    LOG_ERROR("%s: could not create %s server", __func__, backend.c_str());
+    return 1;
+  }
+
+  std::thread server_thread([&server_io_context] { server_io_context.run(); });
+
+  // Clients
+  asio::io_context client_io_context;
+  std::atomic<bool> measuring(false);
+  std::vector<std::unique_ptr<Client>> clients;
+  for (auto i = 0UL; i < num_connections; i++)
+  {
+    clients.push_back(std::make_unique<Client>(&client_io_context, payload_size, &measuring));
+    if (!clients.back()->connect())
+    {
+      server_io_context.stop();
+      server_thread.join();
+      return 1;
+    }
+  }
+
+  for (auto& client : clients)
+  {
+    client->start();
+  }
+
+  std::thread client_thread([&client_io_context] { client_io_context.run(); });
+
+  // Warm up for a second before measuring
+  std::this_thread::sleep_for(std::chrono::seconds(1));
+  measuring = true;
+  const auto start = Clock::now();
+  std::this_thread::sleep_for(std::chrono::seconds(seconds));
+  measuring = false;
+  const auto elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+  // Disconnect the clients and wait for the server to see all disconnects
+  asio::post(client_io_context,
+             [&clients]()
+             {
+               for (auto& client : clients)
+               {
+                 client->stop();
+               }
+             });
+  client_thread.join();
+
+  asio::post(server_io_context,
+             [&]()
+             {
+               stopping = true;
+               stop_server();
+             });
+  server_thread.join();
+
+  // Results
+  std::vector<std::uint32_t> latencies;
+  for (const auto& client : clients)
+  {
+    latencies.insert(latencies.end(), client->getLatencies().begin(), client->getLatencies().end());
+  }
+
+  if (latencies.empty())
+  {
+    LOG_ERROR("%s: no round trips completed", __func__);
+    return 1;
+  }
+
+  std::sort(latencies.begin(), latencies.end());
+  const auto percentile = [&latencies](double p)
+  {
+    return latencies[static_cast<std::size_t>(p * static_cast<double>(latencies.size() - 1U))];
+  };
+  const auto round_trips = static_cast<double>(latencies.size());
+  const auto megabytes = round_trips * 2.0 * static_cast<double>(2U + payload_size) / (1024.0 * 1024.0);
+
+  printf("backend:      %s\n", backend.c_str());
+  printf("connections:  %lu\n", num_connections);
+  printf("payload size: %lu\n", payload_size);
+  printf("round trips:  %.0f/s\n", round_trips / elapsed);
+  printf("throughput:   %.2f MB/s\n", megabytes / elapsed);
+  printf("latency p50:  %u us\n", percentile(0.50));
+  printf("latency p99:  %u us\n", percentile(0.99));
+  printf("latency max:  %u us\n", latencies.back());
+
+  return 0;
+}
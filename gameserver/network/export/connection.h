@@ -25,6 +25,8 @@
 #ifndef NETWORK_EXPORT_CONNECTION_H_
 #define NETWORK_EXPORT_CONNECTION_H_
 
+#include <cstddef>
+#include <cstdint>
 #include <functional>
 
 #include "incoming_packet.h"
@@ -42,11 +44,43 @@ class Connection
     std::function<void(void)> on_disconnected;
   };
 
+  // Limits for the outgoing packet queue
+  // The connection becomes congested when either high watermark is reached and is
+  // no longer congested when the queue is at or below both low watermarks
+  // A high watermark of 0 disables that limit
+  struct QueueLimits
+  {
+    std::size_t high_watermark_bytes = 0U;
+    std::size_t low_watermark_bytes = 0U;
+    std::size_t high_watermark_packets = 0U;
+    std::size_t low_watermark_packets = 0U;
+  };
+
+  // Current depth of the outgoing packet queue, and some counters since the connection was created
+  // bytes also counts data that the backend has accepted but not yet written, e.g. websocketpp
+  // buffers each message itself and completes the write right away, so that the queue of
+  // the connection never holds more than one packet with that backend
+  struct QueueStats
+  {
+    std::size_t packets = 0U;
+    std::size_t bytes = 0U;
+    std::size_t peak_packets = 0U;
+    std::size_t peak_bytes = 0U;
+    std::uint64_t times_congested = 0U;
+    bool congested = false;
+  };
+
   virtual ~Connection() = default;
 
   virtual void init(const Callbacks& callbacks, bool skip_send_packet_header) = 0;
   virtual void close(bool force) = 0;
   virtual void sendPacket(OutgoingPacket&& packet) = 0;
+
+  // The queue is not checked against the limits when packets are sent or written, as the
+  // connection might be closed (and deleted) during those calls. The owner polls it instead,
+  // using updateQueueStats, e.g. after each sendPacket and periodically while congested
+  virtual void setQueueLimits(const QueueLimits& limits) = 0;
+  virtual const QueueStats& updateQueueStats() = 0;
 };
 
 }  // namespace network
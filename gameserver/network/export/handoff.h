@@ -0,0 +1,74 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NETWORK_EXPORT_HANDOFF_H_
+#define NETWORK_EXPORT_HANDOFF_H_
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace asio
+{
+class io_context;
+}
+
+namespace network
+{
+
+// Hands over listening sockets from a running server process to a new one over a local
+// Unix socket (SCM_RIGHTS), so that the port is never closed during a restart.
+//
+// The old process calls listen. The new process calls receive, which connects to the old
+// process and gets duplicates of its listening sockets (see Server::getListeningSockets).
+// The old process then calls on_handoff, in which it should stop accepting connections,
+// i.e. delete its Server, and the new process' receive returns when that is done.
+class Handoff
+{
+ public:
+  using GetListeningSocketsCallback = std::function<std::vector<int>()>;
+  using OnHandoffCallback = std::function<void()>;
+
+  virtual ~Handoff() = default;
+
+  // Accepts a single handoff request on path, any stale socket file at path is removed.
+  // get_listening_sockets and on_handoff are called on io_context, and it is allowed to
+  // delete the returned Handoff in on_handoff.
+  // Returns nullptr if path could not be listened on.
+  static std::unique_ptr<Handoff> listen(asio::io_context* io_context,
+                                         const std::string& path,
+                                         const GetListeningSocketsCallback& get_listening_sockets,
+                                         const OnHandoffCallback& on_handoff);
+
+  // Blocks until the listening sockets have been received from the process listening on
+  // path, and that process has stopped accepting connections. The caller takes ownership
+  // of the sockets, e.g. by passing them to ServerFactory::createServerFromSockets.
+  // Returns false if there is no process listening on path, or if the handoff failed.
+  static bool receive(const std::string& path, std::vector<int>* listening_sockets);
+};
+
+}  // namespace network
+
+#endif  // NETWORK_EXPORT_HANDOFF_H_
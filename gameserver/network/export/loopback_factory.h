@@ -0,0 +1,61 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NETWORK_EXPORT_LOOPBACK_FACTORY_H_
+#define NETWORK_EXPORT_LOOPBACK_FACTORY_H_
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+namespace asio
+{
+class io_context;
+}
+
+namespace network
+{
+
+class Connection;
+
+class LoopbackFactory
+{
+ public:
+  using ConnectionPair = std::pair<std::unique_ptr<Connection>, std::unique_ptr<Connection>>;
+
+  static constexpr std::size_t DEFAULT_BUFFER_SIZE = 65536U;
+
+  // Creates two connections that are connected to each other in memory, so that packets
+  // sent on one are received on the other, without using any sockets. Give one of them to
+  // the server side (e.g. as if it came from Server's on_client_connected) and use the other
+  // as the client. All callbacks are called on io_context, so both connections must only be
+  // used from the thread that runs it.
+  // Each connection buffers at most buffer_size bytes that the other side has not read yet.
+  static ConnectionPair createConnectionPair(asio::io_context* io_context,
+                                             std::size_t buffer_size = DEFAULT_BUFFER_SIZE);
+};
+
+}  // namespace network
+
+#endif  // NETWORK_EXPORT_LOOPBACK_FACTORY_H_
@@ -25,6 +25,7 @@
 #ifndef NETWORK_EXPORT_OUTGOING_PACKET_H_
 #define NETWORK_EXPORT_OUTGOING_PACKET_H_
 
+#include <cstddef>
 #include <cstdint>
 #include <array>
 #include <string>
@@ -38,19 +39,49 @@ namespace network
 class OutgoingPacket
 {
  public:
+  // The packet length is sent as a 16 bit value
+  static constexpr std::size_t MAX_LENGTH = 0xFFFF;
+
+  // Capacity of packets that are not given a size hint, which is the smallest size class
+  // Most packets are a few bytes (e.g. cancel move or a creature turn) and the buffer grows
+  // as needed, so writers of large packets should give a size hint or reserve instead
+  static constexpr std::size_t DEFAULT_CAPACITY = 64;
+
   OutgoingPacket();
+
+  // Creates a packet with room for at least capacity bytes, use this when the final
+  // length of the packet is known (or can be calculated) beforehand
+  explicit OutgoingPacket(std::size_t capacity);
+
   virtual ~OutgoingPacket();
 
-  OutgoingPacket(OutgoingPacket&&) = default;
-  OutgoingPacket& operator=(OutgoingPacket&&) = default;
+  OutgoingPacket(OutgoingPacket&& other) noexcept;
+  OutgoingPacket& operator=(OutgoingPacket&& other) noexcept;
 
   // Delete copy constructors
   OutgoingPacket(const OutgoingPacket&) = delete;
   OutgoingPacket& operator=(const OutgoingPacket&) = delete;
 
-  const std::uint8_t* getBuffer() const { return m_buffer->data(); }
+  const std::uint8_t* getBuffer() const { return m_buffer.get(); }
   std::size_t getLength() const { return m_position; }
+  std::size_t getCapacity() const { return m_capacity; }
+  std::size_t bytesLeft() const { return MAX_LENGTH - m_position; }
+
+  // True if something did not fit in the packet, then nothing more is added to it and the
+  // packet is incomplete, so it must not be sent (Connection::sendPacket drops it)
+  bool hasOverflowed() const { return m_overflowed; }
 
+  // Makes sure that num_bytes more bytes can be added without the buffer being replaced
+  // Returns false if the packet would become longer than MAX_LENGTH
+  // Writers of messages that the client can make large should check this first
+  bool reserve(std::size_t num_bytes);
+
+  // Returns a pointer to the next num_bytes bytes in the packet, which the caller must write,
+  // or nullptr if the packet would become longer than MAX_LENGTH, which overflows the packet
+  std::uint8_t* reserveBytes(std::size_t num_bytes);
+
+  // The buffer grows as needed when adding values, but adding more than MAX_LENGTH
+  // bytes overflows the packet, see hasOverflowed
   void skipBytes(std::size_t num_bytes);
   void addU8(std::uint8_t val);
   void addU16(std::uint16_t val);
@@ -70,10 +101,24 @@ class OutgoingPacket
   void add(T) = delete;
 
  private:
-  std::unique_ptr<std::array<std::uint8_t, 8192>> m_buffer;
+  using Buffer = std::unique_ptr<std::uint8_t[]>;
+
+  // Buffers are pooled per size class, where each size class is a power of two
+  static constexpr std::size_t MIN_SIZE_CLASS_BITS = 6;   // 64 bytes
+  static constexpr std::size_t MAX_SIZE_CLASS_BITS = 16;  // 64 KiB
+  static constexpr std::size_t NUM_SIZE_CLASSES = MAX_SIZE_CLASS_BITS - MIN_SIZE_CLASS_BITS + 1;
+  static_assert(DEFAULT_CAPACITY == std::size_t(1) << MIN_SIZE_CLASS_BITS, "DEFAULT_CAPACITY must be the smallest size class");
+
+  static std::size_t getSizeClass(std::size_t capacity);
+  static Buffer allocateBuffer(std::size_t size_class);
+  static void releaseBuffer(std::size_t size_class, Buffer&& buffer);
+
+  Buffer m_buffer;
+  std::size_t m_capacity{0};
   std::size_t m_position{0};
+  bool m_overflowed{false};
 
-  static std::stack<std::unique_ptr<std::array<std::uint8_t, 8192>>> m_bufferpool;
+  static std::array<std::stack<Buffer>, NUM_SIZE_CLASSES> m_bufferpools;
 };
 
 }  // namespace network
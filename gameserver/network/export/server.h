@@ -25,6 +25,8 @@
 #ifndef NETWORK_EXPORT_SERVER_H_
 #define NETWORK_EXPORT_SERVER_H_
 
+#include <vector>
+
 namespace network
 {
 
@@ -33,7 +35,14 @@ class Server
  public:
   virtual ~Server() = default;
 
-  // TODO(simon): start / stop?
+  // Returns the native handles of the sockets that the server listens on, e.g. to hand
+  // them over to another process (see Handoff). The sockets are still owned by the server.
+  // Returns an empty vector if the server's sockets can't be handed over.
+  virtual std::vector<int> getListeningSockets() { return {}; }
+
+  // Stops accepting new connections and closes the listening sockets. Connections that are
+  // already accepted are not affected, and the server must be kept alive until they are closed.
+  virtual void stopAccepting() = 0;
 };
 
 }  // namespace network
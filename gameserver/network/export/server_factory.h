@@ -25,8 +25,10 @@
 #ifndef NETWORK_EXPORT_SERVER_FACTORY_H_
 #define NETWORK_EXPORT_SERVER_FACTORY_H_
 
+#include <cstddef>
 #include <functional>
 #include <memory>
+#include <vector>
 
 namespace asio
 {
@@ -48,8 +50,33 @@ class ServerFactory
                                               int port,
                                               const OnClientConnectedCallback& on_client_connected);
 
+  // Same as createServer but listens with num_acceptors sockets using SO_REUSEPORT, each
+  // accepting connections on its own thread. The connections are still handled on io_context.
+  static std::unique_ptr<Server> createMultiAcceptorServer(asio::io_context* io_context,
+                                                           int port,
+                                                           int num_acceptors,
+                                                           const OnClientConnectedCallback& on_client_connected);
+
+  // Same as createServer, or createMultiAcceptorServer if there is more than one socket, but
+  // accepts connections on already listening sockets instead of opening the port, e.g. the
+  // sockets received with Handoff::receive. Takes ownership of the sockets.
+  static std::unique_ptr<Server> createServerFromSockets(asio::io_context* io_context,
+                                                         const std::vector<int>& listening_sockets,
+                                                         const OnClientConnectedCallback& on_client_connected);
+
+  // Same as createServer but using io_uring instead of asio for socket I/O, completions are
+  // still handled on io_context. Returns nullptr if io_uring support was not compiled in
+  // (GAMESERVER_IO_URING), if the kernel lacks an io_uring operation or feature that is used,
+  // or if the port could not be listened on, so that the caller can fall back to createServer.
+  static std::unique_ptr<Server> createIoUringServer(asio::io_context* io_context,
+                                                     int port,
+                                                     const OnClientConnectedCallback& on_client_connected);
+
+  // Packets of at least compression_threshold bytes are compressed using permessage-deflate,
+  // for clients that support it. A compression_threshold of 0 disables compression.
   static std::unique_ptr<Server> createWebsocketServer(asio::io_context* io_context,
                                                        int port,
+                                                       std::size_t compression_threshold,
                                                        const OnClientConnectedCallback& on_client_connected);
 };
 
@@ -34,6 +34,12 @@
 namespace network
 {
 
+// A socket that is already listening, e.g. received from another process
+struct ListeningSocket
+{
+  int native_handle;
+};
+
 template <typename Backend>
 class Acceptor
 {
@@ -41,8 +47,31 @@ class Acceptor
   Acceptor(typename Backend::Service* io_context,
            int port,
            std::function<void(typename Backend::Socket&&)> on_accept)
-    : m_acceptor(*io_context, port),
-      m_socket(*io_context),
+    : Acceptor(io_context, io_context, port, false, std::move(on_accept))
+  {
+  }
+
+  // Listens using acceptor_service and accepts connections into sockets on socket_service
+  // With reuse_port, SO_REUSEPORT is set so that multiple acceptors can listen on the same port
+  Acceptor(typename Backend::Service* acceptor_service,
+           typename Backend::Service* socket_service,
+           int port,
+           bool reuse_port,
+           std::function<void(typename Backend::Socket&&)> on_accept)
+    : m_acceptor(*acceptor_service, port, reuse_port),
+      m_socket(*socket_service),
+      m_on_accept(std::move(on_accept))
+  {
+    accept();
+  }
+
+  // Accepts connections on an already listening socket, and takes ownership of it
+  Acceptor(typename Backend::Service* acceptor_service,
+           typename Backend::Service* socket_service,
+           ListeningSocket listening_socket,
+           std::function<void(typename Backend::Socket&&)> on_accept)
+    : m_acceptor(*acceptor_service, listening_socket),
+      m_socket(*socket_service),
       m_on_accept(std::move(on_accept))
   {
     accept();
@@ -50,13 +79,36 @@ class Acceptor
 
   virtual ~Acceptor()
   {
-    m_acceptor.cancel();
+    if (!m_stopped)
+    {
+      m_acceptor.cancel();
+    }
   }
 
   // Delete copy constructors
   Acceptor(const Acceptor&) = delete;
   Acceptor& operator=(const Acceptor&) = delete;
 
+  // The listening socket, which is still owned by this instance
+  int getNativeHandle() { return m_acceptor.native_handle(); }
+
+  // Stops accepting connections and closes the listening socket
+  void stop()
+  {
+    if (m_stopped)
+    {
+      return;
+    }
+    m_stopped = true;
+
+    typename Backend::ErrorCode error_code;
+    m_acceptor.close(error_code);
+    if (error_code)
+    {
+      LOG_ERROR("%s: could not close acceptor: %s", __func__, error_code.message().c_str());
+    }
+  }
+
  private:
   void accept()
   {
@@ -86,6 +138,7 @@ class Acceptor
   typename Backend::Acceptor m_acceptor;
   typename Backend::Socket m_socket;
   std::function<void(typename Backend::Socket&&)> m_on_accept;
+  bool m_stopped = false;
 };
 
 }  // namespace network
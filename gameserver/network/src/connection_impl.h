@@ -27,6 +27,8 @@
 
 #include "connection.h"
 
+#include <algorithm>
+#include <array>
 #include <deque>
 #include <memory>
 #include <vector>
@@ -48,6 +50,12 @@ namespace network
  *   on_disconnected:    called when the connection is closed and
  *                       this instance is ready for deletion
  *
+ * Outgoing packets are queued until they have been written. The queue has no limit
+ * by default, setQueueLimits() sets high and low watermarks (in bytes and in packets)
+ * and updateQueueStats() tells the owner if the queue has crossed them, so that it can
+ * stop queueing packets to a slow client. Backends that buffer written data themselves
+ * report it with Backend::get_buffered_amount, and it is counted as queued bytes.
+ *
  * There are three ways a connection can be closed:
  *   1. Owner asks to close the connection gracefully, using close(force=false).
  *
@@ -76,12 +84,11 @@ namespace network
  *      The on_disconnected callback is called as soon as there is no send and
  *      no receive call in progress.
  *
- * Connection handles its receive loop itself, which is started in its constructor:
- *   1. receivePacket()
+ * Connection handles its receive loop itself, which is started in init():
+ *   1. receivePacket(), reads as much data as is available into the read buffer
  *   2. receivePacket lambda
- *   3. onPacketHeaderReceived()
- *   4. onPacketHeaderReceived lambda
- *   5. onPacketDataReceived()
+ *   3. onDataReceived(), calls on_packet_received for each complete packet in the
+ *      read buffer, keeps any partial packet and goes back to 1.
  *
  */
 template <typename Backend>
@@ -154,13 +161,67 @@ class ConnectionImpl : public Connection
       return;
     }
 
+    if (packet.hasOverflowed())
+    {
+      // Only this packet is dropped, it is incomplete and the client can't parse it
+      LOG_ERROR("%s: cannot send packet, it has overflowed (length: %lu)", __func__, packet.getLength());
+      return;
+    }
+
+    m_queue_stats.packets += 1U;
+    m_queued_bytes += packet.getLength();
+    m_queue_stats.peak_packets = std::max(m_queue_stats.peak_packets, m_queue_stats.packets);
+    m_queue_stats.peak_bytes = std::max(m_queue_stats.peak_bytes, m_queued_bytes);
     m_outgoing_packets.push_back(std::move(packet));
 
     // Start to send packet if this is the only packet in the queue
     if (!m_send_in_progress)
     {
-      sendPacketInternal();
+      sendPacketInternal();  // Note that this instance might be deleted during this call
+    }
+  }
+
+  void setQueueLimits(const QueueLimits& limits) override
+  {
+    m_queue_limits = limits;
+  }
+
+  const QueueStats& updateQueueStats() override
+  {
+    m_queue_stats.bytes = m_queued_bytes + Backend::get_buffered_amount(m_socket);
+    m_queue_stats.peak_bytes = std::max(m_queue_stats.peak_bytes, m_queue_stats.bytes);
+
+    const auto above = [](std::size_t value, std::size_t high) { return high != 0U && value >= high; };
+    const auto below = [](std::size_t value, std::size_t high, std::size_t low) { return high == 0U || value <= low; };
+
+    bool congested = m_queue_stats.congested;
+    if (!congested)
+    {
+      congested = above(m_queue_stats.bytes, m_queue_limits.high_watermark_bytes) ||
+                  above(m_queue_stats.packets, m_queue_limits.high_watermark_packets);
+    }
+    else
+    {
+      congested = !(below(m_queue_stats.bytes, m_queue_limits.high_watermark_bytes, m_queue_limits.low_watermark_bytes) &&
+                    below(m_queue_stats.packets, m_queue_limits.high_watermark_packets, m_queue_limits.low_watermark_packets));
+    }
+
+    if (congested != m_queue_stats.congested)
+    {
+      LOG_DEBUG("%s: congested: %s, packets in queue: %u, bytes in queue: %u",
+                __func__,
+                (congested ? "true" : "false"),
+                m_queue_stats.packets,
+                m_queue_stats.bytes);
+
+      m_queue_stats.congested = congested;
+      if (congested)
+      {
+        m_queue_stats.times_congested += 1U;
+      }
     }
+
+    return m_queue_stats;
   }
 
  private:
@@ -237,6 +298,8 @@ class ConnectionImpl : public Connection
 
   void onPacketDataSent()
   {
+    m_queue_stats.packets -= 1U;
+    m_queued_bytes -= m_outgoing_packets.front().getLength();
     m_outgoing_packets.pop_front();
     if (!m_outgoing_packets.empty())
     {
@@ -262,93 +325,97 @@ class ConnectionImpl : public Connection
   {
     m_receive_in_progress = true;
 
-    Backend::async_read(m_socket,
-                        m_read_buffer.data(),
-                        2,
-                        [this](const typename Backend::ErrorCode& error_code, std::size_t len)
-                        {
-                          if (error_code || len != 2u || m_closing)
-                          {
-                            LOG_DEBUG("%s: error_code: %s, len: %d (expected: 2), m_closing: %s",
-                                      __func__,
-                                      error_code.message().c_str(),
-                                      len,
-                                      (m_closing ? "true" : "false"));
-                            m_receive_in_progress = false;
-                            closeSocket();  // Note that this instance might be deleted during this call
-                            return;
-                          }
-
-                          onPacketHeaderReceived();
-                        });
-  }
-
-  void onPacketHeaderReceived()
-  {
-    // Receive data
-    const auto packet_length = (m_read_buffer[1] << 8) | m_read_buffer[0];
-
-    LOG_DEBUG("%s: received packet header, packet length: %d", __func__, packet_length);
-
-    if (packet_length == 0)
+    // Move any partially received packet to the beginning of the buffer, to make room for more data
+    if (m_read_begin > 0U)
     {
-      LOG_DEBUG("%s: packet length 0 is invalid, closing connection", __func__);
-      m_receive_in_progress = false;
-      closeSocket();
-      return;
+      std::copy(m_read_buffer.begin() + m_read_begin, m_read_buffer.begin() + m_read_end, m_read_buffer.begin());
+      m_read_end -= m_read_begin;
+      m_read_begin = 0U;
     }
 
-    Backend::async_read(m_socket,
-                        m_read_buffer.data(),
-                        packet_length,
-                        [this, packet_length](const typename Backend::ErrorCode& error_code, std::size_t len)
-                        {
-                          if (error_code || static_cast<int>(len) != packet_length || m_closing)
-                          {
-                            LOG_DEBUG("%s: error_code: %s, len: %d (expected: %d), m_closing: %s",
-                                      __func__,
-                                      error_code.message().c_str(),
-                                      len,
-                                      packet_length,
-                                      (m_closing ? "true" : "false"));
-                            m_receive_in_progress = false;
-
-                            // Only close the socket on error or if m_closing is true and send not in
-                            // progress (i.e. close(force=false))
-                            if (error_code ||
-                                static_cast<int>(len) != packet_length ||
-                                (m_closing && !m_send_in_progress))
-                            {
-                              closeSocket();  // Note that this instance might be deleted during this call
-                            }
-                            return;
-                          }
-
-                          onPacketDataReceived(len);
-                        });
+    // Read as much as is available, which might be several packets
+    Backend::async_read_some(m_socket,
+                             m_read_buffer.data() + m_read_end,
+                             m_read_buffer.size() - m_read_end,
+                             [this](const typename Backend::ErrorCode& error_code, std::size_t len)
+                             {
+                               if (error_code || len == 0U || m_closing)
+                               {
+                                 LOG_DEBUG("%s: error_code: %s, len: %d, m_closing: %s",
+                                           __func__,
+                                           error_code.message().c_str(),
+                                           len,
+                                           (m_closing ? "true" : "false"));
+                                 m_receive_in_progress = false;
+
+                                 // Only close the socket on error or if m_closing is true and send not in
+                                 // progress (i.e. close(force=false))
+                                 if (error_code || len == 0U || !m_send_in_progress)
+                                 {
+                                   closeSocket();  // Note that this instance might be deleted during this call
+                                 }
+                                 return;
+                               }
+
+                               m_read_end += len;
+                               onDataReceived();
+                             });
   }
 
-  void onPacketDataReceived(std::size_t len)
+  void onDataReceived()
   {
-    LOG_DEBUG("%s: received packet data, packet length: %d", __func__, len);
+    // Handle each complete packet in the buffer
+    while (m_read_end - m_read_begin >= 2U)
+    {
+      const auto* header = m_read_buffer.data() + m_read_begin;
+      const std::size_t packet_length = (header[1] << 8) | header[0];
 
-    // Call handler
-    // Maybe it should stated somewhere that the IncomingPacket is only valid to read/use
-    // during the on_packet_received call
-    IncomingPacket packet(m_read_buffer.data(), len);
-    m_callbacks.on_packet_received(&packet);
+      if (packet_length == 0U)
+      {
+        LOG_DEBUG("%s: packet length 0 is invalid, closing connection", __func__);
+        m_receive_in_progress = false;
+        closeSocket();
+        return;
+      }
 
-    // m_closing might have been changed due to the packet that was received above
-    // so check it again
-    if (m_closing)
-    {
-      // Don't continue if we are about to shut down
-      m_receive_in_progress = false;
-      if (!m_send_in_progress)
+      if (m_read_end - m_read_begin < 2U + packet_length)
       {
-        closeSocket();  // Note that this instance might be deleted during this call
+        // Wait for the rest of the packet, and make sure that it fits in the buffer
+        if (2U + packet_length > m_read_buffer.size())
+        {
+          LOG_DEBUG("%s: increasing read buffer size to %d", __func__, 2U + packet_length);
+          m_read_buffer.resize(2U + packet_length);
+        }
+        break;
       }
-      return;
+
+      LOG_DEBUG("%s: received packet, packet length: %d", __func__, packet_length);
+
+      // Call handler
+      // Maybe it should stated somewhere that the IncomingPacket is only valid to read/use
+      // during the on_packet_received call
+      IncomingPacket packet(m_read_buffer.data() + m_read_begin + 2U, packet_length);
+      m_read_begin += 2U + packet_length;
+      m_callbacks.on_packet_received(&packet);
+
+      // m_closing might have been changed due to the packet that was received above
+      // so check it again
+      if (m_closing)
+      {
+        // Don't continue if we are about to shut down
+        m_receive_in_progress = false;
+        if (!m_send_in_progress)
+        {
+          closeSocket();  // Note that this instance might be deleted during this call
+        }
+        return;
+      }
+    }
+
+    if (m_read_begin == m_read_end)
+    {
+      m_read_begin = 0U;
+      m_read_end = 0U;
     }
 
     // Receive more packets
@@ -392,10 +459,19 @@ class ConnectionImpl : public Connection
   bool m_skip_send_packet_header = false;
 
   // I/O Buffers
-  std::array<std::uint8_t, 8192> m_read_buffer;
+  // Received data is in [m_read_begin, m_read_end), the buffer grows if a packet doesn't fit
+  static constexpr std::size_t INITIAL_READ_BUFFER_SIZE = 8192;
+  std::vector<std::uint8_t> m_read_buffer = std::vector<std::uint8_t>(INITIAL_READ_BUFFER_SIZE);
+  std::size_t m_read_begin = 0U;
+  std::size_t m_read_end = 0U;
 
   std::array<std::uint8_t, 2> m_outgoing_header_buffer;
   std::deque<OutgoingPacket> m_outgoing_packets;
+
+  // Outgoing queue backpressure, m_queued_bytes does not include the data buffered by the backend
+  QueueLimits m_queue_limits;
+  QueueStats m_queue_stats;
+  std::size_t m_queued_bytes = 0U;
 };
 
 }  // namespace network
@@ -24,6 +24,8 @@
 
 #include "emscripten_client_backend.h"
 
+#include <algorithm>
+
 #include "logger.h"
 
 namespace network
@@ -117,7 +119,7 @@ void EmscriptenClient::asyncRead(std::uint8_t* buffer,
 void EmscriptenClient::checkAsyncRead()
 {
   // Calling the handler might queue another async_read, so continue to check
-  // until either the buffer is nullptr (no new async_read made) or we don't have enough
+  // until either the buffer is nullptr (no new async_read made) or we don't have any
   // data
   /*
   LOG_DEBUG("%s: have buffer=%s, m_read_buffer.size() = %d, m_async_read_length=%d",
@@ -126,14 +128,15 @@ void EmscriptenClient::checkAsyncRead()
             static_cast<int>(m_read_buffer.size()),
             static_cast<int>(m_async_read_length));
   */
-  while (m_async_read_buffer && m_read_buffer.size() >= m_async_read_length)
+  while (m_async_read_buffer && !m_read_buffer.empty())
   {
+    const auto length = std::min(m_read_buffer.size(), m_async_read_length);
     std::copy(m_read_buffer.begin(),
-              m_read_buffer.begin() + m_async_read_length,
+              m_read_buffer.begin() + length,
               m_async_read_buffer);
-    m_read_buffer.erase(m_read_buffer.begin(), m_read_buffer.begin() + m_async_read_length);
+    m_read_buffer.erase(m_read_buffer.begin(), m_read_buffer.begin() + length);
     m_async_read_buffer = nullptr;
-    m_async_read_handler(ErrorCode(), m_async_read_length);
+    m_async_read_handler(ErrorCode(), length);
   }
 }
 
@@ -145,10 +148,10 @@ void EmscriptenClientBackend::async_write(Socket& socket,
   socket.client->asyncWrite(buffer, length, handler);
 }
 
-void EmscriptenClientBackend::async_read(Socket& socket,
-                                         std::uint8_t* buffer,
-                                         std::size_t length,
-                                         const EmscriptenClient::AsyncHandler& handler)
+void EmscriptenClientBackend::async_read_some(Socket& socket,
+                                              std::uint8_t* buffer,
+                                              std::size_t length,
+                                              const EmscriptenClient::AsyncHandler& handler)
 {
   socket.client->asyncRead(buffer, length, handler);
 }
@@ -59,6 +59,7 @@ class EmscriptenClient
   void asyncWrite(const std::uint8_t* buffer,
                   std::size_t length,
                   const AsyncHandler& handler);
+  // asyncRead completes as soon as there is any data, with at most length bytes
   void asyncRead(std::uint8_t* buffer,
                  std::size_t length,
                  const AsyncHandler& handler);
@@ -102,10 +103,17 @@ struct EmscriptenClientBackend
                           std::size_t length,
                           const EmscriptenClient::AsyncHandler& handler);
 
-  static void async_read(Socket& socket,
-                         std::uint8_t* buffer,
-                         std::size_t length,
-                         const EmscriptenClient::AsyncHandler& handler);
+  // The client doesn't limit its queue, so the data buffered by the browser is not needed
+  static std::size_t get_buffered_amount(const Socket& socket)
+  {
+    (void)socket;
+    return 0U;
+  }
+
+  static void async_read_some(Socket& socket,
+                              std::uint8_t* buffer,
+                              std::size_t length,
+                              const EmscriptenClient::AsyncHandler& handler);
 };
 
 }  // namespace network
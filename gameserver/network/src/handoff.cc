@@ -0,0 +1,265 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "handoff.h"
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#include <asio.hpp>
+
+#include "logger.h"
+
+namespace
+{
+
+// Upper limit of sockets in a single handoff, see MultiAcceptorServerImpl
+constexpr std::size_t MAX_SOCKETS = 64U;
+
+// How long receive waits for the old process, in seconds
+constexpr int RECEIVE_TIMEOUT = 10;
+
+}  // namespace
+
+namespace network
+{
+
+class HandoffImpl : public Handoff
+{
+ public:
+  HandoffImpl(asio::io_context* io_context,
+              asio::local::stream_protocol::acceptor&& acceptor,
+              const GetListeningSocketsCallback& get_listening_sockets,
+              const OnHandoffCallback& on_handoff)
+    : m_acceptor(std::move(acceptor)),
+      m_socket(*io_context),
+      m_get_listening_sockets(get_listening_sockets),
+      m_on_handoff(on_handoff)
+  {
+    accept();
+  }
+
+  ~HandoffImpl() override
+  {
+    asio::error_code error;
+    m_acceptor.cancel(error);
+  }
+
+  // Delete copy constructors
+  HandoffImpl(const HandoffImpl&) = delete;
+  HandoffImpl& operator=(const HandoffImpl&) = delete;
+
+ private:
+  void accept()
+  {
+    m_acceptor.async_accept(m_socket, [this](const asio::error_code& error)
+    {
+      if (error == asio::error::operation_aborted)
+      {
+        return;
+      }
+
+      if (error)
+      {
+        LOG_ERROR("HandoffImpl::accept: could not accept: %s", error.message().c_str());
+        accept();
+        return;
+      }
+
+      onAccept();
+    });
+  }
+
+  void onAccept()
+  {
+    const auto listening_sockets = m_get_listening_sockets();
+    if (listening_sockets.empty() || listening_sockets.size() > MAX_SOCKETS)
+    {
+      LOG_ERROR("%s: can not hand off %d sockets", __func__, static_cast<int>(listening_sockets.size()));
+      asio::error_code error;
+      m_socket.close(error);
+      accept();
+      return;
+    }
+
+    // The number of sockets is sent as data, and the sockets themselves as ancillary data
+    auto count = static_cast<std::uint8_t>(listening_sockets.size());
+    iovec iov = { &count, sizeof(count) };
+
+    std::uint8_t control[CMSG_SPACE(sizeof(int) * MAX_SOCKETS)] = {};
+    msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * listening_sockets.size());
+
+    auto* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * listening_sockets.size());
+    std::memcpy(CMSG_DATA(cmsg), listening_sockets.data(), sizeof(int) * listening_sockets.size());
+
+    if (::sendmsg(m_socket.native_handle(), &msg, MSG_NOSIGNAL) != static_cast<ssize_t>(sizeof(count)))
+    {
+      LOG_ERROR("%s: could not send sockets: %s", __func__, std::strerror(errno));
+      asio::error_code error;
+      m_socket.close(error);
+      accept();
+      return;
+    }
+
+    LOG_INFO("%s: handed off %d listening sockets", __func__, static_cast<int>(listening_sockets.size()));
+
+    // on_handoff may delete this instance, so keep the connection in a local variable, and
+    // close it when on_handoff has returned, which tells the new process that we are done
+    auto socket = std::move(m_socket);
+    const auto on_handoff = m_on_handoff;
+    on_handoff();
+  }
+
+  asio::local::stream_protocol::acceptor m_acceptor;
+  asio::local::stream_protocol::socket m_socket;
+  GetListeningSocketsCallback m_get_listening_sockets;
+  OnHandoffCallback m_on_handoff;
+};
+
+std::unique_ptr<Handoff> Handoff::listen(asio::io_context* io_context,
+                                         const std::string& path,
+                                         const GetListeningSocketsCallback& get_listening_sockets,
+                                         const OnHandoffCallback& on_handoff)
+{
+  // Remove the socket file from a previous process, if any
+  ::unlink(path.c_str());
+
+  asio::local::stream_protocol::acceptor acceptor(*io_context);
+  asio::error_code error;
+  acceptor.open(asio::local::stream_protocol(), error);
+  if (!error)
+  {
+    acceptor.bind(asio::local::stream_protocol::endpoint(path), error);
+  }
+  if (!error)
+  {
+    acceptor.listen(asio::socket_base::max_listen_connections, error);
+  }
+  if (error)
+  {
+    LOG_ERROR("%s: could not listen on %s: %s", __func__, path.c_str(), error.message().c_str());
+    return {};
+  }
+
+  LOG_INFO("%s: accepting handoff on %s", __func__, path.c_str());
+  return std::make_unique<HandoffImpl>(io_context, std::move(acceptor), get_listening_sockets, on_handoff);
+}
+
+bool Handoff::receive(const std::string& path, std::vector<int>* listening_sockets)
+{
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(address.sun_path))
+  {
+    LOG_ERROR("%s: path too long: %s", __func__, path.c_str());
+    return false;
+  }
+  std::memcpy(address.sun_path, path.c_str(), path.size());
+
+  const auto fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+  {
+    LOG_ERROR("%s: could not create socket: %s", __func__, std::strerror(errno));
+    return false;
+  }
+
+  if (::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+  {
+    // Not an error, there is simply no old process to take over from
+    LOG_INFO("%s: no handoff on %s: %s", __func__, path.c_str(), std::strerror(errno));
+    ::close(fd);
+    return false;
+  }
+
+  timeval timeout = {};
+  timeout.tv_sec = RECEIVE_TIMEOUT;
+  ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  std::uint8_t count = 0U;
+  iovec iov = { &count, sizeof(count) };
+
+  std::uint8_t control[CMSG_SPACE(sizeof(int) * MAX_SOCKETS)] = {};
+  msghdr msg = {};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  if (::recvmsg(fd, &msg, MSG_CMSG_CLOEXEC) != static_cast<ssize_t>(sizeof(count)))
+  {
+    LOG_ERROR("%s: could not receive sockets: %s", __func__, std::strerror(errno));
+    ::close(fd);
+    return false;
+  }
+
+  std::vector<int> sockets;
+  for (auto* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg))
+  {
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+    {
+      const auto num_fds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+      sockets.resize(num_fds);
+      std::memcpy(sockets.data(), CMSG_DATA(cmsg), sizeof(int) * num_fds);
+    }
+  }
+
+  if (sockets.size() != count || (msg.msg_flags & MSG_CTRUNC) != 0)
+  {
+    LOG_ERROR("%s: expected %d sockets but received %d", __func__, count, static_cast<int>(sockets.size()));
+    for (const auto socket : sockets)
+    {
+      ::close(socket);
+    }
+    ::close(fd);
+    return false;
+  }
+
+  // Wait for the old process to stop accepting connections, it closes the connection when done
+  std::uint8_t eof = 0U;
+  if (::recv(fd, &eof, sizeof(eof), 0) != 0)
+  {
+    LOG_ERROR("%s: old process did not finish handoff", __func__);
+  }
+  ::close(fd);
+
+  LOG_INFO("%s: received %d listening sockets", __func__, static_cast<int>(sockets.size()));
+  *listening_sockets = std::move(sockets);
+  return true;
+}
+
+}  // namespace network
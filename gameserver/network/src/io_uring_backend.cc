@@ -0,0 +1,794 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "io_uring_backend.h"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <utility>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "logger.h"
+
+namespace network
+{
+
+struct IoUringBackend::Socket::State
+{
+  std::shared_ptr<IoUringService> service;
+  int fd = -1;
+
+  // Multishot receive
+  // Data that has been received but not yet read with async_read_some is kept in received
+  bool receiving = false;
+  bool eof = false;
+  ErrorCode receive_error;
+  std::vector<std::uint8_t> received;
+
+  // async_read_some in progress
+  std::uint8_t* read_buffer = nullptr;
+  std::size_t read_length = 0U;
+  Handler read_handler;
+};
+
+struct IoUringBackend::Acceptor::State
+{
+  std::shared_ptr<IoUringService> service;
+  int fd = -1;
+
+  // Multishot accept
+  // Connections that have been accepted but not yet returned by async_accept are kept in accepted_fds
+  bool accepting = false;
+  std::deque<int> accepted_fds;
+
+  // async_accept in progress
+  Socket* socket = nullptr;
+  std::function<void(const ErrorCode&)> handler;
+};
+
+namespace
+{
+
+using SocketState = IoUringBackend::Socket::State;
+using AcceptorState = IoUringBackend::Acceptor::State;
+
+IoUringBackend::ErrorCode makeErrorCode(int result)
+{
+  // result is a negative errno value
+  return IoUringBackend::ErrorCode(-result, std::system_category());
+}
+
+// Cancels all operations on the fd and closes it
+// The cancel is submitted directly, before the fd number can be reused
+int cancelAndClose(IoUringService* service, int fd)
+{
+  auto* sqe = service->getSqe();
+  if (sqe)
+  {
+    io_uring_prep_cancel_fd(sqe, fd, IORING_ASYNC_CANCEL_ALL);
+    service->submitSqe(sqe, IoUringService::CompletionHandler());
+    service->submit();
+  }
+  return ::close(fd);
+}
+
+void completeRead(const std::shared_ptr<SocketState>& state)
+{
+  if (!state->read_handler)
+  {
+    return;
+  }
+
+  IoUringBackend::ErrorCode error;
+  std::size_t length = 0U;
+  if (!state->received.empty())
+  {
+    length = std::min(state->received.size(), state->read_length);
+    std::copy(state->received.begin(), state->received.begin() + length, state->read_buffer);
+    state->received.erase(state->received.begin(), state->received.begin() + length);
+  }
+  else if (state->receive_error)
+  {
+    error = state->receive_error;
+  }
+  else if (!state->eof)
+  {
+    // Nothing to return yet
+    return;
+  }
+
+  // Make sure to reset the read before calling the handler, as it can call async_read_some again
+  auto handler = std::move(state->read_handler);
+  state->read_handler = nullptr;
+  state->read_buffer = nullptr;
+  handler(error, length);
+}
+
+void startReceive(const std::shared_ptr<SocketState>& state);
+
+void onReceive(IoUringService* service,
+               const std::weak_ptr<SocketState>& weak_state,
+               int result,
+               unsigned flags)
+{
+  const auto state = weak_state.lock();
+
+  if ((flags & IORING_CQE_F_BUFFER) != 0U)
+  {
+    const auto buffer_id = static_cast<std::uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+    if (state && result > 0)
+    {
+      const auto* data = service->getProvidedBuffer(buffer_id);
+      state->received.insert(state->received.end(), data, data + result);
+    }
+    service->returnProvidedBuffer(buffer_id);
+  }
+
+  if (!state)
+  {
+    return;
+  }
+
+  if ((flags & IORING_CQE_F_MORE) == 0U)
+  {
+    state->receiving = false;
+  }
+
+  if (result == 0)
+  {
+    state->eof = true;
+  }
+  else if (result < 0 && result != -ENOBUFS)
+  {
+    // -ENOBUFS means that we ran out of provided buffers, just receive again
+    state->receive_error = makeErrorCode(result);
+  }
+
+  if (!state->receiving && state->fd >= 0 && !state->eof && !state->receive_error)
+  {
+    startReceive(state);
+  }
+
+  completeRead(state);
+}
+
+void startReceive(const std::shared_ptr<SocketState>& state)
+{
+  auto* service = state->service.get();
+  auto* sqe = service->getSqe();
+  if (!sqe)
+  {
+    state->receive_error = std::make_error_code(std::errc::no_buffer_space);
+    return;
+  }
+
+  io_uring_prep_recv_multishot(sqe, state->fd, nullptr, 0, 0);
+  sqe->flags |= IOSQE_BUFFER_SELECT;
+  sqe->buf_group = IoUringService::BUFFER_GROUP_ID;
+  state->receiving = true;
+
+  const std::weak_ptr<SocketState> weak_state = state;
+  service->submitSqe(sqe, [service, weak_state](int result, unsigned flags)
+  {
+    onReceive(service, weak_state, result, flags);
+  });
+}
+
+void startSend(const std::shared_ptr<SocketState>& state,
+               const std::uint8_t* buffer,
+               std::size_t length,
+               std::size_t sent,
+               const IoUringBackend::Handler& handler)
+{
+  auto* service = state->service.get();
+  auto* sqe = service->getSqe();
+  if (!sqe)
+  {
+    asio::post(*service->getIoContext(), [handler, sent]()
+    {
+      handler(std::make_error_code(std::errc::no_buffer_space), sent);
+    });
+    return;
+  }
+
+  io_uring_prep_send(sqe, state->fd, buffer + sent, length - sent, MSG_NOSIGNAL);
+
+  // The handler is called even if the socket is gone, as the owner of buffer waits for it
+  const std::weak_ptr<SocketState> weak_state = state;
+  service->submitSqe(sqe, [weak_state, buffer, length, sent, handler](int result, unsigned)
+  {
+    if (result <= 0)
+    {
+      handler(result < 0 ? makeErrorCode(result) : std::make_error_code(std::errc::broken_pipe), sent);
+      return;
+    }
+
+    // Send the rest if this was a partial send
+    const auto total_sent = sent + static_cast<std::size_t>(result);
+    const auto state = weak_state.lock();
+    if (total_sent < length && state && state->fd >= 0)
+    {
+      startSend(state, buffer, length, total_sent, handler);
+      return;
+    }
+
+    handler(total_sent < length ? std::make_error_code(std::errc::broken_pipe) : IoUringBackend::ErrorCode(),
+            total_sent);
+  });
+}
+
+void completeAccept(const std::shared_ptr<AcceptorState>& state)
+{
+  if (!state->handler || state->accepted_fds.empty())
+  {
+    return;
+  }
+
+  *state->socket = IoUringBackend::Socket(*state->service, state->accepted_fds.front());
+  state->accepted_fds.pop_front();
+
+  // Make sure to reset the accept before calling the handler, as it can call async_accept again
+  auto handler = std::move(state->handler);
+  state->handler = nullptr;
+  state->socket = nullptr;
+  handler(IoUringBackend::ErrorCode());
+}
+
+void startAccept(const std::shared_ptr<AcceptorState>& state);
+
+void onAccept(const std::weak_ptr<AcceptorState>& weak_state, int result, unsigned flags)
+{
+  const auto state = weak_state.lock();
+  if (!state)
+  {
+    if (result >= 0)
+    {
+      ::close(result);
+    }
+    return;
+  }
+
+  if ((flags & IORING_CQE_F_MORE) == 0U)
+  {
+    state->accepting = false;
+  }
+
+  if (result >= 0)
+  {
+    state->accepted_fds.push_back(result);
+  }
+  else if (result != -ECANCELED)
+  {
+    LOG_DEBUG("%s: could not accept connection: %s", __func__, std::strerror(-result));
+  }
+
+  if (!state->accepting && state->fd >= 0)
+  {
+    startAccept(state);
+  }
+
+  completeAccept(state);
+}
+
+void startAccept(const std::shared_ptr<AcceptorState>& state)
+{
+  auto* service = state->service.get();
+  auto* sqe = service->getSqe();
+  if (!sqe)
+  {
+    LOG_ERROR("%s: could not start accepting connections, submission queue is full", __func__);
+    return;
+  }
+
+  io_uring_prep_multishot_accept(sqe, state->fd, nullptr, nullptr, SOCK_CLOEXEC);
+  state->accepting = true;
+
+  const std::weak_ptr<AcceptorState> weak_state = state;
+  service->submitSqe(sqe, [weak_state](int result, unsigned flags)
+  {
+    onAccept(weak_state, result, flags);
+  });
+}
+
+}  // namespace
+
+std::shared_ptr<IoUringService> IoUringService::create(asio::io_context* io_context)
+{
+  // The constructor is private, so std::make_shared can't be used
+  auto service = std::shared_ptr<IoUringService>(new IoUringService(io_context));
+  if (!service->init())
+  {
+    return nullptr;
+  }
+  return service;
+}
+
+IoUringService::IoUringService(asio::io_context* io_context)
+  : m_io_context(io_context),
+    m_eventfd(*io_context)
+{
+}
+
+IoUringService::~IoUringService()
+{
+  if (m_buffer_ring)
+  {
+    io_uring_free_buf_ring(&m_ring, m_buffer_ring, PROVIDED_BUFFER_COUNT, BUFFER_GROUP_ID);
+  }
+
+  // Any operations still in progress are cancelled by the kernel
+  if (m_ring_initialized)
+  {
+    io_uring_queue_exit(&m_ring);
+  }
+}
+
+bool IoUringService::init()
+{
+  auto ret = io_uring_queue_init(RING_ENTRIES, &m_ring, 0);
+  if (ret < 0)
+  {
+    LOG_ERROR("%s: could not initialize io_uring: %s", __func__, std::strerror(-ret));
+    return false;
+  }
+  m_ring_initialized = true;
+
+  // Check that the kernel supports the operations that we use
+  // Multishot receive (6.0) and IORING_ASYNC_CANCEL_ALL (5.19) are flags and can't be probed,
+  // but IORING_OP_SEND_ZC was added in 6.0 as well, so it is probed in their place
+  auto* probe = io_uring_get_probe_ring(&m_ring);
+  if (!probe)
+  {
+    LOG_ERROR("%s: could not probe io_uring operations", __func__);
+    return false;
+  }
+  const std::array<std::pair<int, const char*>, 5> operations =
+  {{
+    { IORING_OP_ACCEPT, "IORING_OP_ACCEPT" },
+    { IORING_OP_RECV, "IORING_OP_RECV" },
+    { IORING_OP_SEND, "IORING_OP_SEND" },
+    { IORING_OP_ASYNC_CANCEL, "IORING_OP_ASYNC_CANCEL" },
+    { IORING_OP_SEND_ZC, "IORING_OP_SEND_ZC (multishot receive)" },
+  }};
+  for (const auto& operation : operations)
+  {
+    if (!io_uring_opcode_supported(probe, operation.first))
+    {
+      LOG_ERROR("%s: io_uring operation not supported by the kernel: %s", __func__, operation.second);
+      io_uring_free_probe(probe);
+      return false;
+    }
+  }
+  io_uring_free_probe(probe);
+
+  // The ring signals the eventfd when there are completions
+  const auto eventfd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (eventfd < 0)
+  {
+    LOG_ERROR("%s: could not create eventfd: %s", __func__, std::strerror(errno));
+    return false;
+  }
+  m_eventfd.assign(eventfd);
+
+  ret = io_uring_register_eventfd(&m_ring, eventfd);
+  if (ret < 0)
+  {
+    LOG_ERROR("%s: could not register eventfd: %s", __func__, std::strerror(-ret));
+    return false;
+  }
+
+  // Register the provided buffers used by multishot receive
+  m_buffer_ring = io_uring_setup_buf_ring(&m_ring, PROVIDED_BUFFER_COUNT, BUFFER_GROUP_ID, 0, &ret);
+  if (!m_buffer_ring)
+  {
+    LOG_ERROR("%s: could not register provided buffers: %s", __func__, std::strerror(-ret));
+    return false;
+  }
+
+  m_buffers.resize(PROVIDED_BUFFER_COUNT * PROVIDED_BUFFER_SIZE);
+  for (auto i = 0U; i < PROVIDED_BUFFER_COUNT; i++)
+  {
+    io_uring_buf_ring_add(m_buffer_ring,
+                          m_buffers.data() + (i * PROVIDED_BUFFER_SIZE),
+                          PROVIDED_BUFFER_SIZE,
+                          i,
+                          io_uring_buf_ring_mask(PROVIDED_BUFFER_COUNT),
+                          i);
+  }
+  io_uring_buf_ring_advance(m_buffer_ring, PROVIDED_BUFFER_COUNT);
+
+  return true;
+}
+
+io_uring_sqe* IoUringService::getSqe()
+{
+  auto* sqe = io_uring_get_sqe(&m_ring);
+  if (!sqe)
+  {
+    // The submission queue is full, submit what we have and try again
+    submit();
+    sqe = io_uring_get_sqe(&m_ring);
+    if (!sqe)
+    {
+      LOG_ERROR("%s: submission queue is full", __func__);
+    }
+  }
+  return sqe;
+}
+
+void IoUringService::submitSqe(io_uring_sqe* sqe, CompletionHandler handler)
+{
+  if (handler)
+  {
+    auto operation = std::make_unique<Operation>();
+    operation->handler = std::move(handler);
+    io_uring_sqe_set_data(sqe, operation.get());
+    m_operations.emplace(operation.get(), std::move(operation));
+
+    // Only wait for completions while there are operations in progress, so that
+    // io_context::run() returns when there is nothing left to do, as with asio
+    if (!m_waiting)
+    {
+      waitForCompletions();
+    }
+  }
+  else
+  {
+    io_uring_sqe_set_data(sqe, nullptr);
+  }
+
+  // Submit everything that is prepared during this handler with one system call
+  if (!m_submit_posted)
+  {
+    m_submit_posted = true;
+    asio::post(*m_io_context, [weak_service = weak_from_this()]()
+    {
+      if (const auto service = weak_service.lock())
+      {
+        service->m_submit_posted = false;
+        service->submit();
+      }
+    });
+  }
+}
+
+void IoUringService::submit()
+{
+  const auto ret = io_uring_submit(&m_ring);
+  if (ret < 0)
+  {
+    LOG_ERROR("%s: could not submit: %s", __func__, std::strerror(-ret));
+  }
+}
+
+const std::uint8_t* IoUringService::getProvidedBuffer(std::uint16_t buffer_id) const
+{
+  return m_buffers.data() + (buffer_id * PROVIDED_BUFFER_SIZE);
+}
+
+void IoUringService::returnProvidedBuffer(std::uint16_t buffer_id)
+{
+  io_uring_buf_ring_add(m_buffer_ring,
+                        m_buffers.data() + (buffer_id * PROVIDED_BUFFER_SIZE),
+                        PROVIDED_BUFFER_SIZE,
+                        buffer_id,
+                        io_uring_buf_ring_mask(PROVIDED_BUFFER_COUNT),
+                        0);
+  io_uring_buf_ring_advance(m_buffer_ring, 1);
+}
+
+void IoUringService::waitForCompletions()
+{
+  m_waiting = true;
+  m_eventfd.async_read_some(asio::buffer(&m_eventfd_value, sizeof(m_eventfd_value)),
+                            [this](const std::error_code& error, std::size_t)
+                            {
+                              if (error)
+                              {
+                                // operation_aborted if this instance is deleted, so don't touch
+                                // any instance variables
+                                return;
+                              }
+
+                              handleCompletions();
+                              if (m_operations.empty())
+                              {
+                                m_waiting = false;
+                                return;
+                              }
+                              waitForCompletions();
+                            });
+}
+
+void IoUringService::handleCompletions()
+{
+  // Copy the completions before calling the handlers, as they will prepare new operations
+  m_completions.clear();
+  io_uring_cqe* cqe = nullptr;
+  unsigned head = 0U;
+  unsigned count = 0U;
+  io_uring_for_each_cqe(&m_ring, head, cqe)
+  {
+    m_completions.push_back({ static_cast<Operation*>(io_uring_cqe_get_data(cqe)), cqe->res, cqe->flags });
+    count += 1U;
+  }
+  io_uring_cq_advance(&m_ring, count);
+
+  for (const auto& completion : m_completions)
+  {
+    if (!completion.operation)
+    {
+      continue;
+    }
+
+    completion.operation->handler(completion.result, completion.flags);
+    if ((completion.flags & IORING_CQE_F_MORE) == 0U)
+    {
+      m_operations.erase(completion.operation);
+    }
+  }
+
+  submit();
+}
+
+IoUringBackend::Socket::Socket(Service&)
+{
+}
+
+IoUringBackend::Socket::Socket(Service& service, int fd)
+  : m_state(std::make_shared<State>())
+{
+  m_state->service = service.shared_from_this();
+  m_state->fd = fd;
+  startReceive(m_state);
+}
+
+IoUringBackend::Socket::~Socket()
+{
+  if (is_open())
+  {
+    ErrorCode error;
+    close(error);
+  }
+}
+
+IoUringBackend::Socket& IoUringBackend::Socket::operator=(Socket&& other) noexcept
+{
+  if (this != &other)
+  {
+    if (is_open())
+    {
+      ErrorCode error;
+      close(error);
+    }
+    m_state = std::move(other.m_state);
+  }
+  return *this;
+}
+
+bool IoUringBackend::Socket::is_open() const  // NOLINT
+{
+  return m_state && m_state->fd >= 0;
+}
+
+void IoUringBackend::Socket::shutdown(shutdown_type, ErrorCode& ec)  // NOLINT
+{
+  if (!is_open() || ::shutdown(m_state->fd, SHUT_RDWR) == 0)
+  {
+    ec = ErrorCode();
+  }
+  else
+  {
+    ec = ErrorCode(errno, std::system_category());
+  }
+}
+
+void IoUringBackend::Socket::close(ErrorCode& ec)  // NOLINT
+{
+  ec = ErrorCode();
+  if (!is_open())
+  {
+    return;
+  }
+
+  auto* service = m_state->service.get();
+  if (cancelAndClose(service, m_state->fd) != 0)
+  {
+    ec = ErrorCode(errno, std::system_category());
+  }
+  m_state->fd = -1;
+
+  // The kernel never uses the async_read_some buffer, so the read can be aborted directly
+  if (m_state->read_handler)
+  {
+    auto handler = std::move(m_state->read_handler);
+    m_state->read_handler = nullptr;
+    m_state->read_buffer = nullptr;
+    asio::post(*service->getIoContext(), [handler]()
+    {
+      handler(std::make_error_code(std::errc::operation_canceled), 0U);
+    });
+  }
+}
+
+IoUringBackend::Acceptor::Acceptor(Service& service, int port, bool reuse_port)
+  : Acceptor(service, ListeningSocket{ listen(port, reuse_port) })
+{
+}
+
+IoUringBackend::Acceptor::Acceptor(Service& service, ListeningSocket listening_socket)
+  : m_state(std::make_shared<State>())
+{
+  m_state->service = service.shared_from_this();
+  m_state->fd = listening_socket.native_handle;
+  if (m_state->fd < 0)
+  {
+    LOG_ERROR("%s: invalid listening socket, not accepting connections", __func__);
+    return;
+  }
+  startAccept(m_state);
+}
+
+int IoUringBackend::Acceptor::listen(int port, bool reuse_port)
+{
+  const auto fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+  {
+    LOG_ERROR("%s: could not create socket: %s", __func__, std::strerror(errno));
+    return -1;
+  }
+
+  // Same options as asio::ip::tcp::acceptor
+  const int enable = 1;
+  ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+  if (reuse_port)
+  {
+    ::setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable));
+  }
+
+  sockaddr_in address {};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  address.sin_port = htons(port);
+  if (::bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 ||
+      ::listen(fd, SOMAXCONN) != 0)
+  {
+    LOG_ERROR("%s: could not listen on port %d: %s", __func__, port, std::strerror(errno));
+    ::close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+IoUringBackend::Acceptor::~Acceptor()
+{
+  ErrorCode ec;
+  close(ec);
+}
+
+void IoUringBackend::Acceptor::async_accept(Socket& socket, const std::function<void(const ErrorCode&)>& handler)  // NOLINT
+{
+  m_state->socket = &socket;
+  m_state->handler = handler;
+
+  if (!m_state->accepted_fds.empty())
+  {
+    // There is already an accepted connection, but the handler must not be called from here
+    const std::weak_ptr<State> weak_state = m_state;
+    asio::post(*m_state->service->getIoContext(), [weak_state]()
+    {
+      if (const auto state = weak_state.lock())
+      {
+        completeAccept(state);
+      }
+    });
+  }
+}
+
+void IoUringBackend::Acceptor::cancel()  // NOLINT
+{
+  if (!m_state->handler)
+  {
+    return;
+  }
+
+  auto handler = std::move(m_state->handler);
+  m_state->handler = nullptr;
+  m_state->socket = nullptr;
+  asio::post(*m_state->service->getIoContext(), [handler]()
+  {
+    handler(std::make_error_code(std::errc::operation_canceled));
+  });
+}
+
+void IoUringBackend::Acceptor::close(ErrorCode& ec)  // NOLINT
+{
+  ec = ErrorCode();
+  cancel();
+
+  if (m_state->fd >= 0)
+  {
+    if (cancelAndClose(m_state->service.get(), m_state->fd) != 0)
+    {
+      ec = ErrorCode(errno, std::system_category());
+    }
+    m_state->fd = -1;
+  }
+
+  // Connections that were accepted but not yet handed out
+  for (const auto fd : m_state->accepted_fds)
+  {
+    ::close(fd);
+  }
+  m_state->accepted_fds.clear();
+}
+
+int IoUringBackend::Acceptor::native_handle() const  // NOLINT
+{
+  return m_state->fd;
+}
+
+void IoUringBackend::async_write(Socket& socket,  // NOLINT
+                                 const std::uint8_t* buffer,
+                                 std::size_t length,
+                                 const Handler& handler)
+{
+  startSend(socket.m_state, buffer, length, 0U, handler);
+}
+
+void IoUringBackend::async_read_some(Socket& socket,  // NOLINT
+                                     std::uint8_t* buffer,
+                                     std::size_t length,
+                                     const Handler& handler)
+{
+  auto& state = socket.m_state;
+  state->read_buffer = buffer;
+  state->read_length = length;
+  state->read_handler = handler;
+
+  if (!state->received.empty() || state->eof || state->receive_error)
+  {
+    // There is already something to return, but the handler must not be called from here
+    const std::weak_ptr<SocketState> weak_state = state;
+    asio::post(*state->service->getIoContext(), [weak_state]()
+    {
+      if (const auto state = weak_state.lock())
+      {
+        completeRead(state);
+      }
+    });
+  }
+}
+
+}  // namespace network
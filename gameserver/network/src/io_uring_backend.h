@@ -0,0 +1,217 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NETWORK_SRC_IO_URING_BACKEND_H_
+#define NETWORK_SRC_IO_URING_BACKEND_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+#include <asio.hpp>
+#include <liburing.h>
+
+#include "acceptor.h"
+
+namespace network
+{
+
+/**
+ * class IoUringService
+ *
+ * Owns the io_uring used by IoUringBackend. It is driven by the asio::io_context:
+ * the ring signals an eventfd when there are completions, and the completions are
+ * then handled on the io_context, so handlers are called in the same context as
+ * with the asio backend.
+ *
+ * Prepared submissions are submitted together once the current handler returns.
+ * The eventfd is only waited on while there are operations in progress.
+ *
+ * Multishot receive uses a ring of provided buffers that is registered with the kernel.
+ */
+class IoUringService : public std::enable_shared_from_this<IoUringService>
+{
+ public:
+  // Called for each completion of an operation, with the cqe result and flags
+  // The operation is done after the first completion without IORING_CQE_F_MORE
+  using CompletionHandler = std::function<void(int result, unsigned flags)>;
+
+  static constexpr std::uint16_t BUFFER_GROUP_ID = 0U;
+  static constexpr unsigned PROVIDED_BUFFER_COUNT = 1024U;  // Must be a power of 2
+  static constexpr unsigned PROVIDED_BUFFER_SIZE = 4096U;
+
+  // Returns nullptr if io_uring (or an operation or feature that we need) is not supported
+  static std::shared_ptr<IoUringService> create(asio::io_context* io_context);
+
+  ~IoUringService();
+
+  // Delete copy constructors
+  IoUringService(const IoUringService&) = delete;
+  IoUringService& operator=(const IoUringService&) = delete;
+
+  asio::io_context* getIoContext() { return m_io_context; }
+
+  // Returns nullptr if the submission queue is full
+  io_uring_sqe* getSqe();
+
+  // Queues a prepared sqe for submission, handler can be empty if the completion is not needed
+  void submitSqe(io_uring_sqe* sqe, CompletionHandler handler);
+
+  // Submits all queued sqes directly
+  void submit();
+
+  const std::uint8_t* getProvidedBuffer(std::uint16_t buffer_id) const;
+  void returnProvidedBuffer(std::uint16_t buffer_id);
+
+ private:
+  explicit IoUringService(asio::io_context* io_context);
+
+  bool init();
+  void waitForCompletions();
+  void handleCompletions();
+
+  static constexpr unsigned RING_ENTRIES = 4096U;
+
+  asio::io_context* m_io_context;
+  io_uring m_ring;
+  bool m_ring_initialized = false;
+  bool m_submit_posted = false;
+  bool m_waiting = false;
+
+  asio::posix::stream_descriptor m_eventfd;
+  std::uint64_t m_eventfd_value = 0U;
+
+  io_uring_buf_ring* m_buffer_ring = nullptr;
+  std::vector<std::uint8_t> m_buffers;
+
+  struct Operation
+  {
+    CompletionHandler handler;
+  };
+  std::unordered_map<Operation*, std::unique_ptr<Operation>> m_operations;
+
+  struct Completion
+  {
+    Operation* operation;
+    int result;
+    unsigned flags;
+  };
+  std::vector<Completion> m_completions;
+};
+
+struct IoUringBackend
+{
+  using Service = IoUringService;
+  using ErrorCode = std::error_code;
+  using Handler = std::function<void(const ErrorCode&, std::size_t)>;
+
+  struct Error
+  {
+    static constexpr std::errc operation_aborted = std::errc::operation_canceled;
+  };
+
+  enum shutdown_type
+  {
+    shutdown_both
+  };
+
+  class Socket
+  {
+   public:
+    // Defined in io_uring_backend.cc, shared with the operations in progress
+    struct State;
+
+    Socket() = default;
+    explicit Socket(Service& service);  // NOLINT
+    Socket(Service& service, int fd);
+    ~Socket();
+
+    Socket(Socket&& other) noexcept = default;
+    Socket& operator=(Socket&& other) noexcept;
+
+    bool is_open() const;  // NOLINT
+    void shutdown(shutdown_type, ErrorCode& ec);  // NOLINT
+    void close(ErrorCode& ec);  // NOLINT
+
+   private:
+    friend struct IoUringBackend;
+
+    std::shared_ptr<State> m_state;
+  };
+
+  class Acceptor
+  {
+   public:
+    // Defined in io_uring_backend.cc, shared with the operations in progress
+    struct State;
+
+    // If the port can't be listened on an error is logged and no connections are accepted,
+    // use listen and the ListeningSocket constructor to be able to handle the error
+    Acceptor(Service& service, int port, bool reuse_port);  // NOLINT
+
+    // Accepts connections on an already listening socket, and takes ownership of it
+    Acceptor(Service& service, ListeningSocket listening_socket);  // NOLINT
+
+    ~Acceptor();
+
+    // Returns a socket listening on the port, or -1 if it could not be created
+    static int listen(int port, bool reuse_port);
+
+    // Delete copy constructors
+    Acceptor(const Acceptor&) = delete;
+    Acceptor& operator=(const Acceptor&) = delete;
+
+    void async_accept(Socket& socket, const std::function<void(const ErrorCode&)>& handler);  // NOLINT
+    void cancel();  // NOLINT
+    void close(ErrorCode& ec);  // NOLINT
+    int native_handle() const;  // NOLINT
+
+   private:
+    std::shared_ptr<State> m_state;
+  };
+
+  static void async_write(Socket& socket,  // NOLINT
+                          const std::uint8_t* buffer,
+                          std::size_t length,
+                          const Handler& handler);
+
+  // Written data is not buffered by the backend, it is only in the queue of the connection
+  static std::size_t get_buffered_amount(const Socket& socket)  // NOLINT
+  {
+    (void)socket;
+    return 0U;
+  }
+
+  static void async_read_some(Socket& socket,  // NOLINT
+                              std::uint8_t* buffer,
+                              std::size_t length,
+                              const Handler& handler);
+};
+
+}  // namespace network
+
+#endif  // NETWORK_SRC_IO_URING_BACKEND_H_
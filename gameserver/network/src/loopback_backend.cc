@@ -0,0 +1,292 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "loopback_backend.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace network
+{
+
+struct LoopbackBackend::Socket::State
+{
+  asio::io_context* io_context = nullptr;
+  std::size_t buffer_size = 0U;
+  bool open = true;
+  std::weak_ptr<State> peer;
+
+  // Data written by the peer that has not been read yet is in [buffer_begin, buffer.size())
+  std::vector<std::uint8_t> buffer;
+  std::size_t buffer_begin = 0U;
+
+  // async_read_some in progress
+  std::uint8_t* read_buffer = nullptr;
+  std::size_t read_length = 0U;
+  Handler read_handler;
+
+  // async_write in progress, waiting for room in the peer's buffer
+  const std::uint8_t* write_buffer = nullptr;
+  std::size_t write_length = 0U;
+  std::size_t written = 0U;
+  Handler write_handler;
+};
+
+namespace
+{
+
+using SocketState = LoopbackBackend::Socket::State;
+
+void postHandler(SocketState* state,
+                 LoopbackBackend::Handler* handler,
+                 const LoopbackBackend::ErrorCode& error,
+                 std::size_t length)
+{
+  // Make sure to reset the handler before it is called, as it can start a new operation
+  asio::post(*state->io_context, [handler = std::move(*handler), error, length]()
+  {
+    handler(error, length);
+  });
+  *handler = nullptr;
+}
+
+void completeWrite(const std::shared_ptr<SocketState>& state);
+
+void completeRead(const std::shared_ptr<SocketState>& state)
+{
+  if (!state->read_handler)
+  {
+    return;
+  }
+
+  const auto peer = state->peer.lock();
+  std::size_t length = 0U;
+  if (state->buffer_begin < state->buffer.size())
+  {
+    length = std::min(state->buffer.size() - state->buffer_begin, state->read_length);
+    std::copy(state->buffer.begin() + state->buffer_begin,
+              state->buffer.begin() + state->buffer_begin + length,
+              state->read_buffer);
+    state->buffer_begin += length;
+    if (state->buffer_begin == state->buffer.size())
+    {
+      state->buffer.clear();
+      state->buffer_begin = 0U;
+    }
+  }
+  else if (peer && peer->open)
+  {
+    // Nothing to return yet
+    return;
+  }
+
+  // Return the data, or end of file (length 0) if the peer is closed
+  state->read_buffer = nullptr;
+  postHandler(state.get(), &state->read_handler, LoopbackBackend::ErrorCode(), length);
+
+  // There might be room for more of the peer's write now
+  if (length > 0U && peer)
+  {
+    completeWrite(peer);
+  }
+}
+
+void completeWrite(const std::shared_ptr<SocketState>& state)
+{
+  if (!state->write_handler)
+  {
+    return;
+  }
+
+  const auto peer = state->peer.lock();
+  if (!peer || !peer->open)
+  {
+    state->write_buffer = nullptr;
+    postHandler(state.get(),
+                &state->write_handler,
+                std::make_error_code(std::errc::connection_reset),
+                state->written);
+    return;
+  }
+
+  const auto buffered = peer->buffer.size() - peer->buffer_begin;
+  const auto room = peer->buffer_size > buffered ? peer->buffer_size - buffered : 0U;
+  const auto length = std::min(room, state->write_length - state->written);
+  if (length > 0U)
+  {
+    if (peer->buffer_begin > 0U)
+    {
+      peer->buffer.erase(peer->buffer.begin(), peer->buffer.begin() + peer->buffer_begin);
+      peer->buffer_begin = 0U;
+    }
+    peer->buffer.insert(peer->buffer.end(),
+                        state->write_buffer + state->written,
+                        state->write_buffer + state->written + length);
+    state->written += length;
+  }
+
+  if (state->written == state->write_length)
+  {
+    state->write_buffer = nullptr;
+    postHandler(state.get(), &state->write_handler, LoopbackBackend::ErrorCode(), state->written);
+  }
+
+  if (length > 0U)
+  {
+    completeRead(peer);
+  }
+}
+
+}  // namespace
+
+std::pair<LoopbackBackend::Socket, LoopbackBackend::Socket> LoopbackBackend::Socket::createPair(asio::io_context* io_context,
+                                                                                                std::size_t buffer_size)
+{
+  auto first = std::make_shared<State>();
+  auto second = std::make_shared<State>();
+  first->io_context = io_context;
+  first->buffer_size = buffer_size;
+  first->peer = second;
+  second->io_context = io_context;
+  second->buffer_size = buffer_size;
+  second->peer = first;
+  return { Socket(std::move(first)), Socket(std::move(second)) };
+}
+
+LoopbackBackend::Socket::Socket(std::shared_ptr<State> state)
+  : m_state(std::move(state))
+{
+}
+
+LoopbackBackend::Socket::~Socket()
+{
+  if (is_open())
+  {
+    ErrorCode error;
+    close(error);
+  }
+}
+
+LoopbackBackend::Socket& LoopbackBackend::Socket::operator=(Socket&& other) noexcept
+{
+  if (this != &other)
+  {
+    if (is_open())
+    {
+      ErrorCode error;
+      close(error);
+    }
+    m_state = std::move(other.m_state);
+  }
+  return *this;
+}
+
+bool LoopbackBackend::Socket::is_open() const  // NOLINT
+{
+  return m_state && m_state->open;
+}
+
+void LoopbackBackend::Socket::shutdown(shutdown_type, ErrorCode& ec)  // NOLINT
+{
+  // Nothing to do, the peer sees end of file when the socket is closed
+  ec = ErrorCode();
+}
+
+void LoopbackBackend::Socket::close(ErrorCode& ec)  // NOLINT
+{
+  ec = ErrorCode();
+  if (!is_open())
+  {
+    return;
+  }
+
+  m_state->open = false;
+  m_state->buffer.clear();
+  m_state->buffer_begin = 0U;
+
+  if (m_state->read_handler)
+  {
+    m_state->read_buffer = nullptr;
+    postHandler(m_state.get(), &m_state->read_handler, std::make_error_code(std::errc::operation_canceled), 0U);
+  }
+
+  if (m_state->write_handler)
+  {
+    m_state->write_buffer = nullptr;
+    postHandler(m_state.get(),
+                &m_state->write_handler,
+                std::make_error_code(std::errc::operation_canceled),
+                m_state->written);
+  }
+
+  // Let the peer see end of file, and fail its write if it is waiting for room
+  if (const auto peer = m_state->peer.lock())
+  {
+    completeRead(peer);
+    completeWrite(peer);
+  }
+}
+
+void LoopbackBackend::async_write(Socket& socket,  // NOLINT
+                                  const std::uint8_t* buffer,
+                                  std::size_t length,
+                                  const Handler& handler)
+{
+  auto& state = socket.m_state;
+  state->write_buffer = buffer;
+  state->write_length = length;
+  state->written = 0U;
+  state->write_handler = handler;
+
+  if (!state->open)
+  {
+    state->write_buffer = nullptr;
+    postHandler(state.get(), &state->write_handler, std::make_error_code(std::errc::bad_file_descriptor), 0U);
+    return;
+  }
+
+  completeWrite(state);
+}
+
+void LoopbackBackend::async_read_some(Socket& socket,  // NOLINT
+                                      std::uint8_t* buffer,
+                                      std::size_t length,
+                                      const Handler& handler)
+{
+  auto& state = socket.m_state;
+  state->read_buffer = buffer;
+  state->read_length = length;
+  state->read_handler = handler;
+
+  if (!state->open)
+  {
+    state->read_buffer = nullptr;
+    postHandler(state.get(), &state->read_handler, std::make_error_code(std::errc::bad_file_descriptor), 0U);
+    return;
+  }
+
+  completeRead(state);
+}
+
+}  // namespace network
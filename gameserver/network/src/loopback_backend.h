@@ -0,0 +1,114 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NETWORK_SRC_LOOPBACK_BACKEND_H_
+#define NETWORK_SRC_LOOPBACK_BACKEND_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <system_error>
+#include <utility>
+
+#include <asio.hpp>
+
+namespace network
+{
+
+/**
+ * struct LoopbackBackend
+ *
+ * Backend for ConnectionImpl that passes data between two paired sockets in memory,
+ * without any kernel networking. Used to run many connections in a single process,
+ * e.g. in full-stack benchmarks and soak tests.
+ *
+ * Handlers are posted to the io_context given to createPair, so both sockets in a
+ * pair must only be used from the thread that runs that io_context.
+ *
+ * Each socket can buffer buffer_size bytes that the peer has not read yet. A write
+ * that does not fit completes first when the peer has read enough data, which gives
+ * the same backpressure as a real socket with a full send buffer.
+ *
+ * Closing a socket aborts its own operations. The peer can still read the buffered
+ * data, after that its reads complete with length 0 (end of file) and its writes
+ * fail with connection_reset.
+ */
+struct LoopbackBackend
+{
+  using ErrorCode = std::error_code;
+  using Handler = std::function<void(const ErrorCode&, std::size_t)>;
+
+  enum shutdown_type
+  {
+    shutdown_both
+  };
+
+  class Socket
+  {
+   public:
+    // Defined in loopback_backend.cc, shared with the peer socket
+    struct State;
+
+    // Returns two sockets that are connected to each other
+    static std::pair<Socket, Socket> createPair(asio::io_context* io_context, std::size_t buffer_size);
+
+    Socket() = default;
+    ~Socket();
+
+    Socket(Socket&& other) noexcept = default;
+    Socket& operator=(Socket&& other) noexcept;
+
+    bool is_open() const;  // NOLINT
+    void shutdown(shutdown_type, ErrorCode& ec);  // NOLINT
+    void close(ErrorCode& ec);  // NOLINT
+
+   private:
+    friend struct LoopbackBackend;
+
+    explicit Socket(std::shared_ptr<State> state);
+
+    std::shared_ptr<State> m_state;
+  };
+
+  static void async_write(Socket& socket,  // NOLINT
+                          const std::uint8_t* buffer,
+                          std::size_t length,
+                          const Handler& handler);
+
+  // Written data is not buffered by the backend, it is only in the queue of the connection
+  static std::size_t get_buffered_amount(const Socket& socket)  // NOLINT
+  {
+    (void)socket;
+    return 0U;
+  }
+
+  static void async_read_some(Socket& socket,  // NOLINT
+                              std::uint8_t* buffer,
+                              std::size_t length,
+                              const Handler& handler);
+};
+
+}  // namespace network
+
+#endif  // NETWORK_SRC_LOOPBACK_BACKEND_H_
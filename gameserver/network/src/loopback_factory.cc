@@ -0,0 +1,43 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "loopback_factory.h"
+
+#include <asio.hpp>
+
+#include "connection_impl.h"
+#include "loopback_backend.h"
+
+namespace network
+{
+
+LoopbackFactory::ConnectionPair LoopbackFactory::createConnectionPair(asio::io_context* io_context,
+                                                                      std::size_t buffer_size)
+{
+  auto sockets = LoopbackBackend::Socket::createPair(io_context, buffer_size);
+  return { std::make_unique<ConnectionImpl<LoopbackBackend>>(std::move(sockets.first)),
+           std::make_unique<ConnectionImpl<LoopbackBackend>>(std::move(sockets.second)) };
+}
+
+}  // namespace network
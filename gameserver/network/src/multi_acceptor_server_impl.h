@@ -0,0 +1,186 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NETWORK_SRC_MULTI_ACCEPTOR_SERVER_IMPL_H_
+#define NETWORK_SRC_MULTI_ACCEPTOR_SERVER_IMPL_H_
+
+#include "server.h"
+
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <asio.hpp>
+
+#include "acceptor.h"
+#include "connection_impl.h"
+#include "logger.h"
+
+namespace network
+{
+
+/**
+ * class MultiAcceptorServerImpl
+ *
+ * Listens on the same port with num_acceptors sockets using SO_REUSEPORT, each
+ * accepting connections on its own thread with its own io_context, so that the
+ * kernel spreads incoming connections over the threads.
+ *
+ * Accepted sockets belong to io_context, and the connections are created and
+ * handed over on io_context, so all connection I/O and callbacks happen there,
+ * same as with ServerImpl.
+ */
+template <typename Backend>
+class MultiAcceptorServerImpl : public Server
+{
+ public:
+  MultiAcceptorServerImpl(asio::io_context* io_context,
+                          int port,
+                          int num_acceptors,
+                          const std::function<void(std::unique_ptr<Connection>&&)>& on_client_connected)
+  {
+    const auto on_accept = createOnAccept(io_context, on_client_connected);
+    for (auto i = 0; i < num_acceptors; i++)
+    {
+      auto acceptor_thread = std::make_unique<AcceptorThread>();
+      acceptor_thread->acceptor = std::make_unique<Acceptor<Backend>>(&acceptor_thread->io_context,
+                                                                      io_context,
+                                                                      port,
+                                                                      true,
+                                                                      on_accept);
+      m_acceptor_threads.push_back(std::move(acceptor_thread));
+    }
+    startThreads();
+
+    LOG_INFO("%s: listening on port %d with %d acceptors", __func__, port, num_acceptors);
+  }
+
+  // Accepts connections on already listening sockets, one acceptor thread per socket,
+  // and takes ownership of the sockets
+  MultiAcceptorServerImpl(asio::io_context* io_context,
+                          const std::vector<ListeningSocket>& listening_sockets,
+                          const std::function<void(std::unique_ptr<Connection>&&)>& on_client_connected)
+  {
+    const auto on_accept = createOnAccept(io_context, on_client_connected);
+    for (const auto& listening_socket : listening_sockets)
+    {
+      auto acceptor_thread = std::make_unique<AcceptorThread>();
+      acceptor_thread->acceptor = std::make_unique<Acceptor<Backend>>(&acceptor_thread->io_context,
+                                                                      io_context,
+                                                                      listening_socket,
+                                                                      on_accept);
+      m_acceptor_threads.push_back(std::move(acceptor_thread));
+    }
+    startThreads();
+
+    LOG_INFO("%s: listening with %d acceptors", __func__, static_cast<int>(listening_sockets.size()));
+  }
+
+  ~MultiAcceptorServerImpl() override
+  {
+    // Stop and join the threads before the acceptors are deleted
+    stopThreads();
+  }
+
+  // Delete copy constructors
+  MultiAcceptorServerImpl(const MultiAcceptorServerImpl&) = delete;
+  MultiAcceptorServerImpl& operator=(const MultiAcceptorServerImpl&) = delete;
+
+  std::vector<int> getListeningSockets() override
+  {
+    std::vector<int> listening_sockets;
+    for (auto& acceptor_thread : m_acceptor_threads)
+    {
+      listening_sockets.push_back(acceptor_thread->acceptor->getNativeHandle());
+    }
+    return listening_sockets;
+  }
+
+  void stopAccepting() override
+  {
+    // The acceptors are used on their own threads, so stop and join the threads first
+    stopThreads();
+    for (auto& acceptor_thread : m_acceptor_threads)
+    {
+      acceptor_thread->acceptor->stop();
+    }
+  }
+
+ private:
+  // Returns the on_accept callback for the acceptors, which is called on the acceptor threads
+  // The handler passed to post must be copyable, so the socket is moved into a shared_ptr
+  static std::function<void(typename Backend::Socket&&)> createOnAccept(
+      asio::io_context* io_context,
+      const std::function<void(std::unique_ptr<Connection>&&)>& on_client_connected)
+  {
+    return [io_context, on_client_connected](typename Backend::Socket&& socket)
+    {
+      auto shared_socket = std::make_shared<typename Backend::Socket>(std::move(socket));
+      asio::post(*io_context, [on_client_connected, shared_socket]()
+      {
+        LOG_DEBUG("onAccept()");
+        on_client_connected(std::make_unique<ConnectionImpl<Backend>>(std::move(*shared_socket)));
+      });
+    };
+  }
+
+  // Starts the threads when all sockets are listening
+  void startThreads()
+  {
+    for (auto& acceptor_thread : m_acceptor_threads)
+    {
+      auto* thread_io_context = &acceptor_thread->io_context;
+      acceptor_thread->thread = std::thread([thread_io_context]() { thread_io_context->run(); });
+    }
+  }
+
+  void stopThreads()
+  {
+    for (auto& acceptor_thread : m_acceptor_threads)
+    {
+      acceptor_thread->io_context.stop();
+    }
+    for (auto& acceptor_thread : m_acceptor_threads)
+    {
+      if (acceptor_thread->thread.joinable())
+      {
+        acceptor_thread->thread.join();
+      }
+    }
+  }
+
+  struct AcceptorThread
+  {
+    asio::io_context io_context;
+    std::unique_ptr<Acceptor<Backend>> acceptor;
+    std::thread thread;
+  };
+
+  std::vector<std::unique_ptr<AcceptorThread>> m_acceptor_threads;
+};
+
+}  // namespace network
+
+#endif  // NETWORK_SRC_MULTI_ACCEPTOR_SERVER_IMPL_H_
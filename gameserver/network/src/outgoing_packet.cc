@@ -22,82 +22,221 @@
  * SOFTWARE.
  */
 
+
 #include "outgoing_packet.h"
 
 #include <algorithm>
+#include <utility>
 
 #include "logger.h"
 
 namespace network
 {
 
-// Initialize static packet pool
-std::stack<std::unique_ptr<std::array<std::uint8_t, 8192>>> OutgoingPacket::m_bufferpool;
+// Initialize static packet pools
+std::array<std::stack<OutgoingPacket::Buffer>, OutgoingPacket::NUM_SIZE_CLASSES> OutgoingPacket::m_bufferpools;
 
 OutgoingPacket::OutgoingPacket()
+    : OutgoingPacket(DEFAULT_CAPACITY)
+{
+}
+
+OutgoingPacket::OutgoingPacket(std::size_t capacity)
+{
+  const auto size_class = getSizeClass(std::min(std::max<std::size_t>(capacity, 1U), MAX_LENGTH));
+  m_buffer = allocateBuffer(size_class);
+  m_capacity = std::size_t(1) << size_class;
+}
+
+OutgoingPacket::~OutgoingPacket()
 {
-  if (m_bufferpool.empty())
+  if (m_buffer)
   {
-    m_buffer = std::make_unique<std::array<std::uint8_t, 8192>>();
-    LOG_DEBUG("Allocated new buffer");
+    releaseBuffer(getSizeClass(m_capacity), std::move(m_buffer));
   }
-  else
+}
+
+OutgoingPacket::OutgoingPacket(OutgoingPacket&& other) noexcept
+    : m_buffer(std::move(other.m_buffer)),
+      m_capacity(other.m_capacity),
+      m_position(other.m_position),
+      m_overflowed(other.m_overflowed)
+{
+  other.m_capacity = 0;
+  other.m_position = 0;
+  other.m_overflowed = false;
+}
+
+OutgoingPacket& OutgoingPacket::operator=(OutgoingPacket&& other) noexcept
+{
+  if (this != &other)
   {
-    m_buffer = std::move(m_bufferpool.top());
-    m_bufferpool.pop();
-    LOG_DEBUG("Retrieved buffer from pool, buffers now in pool: %lu",
-              m_bufferpool.size());
+    if (m_buffer)
+    {
+      releaseBuffer(getSizeClass(m_capacity), std::move(m_buffer));
+    }
+
+    m_buffer = std::move(other.m_buffer);
+    m_capacity = other.m_capacity;
+    m_position = other.m_position;
+    m_overflowed = other.m_overflowed;
+
+    other.m_capacity = 0;
+    other.m_position = 0;
+    other.m_overflowed = false;
   }
+  return *this;
 }
 
-OutgoingPacket::~OutgoingPacket()
+bool OutgoingPacket::reserve(std::size_t num_bytes)
 {
+  if (num_bytes > bytesLeft())
+  {
+    return false;
+  }
+
+  const auto length = m_position + num_bytes;
+  if (length <= m_capacity)
+  {
+    return true;
+  }
+
+  // Replace the buffer with one from a size class that is large enough
+  const auto size_class = getSizeClass(length);
+  auto buffer = allocateBuffer(size_class);
   if (m_buffer)
   {
-    m_bufferpool.push(std::move(m_buffer));
-    LOG_DEBUG("Returned buffer to pool, buffers now in pool: %lu",
-              m_bufferpool.size());
+    std::copy(m_buffer.get(), m_buffer.get() + m_position, buffer.get());
+    releaseBuffer(getSizeClass(m_capacity), std::move(m_buffer));
   }
+
+  LOG_DEBUG("%s: capacity increased from %lu to %lu", __func__, m_capacity, std::size_t(1) << size_class);
+
+  m_buffer = std::move(buffer);
+  m_capacity = std::size_t(1) << size_class;
+  return true;
 }
 
-void OutgoingPacket::skipBytes(std::size_t num_bytes)
+std::uint8_t* OutgoingPacket::reserveBytes(std::size_t num_bytes)
 {
-  std::fill(m_buffer->begin() + m_position, m_buffer->begin() + m_position + num_bytes, 0);
+  if (m_overflowed)
+  {
+    return nullptr;
+  }
+
+  if (!reserve(num_bytes))
+  {
+    LOG_ERROR("%s: packet length would exceed %lu bytes (length: %lu, adding: %lu)",
+              __func__,
+              MAX_LENGTH,
+              m_position,
+              num_bytes);
+    m_overflowed = true;
+    return nullptr;
+  }
+
+  auto* bytes = m_buffer.get() + m_position;
   m_position += num_bytes;
+  return bytes;
+}
+
+void OutgoingPacket::skipBytes(std::size_t num_bytes)
+{
+  auto* bytes = reserveBytes(num_bytes);
+  if (bytes)
+  {
+    std::fill(bytes, bytes + num_bytes, 0);
+  }
 }
 
 void OutgoingPacket::addU8(std::uint8_t val)
 {
-  m_buffer->at(m_position++) = val;
+  auto* bytes = reserveBytes(1);
+  if (bytes)
+  {
+    bytes[0] = val;
+  }
 }
 
 void OutgoingPacket::addU16(std::uint16_t val)
 {
-  m_buffer->at(m_position++) = val;
-  m_buffer->at(m_position++) = val >> 8;
+  auto* bytes = reserveBytes(2);
+  if (bytes)
+  {
+    bytes[0] = val;
+    bytes[1] = val >> 8;
+  }
 }
 
 void OutgoingPacket::addU32(std::uint32_t val)
 {
-  m_buffer->at(m_position++) = val;
-  m_buffer->at(m_position++) = val >> 8;
-  m_buffer->at(m_position++) = val >> 16;
-  m_buffer->at(m_position++) = val >> 24;
+  auto* bytes = reserveBytes(4);
+  if (!bytes)
+  {
+    return;
+  }
+  bytes[0] = val;
+  bytes[1] = val >> 8;
+  bytes[2] = val >> 16;
+  bytes[3] = val >> 24;
 }
 
 void OutgoingPacket::addString(const std::string& string)
 {
-  addU16(string.length());
-  for (auto c : string)
+  // The length and the string are reserved together, so that neither is added if the
+  // string doesn't fit
+  auto* bytes = reserveBytes(2 + string.length());
+  if (bytes)
   {
-    m_buffer->at(m_position++) = c;
+    bytes[0] = string.length();
+    bytes[1] = string.length() >> 8;
+    std::copy(string.begin(), string.end(), bytes + 2);
   }
 }
 
 void OutgoingPacket::addRawData(const std::uint8_t* buffer, std::size_t length)
 {
-  std::copy(buffer, buffer + length, m_buffer->data() + m_position);
-  m_position += length;
+  auto* bytes = reserveBytes(length);
+  if (bytes)
+  {
+    std::copy(buffer, buffer + length, bytes);
+  }
+}
+
+std::size_t OutgoingPacket::getSizeClass(std::size_t capacity)
+{
+  auto size_class = MIN_SIZE_CLASS_BITS;
+  while ((std::size_t(1) << size_class) < capacity)
+  {
+    size_class += 1;
+  }
+  return size_class;
+}
+
+OutgoingPacket::Buffer OutgoingPacket::allocateBuffer(std::size_t size_class)
+{
+  auto& bufferpool = m_bufferpools[size_class - MIN_SIZE_CLASS_BITS];
+  if (bufferpool.empty())
+  {
+    LOG_DEBUG("Allocated new buffer of size %lu", std::size_t(1) << size_class);
+    return Buffer(new std::uint8_t[std::size_t(1) << size_class]);
+  }
+
+  auto buffer = std::move(bufferpool.top());
+  bufferpool.pop();
+  LOG_DEBUG("Retrieved buffer of size %lu from pool, buffers now in pool: %lu",
+            std::size_t(1) << size_class,
+            bufferpool.size());
+  return buffer;
+}
+
+void OutgoingPacket::releaseBuffer(std::size_t size_class, Buffer&& buffer)
+{
+  auto& bufferpool = m_bufferpools[size_class - MIN_SIZE_CLASS_BITS];
+  bufferpool.push(std::move(buffer));
+  LOG_DEBUG("Returned buffer of size %lu to pool, buffers now in pool: %lu",
+            std::size_t(1) << size_class,
+            bufferpool.size());
 }
 
 }  // namespace network
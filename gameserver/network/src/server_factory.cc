@@ -26,8 +26,14 @@
 
 #include <asio.hpp>
 
+#include "multi_acceptor_server_impl.h"
 #include "server_impl.h"
 #include "websocketpp_server_backend.h"
+#include "logger.h"
+
+#ifdef GAMESERVER_IO_URING
+#include "io_uring_backend.h"
+#endif
 
 namespace network
 {
@@ -39,8 +45,26 @@ struct Backend
   class Acceptor : public asio::ip::tcp::acceptor
   {
    public:
-    Acceptor(Service& io_context, int port)  //NOLINT
-      : asio::ip::tcp::acceptor(io_context, asio::ip::tcp::endpoint(asio::ip::tcp::v4(), port))
+    using reuse_port = asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+
+    // Same as the asio::ip::tcp::acceptor constructor that takes an endpoint, plus SO_REUSEPORT
+    Acceptor(Service& io_context, int port, bool reuse_port)  //NOLINT
+      : asio::ip::tcp::acceptor(io_context)
+    {
+      const asio::ip::tcp::endpoint endpoint(asio::ip::tcp::v4(), port);
+      open(endpoint.protocol());
+      set_option(asio::socket_base::reuse_address(true));
+      if (reuse_port)
+      {
+        set_option(Acceptor::reuse_port(true));
+      }
+      bind(endpoint);
+      listen();
+    }
+
+    // Takes ownership of an already listening socket
+    Acceptor(Service& io_context, ListeningSocket listening_socket)  //NOLINT
+      : asio::ip::tcp::acceptor(io_context, asio::ip::tcp::v4(), listening_socket.native_handle)
     {
     }
   };
@@ -58,12 +82,19 @@ struct Backend
     asio::async_write(socket, asio::buffer(buffer, length), handler);
   }
 
-  static void async_read(Socket& socket,  //NOLINT
-                         std::uint8_t* buffer,
-                         std::size_t length,
-                         const std::function<void(const Backend::ErrorCode&, std::size_t)>& handler)
+  // Written data is not buffered by asio, it is only in the queue of the connection
+  static std::size_t get_buffered_amount(const Socket& socket)  //NOLINT
+  {
+    (void)socket;
+    return 0U;
+  }
+
+  static void async_read_some(Socket& socket,  //NOLINT
+                              std::uint8_t* buffer,
+                              std::size_t length,
+                              const std::function<void(const Backend::ErrorCode&, std::size_t)>& handler)
   {
-    asio::async_read(socket, asio::buffer(buffer, length), handler);
+    socket.async_read_some(asio::buffer(buffer, length), handler);
   }
 };
 
@@ -74,11 +105,72 @@ std::unique_ptr<Server> ServerFactory::createServer(asio::io_context* io_context
   return std::make_unique<ServerImpl<Backend>>(io_context, port, on_client_connected);
 }
 
+std::unique_ptr<Server> ServerFactory::createMultiAcceptorServer(asio::io_context* io_context,
+                                                                 int port,
+                                                                 int num_acceptors,
+                                                                 const OnClientConnectedCallback& on_client_connected)
+{
+  return std::make_unique<MultiAcceptorServerImpl<Backend>>(io_context, port, num_acceptors, on_client_connected);
+}
+
+std::unique_ptr<Server> ServerFactory::createServerFromSockets(asio::io_context* io_context,
+                                                               const std::vector<int>& listening_sockets,
+                                                               const OnClientConnectedCallback& on_client_connected)
+{
+  if (listening_sockets.empty())
+  {
+    LOG_ERROR("%s: no listening sockets", __func__);
+    return {};
+  }
+
+  std::vector<ListeningSocket> sockets;
+  for (const auto native_handle : listening_sockets)
+  {
+    sockets.push_back(ListeningSocket{ native_handle });
+  }
+
+  if (sockets.size() == 1U)
+  {
+    return std::make_unique<ServerImpl<Backend>>(io_context, sockets.front(), on_client_connected);
+  }
+  return std::make_unique<MultiAcceptorServerImpl<Backend>>(io_context, sockets, on_client_connected);
+}
+
+std::unique_ptr<Server> ServerFactory::createIoUringServer(asio::io_context* io_context,
+                                                           int port,
+                                                           const OnClientConnectedCallback& on_client_connected)
+{
+#ifdef GAMESERVER_IO_URING
+  auto service = IoUringService::create(io_context);
+  if (!service)
+  {
+    return {};
+  }
+
+  // Listen before creating the server, so that an error can be returned
+  const auto fd = IoUringBackend::Acceptor::listen(port, false);
+  if (fd < 0)
+  {
+    return {};
+  }
+
+  // The service is kept alive by the acceptor and the sockets
+  return std::make_unique<ServerImpl<IoUringBackend>>(service.get(), ListeningSocket{ fd }, on_client_connected);
+#else
+  (void)io_context;
+  (void)port;
+  (void)on_client_connected;
+  LOG_ERROR("%s: io_uring support not compiled in (GAMESERVER_IO_URING)", __func__);
+  return {};
+#endif
+}
+
 std::unique_ptr<Server> ServerFactory::createWebsocketServer(asio::io_context* io_context,
                                                              int port,
+                                                             std::size_t compression_threshold,
                                                              const OnClientConnectedCallback& on_client_connected)
 {
-  return std::make_unique<WebsocketServerImpl>(io_context, port, on_client_connected);
+  return std::make_unique<WebsocketServerImpl>(io_context, port, compression_threshold, on_client_connected);
 }
 
 }  // namespace network
@@ -30,6 +30,7 @@
 #include <memory>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "acceptor.h"
 #include "connection_impl.h"
@@ -45,13 +46,15 @@ class ServerImpl : public Server
   ServerImpl(typename Backend::Service* io_context,
              int port,
              const std::function<void(std::unique_ptr<Connection>&&)>& on_client_connected)
-      : m_acceptor(io_context,
-                   port,
-                   [on_client_connected](typename Backend::Socket&& socket)
-                   {
-                     LOG_DEBUG("onAccept()");
-                     on_client_connected(std::make_unique<ConnectionImpl<Backend>>(std::move(socket)));
-                   })
+      : m_acceptor(io_context, port, createOnAccept(on_client_connected))
+  {
+  }
+
+  // Accepts connections on an already listening socket, and takes ownership of it
+  ServerImpl(typename Backend::Service* io_context,
+             ListeningSocket listening_socket,
+             const std::function<void(std::unique_ptr<Connection>&&)>& on_client_connected)
+      : m_acceptor(io_context, io_context, listening_socket, createOnAccept(on_client_connected))
   {
   }
 
@@ -59,7 +62,27 @@ class ServerImpl : public Server
   ServerImpl(const ServerImpl&) = delete;
   ServerImpl& operator=(const ServerImpl&) = delete;
 
+  std::vector<int> getListeningSockets() override
+  {
+    return { m_acceptor.getNativeHandle() };
+  }
+
+  void stopAccepting() override
+  {
+    m_acceptor.stop();
+  }
+
  private:
+  static std::function<void(typename Backend::Socket&&)> createOnAccept(
+      const std::function<void(std::unique_ptr<Connection>&&)>& on_client_connected)
+  {
+    return [on_client_connected](typename Backend::Socket&& socket)
+    {
+      LOG_DEBUG("onAccept()");
+      on_client_connected(std::make_unique<ConnectionImpl<Backend>>(std::move(socket)));
+    };
+  }
+
   Acceptor<Backend> m_acceptor;
 };
 
@@ -24,6 +24,7 @@
 
 #include "websocketpp_client_backend.h"
 
+#include <algorithm>
 #include <memory>
 
 #define ASIO_STANDALONE 1
@@ -164,7 +165,7 @@ void WebsocketClient::asyncRead(std::uint8_t* buffer,
 void WebsocketClient::checkAsyncRead()
 {
   // Calling the handler might queue another async_read, so continue to check
-  // until either the buffer is nullptr (no new async_read made) or we don't have enough
+  // until either the buffer is nullptr (no new async_read made) or we don't have any
   // data
   /*
   LOG_DEBUG("%s: have buffer=%s, m_read_buffer.size() = %d, m_async_read_length=%d",
@@ -173,14 +174,15 @@ void WebsocketClient::checkAsyncRead()
             static_cast<int>(m_read_buffer.size()),
             static_cast<int>(m_async_read_length));
   */
-  while (m_async_read_buffer && m_read_buffer.size() >= m_async_read_length)
+  while (m_async_read_buffer && !m_read_buffer.empty())
   {
+    const auto length = std::min(m_read_buffer.size(), m_async_read_length);
     std::copy(m_read_buffer.begin(),
-              m_read_buffer.begin() + m_async_read_length,
+              m_read_buffer.begin() + length,
               m_async_read_buffer);
-    m_read_buffer.erase(m_read_buffer.begin(), m_read_buffer.begin() + m_async_read_length);
+    m_read_buffer.erase(m_read_buffer.begin(), m_read_buffer.begin() + length);
     m_async_read_buffer = nullptr;
-    m_async_read_handler(ErrorCode(), m_async_read_length);
+    m_async_read_handler(ErrorCode(), length);
   }
 }
 
@@ -192,10 +194,10 @@ void WebsocketBackend::async_write(Socket& socket,  // NOLINT
   socket.client->asyncWrite(buffer, length, handler);
 }
 
-void WebsocketBackend::async_read(Socket& socket,  // NOLINT
-                                  std::uint8_t* buffer,
-                                  std::size_t length,
-                                  const WebsocketClient::AsyncHandler& handler)
+void WebsocketBackend::async_read_some(Socket& socket,  // NOLINT
+                                       std::uint8_t* buffer,
+                                       std::size_t length,
+                                       const WebsocketClient::AsyncHandler& handler)
 {
   socket.client->asyncRead(buffer, length, handler);
 }
@@ -63,6 +63,7 @@ class WebsocketClient
   void asyncWrite(const std::uint8_t* buffer,
                   std::size_t length,
                   const AsyncHandler& handler);
+  // asyncRead completes as soon as there is any data, with at most length bytes
   void asyncRead(std::uint8_t* buffer,
                  std::size_t length,
                  const AsyncHandler& handler);
@@ -103,10 +104,17 @@ struct WebsocketBackend
                           std::size_t length,
                           const WebsocketClient::AsyncHandler& handler);
 
-  static void async_read(Socket& socket,  // NOLINT
-                         std::uint8_t* buffer,
-                         std::size_t length,
-                         const WebsocketClient::AsyncHandler& handler);
+  // The client doesn't limit its queue, so the data buffered by websocketpp is not needed
+  static std::size_t get_buffered_amount(const Socket& socket)  // NOLINT
+  {
+    (void)socket;
+    return 0U;
+  }
+
+  static void async_read_some(Socket& socket,  // NOLINT
+                              std::uint8_t* buffer,
+                              std::size_t length,
+                              const WebsocketClient::AsyncHandler& handler);
 };
 
 }  // namespace network
@@ -24,6 +24,8 @@
 
 #include "websocketpp_server_backend.h"
 
+#include <algorithm>
+
 #include "logger.h"
 
 namespace network
@@ -45,10 +47,10 @@ void WebsocketBackend::Socket::close(ErrorCode& ec)
   server->close(hdl, ec);
 }
 
-void WebsocketBackend::async_read(Socket socket,  // NOLINT
-                                  std::uint8_t* buffer,
-                                  unsigned length,
-                                  const std::function<void(ErrorCode, std::size_t)>& callback)
+void WebsocketBackend::async_read_some(Socket socket,  // NOLINT
+                                       std::uint8_t* buffer,
+                                       unsigned length,
+                                       const std::function<void(ErrorCode, std::size_t)>& callback)
 {
   socket.server->asyncRead(socket, buffer, length, callback);
 }
@@ -61,10 +63,17 @@ void WebsocketBackend::async_write(Socket socket,  // NOLINT
   socket.server->asyncWrite(socket, buffer, length, callback);
 }
 
+std::size_t WebsocketBackend::get_buffered_amount(const Socket& socket)  // NOLINT
+{
+  return socket.server->getBufferedAmount(socket);
+}
+
 WebsocketServerImpl::WebsocketServerImpl(asio::io_context* io_context,
                                          int port,
+                                         std::size_t compression_threshold,
                                          std::function<void(std::unique_ptr<Connection>&&)> on_client_connected)
-    : m_on_client_connected(std::move(on_client_connected))
+    : m_compression_threshold(compression_threshold),
+      m_on_client_connected(std::move(on_client_connected))
 {
 
   websocketpp::lib::error_code ec;
@@ -86,6 +95,7 @@ WebsocketServerImpl::WebsocketServerImpl(asio::io_context* io_context,
     auto socket = WebsocketBackend::Socket();
     socket.server = this;
     socket.hdl = hdl;
+    socket.compression_threshold = m_compression_threshold;
     m_on_client_connected(std::make_unique<ConnectionImpl<WebsocketBackend>>(std::move(socket)));
   });
 
@@ -113,7 +123,7 @@ WebsocketServerImpl::WebsocketServerImpl(asio::io_context* io_context,
     }
 
     auto& buffered_data = *it;
-    buffered_data.payload.insert(buffered_data.payload.begin(),
+    buffered_data.payload.insert(buffered_data.payload.end(),
                                  reinterpret_cast<const std::uint8_t*>(msg->get_payload().c_str()),
                                  reinterpret_cast<const std::uint8_t*>(msg->get_payload().c_str()) + msg->get_payload().length());
 
@@ -125,6 +135,21 @@ WebsocketServerImpl::WebsocketServerImpl(asio::io_context* io_context,
   m_server.start_accept();
 }
 
+void WebsocketServerImpl::stopAccepting()
+{
+  if (!m_server.is_listening())
+  {
+    return;
+  }
+
+  websocketpp::lib::error_code ec;
+  m_server.stop_listening(ec);
+  if (ec)
+  {
+    LOG_ERROR("%s: could not stop listening: %s", __func__, ec.message().c_str());
+  }
+}
+
 void WebsocketServerImpl::asyncRead(const WebsocketBackend::Socket& socket,
                                     std::uint8_t* buffer,
                                     unsigned length,
@@ -145,7 +170,20 @@ void WebsocketServerImpl::asyncWrite(const WebsocketBackend::Socket& socket,
                                      const std::function<void(WebsocketBackend::ErrorCode, std::size_t)>& callback)
 {
   websocketpp::lib::error_code error;
-  m_server.send(socket.hdl, buffer, length, websocketpp::frame::opcode::BINARY, error);
+  auto connection = m_server.get_con_from_hdl(socket.hdl, error);
+  if (!error)
+  {
+    // Small packets don't gain anything from being compressed, so only compress large ones
+    // If the client didn't negotiate permessage-deflate the message is sent uncompressed
+    auto message = websocketpp::lib::make_shared<WebsocketServerConfig::message_type>(
+        WebsocketServerConfig::message_type::con_msg_man_ptr(),
+        websocketpp::frame::opcode::BINARY,
+        length);
+    message->append_payload(buffer, length);
+    message->set_compressed(socket.compression_threshold != 0U && length >= socket.compression_threshold);
+    error = connection->send(message);
+  }
+
   if (error)
   {
     callback(WebsocketBackend::ErrorCode(error.message()), 0U);
@@ -156,6 +194,18 @@ void WebsocketServerImpl::asyncWrite(const WebsocketBackend::Socket& socket,
   }
 }
 
+std::size_t WebsocketServerImpl::getBufferedAmount(const WebsocketBackend::Socket& socket)
+{
+  websocketpp::lib::error_code error;
+  auto connection = m_server.get_con_from_hdl(socket.hdl, error);
+  if (error)
+  {
+    // The connection is closed, nothing more will be written
+    return 0U;
+  }
+  return connection->get_buffered_amount();
+}
+
 void WebsocketServerImpl::close(const websocketpp::connection_hdl& hdl, WebsocketBackend::ErrorCode& ec)
 {
   // Close socket
@@ -222,20 +272,21 @@ void WebsocketServerImpl::fix(websocketpp::lib::shared_ptr<void> hdl_lock)
   }
   auto& data = *bit;
 
-  // Check if we have enough data to send
-  if (data.payload.size() >= read.length)
+  // Forward as much data as we have, but at most read.length bytes
+  if (!data.payload.empty())
   {
+    const auto length = std::min<std::size_t>(data.payload.size(), read.length);
+
     // Copy from payload to async_read buffer, then delete it from payload
-    std::copy(data.payload.begin(), data.payload.begin() + read.length, read.buffer);
-    data.payload.erase(data.payload.begin(), data.payload.begin() + read.length);
+    std::copy(data.payload.begin(), data.payload.begin() + length, read.buffer);
+    data.payload.erase(data.payload.begin(), data.payload.begin() + length);
 
     // Make sure to delete AsyncRead before calling callback, as a new async_read call
     // can be made within the callback
     const auto callback = read.callback;
-    const auto length = read.length;
     m_async_reads.erase(ait);
 
-    LOG_DEBUG("%s: forwarding data to async_read call with length: %u", __func__, length);
+    LOG_DEBUG("%s: forwarding data to async_read call with length: %u", __func__, static_cast<unsigned>(length));
 
     callback(WebsocketBackend::ErrorCode(), length);
   }
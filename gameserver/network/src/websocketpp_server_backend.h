@@ -34,6 +34,7 @@
 
 #define ASIO_STANDALONE 1
 #include <websocketpp/config/asio_no_tls.hpp>
+#include <websocketpp/extensions/permessage_deflate/enabled.hpp>
 #include <websocketpp/server.hpp>
 
 #include "error_code.h"
@@ -45,6 +46,16 @@ namespace network
 
 class WebsocketServerImpl;
 
+// Same as websocketpp::config::asio but with the permessage-deflate extension enabled
+// It is only used if the client asks for it when connecting
+struct WebsocketServerConfig : public websocketpp::config::asio
+{
+  using type = WebsocketServerConfig;
+
+  struct permessage_deflate_config {};
+  using permessage_deflate_type = websocketpp::extensions::permessage_deflate::enabled<permessage_deflate_config>;
+};
+
 struct WebsocketBackend
 {
   enum shutdown_type
@@ -59,37 +70,48 @@ struct WebsocketBackend
     WebsocketServerImpl* server;
     websocketpp::connection_hdl hdl;
 
+    // Packets of at least this many bytes are compressed, 0 means never
+    std::size_t compression_threshold;
+
     bool is_open() const;  // NOLINT
     static void shutdown(shutdown_type, ErrorCode&);  // NOLINT
     void close(ErrorCode&);  // NOLINT
   };
 
-  static void async_read(Socket socket,  // NOLINT
-                         std::uint8_t* buffer,
-                         unsigned length,
-                         const std::function<void(ErrorCode, std::size_t)>& callback);
+  static void async_read_some(Socket socket,  // NOLINT
+                              std::uint8_t* buffer,
+                              unsigned length,
+                              const std::function<void(ErrorCode, std::size_t)>& callback);
 
   static void async_write(Socket socket,  // NOLINT
                           const std::uint8_t* buffer,
                           unsigned length,
                           const std::function<void(ErrorCode, std::size_t)>& callback);
+
+  // async_write completes as soon as websocketpp has buffered the message, this is the
+  // amount of data that websocketpp has buffered but not yet written to the socket
+  static std::size_t get_buffered_amount(const Socket& socket);  // NOLINT
 };
 
 class WebsocketServerImpl : public Server
 {
-  using WebsocketServer = websocketpp::server<websocketpp::config::asio>;
+  using WebsocketServer = websocketpp::server<WebsocketServerConfig>;
 
  public:
   WebsocketServerImpl(asio::io_context* io_context,
                       int port,
+                      std::size_t compression_threshold,
                       std::function<void(std::unique_ptr<Connection>&&)> on_client_connected);
 
   ~WebsocketServerImpl() override
   {
-    m_server.stop_listening();
+    stopAccepting();
   }
 
+  void stopAccepting() override;
+
   // Called from static functions in WebsocketBackend
+  // asyncRead completes as soon as there is any data, with at most length bytes
   void asyncRead(const WebsocketBackend::Socket& socket,
                  std::uint8_t* buffer,
                  unsigned length,
@@ -100,6 +122,8 @@ class WebsocketServerImpl : public Server
                   unsigned length,
                   const std::function<void(WebsocketBackend::ErrorCode, std::size_t)>& callback);
 
+  std::size_t getBufferedAmount(const WebsocketBackend::Socket& socket);
+
   // Called from functions in WebsocketBackend::Socket
   void close(const websocketpp::connection_hdl& hdl, WebsocketBackend::ErrorCode& ec);  // NOLINT
 
@@ -108,6 +132,7 @@ class WebsocketServerImpl : public Server
   void fix(websocketpp::lib::shared_ptr<void> hdl_lock);
 
   WebsocketServer m_server;
+  std::size_t m_compression_threshold;
   std::function<void(std::unique_ptr<Connection>&&)> m_on_client_connected;
 
   struct AsyncRead
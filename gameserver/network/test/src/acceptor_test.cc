@@ -145,4 +145,33 @@ TEST_F(AcceptorTest, AsyncAcceptAbort)
   acceptor_.reset();
 }
 
+TEST_F(AcceptorTest, SeparateSocketService)
+{
+  using ::testing::_;
+  using ::testing::Invoke;
+  using ::testing::SaveArg;
+
+  // Create Acceptor that listens using acceptor_service and accepts into sockets on service_
+  // async_accept and cancel should be called on acceptor_service
+  Backend::Service acceptor_service;
+  std::function<void(Backend::ErrorCode)> callback;
+  EXPECT_CALL(acceptor_service, acceptor_async_accept(_, _)).WillOnce(SaveArg<1>(&callback));
+  acceptor_ = std::make_unique<Acceptor<Backend>>(&acceptor_service, &service_, 1234, true, [this](Backend::Socket socket)
+  {
+    onAcceptMock_.onAccept(socket);
+  });
+
+  // The accepted socket should be on service_
+  EXPECT_CALL(onAcceptMock_, onAccept(_)).WillOnce(Invoke([this](const Backend::Socket& socket)
+  {
+    EXPECT_EQ(&service_, &socket.service_);
+  }));
+  EXPECT_CALL(acceptor_service, acceptor_async_accept(_, _));
+  callback(Backend::Error::no_error);
+
+  // Delete Acceptor
+  EXPECT_CALL(acceptor_service, acceptor_cancel());
+  acceptor_.reset();
+}
+
 }  // namespace network
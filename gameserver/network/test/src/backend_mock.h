@@ -29,6 +29,8 @@
 
 #include "gmock/gmock.h"
 
+#include "acceptor.h"
+
 namespace network
 {
 
@@ -57,6 +59,7 @@ struct Backend
     // Calls from Acceptor
     MOCK_METHOD0(acceptor_cancel, void());
     MOCK_METHOD2(acceptor_async_accept, void(Socket&, const std::function<void(const ErrorCode&)>&));
+    MOCK_CONST_METHOD0(acceptor_native_handle, int());
 
     // Calls from Socket
     MOCK_CONST_METHOD0(socket_is_open, bool());
@@ -69,10 +72,12 @@ struct Backend
                                    std::size_t,
                                    const std::function<void(const ErrorCode&, std::size_t)>&));
 
-    MOCK_METHOD4(async_read, void(Socket&,
-                                  std::uint8_t*,
-                                  std::size_t,
-                                  const std::function<void(const ErrorCode&, std::size_t)>&));
+    MOCK_METHOD4(async_read_some, void(Socket&,
+                                       std::uint8_t*,
+                                       std::size_t,
+                                       const std::function<void(const ErrorCode&, std::size_t)>&));
+
+    MOCK_CONST_METHOD0(get_buffered_amount, std::size_t());
   };
 
   struct Socket
@@ -91,13 +96,23 @@ struct Backend
 
   struct Acceptor
   {
-    Acceptor(Service& service, int port)
+    Acceptor(Service& service, int port, bool reuse_port)
       : service_(service),
-        port_(port)
+        port_(port),
+        reuse_port_(reuse_port)
+    {
+    }
+
+    Acceptor(Service& service, ListeningSocket listening_socket)
+      : service_(service),
+        port_(-1),
+        reuse_port_(false),
+        listening_socket_(listening_socket.native_handle)
     {
     }
 
     void cancel() { service_.acceptor_cancel(); }
+    int native_handle() const { return service_.acceptor_native_handle(); }
     void async_accept(Socket& s, const std::function<void(const ErrorCode&)>& cb)
     {
       service_.acceptor_async_accept(s, cb);
@@ -105,6 +120,8 @@ struct Backend
 
     Service& service_;
     int port_;
+    bool reuse_port_;
+    int listening_socket_ = -1;
   };
 
   static void async_write(Socket& socket,
@@ -115,12 +132,17 @@ struct Backend
     socket.service_.async_write(socket, buffer, length, handler);
   }
 
-  static void async_read(Socket& socket,
-                         std::uint8_t* buffer,
-                         std::size_t length,
-                         const std::function<void(const ErrorCode&, std::size_t)>& handler)
+  static void async_read_some(Socket& socket,
+                              std::uint8_t* buffer,
+                              std::size_t length,
+                              const std::function<void(const ErrorCode&, std::size_t)>& handler)
+  {
+    socket.service_.async_read_some(socket, buffer, length, handler);
+  }
+
+  static std::size_t get_buffered_amount(const Socket& socket)
   {
-    socket.service_.async_read(socket, buffer, length, handler);
+    return socket.service_.get_buffered_amount();
   }
 };
 
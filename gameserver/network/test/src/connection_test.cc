@@ -22,7 +22,10 @@
  * SOFTWARE.
  */
 
+#include <algorithm>
+#include <iterator>
 #include <memory>
+#include <vector>
 
 #include "gtest/gtest.h"
 #include "gmock/gmock.h"
@@ -37,6 +40,8 @@ using ::testing::_;
 using ::testing::SaveArg;
 using ::testing::Pointee;
 using ::testing::Return;
+using ::testing::InSequence;
+using ::testing::InvokeArgument;
 
 // To be able to match IncomingPackets
 bool operator==(const IncomingPacket& a, const IncomingPacket& b)
@@ -112,7 +117,7 @@ TEST_F(ConnectionTest, InitClose)
   // Create and initialize connection
   connection_ = std::make_unique<ConnectionImpl<Backend>>(Backend::Socket(service_));
 
-  EXPECT_CALL(service_, async_read(_, _, _, _)).WillOnce(SaveArg<3>(&readHandler));
+  EXPECT_CALL(service_, async_read_some(_, _, _, _)).WillOnce(SaveArg<3>(&readHandler));
   connection_->init(callbacks_, false);
 
   // Close the connection with force = false
@@ -129,7 +134,7 @@ TEST_F(ConnectionTest, InitClose)
   // Create and initialize connection
   connection_ = std::make_unique<ConnectionImpl<Backend>>(Backend::Socket(service_));
 
-  EXPECT_CALL(service_, async_read(_, _, _, _)).WillOnce(SaveArg<3>(&readHandler));
+  EXPECT_CALL(service_, async_read_some(_, _, _, _)).WillOnce(SaveArg<3>(&readHandler));
   connection_->init(callbacks_, false);
 
   // Close the connection with force = true
@@ -151,28 +156,108 @@ TEST_F(ConnectionTest, ReceivePacket)
 
   // Create and initialize connection
   connection_ = std::make_unique<ConnectionImpl<Backend>>(Backend::Socket(service_));
-  EXPECT_CALL(service_, async_read(_, _, 2, _)).WillOnce(DoAll(SaveArg<1>(&buffer), SaveArg<3>(&readHandler)));
+  EXPECT_CALL(service_, async_read_some(_, _, _, _)).WillOnce(DoAll(SaveArg<1>(&buffer), SaveArg<3>(&readHandler)));
   connection_->init(callbacks_, false);
   ASSERT_NE(nullptr, buffer);
 
-  // Send packet header to connection (packet data is 4 bytes)
+  // Send packet header and packet data (4 bytes) to connection
   buffer[0] = 0x04;
   buffer[1] = 0x00;
-  buffer = nullptr;
-  EXPECT_CALL(service_, async_read(_, _, 4, _)).WillOnce(DoAll(SaveArg<1>(&buffer), SaveArg<3>(&readHandler)));
-  readHandler(Backend::Error::no_error, 2);
-  ASSERT_NE(nullptr, buffer);
-
-  // Send packet data to connection
-  buffer[0] = 0x12;
-  buffer[1] = 0x34;
-  buffer[2] = 0x56;
-  buffer[3] = 0x78;
+  buffer[2] = 0x12;
+  buffer[3] = 0x34;
+  buffer[4] = 0x56;
+  buffer[5] = 0x78;
   const std::uint8_t expectedPacketData[] = { 0x12, 0x34, 0x56, 0x78 };
   IncomingPacket expectedPacket { expectedPacketData, 4u };
   EXPECT_CALL(callbacksMock_, onPacketReceived(Pointee(expectedPacket)));
-  EXPECT_CALL(service_, async_read(_, _, 2, _));
-  readHandler(Backend::Error::no_error, 4);
+  EXPECT_CALL(service_, async_read_some(_, _, _, _));
+  readHandler(Backend::Error::no_error, 6);
+
+  // Close the connection
+  EXPECT_CALL(service_, socket_is_open()).WillOnce(Return(true));
+  EXPECT_CALL(service_, socket_shutdown(Backend::shutdown_both, _));
+  EXPECT_CALL(service_, socket_close(_));
+  connection_->close(false);
+
+  EXPECT_CALL(service_, socket_is_open()).WillOnce(Return(false));
+  EXPECT_CALL(callbacksMock_, onDisconnected());
+  readHandler(Backend::operation_aborted, 0);
+  connection_.reset();
+}
+
+TEST_F(ConnectionTest, ReceiveMultiplePacketsInOneRead)
+{
+  std::uint8_t* buffer = nullptr;
+  std::function<void(const Backend::ErrorCode&, std::size_t)> readHandler;
+
+  // Create and initialize connection
+  connection_ = std::make_unique<ConnectionImpl<Backend>>(Backend::Socket(service_));
+  EXPECT_CALL(service_, async_read_some(_, _, _, _)).WillOnce(DoAll(SaveArg<1>(&buffer), SaveArg<3>(&readHandler)));
+  connection_->init(callbacks_, false);
+  ASSERT_NE(nullptr, buffer);
+
+  // Send two complete packets in one read, both should be handled before the next read
+  const std::uint8_t data[] = { 0x02, 0x00, 0x12, 0x34, 0x01, 0x00, 0x56 };
+  std::copy(std::begin(data), std::end(data), buffer);
+  const std::uint8_t expectedPacketData1[] = { 0x12, 0x34 };
+  const std::uint8_t expectedPacketData2[] = { 0x56 };
+  IncomingPacket expectedPacket1 { expectedPacketData1, 2u };
+  IncomingPacket expectedPacket2 { expectedPacketData2, 1u };
+  {
+    InSequence s;
+    EXPECT_CALL(callbacksMock_, onPacketReceived(Pointee(expectedPacket1)));
+    EXPECT_CALL(callbacksMock_, onPacketReceived(Pointee(expectedPacket2)));
+    EXPECT_CALL(service_, async_read_some(_, buffer, _, _)).WillOnce(SaveArg<3>(&readHandler));
+  }
+  readHandler(Backend::Error::no_error, sizeof(data));
+
+  // Close the connection
+  EXPECT_CALL(service_, socket_is_open()).WillOnce(Return(true));
+  EXPECT_CALL(service_, socket_shutdown(Backend::shutdown_both, _));
+  EXPECT_CALL(service_, socket_close(_));
+  connection_->close(false);
+
+  EXPECT_CALL(service_, socket_is_open()).WillOnce(Return(false));
+  EXPECT_CALL(callbacksMock_, onDisconnected());
+  readHandler(Backend::operation_aborted, 0);
+  connection_.reset();
+}
+
+TEST_F(ConnectionTest, ReceivePacketSplitOverReads)
+{
+  std::uint8_t* buffer = nullptr;
+  std::uint8_t* next_buffer = nullptr;
+  std::function<void(const Backend::ErrorCode&, std::size_t)> readHandler;
+
+  // Create and initialize connection
+  connection_ = std::make_unique<ConnectionImpl<Backend>>(Backend::Socket(service_));
+  EXPECT_CALL(service_, async_read_some(_, _, _, _)).WillOnce(DoAll(SaveArg<1>(&buffer), SaveArg<3>(&readHandler)));
+  connection_->init(callbacks_, false);
+  ASSERT_NE(nullptr, buffer);
+
+  // Send one complete packet followed by the first part of another packet
+  // The partial packet should be moved to the beginning of the buffer
+  const std::uint8_t data1[] = { 0x01, 0x00, 0x11, 0x03, 0x00, 0x22 };
+  std::copy(std::begin(data1), std::end(data1), buffer);
+  const std::uint8_t expectedPacketData1[] = { 0x11 };
+  IncomingPacket expectedPacket1 { expectedPacketData1, 1u };
+  EXPECT_CALL(callbacksMock_, onPacketReceived(Pointee(expectedPacket1)));
+  EXPECT_CALL(service_, async_read_some(_, _, _, _)).WillOnce(DoAll(SaveArg<1>(&next_buffer),
+                                                                    SaveArg<3>(&readHandler)));
+  readHandler(Backend::Error::no_error, sizeof(data1));
+  ASSERT_EQ(buffer + 3, next_buffer);
+  EXPECT_EQ(0x03, buffer[0]);
+  EXPECT_EQ(0x00, buffer[1]);
+  EXPECT_EQ(0x22, buffer[2]);
+
+  // Send the rest of the packet
+  next_buffer[0] = 0x33;
+  next_buffer[1] = 0x44;
+  const std::uint8_t expectedPacketData2[] = { 0x22, 0x33, 0x44 };
+  IncomingPacket expectedPacket2 { expectedPacketData2, 3u };
+  EXPECT_CALL(callbacksMock_, onPacketReceived(Pointee(expectedPacket2)));
+  EXPECT_CALL(service_, async_read_some(_, buffer, _, _)).WillOnce(SaveArg<3>(&readHandler));
+  readHandler(Backend::Error::no_error, 2);
 
   // Close the connection
   EXPECT_CALL(service_, socket_is_open()).WillOnce(Return(true));
@@ -194,7 +279,7 @@ TEST_F(ConnectionTest, SendPacket)
 
   // Create and initialize connection
   connection_ = std::make_unique<ConnectionImpl<Backend>>(Backend::Socket(service_));
-  EXPECT_CALL(service_, async_read(_, _, _, _)).WillOnce(SaveArg<3>(&readHandler));
+  EXPECT_CALL(service_, async_read_some(_, _, _, _)).WillOnce(SaveArg<3>(&readHandler));
   connection_->init(callbacks_, false);
 
   // Create an OutgoingPacket
@@ -233,13 +318,165 @@ TEST_F(ConnectionTest, SendPacket)
   connection_.reset();
 }
 
+TEST_F(ConnectionTest, OverflowedPacketIsDropped)
+{
+  std::function<void(const Backend::ErrorCode&, std::size_t)> readHandler;
+
+  // Create and initialize connection
+  connection_ = std::make_unique<ConnectionImpl<Backend>>(Backend::Socket(service_));
+  EXPECT_CALL(service_, async_read_some(_, _, _, _)).WillOnce(SaveArg<3>(&readHandler));
+  connection_->init(callbacks_, false);
+
+  // The packet is incomplete, so nothing should be sent
+  OutgoingPacket outgoingPacket;
+  outgoingPacket.addU32(0x12345678);
+  outgoingPacket.skipBytes(OutgoingPacket::MAX_LENGTH);
+  ASSERT_TRUE(outgoingPacket.hasOverflowed());
+  EXPECT_CALL(service_, async_write(_, _, _, _)).Times(0);
+  connection_->sendPacket(std::move(outgoingPacket));
+  EXPECT_CALL(service_, get_buffered_amount()).WillOnce(Return(0U));
+  EXPECT_EQ(0U, connection_->updateQueueStats().packets);
+
+  // Close the connection
+  EXPECT_CALL(service_, socket_is_open()).WillOnce(Return(true));
+  EXPECT_CALL(service_, socket_shutdown(Backend::shutdown_both, _));
+  EXPECT_CALL(service_, socket_close(_));
+  connection_->close(false);
+
+  EXPECT_CALL(service_, socket_is_open()).WillOnce(Return(false));
+  EXPECT_CALL(callbacksMock_, onDisconnected());
+  readHandler(Backend::operation_aborted, 0);
+  connection_.reset();
+}
+
+TEST_F(ConnectionTest, OutgoingQueueWatermarks)
+{
+  std::function<void(const Backend::ErrorCode&, std::size_t)> writeHandler;
+  std::function<void(const Backend::ErrorCode&, std::size_t)> readHandler;
+
+  // Create and initialize connection
+  connection_ = std::make_unique<ConnectionImpl<Backend>>(Backend::Socket(service_));
+  EXPECT_CALL(service_, async_read_some(_, _, _, _)).WillOnce(SaveArg<3>(&readHandler));
+  connection_->init(callbacks_, false);
+
+  // Congested at 3 packets, no longer congested at 1 packet
+  Connection::QueueLimits limits;
+  limits.high_watermark_packets = 3U;
+  limits.low_watermark_packets = 1U;
+  connection_->setQueueLimits(limits);
+
+  // This backend doesn't buffer anything itself
+  EXPECT_CALL(service_, get_buffered_amount()).WillRepeatedly(Return(0U));
+
+  // Queue three packets with 4 bytes each, the first one is sent directly
+  EXPECT_CALL(service_, async_write(_, _, 2, _)).WillOnce(SaveArg<3>(&writeHandler));
+  for (auto i = 0; i < 3; i++)
+  {
+    OutgoingPacket outgoingPacket;
+    outgoingPacket.addU32(0x12345678);
+    connection_->sendPacket(std::move(outgoingPacket));
+  }
+  EXPECT_TRUE(connection_->updateQueueStats().congested);
+  EXPECT_EQ(3U, connection_->updateQueueStats().packets);
+  EXPECT_EQ(12U, connection_->updateQueueStats().bytes);
+
+  // Send the first packet, still congested with 2 packets in queue
+  EXPECT_CALL(service_, async_write(_, _, 4, _)).WillOnce(SaveArg<3>(&writeHandler));
+  writeHandler(Backend::Error::no_error, 2);
+  EXPECT_CALL(service_, async_write(_, _, 2, _)).WillOnce(SaveArg<3>(&writeHandler));
+  writeHandler(Backend::Error::no_error, 4);
+  EXPECT_TRUE(connection_->updateQueueStats().congested);
+  EXPECT_EQ(2U, connection_->updateQueueStats().packets);
+
+  // Send the second packet, no longer congested with 1 packet in queue
+  EXPECT_CALL(service_, async_write(_, _, 4, _)).WillOnce(SaveArg<3>(&writeHandler));
+  writeHandler(Backend::Error::no_error, 2);
+  EXPECT_CALL(service_, async_write(_, _, 2, _)).WillOnce(SaveArg<3>(&writeHandler));
+  writeHandler(Backend::Error::no_error, 4);
+  const auto& queueStats = connection_->updateQueueStats();
+  EXPECT_FALSE(queueStats.congested);
+  EXPECT_EQ(1U, queueStats.packets);
+  EXPECT_EQ(4U, queueStats.bytes);
+  EXPECT_EQ(3U, queueStats.peak_packets);
+  EXPECT_EQ(12U, queueStats.peak_bytes);
+  EXPECT_EQ(1U, queueStats.times_congested);
+
+  // Close the connection, the last packet is lost
+  EXPECT_CALL(service_, socket_is_open()).WillOnce(Return(true));
+  EXPECT_CALL(service_, socket_shutdown(Backend::shutdown_both, _));
+  EXPECT_CALL(service_, socket_close(_));
+  connection_->close(true);
+
+  EXPECT_CALL(service_, socket_is_open()).WillOnce(Return(false));
+  writeHandler(Backend::operation_aborted, 0);
+
+  EXPECT_CALL(service_, socket_is_open()).WillOnce(Return(false));
+  EXPECT_CALL(callbacksMock_, onDisconnected());
+  readHandler(Backend::operation_aborted, 0);
+  connection_.reset();
+}
+
+TEST_F(ConnectionTest, OutgoingQueueWatermarksBufferedByBackend)
+{
+  std::function<void(const Backend::ErrorCode&, std::size_t)> readHandler;
+
+  // Create and initialize connection, without packet header as with websocket connections
+  connection_ = std::make_unique<ConnectionImpl<Backend>>(Backend::Socket(service_));
+  EXPECT_CALL(service_, async_read_some(_, _, _, _)).WillOnce(SaveArg<3>(&readHandler));
+  connection_->init(callbacks_, true);
+
+  // Congested at 12 bytes, no longer congested at 4 bytes
+  Connection::QueueLimits limits;
+  limits.high_watermark_bytes = 12U;
+  limits.low_watermark_bytes = 4U;
+  connection_->setQueueLimits(limits);
+
+  // Like websocketpp, the backend buffers the data and completes each write directly, so that the
+  // queue of the connection is always empty and only the data buffered by the backend counts
+  EXPECT_CALL(service_, async_write(_, _, 4, _))
+      .Times(3)
+      .WillRepeatedly(InvokeArgument<3>(Backend::ErrorCode(Backend::Error::no_error), 4U));
+  for (auto i = 0; i < 3; i++)
+  {
+    OutgoingPacket outgoingPacket;
+    outgoingPacket.addU32(0x12345678);
+    connection_->sendPacket(std::move(outgoingPacket));
+  }
+
+  EXPECT_CALL(service_, get_buffered_amount()).WillOnce(Return(12U));
+  const auto& queueStats = connection_->updateQueueStats();
+  EXPECT_TRUE(queueStats.congested);
+  EXPECT_EQ(0U, queueStats.packets);
+  EXPECT_EQ(12U, queueStats.bytes);
+
+  // The backend writes some data, but not enough
+  EXPECT_CALL(service_, get_buffered_amount()).WillOnce(Return(8U));
+  EXPECT_TRUE(connection_->updateQueueStats().congested);
+
+  EXPECT_CALL(service_, get_buffered_amount()).WillOnce(Return(4U));
+  EXPECT_FALSE(connection_->updateQueueStats().congested);
+  EXPECT_EQ(12U, queueStats.peak_bytes);
+  EXPECT_EQ(1U, queueStats.times_congested);
+
+  // Close the connection
+  EXPECT_CALL(service_, socket_is_open()).WillOnce(Return(true));
+  EXPECT_CALL(service_, socket_shutdown(Backend::shutdown_both, _));
+  EXPECT_CALL(service_, socket_close(_));
+  connection_->close(true);
+
+  EXPECT_CALL(service_, socket_is_open()).WillOnce(Return(false));
+  EXPECT_CALL(callbacksMock_, onDisconnected());
+  readHandler(Backend::operation_aborted, 0);
+  connection_.reset();
+}
+
 TEST_F(ConnectionTest, DisconnectInHeaderReadCall)
 {
   std::function<void(const Backend::ErrorCode&, std::size_t)> readHandler;
 
   // Create and initialize connection
   connection_ = std::make_unique<ConnectionImpl<Backend>>(Backend::Socket(service_));
-  EXPECT_CALL(service_, async_read(_, _, _, _)).WillOnce(SaveArg<3>(&readHandler));
+  EXPECT_CALL(service_, async_read_some(_, _, _, _)).WillOnce(SaveArg<3>(&readHandler));
   connection_->init(callbacks_, false);
 
   // As there is no send in progress the connection should close the socket
@@ -259,14 +496,14 @@ TEST_F(ConnectionTest, DisconnectInDataReadCall)
 
   // Create and initialize connection
   connection_ = std::make_unique<ConnectionImpl<Backend>>(Backend::Socket(service_));
-  EXPECT_CALL(service_, async_read(_, _, 2, _)).WillOnce(DoAll(SaveArg<1>(&buffer), SaveArg<3>(&readHandler)));
+  EXPECT_CALL(service_, async_read_some(_, _, _, _)).WillOnce(DoAll(SaveArg<1>(&buffer), SaveArg<3>(&readHandler)));
   connection_->init(callbacks_, false);
   ASSERT_NE(nullptr, buffer);
 
-  // Set packet length to 100
+  // Set packet length to 100, but only send the packet header
   buffer[0] = 0x64;
   buffer[1] = 0x00;
-  EXPECT_CALL(service_, async_read(_, _, 0x64, _)).WillOnce(SaveArg<3>(&readHandler));
+  EXPECT_CALL(service_, async_read_some(_, buffer + 2, _, _)).WillOnce(SaveArg<3>(&readHandler));
   readHandler(Backend::no_error, 2);
 
   // As there is no send in progress the connection should close the socket
@@ -286,7 +523,7 @@ TEST_F(ConnectionTest, DisconnectInHeaderWriteCall)
 
   // Create and initialize connection
   connection_ = std::make_unique<ConnectionImpl<Backend>>(Backend::Socket(service_));
-  EXPECT_CALL(service_, async_read(_, _, _, _)).WillOnce(SaveArg<3>(&readHandler));
+  EXPECT_CALL(service_, async_read_some(_, _, _, _)).WillOnce(SaveArg<3>(&readHandler));
   connection_->init(callbacks_, false);
 
   // Send a packet (header will be sent first)
@@ -316,7 +553,7 @@ TEST_F(ConnectionTest, DisconnectInDataWriteCall)
 
   // Create and initialize connection
   connection_ = std::make_unique<ConnectionImpl<Backend>>(Backend::Socket(service_));
-  EXPECT_CALL(service_, async_read(_, _, _, _)).WillOnce(SaveArg<3>(&readHandler));
+  EXPECT_CALL(service_, async_read_some(_, _, _, _)).WillOnce(SaveArg<3>(&readHandler));
   connection_->init(callbacks_, false);
 
   // Send a packet (header will be sent first)
@@ -350,7 +587,7 @@ TEST_F(ConnectionTest, ReadsPacketLengthZero)
 
   // Create and initialize connection
   connection_ = std::make_unique<ConnectionImpl<Backend>>(Backend::Socket(service_));
-  EXPECT_CALL(service_, async_read(_, _, 2, _)).WillOnce(DoAll(SaveArg<1>(&buffer), SaveArg<3>(&readHandler)));
+  EXPECT_CALL(service_, async_read_some(_, _, _, _)).WillOnce(DoAll(SaveArg<1>(&buffer), SaveArg<3>(&readHandler)));
   connection_->init(callbacks_, false);
   ASSERT_NE(nullptr, buffer);
 
@@ -0,0 +1,224 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <asio.hpp>
+
+#include "gtest/gtest.h"
+
+#include "connection.h"
+#include "incoming_packet.h"
+#include "loopback_backend.h"
+#include "loopback_factory.h"
+#include "outgoing_packet.h"
+
+namespace network
+{
+
+class LoopbackTest : public ::testing::Test
+{
+ protected:
+  // Initializes a connection that saves each received packet and counts disconnects
+  void init(Connection* connection,
+            std::vector<std::vector<std::uint8_t>>* received,
+            int* num_disconnected)
+  {
+    Connection::Callbacks callbacks;
+    callbacks.on_packet_received = [received](IncomingPacket* packet)
+    {
+      received->push_back(packet->getBytes(static_cast<int>(packet->bytesLeft())));
+    };
+    callbacks.on_disconnected = [num_disconnected]()
+    {
+      *num_disconnected += 1;
+    };
+    connection->init(callbacks, false);
+  }
+
+  // Runs all handlers that are ready, including handlers posted by those handlers
+  void poll()
+  {
+    io_context_.restart();
+    io_context_.poll();
+  }
+
+  static OutgoingPacket createPacket(std::size_t length, std::uint8_t value)
+  {
+    OutgoingPacket packet;
+    for (auto i = 0U; i < length; i++)
+    {
+      packet.addU8(value);
+    }
+    return packet;
+  }
+
+  asio::io_context io_context_;
+};
+
+TEST_F(LoopbackTest, SendAndReceive)
+{
+  auto connections = LoopbackFactory::createConnectionPair(&io_context_);
+
+  std::vector<std::vector<std::uint8_t>> received_a;
+  std::vector<std::vector<std::uint8_t>> received_b;
+  int disconnected_a = 0;
+  int disconnected_b = 0;
+  init(connections.first.get(), &received_a, &disconnected_a);
+  init(connections.second.get(), &received_b, &disconnected_b);
+
+  connections.first->sendPacket(createPacket(3U, 0x11));
+  connections.first->sendPacket(createPacket(5U, 0x22));
+  connections.second->sendPacket(createPacket(7U, 0x33));
+  poll();
+
+  ASSERT_EQ(2U, received_b.size());
+  EXPECT_EQ(std::vector<std::uint8_t>(3U, 0x11), received_b[0]);
+  EXPECT_EQ(std::vector<std::uint8_t>(5U, 0x22), received_b[1]);
+  ASSERT_EQ(1U, received_a.size());
+  EXPECT_EQ(std::vector<std::uint8_t>(7U, 0x33), received_a[0]);
+  EXPECT_EQ(0, disconnected_a);
+  EXPECT_EQ(0, disconnected_b);
+
+  connections.first->close(true);
+  poll();
+  EXPECT_EQ(1, disconnected_a);
+  EXPECT_EQ(1, disconnected_b);
+}
+
+TEST_F(LoopbackTest, PacketsLargerThanBuffer)
+{
+  // Each packet needs several reads and writes to pass through the 16 byte buffer
+  auto connections = LoopbackFactory::createConnectionPair(&io_context_, 16U);
+
+  std::vector<std::vector<std::uint8_t>> received_a;
+  std::vector<std::vector<std::uint8_t>> received_b;
+  int disconnected_a = 0;
+  int disconnected_b = 0;
+  init(connections.first.get(), &received_a, &disconnected_a);
+  init(connections.second.get(), &received_b, &disconnected_b);
+
+  for (auto i = 0U; i < 10U; i++)
+  {
+    connections.first->sendPacket(createPacket(1000U, static_cast<std::uint8_t>(i)));
+  }
+  poll();
+
+  ASSERT_EQ(10U, received_b.size());
+  for (auto i = 0U; i < 10U; i++)
+  {
+    EXPECT_EQ(std::vector<std::uint8_t>(1000U, static_cast<std::uint8_t>(i)), received_b[i]);
+  }
+  EXPECT_EQ(0U, connections.first->updateQueueStats().packets);
+
+  connections.second->close(true);
+  poll();
+  EXPECT_EQ(1, disconnected_a);
+  EXPECT_EQ(1, disconnected_b);
+}
+
+TEST_F(LoopbackTest, GracefulCloseSendsQueuedPackets)
+{
+  auto connections = LoopbackFactory::createConnectionPair(&io_context_, 16U);
+
+  std::vector<std::vector<std::uint8_t>> received_a;
+  std::vector<std::vector<std::uint8_t>> received_b;
+  int disconnected_a = 0;
+  int disconnected_b = 0;
+  init(connections.first.get(), &received_a, &disconnected_a);
+  init(connections.second.get(), &received_b, &disconnected_b);
+
+  connections.first->sendPacket(createPacket(100U, 0x44));
+  connections.first->sendPacket(createPacket(100U, 0x55));
+  connections.first->close(false);
+  poll();
+
+  ASSERT_EQ(2U, received_b.size());
+  EXPECT_EQ(std::vector<std::uint8_t>(100U, 0x44), received_b[0]);
+  EXPECT_EQ(std::vector<std::uint8_t>(100U, 0x55), received_b[1]);
+  EXPECT_EQ(1, disconnected_a);
+  EXPECT_EQ(1, disconnected_b);
+}
+
+TEST_F(LoopbackTest, WriteWaitsForRoomInPeerBuffer)
+{
+  auto sockets = LoopbackBackend::Socket::createPair(&io_context_, 4U);
+
+  const std::vector<std::uint8_t> data = { 1, 2, 3, 4, 5, 6 };
+  bool written = false;
+  LoopbackBackend::async_write(sockets.first,
+                               data.data(),
+                               data.size(),
+                               [&written](const LoopbackBackend::ErrorCode& error, std::size_t length)
+                               {
+                                 EXPECT_FALSE(error);
+                                 EXPECT_EQ(6U, length);
+                                 written = true;
+                               });
+  poll();
+  EXPECT_FALSE(written);
+
+  // Reading makes room for the rest of the write
+  std::vector<std::uint8_t> buffer(8U);
+  std::vector<std::uint8_t> read;
+  const auto read_some = [&]()
+  {
+    LoopbackBackend::async_read_some(sockets.second,
+                                     buffer.data(),
+                                     buffer.size(),
+                                     [&](const LoopbackBackend::ErrorCode& error, std::size_t length)
+                                     {
+                                       EXPECT_FALSE(error);
+                                       read.insert(read.end(), buffer.begin(), buffer.begin() + length);
+                                     });
+    poll();
+  };
+
+  read_some();
+  EXPECT_EQ(4U, read.size());
+  EXPECT_TRUE(written);
+
+  read_some();
+  EXPECT_EQ(data, read);
+
+  // Closing one socket gives end of file on the other
+  LoopbackBackend::ErrorCode error;
+  sockets.first.close(error);
+  EXPECT_FALSE(error);
+
+  bool eof = false;
+  LoopbackBackend::async_read_some(sockets.second,
+                                   buffer.data(),
+                                   buffer.size(),
+                                   [&eof](const LoopbackBackend::ErrorCode& error, std::size_t length)
+                                   {
+                                     eof = !error && length == 0U;
+                                   });
+  poll();
+  EXPECT_TRUE(eof);
+}
+
+}  // namespace network
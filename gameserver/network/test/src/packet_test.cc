@@ -23,6 +23,7 @@
  */
 
 #include <memory>
+#include <string>
 
 #include "gtest/gtest.h"
 #include "gmock/gmock.h"
@@ -162,4 +163,84 @@ TEST_F(PacketTest, OutgoingPacket)
   EXPECT_EQ(0x55, packetBuffer[15]);
 }
 
+TEST_F(PacketTest, OutgoingPacketCapacity)
+{
+  // Capacity is rounded up to a size class
+  OutgoingPacket small(10);
+  EXPECT_EQ(64u, small.getCapacity());
+
+  OutgoingPacket exact(128);
+  EXPECT_EQ(128u, exact.getCapacity());
+
+  // Packets without a size hint get the smallest size class, which fits small messages
+  OutgoingPacket cancelMove;
+  cancelMove.addU8(0xB5);
+  cancelMove.addU8(0x02);
+  EXPECT_EQ(64u, cancelMove.getCapacity());
+
+  // Default capacity
+  OutgoingPacket packet;
+  EXPECT_EQ(OutgoingPacket::DEFAULT_CAPACITY, packet.getCapacity());
+
+  // The buffer grows when needed and keeps the data
+  for (auto i = 0u; i < OutgoingPacket::DEFAULT_CAPACITY + 1; i++)
+  {
+    packet.addU8(i & 0xFF);
+  }
+  EXPECT_EQ(OutgoingPacket::DEFAULT_CAPACITY + 1, packet.getLength());
+  EXPECT_LE(OutgoingPacket::DEFAULT_CAPACITY + 1, packet.getCapacity());
+  for (auto i = 0u; i < OutgoingPacket::DEFAULT_CAPACITY + 1; i++)
+  {
+    EXPECT_EQ(i & 0xFF, packet.getBuffer()[i]);
+  }
+
+  // reserve does not change the length
+  const auto length = packet.getLength();
+  EXPECT_TRUE(packet.reserve(20000));
+  EXPECT_EQ(length, packet.getLength());
+  EXPECT_LE(length + 20000, packet.getCapacity());
+
+  // But the packet can never be longer than MAX_LENGTH
+  EXPECT_FALSE(packet.reserve(OutgoingPacket::MAX_LENGTH));
+  EXPECT_FALSE(packet.hasOverflowed());
+  EXPECT_EQ(nullptr, packet.reserveBytes(OutgoingPacket::MAX_LENGTH));
+  EXPECT_EQ(length, packet.getLength());
+  EXPECT_TRUE(packet.hasOverflowed());
+
+  // Moved from packets are empty
+  OutgoingPacket moved(std::move(packet));
+  EXPECT_EQ(length, moved.getLength());
+  EXPECT_TRUE(moved.hasOverflowed());
+  EXPECT_EQ(0u, packet.getLength());  // NOLINT testing moved from state
+  EXPECT_FALSE(packet.hasOverflowed());  // NOLINT testing moved from state
+}
+
+TEST_F(PacketTest, OutgoingPacketOverflow)
+{
+  OutgoingPacket packet;
+  packet.addU8(0x01);
+
+  // A string that doesn't fit is not added at all, not even its length
+  const std::string string(OutgoingPacket::MAX_LENGTH, 'a');
+  packet.addString(string);
+  EXPECT_TRUE(packet.hasOverflowed());
+  EXPECT_EQ(1u, packet.getLength());
+
+  // Nothing more is added once the packet has overflowed, even if it would fit
+  packet.addU8(0x02);
+  packet.addU16(0x0304);
+  packet.addU32(0x05060708);
+  packet.addString("abc");
+  EXPECT_EQ(1u, packet.getLength());
+  EXPECT_EQ(0x01, packet.getBuffer()[0]);
+
+  // The largest packet that fits does not overflow
+  OutgoingPacket full;
+  full.skipBytes(OutgoingPacket::MAX_LENGTH);
+  EXPECT_FALSE(full.hasOverflowed());
+  full.addU8(0x00);
+  EXPECT_TRUE(full.hasOverflowed());
+  EXPECT_EQ(OutgoingPacket::MAX_LENGTH, full.getLength());
+}
+
 }  // namespace network
@@ -23,6 +23,7 @@
  */
 
 #include <memory>
+#include <vector>
 
 #include "gtest/gtest.h"
 #include "gmock/gmock.h"
@@ -34,6 +35,7 @@ namespace network
 {
 
 using ::testing::_;
+using ::testing::Return;
 using ::testing::SaveArg;
 
 class ServerTest : public ::testing::Test
@@ -84,4 +86,32 @@ TEST_F(ServerTest, AcceptConnection)
   server_.reset();
 }
 
+TEST_F(ServerTest, AcceptOnListeningSocket)
+{
+  std::function<void(const Backend::ErrorCode&)> onAcceptHandler;
+
+  // Create Server from an already listening socket, should call async_accept
+  EXPECT_CALL(service_, acceptor_async_accept(_, _)).WillOnce(SaveArg<1>(&onAcceptHandler));
+  server_ = std::make_unique<ServerImpl<Backend>>(&service_,
+                                                  ListeningSocket{ 42 },
+                                                  [this](std::unique_ptr<Connection>&& connection)
+  {
+    callbackMock_.onClientConnected(std::move(connection));
+  });
+
+  // Server should return the socket that it listens on
+  EXPECT_CALL(service_, acceptor_native_handle()).WillOnce(Return(42));
+  EXPECT_EQ(std::vector<int>{ 42 }, server_->getListeningSockets());
+
+  // Call onAccept handler with non-error errorcode
+  // Server should call onClientConnected callback and call async_accept again
+  EXPECT_CALL(callbackMock_, onClientConnected(_));
+  EXPECT_CALL(service_, acceptor_async_accept(_, _)).WillOnce(SaveArg<1>(&onAcceptHandler));
+  onAcceptHandler(Backend::Error::no_error);
+
+  // Delete Server, should call cancel
+  EXPECT_CALL(service_, acceptor_cancel());
+  server_.reset();
+}
+
 }  // namespace network
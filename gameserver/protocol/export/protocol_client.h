@@ -28,6 +28,7 @@
 #include <cstdint>
 #include <string>
 
+#include "protocol_schemas.h"
 #include "protocol_common.h"
 
 namespace protocol::client
@@ -39,11 +40,6 @@ struct Login
   std::uint16_t server_beat;
 };
 
-struct LoginFailed
-{
-  std::string reason;
-};
-
 struct Equipment
 {
   bool empty;
@@ -51,12 +47,6 @@ struct Equipment
   Item item;  // only if empty = false
 };
 
-struct CreatureSkull
-{
-  common::CreatureId creature_id;
-  std::uint8_t skull;
-};
-
 struct MagicEffect
 {
   common::Position position = { 0, 0, 0 };
@@ -77,12 +67,6 @@ struct PlayerStats
   std::uint8_t magic_level_perc;
 };
 
-struct WorldLight
-{
-  std::uint8_t intensity;
-  std::uint8_t color;
-};
-
 struct PlayerSkills
 {
   std::uint8_t fist;
@@ -101,12 +85,6 @@ struct PlayerSkills
   std::uint8_t fish_perc;
 };
 
-struct TextMessage
-{
-  std::uint8_t type;
-  std::string message;
-};
-
 struct ThingAdded
 {
   common::Position position = { 0, 0, 0 };
@@ -156,6 +134,27 @@ struct FloorChange
   std::vector<Tile> tiles;
 };
 
+/**
+ * class TileVisitor
+ *
+ * Receives the tiles of a map packet as they are parsed, see parseFullMap, parsePartialMap
+ * and parseFloorChange. This makes it possible to write the tiles directly to where they are
+ * stored without creating intermediate protocol::Tile objects.
+ *
+ * onTile is called for each tile in the order they are sent (floor, x, y), where floor, x and y
+ * are relative to the area of the packet. It is followed by onCreature and onItem for each thing
+ * on the tile in stack order, unless skip is true, in which case the tile is empty.
+ */
+class TileVisitor
+{
+ public:
+  virtual ~TileVisitor() = default;
+
+  virtual void onTile(int floor, int x, int y, bool skip) = 0;
+  virtual void onCreature(const Creature& creature) = 0;
+  virtual void onItem(const Item& item) = 0;
+};
+
 // Reading packets
 
 // 0x0A
@@ -176,6 +175,17 @@ TileUpdate getTileUpdate(network::IncomingPacket* packet);
 // 0xBE 0xBF
 FloorChange getFloorChange(int num_floors, int width, int height, network::IncomingPacket* packet);
 
+// Streaming versions of the map packets above, see TileVisitor
+
+// 0x64, returns the position
+common::Position parseFullMap(network::IncomingPacket* packet, TileVisitor* visitor);
+
+// 0x65 0x66 0x67 0x68
+void parsePartialMap(int z, common::Direction direction, network::IncomingPacket* packet, TileVisitor* visitor);
+
+// 0xBE 0xBF
+void parseFloorChange(int num_floors, int width, int height, network::IncomingPacket* packet, TileVisitor* visitor);
+
 // 0x83
 MagicEffect getMagicEffect(network::IncomingPacket* packet);
 
@@ -0,0 +1,297 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef PROTOCOL_EXPORT_PROTOCOL_CODEC_H_
+#define PROTOCOL_EXPORT_PROTOCOL_CODEC_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "incoming_packet.h"
+#include "outgoing_packet.h"
+
+namespace protocol::codec
+{
+
+/**
+ * Compile-time packet codec
+ *
+ * A message is described by a Schema: the message struct and a list of its fields,
+ * in the order they are sent. The Schema then generates both encode and decode for the
+ * message, so that the two can never get out of sync:
+ *
+ *   using CloseContainerSchema = codec::Schema<CloseContainer,
+ *                                              codec::Field<&CloseContainer::container_id>>;
+ *
+ * Supported field types are std::uint8_t, std::uint16_t, std::uint32_t and std::string.
+ * A field can also be conditional on the message (FieldIf), e.g. fields that are only sent
+ * for some message types.
+ *
+ * The encoded size is known at compile time for messages with only fixed size fields
+ * (Schema::FIXED_SIZE), otherwise it is calculated from the message before encoding.
+ * Encoding checks the size of the packet once per message. Decoding checks the size once
+ * for all fixed size fields and once for each string (as its length is part of the data).
+ */
+
+namespace detail
+{
+
+template <typename T>
+struct FieldType;
+
+template <typename Message, typename T>
+struct FieldType<T Message::*>
+{
+  using message_type = Message;
+  using value_type = T;
+};
+
+template <typename T>
+struct Codec;
+
+template <>
+struct Codec<std::uint8_t>
+{
+  static constexpr std::size_t SIZE = 1;
+  static constexpr bool IS_FIXED_SIZE = true;
+  static std::size_t size(std::uint8_t) { return SIZE; }
+  static std::uint8_t* write(std::uint8_t value, std::uint8_t* out)
+  {
+    out[0] = value;
+    return out + 1;
+  }
+  static void read(network::IncomingPacket* packet, std::uint8_t* value) { *value = packet->getU8(); }
+};
+
+template <>
+struct Codec<std::uint16_t>
+{
+  static constexpr std::size_t SIZE = 2;
+  static constexpr bool IS_FIXED_SIZE = true;
+  static std::size_t size(std::uint16_t) { return SIZE; }
+  static std::uint8_t* write(std::uint16_t value, std::uint8_t* out)
+  {
+    out[0] = static_cast<std::uint8_t>(value);
+    out[1] = static_cast<std::uint8_t>(value >> 8);
+    return out + 2;
+  }
+  static void read(network::IncomingPacket* packet, std::uint16_t* value) { *value = packet->getU16(); }
+};
+
+template <>
+struct Codec<std::uint32_t>
+{
+  static constexpr std::size_t SIZE = 4;
+  static constexpr bool IS_FIXED_SIZE = true;
+  static std::size_t size(std::uint32_t) { return SIZE; }
+  static std::uint8_t* write(std::uint32_t value, std::uint8_t* out)
+  {
+    out[0] = static_cast<std::uint8_t>(value);
+    out[1] = static_cast<std::uint8_t>(value >> 8);
+    out[2] = static_cast<std::uint8_t>(value >> 16);
+    out[3] = static_cast<std::uint8_t>(value >> 24);
+    return out + 4;
+  }
+  static void read(network::IncomingPacket* packet, std::uint32_t* value) { *value = packet->getU32(); }
+};
+
+template <>
+struct Codec<std::string>
+{
+  // Only the length is of fixed size
+  static constexpr std::size_t SIZE = 2;
+  static constexpr bool IS_FIXED_SIZE = false;
+  static std::size_t size(const std::string& value) { return SIZE + value.length(); }
+  static std::uint8_t* write(const std::string& value, std::uint8_t* out)
+  {
+    out = Codec<std::uint16_t>::write(static_cast<std::uint16_t>(value.length()), out);
+    for (const auto c : value)
+    {
+      *out++ = static_cast<std::uint8_t>(c);
+    }
+    return out;
+  }
+  static bool read(network::IncomingPacket* packet, std::string* value, std::size_t fixed_size_after)
+  {
+    // The length has already been checked, but not the string itself, and as the
+    // string moves the position forward, the fixed size fields after it must be checked again
+    const auto length = packet->peekU16();
+    if (packet->bytesLeft() < SIZE + length + fixed_size_after)
+    {
+      return false;
+    }
+    *value = packet->getString();
+    return true;
+  }
+};
+
+}  // namespace detail
+
+// A field that is always sent
+template <auto Member>
+struct Field
+{
+  using message_type = typename detail::FieldType<decltype(Member)>::message_type;
+  using value_type = typename detail::FieldType<decltype(Member)>::value_type;
+  using codec = detail::Codec<value_type>;
+
+  // Size of the field that is known at compile time
+  static constexpr std::size_t FIXED_SIZE = codec::SIZE;
+  static constexpr bool IS_FIXED_SIZE = codec::IS_FIXED_SIZE;
+
+  static std::size_t size(const message_type& message) { return codec::size(message.*Member); }
+
+  static std::uint8_t* write(const message_type& message, std::uint8_t* out)
+  {
+    return codec::write(message.*Member, out);
+  }
+
+  // fixed_size_after is the fixed size of all fields after this field, see Schema::decode
+  static bool read(network::IncomingPacket* packet, message_type* message, std::size_t fixed_size_after)
+  {
+    if constexpr (IS_FIXED_SIZE)
+    {
+      (void)fixed_size_after;
+      codec::read(packet, &(message->*Member));
+      return true;
+    }
+    else
+    {
+      return codec::read(packet, &(message->*Member), fixed_size_after);
+    }
+  }
+};
+
+// A field that is only sent if Condition(message) returns true
+// Condition is a function bool(const Message&), and may only use fields that come before this field
+template <auto Member, auto Condition>
+struct FieldIf
+{
+  using message_type = typename Field<Member>::message_type;
+  using value_type = typename Field<Member>::value_type;
+
+  // Size is not known until the condition has been checked
+  static constexpr std::size_t FIXED_SIZE = 0;
+  static constexpr bool IS_FIXED_SIZE = false;
+
+  static std::size_t size(const message_type& message)
+  {
+    return Condition(message) ? Field<Member>::size(message) : 0;
+  }
+
+  static std::uint8_t* write(const message_type& message, std::uint8_t* out)
+  {
+    return Condition(message) ? Field<Member>::write(message, out) : out;
+  }
+
+  static bool read(network::IncomingPacket* packet, message_type* message, std::size_t fixed_size_after)
+  {
+    if (!Condition(*message))
+    {
+      return true;
+    }
+
+    // This field was not part of the fixed size check
+    if (packet->bytesLeft() < Field<Member>::FIXED_SIZE + fixed_size_after)
+    {
+      return false;
+    }
+    return Field<Member>::read(packet, message, fixed_size_after);
+  }
+};
+
+template <typename Message, typename... Fields>
+struct Schema
+{
+  static_assert((std::is_same_v<Message, typename Fields::message_type> && ...),
+                "All fields must be members of Message");
+
+  // Minimum encoded size, which is the exact size if IS_FIXED_SIZE is true
+  static constexpr std::size_t FIXED_SIZE = (Fields::FIXED_SIZE + ... + 0);
+  static constexpr bool IS_FIXED_SIZE = (Fields::IS_FIXED_SIZE && ...);
+
+  static std::size_t size(const Message& message)
+  {
+    if constexpr (IS_FIXED_SIZE)
+    {
+      (void)message;
+      return FIXED_SIZE;
+    }
+    else
+    {
+      return (Fields::size(message) + ... + 0);
+    }
+  }
+
+  // Returns false, and does not write anything, if the message does not fit in the packet
+  static bool encode(const Message& message, network::OutgoingPacket* packet)
+  {
+    auto* out = packet->reserveBytes(size(message));
+    if (!out)
+    {
+      return false;
+    }
+    ((out = Fields::write(message, out)), ...);
+    return true;
+  }
+
+  // Returns false if the packet does not contain the full message, then the message
+  // is only partly decoded, and the packet position is undefined
+  static bool decode(network::IncomingPacket* packet, Message* message)
+  {
+    // Fixed size fields are only read if all of them are in the packet, and then
+    // without any further checks. Fields that are not of fixed size do their own check.
+    if (packet->bytesLeft() < FIXED_SIZE)
+    {
+      return false;
+    }
+    return decode(packet, message, std::index_sequence_for<Fields...>{});
+  }
+
+ private:
+  template <std::size_t... Indexes>
+  static bool decode(network::IncomingPacket* packet, Message* message, std::index_sequence<Indexes...>)
+  {
+    return (Fields::read(packet, message, getFixedSizeAfter(Indexes)) && ...);
+  }
+
+  // Returns the fixed size of all fields after the field with the given index
+  static constexpr std::size_t getFixedSizeAfter(std::size_t index)
+  {
+    constexpr std::size_t fixed_sizes[] = { Fields::FIXED_SIZE..., 0 };
+    std::size_t fixed_size = 0;
+    for (auto i = index + 1; i < sizeof...(Fields); i++)
+    {
+      fixed_size += fixed_sizes[i];
+    }
+    return fixed_size;
+  }
+};
+
+}  // namespace protocol::codec
+
+#endif  // PROTOCOL_EXPORT_PROTOCOL_CODEC_H_
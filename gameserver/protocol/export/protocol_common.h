@@ -26,6 +26,8 @@
 #define PROTOCOL_EXPORT_PROTOCOL_COMMON_H_
 
 #include <array>
+#include <cstddef>
+#include <cstdint>
 #include <variant>
 #include <vector>
 
@@ -87,7 +89,70 @@ struct Tile
   std::vector<Thing> things;
 };
 
-using KnownCreatures = std::array<common::CreatureId, 64>;
+/**
+ * class KnownCreatures
+ *
+ * The creatures that the client knows about (max 64)
+ *
+ * When a new creature is added and the client already knows about 64 creatures,
+ * the least recently used creature is removed and its CreatureId should be sent
+ * to the client as "creature id to remove".
+ *
+ * Lookup is done via a small open addressing hash table (linear probing), and the
+ * least recently used order is kept in a doubly linked list, both using fixed size
+ * arrays, so no operation allocates memory.
+ */
+class KnownCreatures
+{
+ public:
+  static constexpr std::size_t MAX_SIZE = 64;
+
+  KnownCreatures();
+
+  // Returns true if the creature is known, and then also marks it as most recently used
+  bool touch(common::CreatureId creature_id);
+
+  // Adds the creature, which must not be known, as most recently used
+  // Returns the CreatureId of the creature that was removed to make room for it,
+  // or common::Creature::INVALID_ID if no creature was removed
+  common::CreatureId add(common::CreatureId creature_id);
+
+  bool contains(common::CreatureId creature_id) const { return find(creature_id) != EMPTY; }
+  std::size_t size() const { return m_size; }
+  void clear();
+
+ private:
+  static constexpr std::size_t TABLE_SIZE = MAX_SIZE * 2;  // Must be a power of two
+  static constexpr std::uint8_t EMPTY = 0xFF;
+
+  static std::size_t hash(common::CreatureId creature_id);
+
+  // Returns the entry index, or EMPTY
+  std::uint8_t find(common::CreatureId creature_id) const;
+
+  void tableInsert(std::uint8_t entry);
+  void tableErase(common::CreatureId creature_id);
+
+  void listUnlink(std::uint8_t entry);
+  void listPushFront(std::uint8_t entry);
+
+  struct Entry
+  {
+    common::CreatureId creature_id;
+    std::uint8_t prev;
+    std::uint8_t next;
+  };
+  std::array<Entry, MAX_SIZE> m_entries;
+  std::size_t m_size;
+
+  // Most recently used first
+  std::uint8_t m_head;
+  std::uint8_t m_tail;
+
+  // Entry index for each slot, or EMPTY
+  std::array<std::uint8_t, TABLE_SIZE> m_table;
+};
+
 using KnownContainers = std::array<common::ItemUniqueId, 64>;
 
 void setItemTypes(const utils::data_loader::ItemTypes* item_types_in);
@@ -95,6 +160,7 @@ void setItemTypes(const utils::data_loader::ItemTypes* item_types_in);
 common::Position getPosition(network::IncomingPacket* packet);
 common::Outfit getOutfit(network::IncomingPacket* packet);
 common::GamePosition getGamePosition(KnownContainers* container_ids, network::IncomingPacket* packet);
+common::GamePosition getGamePosition(KnownContainers* container_ids, std::uint16_t x, std::uint16_t y, std::uint8_t z);
 common::ItemPosition getItemPosition(KnownContainers* container_ids, network::IncomingPacket* packet);
 Creature getCreature(Creature::Update update, network::IncomingPacket* packet);
 Item getItem(network::IncomingPacket* packet);
@@ -110,6 +176,12 @@ void addCreature(const common::Creature* creature,
 void addItem(const common::Item* item, network::OutgoingPacket* packet);
 void addOutfitData(const common::Outfit& outfit, network::OutgoingPacket* packet);
 
+// Number of bytes the add functions above would write, used to size packets up front
+// known_creatures is not modified, so the size of a creature assumes that it is still
+// known (or unknown) when it is added
+std::size_t getCreatureSize(const common::Creature* creature, const KnownCreatures& known_creatures);
+std::size_t getItemSize(const common::Item* item);
+
 }  // namespace protocol
 
 #endif  // PROTOCOL_EXPORT_PROTOCOL_COMMON_H_
@@ -0,0 +1,221 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef PROTOCOL_EXPORT_PROTOCOL_SCHEMAS_H_
+#define PROTOCOL_EXPORT_PROTOCOL_SCHEMAS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "protocol_codec.h"
+#include "protocol_common.h"
+
+// Messages that are described by a Schema (see protocol_codec.h)
+// They are shared by protocol_client and protocol_server, as each message is written by
+// one side and read by the other, e.g. the server reads a Login that the client writes
+
+namespace protocol::client
+{
+
+struct LoginFailed
+{
+  std::string reason;
+};
+
+struct WorldLight
+{
+  std::uint8_t intensity;
+  std::uint8_t color;
+};
+
+struct CreatureSkull
+{
+  common::CreatureId creature_id;
+  std::uint8_t skull;
+};
+
+struct TextMessage
+{
+  std::uint8_t type;
+  std::string message;
+};
+
+// 0x14
+using LoginFailedSchema = codec::Schema<LoginFailed,
+                                        codec::Field<&LoginFailed::reason>>;
+
+// 0x82
+using WorldLightSchema = codec::Schema<WorldLight,
+                                       codec::Field<&WorldLight::intensity>,
+                                       codec::Field<&WorldLight::color>>;
+
+// 0x90
+using CreatureSkullSchema = codec::Schema<CreatureSkull,
+                                          codec::Field<&CreatureSkull::creature_id>,
+                                          codec::Field<&CreatureSkull::skull>>;
+
+// 0xB4
+using TextMessageSchema = codec::Schema<TextMessage,
+                                        codec::Field<&TextMessage::type>,
+                                        codec::Field<&TextMessage::message>>;
+
+}  // namespace protocol::client
+
+namespace protocol::server
+{
+
+struct Login
+{
+  std::uint8_t unknown1;
+  std::uint8_t client_os;
+  std::uint16_t client_version;
+  std::uint8_t unknown2;
+  std::string character_name;
+  std::string password;
+};
+
+// MoveItem, UseItem and LookAt as sent by the client, with the positions not yet resolved,
+// see the readers in protocol_server.h for the resolved messages
+struct RawMoveItem
+{
+  std::uint16_t from_x;
+  std::uint16_t from_y;
+  std::uint8_t from_z;
+  std::uint16_t item_type_id;
+  std::uint8_t stackpos;
+  std::uint16_t to_x;
+  std::uint16_t to_y;
+  std::uint8_t to_z;
+  std::uint8_t count;
+};
+
+struct RawUseItem
+{
+  std::uint16_t x;
+  std::uint16_t y;
+  std::uint8_t z;
+  std::uint16_t item_type_id;
+  std::uint8_t stackpos;
+  std::uint8_t new_container_id;
+};
+
+struct RawLookAt
+{
+  std::uint16_t x;
+  std::uint16_t y;
+  std::uint8_t z;
+  std::uint16_t item_type_id;
+  std::uint8_t stackpos;
+};
+
+struct CloseContainer
+{
+  std::uint8_t container_id;
+};
+
+struct OpenParentContainer
+{
+  std::uint8_t container_id;
+};
+
+struct Say
+{
+  // Longer messages are not accepted from the client, as they are echoed to all nearby players
+  static constexpr std::size_t MAX_MESSAGE_LENGTH = 255U;
+
+  std::uint8_t type;
+  std::string receiver;
+  std::uint16_t channel_id;
+  std::string message;
+};
+
+// 0x0A
+using LoginSchema = codec::Schema<Login,
+                                  codec::Field<&Login::unknown1>,
+                                  codec::Field<&Login::client_os>,
+                                  codec::Field<&Login::client_version>,
+                                  codec::Field<&Login::unknown2>,
+                                  codec::Field<&Login::character_name>,
+                                  codec::Field<&Login::password>>;
+
+// 0x78
+using RawMoveItemSchema = codec::Schema<RawMoveItem,
+                                        codec::Field<&RawMoveItem::from_x>,
+                                        codec::Field<&RawMoveItem::from_y>,
+                                        codec::Field<&RawMoveItem::from_z>,
+                                        codec::Field<&RawMoveItem::item_type_id>,
+                                        codec::Field<&RawMoveItem::stackpos>,
+                                        codec::Field<&RawMoveItem::to_x>,
+                                        codec::Field<&RawMoveItem::to_y>,
+                                        codec::Field<&RawMoveItem::to_z>,
+                                        codec::Field<&RawMoveItem::count>>;
+
+// 0x82
+using RawUseItemSchema = codec::Schema<RawUseItem,
+                                       codec::Field<&RawUseItem::x>,
+                                       codec::Field<&RawUseItem::y>,
+                                       codec::Field<&RawUseItem::z>,
+                                       codec::Field<&RawUseItem::item_type_id>,
+                                       codec::Field<&RawUseItem::stackpos>,
+                                       codec::Field<&RawUseItem::new_container_id>>;
+
+// 0x87
+using CloseContainerSchema = codec::Schema<CloseContainer,
+                                           codec::Field<&CloseContainer::container_id>>;
+
+// 0x88
+using OpenParentContainerSchema = codec::Schema<OpenParentContainer,
+                                                codec::Field<&OpenParentContainer::container_id>>;
+
+// 0x8C
+using RawLookAtSchema = codec::Schema<RawLookAt,
+                                      codec::Field<&RawLookAt::x>,
+                                      codec::Field<&RawLookAt::y>,
+                                      codec::Field<&RawLookAt::z>,
+                                      codec::Field<&RawLookAt::item_type_id>,
+                                      codec::Field<&RawLookAt::stackpos>>;
+
+// 0x96
+inline bool sayHasReceiver(const Say& say)
+{
+  return say.type == 0x06 ||  // PRIVATE
+         say.type == 0x0B;    // PRIVATE RED
+}
+
+inline bool sayHasChannelId(const Say& say)
+{
+  return say.type == 0x07 ||  // CHANNEL_Y
+         say.type == 0x0A;    // CHANNEL_R1
+}
+
+using SaySchema = codec::Schema<Say,
+                                codec::Field<&Say::type>,
+                                codec::FieldIf<&Say::receiver, &sayHasReceiver>,
+                                codec::FieldIf<&Say::channel_id, &sayHasChannelId>,
+                                codec::Field<&Say::message>>;
+
+}  // namespace protocol::server
+
+#endif  // PROTOCOL_EXPORT_PROTOCOL_SCHEMAS_H_
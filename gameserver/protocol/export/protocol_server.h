@@ -25,10 +25,16 @@
 #ifndef PROTOCOL_EXPORT_PROTOCOL_SERVER_H_
 #define PROTOCOL_EXPORT_PROTOCOL_SERVER_H_
 
+#include <array>
+#include <cstddef>
 #include <cstdint>
 #include <deque>
+#include <optional>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
+#include "protocol_schemas.h"
 #include "protocol_common.h"
 
 namespace gameengine
@@ -51,16 +57,6 @@ class World;
 namespace protocol::server
 {
 
-struct Login
-{
-  std::uint8_t unknown1;
-  std::uint8_t client_os;
-  std::uint16_t client_version;
-  std::uint8_t unknown2;
-  std::string character_name;
-  std::string password;
-};
-
 struct MoveClick
 {
   std::deque<common::Direction> path;
@@ -79,60 +75,163 @@ struct UseItem
   std::uint8_t new_container_id;
 };
 
-struct CloseContainer
+struct LookAt
 {
-  std::uint8_t container_id;
+  common::ItemPosition item_position;
 };
 
-struct OpenParentContainer
+// Traffic accounting
+// Each writer below counts the message it adds as outgoing traffic for its opcode, with
+// the number of bytes it wrote (including the opcode). Incoming messages are counted by
+// the caller using countIncoming, as the opcode is read before the reader is called and
+// some opcodes have no reader.
+// All messages are counted in the process-wide TrafficStats, see getTrafficStats, and also
+// in connection_traffic, the TrafficStats of the connection, unless it is nullptr.
+// Not thread-safe, all messages must be read and written on the same thread.
+class TrafficStats
 {
-  std::uint8_t container_id;
+ public:
+  enum class Direction
+  {
+    INCOMING,
+    OUTGOING,
+  };
+
+  struct Counters
+  {
+    std::uint64_t messages = 0U;
+    std::uint64_t bytes = 0U;
+  };
+
+  void add(Direction direction, std::uint8_t opcode, std::size_t bytes)
+  {
+    auto& counters = m_counters[static_cast<std::size_t>(direction)][opcode];
+    counters.messages += 1U;
+    counters.bytes += bytes;
+  }
+
+  const Counters& get(Direction direction, std::uint8_t opcode) const
+  {
+    return m_counters[static_cast<std::size_t>(direction)][opcode];
+  }
+
+  // Sum of all opcodes in the given direction
+  Counters getTotal(Direction direction) const
+  {
+    Counters total;
+    for (const auto& counters : m_counters[static_cast<std::size_t>(direction)])
+    {
+      total.messages += counters.messages;
+      total.bytes += counters.bytes;
+    }
+    return total;
+  }
+
+  // Calls func(opcode, counters) for each opcode with at least one message in the given direction
+  template <typename Func>
+  void forEach(Direction direction, const Func& func) const
+  {
+    const auto& counters = m_counters[static_cast<std::size_t>(direction)];
+    for (auto opcode = 0U; opcode < counters.size(); opcode++)
+    {
+      if (counters[opcode].messages > 0U)
+      {
+        func(static_cast<std::uint8_t>(opcode), counters[opcode]);
+      }
+    }
+  }
+
+  void reset() { m_counters = {}; }
+
+ private:
+  std::array<std::array<Counters, 256>, 2> m_counters = {};
 };
 
-struct LookAt
-{
-  common::ItemPosition item_position;
-};
+const TrafficStats& getTrafficStats();
+void resetTrafficStats();
 
-struct Say
+// Counts an incoming message, bytes should include the opcode
+void countIncoming(std::uint8_t opcode, std::size_t bytes, TrafficStats* connection_traffic);
+
+// Encoded items of the tiles that have been sent, so that the items on a tile are only
+// encoded again when they have changed, see world::Tile::getVersion
+// There should be one TileCache per World, which must not outlive it, as the tiles are
+// keyed by address. It holds at most one entry per tile of the World.
+// Not thread-safe, the same as World.
+class TileCache
 {
-  std::uint8_t type;
-  std::string receiver;
-  std::uint16_t channel_id;
-  std::string message;
+ public:
+  struct EncodedTile
+  {
+    // Only valid if equal to the tile's version, a tile never has version 0
+    std::uint64_t version{0};
+
+    // All items on the tile, encoded, in stack order
+    std::vector<std::uint8_t> data;
+
+    // Offset in data where each item on the tile ends, indexed by the item's position among
+    // the items only. Creatures are not encoded, so that adding or removing a creature doesn't
+    // change this (or the version) even though it changes the stackpos of the items after it
+    std::vector<std::uint16_t> item_ends;
+  };
+
+  // Returns the encoded items of the tile, encoding them again if they have changed
+  const EncodedTile& get(const world::Tile& tile);
+
+  std::size_t size() const { return m_tiles.size(); }
+  void clear() { m_tiles.clear(); }
+
+ private:
+  std::unordered_map<const world::Tile*, EncodedTile> m_tiles;
 };
 
 // Writing packets
+// The get*Size functions return the exact number of bytes the matching add function
+// writes, and the add functions use them to reserve room in the packet up front
 
 // 0x0A
-void addLogin(common::CreatureId player_id, std::uint16_t server_beat, network::OutgoingPacket* packet);
+void addLogin(common::CreatureId player_id,
+              std::uint16_t server_beat,
+              TrafficStats* connection_traffic,
+              network::OutgoingPacket* packet);
 
 // 0x14
-void addLoginFailed(const std::string& reason, network::OutgoingPacket* packet);
+void addLoginFailed(const std::string& reason, TrafficStats* connection_traffic, network::OutgoingPacket* packet);
 
 // 0x64
 void addMapFull(const world::World& world_interface,
+                TileCache* tile_cache,
                 const common::Position& position,
                 KnownCreatures* known_creatures,
+                TrafficStats* connection_traffic,
                 network::OutgoingPacket* packet);
+std::size_t getMapFullSize(const world::World& world_interface,
+                           TileCache* tile_cache,
+                           const common::Position& position,
+                           const KnownCreatures& known_creatures);
 
 // 0x65, 0x66, 0x67, 0x68
 void addMap(const world::World& world_interface,
+            TileCache* tile_cache,
             const common::Position& old_position,
             const common::Position& new_position,
             KnownCreatures* known_creatures,
+            TrafficStats* connection_traffic,
             network::OutgoingPacket* packet);
 
 // 0x69
 void addTileUpdated(const common::Position& position,
                     const world::World& world_interface,
+                    TileCache* tile_cache,
                     KnownCreatures* known_creatures,
+                    TrafficStats* connection_traffic,
                     network::OutgoingPacket* packet);
 
 // 0x6A
 void addThingAdded(const common::Position& position,
                    const common::Thing& thing,
                    KnownCreatures* known_creatures,
+                   TrafficStats* connection_traffic,
                    network::OutgoingPacket* packet);
 
 // 0x6B
@@ -140,101 +239,137 @@ void addThingChanged(const common::Position& position,
                      std::uint8_t stackpos,
                      const common::Thing& thing,
                      KnownCreatures* known_creatures,
+                     TrafficStats* connection_traffic,
                      network::OutgoingPacket* packet);
 
 // 0x6C
-void addThingRemoved(const common::Position& position, std::uint8_t stackpos, network::OutgoingPacket* packet);
+void addThingRemoved(const common::Position& position,
+                     std::uint8_t stackpos,
+                     TrafficStats* connection_traffic,
+                     network::OutgoingPacket* packet);
 
 // 0x6D
 void addThingMoved(const common::Position& old_position,
                    std::uint8_t old_stackpos,
                    const common::Position& new_position,
+                   TrafficStats* connection_traffic,
                    network::OutgoingPacket* packet);
 
 // 0x6E
 void addContainerOpen(std::uint8_t container_id,
                       const common::Thing& thing,
                       const gameengine::Container& container,
+                      TrafficStats* connection_traffic,
                       network::OutgoingPacket* packet);
+std::size_t getContainerOpenSize(const common::Thing& thing, const gameengine::Container& container);
 
 // 0x6F
-void addContainerClose(std::uint8_t container_id, network::OutgoingPacket* packet);
+void addContainerClose(std::uint8_t container_id, TrafficStats* connection_traffic, network::OutgoingPacket* packet);
 
 // 0x70
-void addContainerAddItem(std::uint8_t container_id, const common::Thing& thing, network::OutgoingPacket* packet);
+void addContainerAddItem(std::uint8_t container_id,
+                         const common::Thing& thing,
+                         TrafficStats* connection_traffic,
+                         network::OutgoingPacket* packet);
 
 // 0x71
 void addContainerUpdateItem(std::uint8_t container_id,
                             std::uint8_t container_slot,
                             const common::Thing& thing,
+                            TrafficStats* connection_traffic,
                             network::OutgoingPacket* packet);
 
 // 0x72
-void addContainerRemoveItem(std::uint8_t container_id, std::uint8_t container_slot, network::OutgoingPacket* packet);
+void addContainerRemoveItem(std::uint8_t container_id,
+                            std::uint8_t container_slot,
+                            TrafficStats* connection_traffic,
+                            network::OutgoingPacket* packet);
 
 // 0x78, 0x79
-void addEquipmentUpdated(const gameengine::Equipment& equipment, std::uint8_t inventory_index, network::OutgoingPacket* packet);
+void addEquipmentUpdated(const gameengine::Equipment& equipment,
+                         std::uint8_t inventory_index,
+                         TrafficStats* connection_traffic,
+                         network::OutgoingPacket* packet);
 
 // 0x82
-void addWorldLight(std::uint8_t intensity, std::uint8_t color, network::OutgoingPacket* packet);
+void addWorldLight(std::uint8_t intensity,
+                   std::uint8_t color,
+                   TrafficStats* connection_traffic,
+                   network::OutgoingPacket* packet);
 
 // 0x83
-void addMagicEffect(const common::Position& position, std::uint8_t type, network::OutgoingPacket* packet);
+void addMagicEffect(const common::Position& position,
+                    std::uint8_t type,
+                    TrafficStats* connection_traffic,
+                    network::OutgoingPacket* packet);
 
 // 0xA0
-void addPlayerStats(const gameengine::Player& player, network::OutgoingPacket* packet);
+void addPlayerStats(const gameengine::Player& player,
+                    TrafficStats* connection_traffic,
+                    network::OutgoingPacket* packet);
 
 // 0xA1
-void addPlayerSkills(const gameengine::Player& player, network::OutgoingPacket* packet);
+void addPlayerSkills(const gameengine::Player& player,
+                     TrafficStats* connection_traffic,
+                     network::OutgoingPacket* packet);
 
 // 0xAA
 void addTalk(const std::string& name,
              std::uint8_t type,
              const common::Position& position,
              const std::string& message,
+             TrafficStats* connection_traffic,
              network::OutgoingPacket* packet);
 
 // 0xB4
-void addTextMessage(std::uint8_t type, const std::string& text, network::OutgoingPacket* packet);
+void addTextMessage(std::uint8_t type,
+                    const std::string& text,
+                    TrafficStats* connection_traffic,
+                    network::OutgoingPacket* packet);
 
 // 0xB5
-void addCancelMove(network::OutgoingPacket* packet);
+void addCancelMove(TrafficStats* connection_traffic, network::OutgoingPacket* packet);
 
 // Helpers
 void addMapData(const world::World& world_interface,
+                TileCache* tile_cache,
                 const common::Position& position,
                 int width,
                 int height,
                 KnownCreatures* known_creatures,
                 network::OutgoingPacket* packet);
 
-void addTileData(const world::Tile& tile, KnownCreatures* known_creatures, network::OutgoingPacket* packet);
+void addTileData(const world::Tile& tile,
+                 TileCache* tile_cache,
+                 KnownCreatures* known_creatures,
+                 network::OutgoingPacket* packet);
 
 // Reading packets
+// The readers of messages with a Schema return std::nullopt if the packet is too short
 
 // 0x0A
-Login getLogin(network::IncomingPacket* packet);
+std::optional<Login> getLogin(network::IncomingPacket* packet);
 
 // 0x64
 MoveClick getMoveClick(network::IncomingPacket* packet);
 
 // 0x78
-MoveItem getMoveItem(KnownContainers* container_ids, network::IncomingPacket* packet);
+std::optional<MoveItem> getMoveItem(KnownContainers* container_ids, network::IncomingPacket* packet);
 
 // 0x82
-UseItem getUseItem(KnownContainers* container_ids, network::IncomingPacket* packet);
+std::optional<UseItem> getUseItem(KnownContainers* container_ids, network::IncomingPacket* packet);
 
 // 0x87
-CloseContainer getCloseContainer(network::IncomingPacket* packet);
+std::optional<CloseContainer> getCloseContainer(network::IncomingPacket* packet);
 
 // 0x88
-OpenParentContainer getOpenParentContainer(network::IncomingPacket* packet);
+std::optional<OpenParentContainer> getOpenParentContainer(network::IncomingPacket* packet);
 
 // 0x8C
-LookAt getLookAt(KnownContainers* container_ids, network::IncomingPacket* packet);
+std::optional<LookAt> getLookAt(KnownContainers* container_ids, network::IncomingPacket* packet);
 
 // 0x96
-Say getSay(network::IncomingPacket* packet);
+std::optional<Say> getSay(network::IncomingPacket* packet);
 
 }  // namespace protocol::server
 
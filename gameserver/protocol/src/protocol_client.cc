@@ -24,6 +24,8 @@
 #include "protocol_client.h"
 
 #include <cstdint>
+#include <utility>
+#include <vector>
 
 #include "logger.h"
 #include "incoming_packet.h"
@@ -32,12 +34,37 @@
 namespace
 {
 
-int parseTile(protocol::Tile* tile, network::IncomingPacket* packet)
+// Collects the tiles into protocol::Tile objects, used by the non-streaming functions
+class TileCollector : public protocol::client::TileVisitor
 {
-  // Parse tile
-  tile->skip = false;
-  tile->things.clear();
+ public:
+  explicit TileCollector(std::vector<protocol::Tile>* tiles)
+      : m_tiles(tiles)
+  {
+  }
+
+  void onTile(int, int, int, bool skip) override
+  {
+    m_tiles->emplace_back();
+    m_tiles->back().skip = skip;
+  }
+
+  void onCreature(const protocol::Creature& creature) override
+  {
+    m_tiles->back().things.emplace_back(creature);
+  }
 
+  void onItem(const protocol::Item& item) override
+  {
+    m_tiles->back().things.emplace_back(item);
+  }
+
+ private:
+  std::vector<protocol::Tile>* m_tiles;
+};
+
+int parseTile(protocol::client::TileVisitor* visitor, network::IncomingPacket* packet)
+{
   auto stackpos = 0;
   while (packet->peekU16() < 0xFF00)
   {
@@ -46,14 +73,23 @@ int parseTile(protocol::Tile* tile, network::IncomingPacket* packet)
       LOG_ERROR("%s: too many things on this tile", __func__);
       abort();
     }
+    stackpos += 1;
 
-    tile->things.emplace_back(protocol::getThing(packet));
+    const auto peek = packet->peekU16();
+    if (peek == 0x0061U || peek == 0x0062U || peek == 0x0063U)
+    {
+      visitor->onCreature(protocol::getCreature(static_cast<protocol::Creature::Update>(packet->getU16()), packet));
+    }
+    else
+    {
+      visitor->onItem(protocol::getItem(packet));
+    }
   }
 
   return packet->getU16() & 0xFF;
 }
 
-void parseFloorTiles(int num_floors, int width, int height, network::IncomingPacket* packet, std::vector<protocol::Tile>* tiles)
+void parseFloorTiles(int num_floors, int width, int height, network::IncomingPacket* packet, protocol::client::TileVisitor* visitor)
 {
   auto skip = 0;
   for (auto z = 0; z < num_floors; ++z)
@@ -62,31 +98,25 @@ void parseFloorTiles(int num_floors, int width, int height, network::IncomingPac
     {
       for (auto y = 0; y < height; ++y)
       {
-        protocol::Tile tile = {};
         if (skip > 0)
         {
           skip -= 1;
-          tile.skip = true;
-          tiles->push_back(std::move(tile));
+          visitor->onTile(z, x, y, true);
           continue;
         }
 
-        skip = parseTile(&tile, packet);
-        tiles->push_back(std::move(tile));
+        visitor->onTile(z, x, y, false);
+        skip = parseTile(visitor, packet);
       }
     }
   }
 }
 
-std::vector<protocol::Tile> getMapData(int z, int width, int height, network::IncomingPacket* packet)
+void parseMapData(int z, int width, int height, network::IncomingPacket* packet, protocol::client::TileVisitor* visitor)
 {
-  std::vector<protocol::Tile> tiles;
-
   // see doc/world.txt
   const auto num_floors = z <= 7 ? 8 : (z <= 13 ? 5 : (z == 14 ? 4 : 3));
-  parseFloorTiles(num_floors, width, height, packet, &tiles);
-
-  return tiles;
+  parseFloorTiles(num_floors, width, height, packet, visitor);
 }
 
 }  // namespace
@@ -105,8 +135,11 @@ Login getLogin(network::IncomingPacket* packet)
 
 LoginFailed getLoginFailed(network::IncomingPacket* packet)
 {
-  LoginFailed failed;
-  packet->get(&failed.reason);
+  LoginFailed failed{};
+  if (!LoginFailedSchema::decode(packet, &failed))
+  {
+    LOG_ERROR("%s: packet is too short", __func__);
+  }
   return failed;
 }
 
@@ -124,9 +157,11 @@ Equipment getEquipment(bool empty, network::IncomingPacket* packet)
 
 CreatureSkull getCreatureSkull(network::IncomingPacket* packet)
 {
-  CreatureSkull creature_skull;
-  packet->get(&creature_skull.creature_id);
-  packet->get(&creature_skull.skull);
+  CreatureSkull creature_skull{};
+  if (!CreatureSkullSchema::decode(packet, &creature_skull))
+  {
+    LOG_ERROR("%s: packet is too short", __func__);
+  }
   return creature_skull;
 }
 
@@ -156,9 +191,11 @@ PlayerStats getPlayerStats(network::IncomingPacket* packet)
 
 WorldLight getWorldLight(network::IncomingPacket* packet)
 {
-  WorldLight light;
-  packet->get(&light.intensity);
-  packet->get(&light.color);
+  WorldLight light{};
+  if (!WorldLightSchema::decode(packet, &light))
+  {
+    LOG_ERROR("%s: packet is too short", __func__);
+  }
   return light;
 }
 
@@ -184,9 +221,11 @@ PlayerSkills getPlayerSkills(network::IncomingPacket* packet)
 
 TextMessage getTextMessage(network::IncomingPacket* packet)
 {
-  TextMessage message;
-  packet->get(&message.type);
-  packet->get(&message.message);
+  TextMessage message{};
+  if (!TextMessageSchema::decode(packet, &message))
+  {
+    LOG_ERROR("%s: packet is too short", __func__);
+  }
   return message;
 }
 
@@ -227,8 +266,8 @@ ThingMoved getThingMoved(network::IncomingPacket* packet)
 FullMap getFullMap(network::IncomingPacket* packet)
 {
   FullMap map = {};
-  map.position = getPosition(packet);
-  map.tiles = getMapData(map.position.getZ(), 18, 14, packet);
+  TileCollector collector(&map.tiles);
+  map.position = parseFullMap(packet, &collector);
   return map;
 }
 
@@ -236,18 +275,8 @@ PartialMap getPartialMap(int z, common::Direction direction, network::IncomingPa
 {
   PartialMap map = {};
   map.direction = direction;
-  switch (direction)
-  {
-    case common::Direction::NORTH:
-    case common::Direction::SOUTH:
-      map.tiles = getMapData(z, 18, 1, packet);
-      break;
-
-    case common::Direction::EAST:
-    case common::Direction::WEST:
-      map.tiles = getMapData(z, 1, 14, packet);
-      break;
-  }
+  TileCollector collector(&map.tiles);
+  parsePartialMap(z, direction, packet, &collector);
   return map;
 }
 
@@ -255,15 +284,49 @@ TileUpdate getTileUpdate(network::IncomingPacket* packet)
 {
   TileUpdate tile_update;
   tile_update.position = getPosition(packet);
-  parseTile(&tile_update.tile, packet);
+
+  std::vector<Tile> tiles;
+  TileCollector collector(&tiles);
+  collector.onTile(0, 0, 0, false);
+  parseTile(&collector, packet);
+  tile_update.tile = std::move(tiles.front());
   return tile_update;
 }
 
 FloorChange getFloorChange(int num_floors, int width, int height, network::IncomingPacket* packet)
 {
   FloorChange map = {};
-  parseFloorTiles(num_floors, width, height, packet, &map.tiles);
+  TileCollector collector(&map.tiles);
+  parseFloorTiles(num_floors, width, height, packet, &collector);
   return map;
 }
 
+common::Position parseFullMap(network::IncomingPacket* packet, TileVisitor* visitor)
+{
+  const auto position = getPosition(packet);
+  parseMapData(position.getZ(), 18, 14, packet, visitor);
+  return position;
+}
+
+void parsePartialMap(int z, common::Direction direction, network::IncomingPacket* packet, TileVisitor* visitor)
+{
+  switch (direction)
+  {
+    case common::Direction::NORTH:
+    case common::Direction::SOUTH:
+      parseMapData(z, 18, 1, packet, visitor);
+      break;
+
+    case common::Direction::EAST:
+    case common::Direction::WEST:
+      parseMapData(z, 1, 14, packet, visitor);
+      break;
+  }
+}
+
+void parseFloorChange(int num_floors, int width, int height, network::IncomingPacket* packet, TileVisitor* visitor)
+{
+  parseFloorTiles(num_floors, width, height, packet, visitor);
+}
+
 }  // namespace protocol::client
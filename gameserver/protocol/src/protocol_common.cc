@@ -38,6 +38,150 @@ namespace protocol
 
 static const utils::data_loader::ItemTypes* item_types = nullptr;
 
+KnownCreatures::KnownCreatures()
+{
+  clear();
+}
+
+bool KnownCreatures::touch(common::CreatureId creature_id)
+{
+  const auto entry = find(creature_id);
+  if (entry == EMPTY)
+  {
+    return false;
+  }
+
+  if (entry != m_head)
+  {
+    listUnlink(entry);
+    listPushFront(entry);
+  }
+  return true;
+}
+
+common::CreatureId KnownCreatures::add(common::CreatureId creature_id)
+{
+  auto removed_creature_id = common::Creature::INVALID_ID;
+  std::uint8_t entry;
+  if (m_size < MAX_SIZE)
+  {
+    // Entries are used in order and never freed (except by clear)
+    entry = static_cast<std::uint8_t>(m_size);
+    m_size += 1;
+  }
+  else
+  {
+    // Reuse the least recently used entry
+    entry = m_tail;
+    removed_creature_id = m_entries[entry].creature_id;
+    tableErase(removed_creature_id);
+    listUnlink(entry);
+  }
+
+  m_entries[entry].creature_id = creature_id;
+  tableInsert(entry);
+  listPushFront(entry);
+  return removed_creature_id;
+}
+
+void KnownCreatures::clear()
+{
+  m_size = 0;
+  m_head = EMPTY;
+  m_tail = EMPTY;
+  m_table.fill(EMPTY);
+}
+
+std::size_t KnownCreatures::hash(common::CreatureId creature_id)
+{
+  // Fibonacci hashing, use the upper 7 bits as they are the best mixed
+  static_assert(TABLE_SIZE == 128, "hash() needs to be updated");
+  return static_cast<std::uint32_t>(creature_id * 2654435769U) >> (32 - 7);
+}
+
+std::uint8_t KnownCreatures::find(common::CreatureId creature_id) const
+{
+  for (auto slot = hash(creature_id); m_table[slot] != EMPTY; slot = (slot + 1) % TABLE_SIZE)
+  {
+    if (m_entries[m_table[slot]].creature_id == creature_id)
+    {
+      return m_table[slot];
+    }
+  }
+  return EMPTY;
+}
+
+void KnownCreatures::tableInsert(std::uint8_t entry)
+{
+  auto slot = hash(m_entries[entry].creature_id);
+  while (m_table[slot] != EMPTY)
+  {
+    slot = (slot + 1) % TABLE_SIZE;
+  }
+  m_table[slot] = entry;
+}
+
+void KnownCreatures::tableErase(common::CreatureId creature_id)
+{
+  auto slot = hash(creature_id);
+  while (m_entries[m_table[slot]].creature_id != creature_id)
+  {
+    slot = (slot + 1) % TABLE_SIZE;
+  }
+
+  // Backward shift deletion: move entries after the erased slot back if their
+  // home slot is not in (slot, next], so that they can still be found
+  m_table[slot] = EMPTY;
+  for (auto next = (slot + 1) % TABLE_SIZE; m_table[next] != EMPTY; next = (next + 1) % TABLE_SIZE)
+  {
+    const auto home = hash(m_entries[m_table[next]].creature_id);
+    const auto home_in_range = slot <= next ? (slot < home && home <= next) : (slot < home || home <= next);
+    if (!home_in_range)
+    {
+      m_table[slot] = m_table[next];
+      m_table[next] = EMPTY;
+      slot = next;
+    }
+  }
+}
+
+void KnownCreatures::listUnlink(std::uint8_t entry)
+{
+  const auto prev = m_entries[entry].prev;
+  const auto next = m_entries[entry].next;
+  if (prev != EMPTY)
+  {
+    m_entries[prev].next = next;
+  }
+  else
+  {
+    m_head = next;
+  }
+  if (next != EMPTY)
+  {
+    m_entries[next].prev = prev;
+  }
+  else
+  {
+    m_tail = prev;
+  }
+}
+
+void KnownCreatures::listPushFront(std::uint8_t entry)
+{
+  m_entries[entry].prev = EMPTY;
+  m_entries[entry].next = m_head;
+  if (m_head != EMPTY)
+  {
+    m_entries[m_head].prev = entry;
+  }
+  else
+  {
+    m_tail = entry;
+  }
+  m_head = entry;
+}
+
 void setItemTypes(const utils::data_loader::ItemTypes* item_types_in)
 {
   item_types = item_types_in;
@@ -78,7 +222,11 @@ common::GamePosition getGamePosition(KnownContainers* container_ids, network::In
   const auto x = packet->getU16();
   const auto y = packet->getU16();
   const auto z = packet->getU8();
+  return getGamePosition(container_ids, x, y, z);
+}
 
+common::GamePosition getGamePosition(KnownContainers* container_ids, std::uint16_t x, std::uint16_t y, std::uint8_t z)
+{
   LOG_DEBUG("%s: x = 0x%04X, y = 0x%04X, z = 0x%02X", __func__, x, y, z);
 
   if (x != 0xFFFF)
@@ -205,23 +353,14 @@ void addThing(const common::Thing& thing, KnownCreatures* known_creatures, netwo
 void addCreature(const common::Creature* creature, KnownCreatures* known_creatures, network::OutgoingPacket* packet)
 {
   // First check if we know about this creature or not
-  auto it = std::find(known_creatures->begin(), known_creatures->end(), creature->getCreatureId());
-  if (it == known_creatures->end())
+  if (!known_creatures->touch(creature->getCreatureId()))
   {
-    // Find an empty spot
-    auto unused = std::find(known_creatures->begin(), known_creatures->end(), common::Creature::INVALID_ID);
-    if (unused == known_creatures->end())
-    {
-      // No empty spot!
-      // TODO(simon): Figure out how to handle this - related to "creatureId to remove" below?
-      LOG_ERROR("%s: known_creatures_ is full!", __func__);
-      return;
-    }
-
-    *unused = creature->getCreatureId();
+    // If the client already knows about 64 creatures the least recently used one is
+    // replaced, and the client is told to forget about it
+    const auto creature_id_to_remove = known_creatures->add(creature->getCreatureId());
 
     packet->addU16(0x0061);  // UnknownCreature
-    packet->addU32(0x00);  // creatureId to remove (0x00 = none)
+    packet->add(creature_id_to_remove);  // creatureId to remove (0x00 = none)
     packet->add(creature->getCreatureId());
     packet->add(creature->getName());
   }
@@ -267,4 +406,25 @@ void addOutfitData(const common::Outfit& outfit, network::OutgoingPacket* packet
   packet->add(outfit.feet);
 }
 
+std::size_t getCreatureSize(const common::Creature* creature, const KnownCreatures& known_creatures)
+{
+  // 0x0061: type, creature id to remove, creature id, name
+  // 0x0062: type, creature id
+  const auto header_size = known_creatures.contains(creature->getCreatureId()) ?
+      2U + 4U :
+      2U + 4U + 4U + 2U + creature->getName().length();
+
+  // health, direction, outfit (5), 0x00 0xDC, speed
+  return header_size + 1U + 1U + 5U + 2U + 2U;
+}
+
+std::size_t getItemSize(const common::Item* item)
+{
+  if (item->getItemType().is_stackable || item->getItemType().is_splash)
+  {
+    return 2U + 1U;
+  }
+  return 2U;
+}
+
 }  // namespace protocol
@@ -23,7 +23,10 @@
  */
 #include "protocol_server.h"
 
+#include <algorithm>
 #include <cstdint>
+#include <optional>
+#include <vector>
 
 #include "logger.h"
 #include "creature.h"
@@ -37,26 +40,272 @@
 namespace protocol::server
 {
 
-void addLogin(common::CreatureId player_id, std::uint16_t server_beat, network::OutgoingPacket* packet)
+namespace
 {
-  packet->addU8(0x0A);
+
+// Iterates over the map area in the order that it is sent to the client, calling
+// on_skip(count) when count tiles should be skipped and on_tile(tile) for each tile
+template <typename OnSkip, typename OnTile>
+void forEachMapTile(const world::World& world,
+                    const common::Position& position,
+                    int width,
+                    int height,
+                    const OnSkip& on_skip,
+                    const OnTile& on_tile)
+{
+  // Calculate how to iterate over z
+  // Valid z is 0..15, 0 is highest and 15 is lowest. 7 is sea level.
+  // If on ground or higher (z <= 7) then go over everything above ground (from 7 to 0)
+  // If underground (z > 7) then go from two below to two above, with cap on lowest level (from e.g. 8 to 12, if z = 10)
+  const auto z_start = position.getZ() > 7 ? (position.getZ() - 2) : 7;
+  const auto z_end = position.getZ() > 7 ? std::min(position.getZ() + 2, 15) : 0;
+  const auto z_dir = z_start > z_end ? -1 : 1;
+
+  // After sending each tile we should send 0xYY 0xFF where YY is the number of following tiles
+  // that are empty and should be skipped. If there are no empty following tiles then we need
+  // to send 0x00 0xFF which denotes that this tiles is done.
+  // We don't know if the next tile is empty until the next iteration, so we will never send
+  // the "this tile is done" bytes on the same iteration as the actual tile, but rather in a
+  // later iteration, which is a bit confusing. We start off with -1 so that we don't start the
+  // message with saying that a tile is done.
+  int skip = -1;
+
+  for (auto z = z_start; z != z_end + z_dir; z += z_dir)
+  {
+    // Currently we are always on z = 7, so we should send z=7, z=6, ..., z=0
+    // But we skip z=6, ..., z=0 as we only have ground
+    if (z != 7)
+    {
+      if (skip != -1)
+      {
+        // Send current skip value first
+        on_skip(skip);
+      }
+
+      // Skip this level (skip width * height tiles)
+      on_skip(width * height);
+      skip = -1;
+      continue;
+    }
+
+    for (auto x = position.getX(); x < position.getX() + width; x++)
+    {
+      for (auto y = position.getY(); y < position.getY() + height; y++)
+      {
+        const auto* tile = world.getTile(common::Position(x, y, position.getZ()));
+        if (!tile)
+        {
+          skip += 1;
+          if (skip == 0xFF)
+          {
+            on_skip(skip);
+
+            // If there is a tile on the next iteration we don't want to send
+            // "tile is done", as we just sent one due to skip being max
+            skip = -1;
+          }
+        }
+        else
+        {
+          // Send "tile is done" with the number of tiles that were empty, unless this
+          // is the first tile (-1)
+          if (skip != -1)
+          {
+            on_skip(skip);
+          }
+          else
+          {
+            // Don't let skip be -1 more than one iteration
+            skip = 0;
+          }
+
+          on_tile(*tile);
+        }
+      }
+    }
+  }
+
+  // Send last skip value
+  if (skip != -1)
+  {
+    on_skip(skip);
+  }
+}
+
+std::size_t getTileDataSize(const world::Tile& tile, TileCache* tile_cache, const KnownCreatures& known_creatures)
+{
+  // See addTileData
+  const auto& encoded_tile = tile_cache->get(tile);
+  const auto& things = tile.getThings();
+  const auto count = std::min<std::size_t>(things.size(), 10U);
+  std::size_t size = 0U;
+  std::size_t num_items = 0U;
+  for (auto i = 0U; i < count; i++)
+  {
+    if (things[i].hasCreature())
+    {
+      size += getCreatureSize(things[i].creature(), known_creatures);
+    }
+    else
+    {
+      num_items += 1U;
+    }
+  }
+  return size + (num_items > 0U ? encoded_tile.item_ends[num_items - 1] : 0U);
+}
+
+std::size_t getMapDataSize(const world::World& world,
+                           TileCache* tile_cache,
+                           const common::Position& position,
+                           int width,
+                           int height,
+                           const KnownCreatures& known_creatures)
+{
+  std::size_t size = 0U;
+  forEachMapTile(world,
+                 position,
+                 width,
+                 height,
+                 [&size](std::uint8_t)
+                 {
+                   size += 2U;
+                 },
+                 [&size, tile_cache, &known_creatures](const world::Tile& tile)
+                 {
+                   size += getTileDataSize(tile, tile_cache, known_creatures);
+                 });
+  return size;
+}
+
+void countTraffic(TrafficStats::Direction direction,
+                  std::uint8_t opcode,
+                  std::size_t bytes,
+                  TrafficStats* connection_traffic);
+
+// Adds the opcode of a message to the packet, and counts the message as outgoing
+// traffic when the writer is done with it, i.e. when this object is destroyed
+class OutgoingMessage
+{
+ public:
+  OutgoingMessage(std::uint8_t opcode, TrafficStats* connection_traffic, network::OutgoingPacket* packet)
+      : m_opcode(opcode),
+        m_connection_traffic(connection_traffic),
+        m_packet(packet),
+        m_begin(packet->getLength())
+  {
+    packet->addU8(opcode);
+  }
+
+  ~OutgoingMessage()
+  {
+    countTraffic(TrafficStats::Direction::OUTGOING, m_opcode, m_packet->getLength() - m_begin, m_connection_traffic);
+  }
+
+  // Delete copy constructors
+  OutgoingMessage(const OutgoingMessage&) = delete;
+  OutgoingMessage& operator=(const OutgoingMessage&) = delete;
+
+ private:
+  std::uint8_t m_opcode;
+  TrafficStats* m_connection_traffic;
+  const network::OutgoingPacket* m_packet;
+  std::size_t m_begin;
+};
+
+// Writes the message as described by its Schema, see protocol_codec.h
+// Like OutgoingPacket::add, the packet overflows if the message does not fit in it
+template <typename Schema, typename Message>
+void encodeMessage(const Message& message, network::OutgoingPacket* packet)
+{
+  if (!Schema::encode(message, packet))
+  {
+    LOG_ERROR("%s: message does not fit in packet (length: %lu)", __func__, packet->getLength());
+  }
+}
+
+TrafficStats traffic_stats;
+
+void countTraffic(TrafficStats::Direction direction,
+                  std::uint8_t opcode,
+                  std::size_t bytes,
+                  TrafficStats* connection_traffic)
+{
+  traffic_stats.add(direction, opcode, bytes);
+  if (connection_traffic)
+  {
+    connection_traffic->add(direction, opcode, bytes);
+  }
+}
+
+}  // namespace
+
+const TileCache::EncodedTile& TileCache::get(const world::Tile& tile)
+{
+  auto& encoded_tile = m_tiles[&tile];
+  if (encoded_tile.version != tile.getVersion())
+  {
+    encoded_tile.version = tile.getVersion();
+    encoded_tile.data.clear();
+    encoded_tile.item_ends.clear();
+
+    // An item is at most 3 bytes
+    network::OutgoingPacket packet(tile.getThings().size() * 3U);
+    for (const auto& thing : tile.getThings())
+    {
+      if (!thing.hasCreature())
+      {
+        addItem(thing.item(), &packet);
+        encoded_tile.item_ends.push_back(packet.getLength());
+      }
+    }
+    encoded_tile.data.assign(packet.getBuffer(), packet.getBuffer() + packet.getLength());
+  }
+  return encoded_tile;
+}
+
+const TrafficStats& getTrafficStats()
+{
+  return traffic_stats;
+}
+
+void resetTrafficStats()
+{
+  traffic_stats.reset();
+}
+
+void countIncoming(std::uint8_t opcode, std::size_t bytes, TrafficStats* connection_traffic)
+{
+  countTraffic(TrafficStats::Direction::INCOMING, opcode, bytes, connection_traffic);
+}
+
+void addLogin(common::CreatureId player_id,
+              std::uint16_t server_beat,
+              TrafficStats* connection_traffic,
+              network::OutgoingPacket* packet)
+{
+  const OutgoingMessage outgoing(0x0A, connection_traffic, packet);
   packet->add(player_id);
   packet->add(server_beat);
 }
 
-void addLoginFailed(const std::string& reason, network::OutgoingPacket* packet)
+void addLoginFailed(const std::string& reason, TrafficStats* connection_traffic, network::OutgoingPacket* packet)
 {
-  packet->addU8(0x14);
-  packet->add(reason);
+  const OutgoingMessage outgoing(0x14, connection_traffic, packet);
+  encodeMessage<client::LoginFailedSchema>(client::LoginFailed{ reason }, packet);
 }
+
 void addMapFull(const world::World& world,
+                TileCache* tile_cache,
                 const common::Position& position,
                 KnownCreatures* known_creatures,
+                TrafficStats* connection_traffic,
                 network::OutgoingPacket* packet)
 {
-  packet->addU8(0x64);
+  packet->reserve(getMapFullSize(world, tile_cache, position, *known_creatures));
+  const OutgoingMessage outgoing(0x64, connection_traffic, packet);
   addPosition(position, packet);
   addMapData(world,
+             tile_cache,
              common::Position(position.getX() - 8, position.getY() - 6, position.getZ()),
              18,
              14,
@@ -64,17 +313,33 @@ void addMapFull(const world::World& world,
              packet);
 }
 
+std::size_t getMapFullSize(const world::World& world,
+                           TileCache* tile_cache,
+                           const common::Position& position,
+                           const KnownCreatures& known_creatures)
+{
+  return 1U + 5U + getMapDataSize(world,
+                                  tile_cache,
+                                  common::Position(position.getX() - 8, position.getY() - 6, position.getZ()),
+                                  18,
+                                  14,
+                                  known_creatures);
+}
+
 void addMap(const world::World& world,
+            TileCache* tile_cache,
             const common::Position& old_position,
             const common::Position& new_position,
             KnownCreatures* known_creatures,
+            TrafficStats* connection_traffic,
             network::OutgoingPacket* packet)
 {
   if (old_position.getY() > new_position.getY())
   {
     // North
-    packet->addU8(0x65);
+    const OutgoingMessage outgoing(0x65, connection_traffic, packet);
     addMapData(world,
+               tile_cache,
                common::Position(old_position.getX() - 8, new_position.getY() - 6, old_position.getZ()),
                18,
                1,
@@ -84,8 +349,9 @@ void addMap(const world::World& world,
   else if (old_position.getY() < new_position.getY())
   {
     // South
-    packet->addU8(0x67);
+    const OutgoingMessage outgoing(0x67, connection_traffic, packet);
     addMapData(world,
+               tile_cache,
                common::Position(old_position.getX() - 8, new_position.getY() + 7, old_position.getZ()),
                18,
                1,
@@ -96,8 +362,9 @@ void addMap(const world::World& world,
   if (old_position.getX() > new_position.getX())
   {
     // West
-    packet->addU8(0x68);
+    const OutgoingMessage outgoing(0x68, connection_traffic, packet);
     addMapData(world,
+               tile_cache,
                common::Position(new_position.getX() - 8, new_position.getY() - 6, old_position.getZ()),
                1,
                14,
@@ -107,8 +374,9 @@ void addMap(const world::World& world,
   else if (old_position.getX() < new_position.getX())
   {
     // East
-    packet->addU8(0x66);
+    const OutgoingMessage outgoing(0x66, connection_traffic, packet);
     addMapData(world,
+               tile_cache,
                common::Position(new_position.getX() + 9, new_position.getY() - 6, old_position.getZ()),
                1,
                14,
@@ -119,15 +387,17 @@ void addMap(const world::World& world,
 
 void addTileUpdated(const common::Position& position,
                     const world::World& world,
+                    TileCache* tile_cache,
                     KnownCreatures* known_creatures,
+                    TrafficStats* connection_traffic,
                     network::OutgoingPacket* packet)
 {
-  packet->addU8(0x69);
+  const OutgoingMessage outgoing(0x69, connection_traffic, packet);
   addPosition(position, packet);
   const auto* tile = world.getTile(position);
   if (tile)
   {
-    addTileData(*tile, known_creatures, packet);
+    addTileData(*tile, tile_cache, known_creatures, packet);
     packet->addU8(0x0);
   }
   else
@@ -140,9 +410,10 @@ void addTileUpdated(const common::Position& position,
 void addThingAdded(const common::Position& position,
                    const common::Thing& thing,
                    KnownCreatures* known_creatures,
+                   TrafficStats* connection_traffic,
                    network::OutgoingPacket* packet)
 {
-  packet->addU8(0x6A);
+  const OutgoingMessage outgoing(0x6A, connection_traffic, packet);
   addPosition(position, packet);
   addThing(thing, known_creatures, packet);
 }
@@ -151,11 +422,12 @@ void addThingChanged(const common::Position& position,
                      std::uint8_t stackpos,
                      const common::Thing& thing,
                      KnownCreatures* known_creatures,
+                     TrafficStats* connection_traffic,
                      network::OutgoingPacket* packet)
 {
   (void)known_creatures;
 
-  packet->addU8(0x6B);
+  const OutgoingMessage outgoing(0x6B, connection_traffic, packet);
   addPosition(position, packet);
   packet->add(stackpos);
 
@@ -172,9 +444,12 @@ void addThingChanged(const common::Position& position,
   }
 }
 
-void addThingRemoved(const common::Position& position, std::uint8_t stackpos, network::OutgoingPacket* packet)
+void addThingRemoved(const common::Position& position,
+                     std::uint8_t stackpos,
+                     TrafficStats* connection_traffic,
+                     network::OutgoingPacket* packet)
 {
-  packet->addU8(0x6C);
+  const OutgoingMessage outgoing(0x6C, connection_traffic, packet);
   addPosition(position, packet);
   packet->add(stackpos);
 }
@@ -182,9 +457,10 @@ void addThingRemoved(const common::Position& position, std::uint8_t stackpos, ne
 void addThingMoved(const common::Position& old_position,
                    std::uint8_t old_stackpos,
                    const common::Position& new_position,
+                   TrafficStats* connection_traffic,
                    network::OutgoingPacket* packet)
 {
-  packet->addU8(0x6D);
+  const OutgoingMessage outgoing(0x6D, connection_traffic, packet);
   addPosition(old_position, packet);
   packet->add(old_stackpos);
   addPosition(new_position, packet);
@@ -193,9 +469,11 @@ void addThingMoved(const common::Position& old_position,
 void addContainerOpen(std::uint8_t container_id,
                       const common::Thing& thing,
                       const gameengine::Container& container,
+                      TrafficStats* connection_traffic,
                       network::OutgoingPacket* packet)
 {
-  packet->addU8(0x6E);
+  packet->reserve(getContainerOpenSize(thing, container));
+  const OutgoingMessage outgoing(0x6E, connection_traffic, packet);
   packet->add(container_id);
   addThing(thing, nullptr, packet);
   packet->add(thing.item()->getItemType().name);
@@ -212,15 +490,29 @@ void addContainerOpen(std::uint8_t container_id,
   }
 }
 
-void addContainerClose(std::uint8_t container_id, network::OutgoingPacket* packet)
+std::size_t getContainerOpenSize(const common::Thing& thing, const gameengine::Container& container)
+{
+  // type, container id, item, name, max items, has parent, number of items
+  auto size = 1U + 1U + getItemSize(thing.item()) + 2U + thing.item()->getItemType().name.length() + 1U + 1U + 1U;
+  for (const auto* item : container.items)
+  {
+    size += item->getItemType().is_stackable ? 3U : 2U;
+  }
+  return size;
+}
+
+void addContainerClose(std::uint8_t container_id, TrafficStats* connection_traffic, network::OutgoingPacket* packet)
 {
-  packet->addU8(0x6F);
+  const OutgoingMessage outgoing(0x6F, connection_traffic, packet);
   packet->add(container_id);
 }
 
-void addContainerAddItem(std::uint8_t container_id, const common::Thing& thing, network::OutgoingPacket* packet)
+void addContainerAddItem(std::uint8_t container_id,
+                         const common::Thing& thing,
+                         TrafficStats* connection_traffic,
+                         network::OutgoingPacket* packet)
 {
-  packet->addU8(0x70);
+  const OutgoingMessage outgoing(0x70, connection_traffic, packet);
   packet->add(container_id);
   addThing(thing, nullptr, packet);
 }
@@ -228,9 +520,10 @@ void addContainerAddItem(std::uint8_t container_id, const common::Thing& thing,
 void addContainerUpdateItem(std::uint8_t container_id,
                             std::uint8_t container_slot,
                             const common::Thing& thing,
+                            TrafficStats* connection_traffic,
                             network::OutgoingPacket* packet)
 {
-  packet->addU8(0x71);
+  const OutgoingMessage outgoing(0x71, connection_traffic, packet);
   packet->add(container_id);
   packet->add(container_slot);
   addThing(thing, nullptr, packet);
@@ -238,46 +531,55 @@ void addContainerUpdateItem(std::uint8_t container_id,
 
 void addContainerRemoveItem(std::uint8_t container_id,
                             std::uint8_t container_slot,
+                            TrafficStats* connection_traffic,
                             network::OutgoingPacket* packet)
 {
-  packet->addU8(0x72);
+  const OutgoingMessage outgoing(0x72, connection_traffic, packet);
   packet->add(container_id);
   packet->add(container_slot);
 }
 
-void addEquipmentUpdated(const gameengine::Equipment& equipment, std::uint8_t inventory_index, network::OutgoingPacket* packet)
+void addEquipmentUpdated(const gameengine::Equipment& equipment,
+                         std::uint8_t inventory_index,
+                         TrafficStats* connection_traffic,
+                         network::OutgoingPacket* packet)
 {
   const auto* item = equipment.getItem(inventory_index);
   if (item)
   {
-    packet->addU8(0x78);
+    const OutgoingMessage outgoing(0x78, connection_traffic, packet);
     packet->add(inventory_index);
     addThing(common::Thing(item), nullptr, packet);
   }
   else
   {
-    packet->addU8(0x79);  // No Item in this slot
+    const OutgoingMessage outgoing(0x79, connection_traffic, packet);  // No Item in this slot
     packet->add(inventory_index);
   }
 }
 
-void addWorldLight(std::uint8_t intensity, std::uint8_t color, network::OutgoingPacket* packet)
+void addWorldLight(std::uint8_t intensity,
+                   std::uint8_t color,
+                   TrafficStats* connection_traffic,
+                   network::OutgoingPacket* packet)
 {
-  packet->addU8(0x82);
-  packet->add(intensity);
-  packet->add(color);
+  const OutgoingMessage outgoing(0x82, connection_traffic, packet);
+  encodeMessage<client::WorldLightSchema>(client::WorldLight{ intensity, color }, packet);
 }
 
-void addMagicEffect(const common::Position& position, std::uint8_t type, network::OutgoingPacket* packet)
+void addMagicEffect(const common::Position& position,
+                    std::uint8_t type,
+                    TrafficStats* connection_traffic,
+                    network::OutgoingPacket* packet)
 {
-  packet->addU8(0x83);
+  const OutgoingMessage outgoing(0x83, connection_traffic, packet);
   addPosition(position, packet);
   packet->add(type);
 }
 
-void addPlayerStats(const gameengine::Player& player, network::OutgoingPacket* packet)
+void addPlayerStats(const gameengine::Player& player, TrafficStats* connection_traffic, network::OutgoingPacket* packet)
 {
-  packet->addU8(0xA0);
+  const OutgoingMessage outgoing(0xA0, connection_traffic, packet);
   packet->add(player.getHealth());
   packet->add(player.getMaxHealth());
   packet->add(player.getCapacity());
@@ -288,12 +590,14 @@ void addPlayerStats(const gameengine::Player& player, network::OutgoingPacket* p
   packet->add(player.getMagicLevel());
 }
 
-void addPlayerSkills(const gameengine::Player& player, network::OutgoingPacket* packet)
+void addPlayerSkills(const gameengine::Player& player,
+                     TrafficStats* connection_traffic,
+                     network::OutgoingPacket* packet)
 {
   // TODO(simon): get skills from Player
   (void)player;
 
-  packet->addU8(0xA1);
+  const OutgoingMessage outgoing(0xA1, connection_traffic, packet);
   for (auto i = 0; i < 7; i++)
   {
     packet->addU8(10);
@@ -304,9 +608,22 @@ void addTalk(const std::string& name,
              std::uint8_t type,
              const common::Position& position,
              const std::string& message,
+             TrafficStats* connection_traffic,
              network::OutgoingPacket* packet)
 {
-  packet->addU8(0xAA);
+  // Skip the message, instead of overflowing the packet, if the name and message don't fit
+  // opcode, name, type, position, message
+  if (!packet->reserve(1U + 2U + name.length() + 1U + 5U + 2U + message.length()))
+  {
+    LOG_ERROR("%s: message from %s does not fit in packet (length: %lu, message length: %lu)",
+              __func__,
+              name.c_str(),
+              packet->getLength(),
+              message.length());
+    return;
+  }
+
+  const OutgoingMessage outgoing(0xAA, connection_traffic, packet);
   packet->add(name);
   packet->add(type);
 
@@ -318,133 +635,83 @@ void addTalk(const std::string& name,
   packet->add(message);
 }
 
-void addTextMessage(std::uint8_t type, const std::string& text, network::OutgoingPacket* packet)
+void addTextMessage(std::uint8_t type,
+                    const std::string& text,
+                    TrafficStats* connection_traffic,
+                    network::OutgoingPacket* packet)
 {
-  packet->addU8(0xB4);
-  packet->add(type);
-  packet->add(text);
+  const OutgoingMessage outgoing(0xB4, connection_traffic, packet);
+  encodeMessage<client::TextMessageSchema>(client::TextMessage{ type, text }, packet);
 }
 
-void addCancelMove(network::OutgoingPacket* packet)
+void addCancelMove(TrafficStats* connection_traffic, network::OutgoingPacket* packet)
 {
-  packet->addU8(0xB5);
+  const OutgoingMessage outgoing(0xB5, connection_traffic, packet);
 }
 
 void addMapData(const world::World& world,
+                TileCache* tile_cache,
                 const common::Position& position,
                 int width,
                 int height,
                 KnownCreatures* known_creatures,
                 network::OutgoingPacket* packet)
 {
-  // Calculate how to iterate over z
-  // Valid z is 0..15, 0 is highest and 15 is lowest. 7 is sea level.
-  // If on ground or higher (z <= 7) then go over everything above ground (from 7 to 0)
-  // If underground (z > 7) then go from two below to two above, with cap on lowest level (from e.g. 8 to 12, if z = 10)
-  const auto z_start = position.getZ() > 7 ? (position.getZ() - 2) : 7;
-  const auto z_end = position.getZ() > 7 ? std::min(position.getZ() + 2, 15) : 0;
-  const auto z_dir = z_start > z_end ? -1 : 1;
-
-  // After sending each tile we should send 0xYY 0xFF where YY is the number of following tiles
-  // that are empty and should be skipped. If there are no empty following tiles then we need
-  // to send 0x00 0xFF which denotes that this tiles is done.
-  // We don't know if the next tile is empty until the next iteration, so we will never send
-  // the "this tile is done" bytes on the same iteration as the actual tile, but rather in a
-  // later iteration, which is a bit confusing. We start off with -1 so that we don't start the
-  // message with saying that a tile is done.
-  int skip = -1;
-
-  for (auto z = z_start; z != z_end + z_dir; z += z_dir)
+  forEachMapTile(world,
+                 position,
+                 width,
+                 height,
+                 [packet](std::uint8_t skip)
+                 {
+                   packet->addU8(skip);
+                   packet->addU8(0xFF);
+                 },
+                 [tile_cache, known_creatures, packet](const world::Tile& tile)
+                 {
+                   addTileData(tile, tile_cache, known_creatures, packet);
+                 });
+}
+
+void addTileData(const world::Tile& tile,
+                 TileCache* tile_cache,
+                 KnownCreatures* known_creatures,
+                 network::OutgoingPacket* packet)
+{
+  // Items are copied from the cached encoding, in as few chunks as possible,
+  // while creatures are always encoded as they change (and affect known_creatures)
+  const auto& encoded_tile = tile_cache->get(tile);
+  const auto& things = tile.getThings();
+  const auto count = std::min<std::size_t>(things.size(), 10U);
+  std::size_t chunk_begin = 0U;
+  std::size_t num_items = 0U;
+  for (auto i = 0U; i < count; i++)
   {
-    // Currently we are always on z = 7, so we should send z=7, z=6, ..., z=0
-    // But we skip z=6, ..., z=0 as we only have ground
-    if (z != 7)
+    if (things[i].hasCreature())
     {
-      if (skip != -1)
-      {
-        // Send current skip value first
-        packet->addU8(skip);
-        packet->addU8(0xFF);
-      }
+      const std::size_t chunk_end = num_items > 0U ? encoded_tile.item_ends[num_items - 1] : 0U;
+      packet->addRawData(encoded_tile.data.data() + chunk_begin, chunk_end - chunk_begin);
+      chunk_begin = chunk_end;
 
-      // Skip this level (skip width * height tiles)
-      packet->addU8(width * height);
-      packet->addU8(0xFF);
-      skip = -1;
-      continue;
+      addCreature(things[i].creature(), known_creatures, packet);
     }
-
-    for (auto x = position.getX(); x < position.getX() + width; x++)
+    else
     {
-      for (auto y = position.getY(); y < position.getY() + height; y++)
-      {
-        const auto* tile = world.getTile(common::Position(x, y, position.getZ()));
-        if (!tile)
-        {
-          skip += 1;
-          if (skip == 0xFF)
-          {
-            packet->addU8(skip);
-            packet->addU8(0xFF);
-
-            // If there is a tile on the next iteration we don't want to send
-            // "tile is done", as we just sent one due to skip being max
-            skip = -1;
-          }
-        }
-        else
-        {
-          // Send "tile is done" with the number of tiles that were empty, unless this
-          // is the first tile (-1)
-          if (skip != -1)
-          {
-            packet->addU8(skip);
-            packet->addU8(0xFF);
-          }
-          else
-          {
-            // Don't let skip be -1 more than one iteration
-            skip = 0;
-          }
-
-          addTileData(*tile, known_creatures, packet);
-        }
-      }
+      num_items += 1U;
     }
   }
 
-  // Send last skip value
-  if (skip != -1)
-  {
-    packet->addU8(skip);
-    packet->addU8(0xFF);
-  }
+  const std::size_t chunk_end = num_items > 0U ? encoded_tile.item_ends[num_items - 1] : 0U;
+  packet->addRawData(encoded_tile.data.data() + chunk_begin, chunk_end - chunk_begin);
 }
 
-void addTileData(const world::Tile& tile, KnownCreatures* known_creatures, network::OutgoingPacket* packet)
+std::optional<Login> getLogin(network::IncomingPacket* packet)
 {
-  auto count = 0;
-  for (const auto& thing : tile.getThings())
+  Login login{};
+  if (!LoginSchema::decode(packet, &login))
   {
-    if (count >= 10)
-    {
-      break;
-    }
-
-    addThing(thing, known_creatures, packet);
-    count += 1;
+    LOG_ERROR("%s: packet is too short", __func__);
+    return std::nullopt;
   }
-}
-
-Login getLogin(network::IncomingPacket* packet)
-{
-  Login login;
-  packet->get(&login.unknown1);
-  packet->get(&login.client_os);
-  packet->get(&login.client_version);
-  packet->get(&login.unknown2);
-  packet->get(&login.character_name);
-  packet->get(&login.password);
   return login;
 }
 
@@ -459,62 +726,83 @@ MoveClick getMoveClick(network::IncomingPacket* packet)
   return move;
 }
 
-MoveItem getMoveItem(KnownContainers* container_ids, network::IncomingPacket* packet)
+std::optional<MoveItem> getMoveItem(KnownContainers* container_ids, network::IncomingPacket* packet)
 {
+  RawMoveItem raw{};
+  if (!RawMoveItemSchema::decode(packet, &raw))
+  {
+    LOG_ERROR("%s: packet is too short", __func__);
+    return std::nullopt;
+  }
+
   MoveItem move;
-  move.from_item_position = getItemPosition(container_ids, packet);
-  move.to_game_position = getGamePosition(container_ids, packet);
-  packet->get(&move.count);
+  move.from_item_position = { getGamePosition(container_ids, raw.from_x, raw.from_y, raw.from_z),
+                              raw.item_type_id,
+                              raw.stackpos };
+  move.to_game_position = getGamePosition(container_ids, raw.to_x, raw.to_y, raw.to_z);
+  move.count = raw.count;
   return move;
 }
 
-UseItem getUseItem(KnownContainers* container_ids, network::IncomingPacket* packet)
+std::optional<UseItem> getUseItem(KnownContainers* container_ids, network::IncomingPacket* packet)
 {
+  RawUseItem raw{};
+  if (!RawUseItemSchema::decode(packet, &raw))
+  {
+    LOG_ERROR("%s: packet is too short", __func__);
+    return std::nullopt;
+  }
+
   UseItem use;
-  use.item_position = getItemPosition(container_ids, packet);
-  packet->get(&use.new_container_id);
+  use.item_position = { getGamePosition(container_ids, raw.x, raw.y, raw.z), raw.item_type_id, raw.stackpos };
+  use.new_container_id = raw.new_container_id;
   return use;
 }
 
-CloseContainer getCloseContainer(network::IncomingPacket* packet)
+std::optional<CloseContainer> getCloseContainer(network::IncomingPacket* packet)
 {
-  CloseContainer close;
-  packet->get(&close.container_id);
+  CloseContainer close{};
+  if (!CloseContainerSchema::decode(packet, &close))
+  {
+    LOG_ERROR("%s: packet is too short", __func__);
+    return std::nullopt;
+  }
   return close;
 }
 
-OpenParentContainer getOpenParentContainer(network::IncomingPacket* packet)
+std::optional<OpenParentContainer> getOpenParentContainer(network::IncomingPacket* packet)
 {
-  OpenParentContainer open;
-  packet->get(&open.container_id);
+  OpenParentContainer open{};
+  if (!OpenParentContainerSchema::decode(packet, &open))
+  {
+    LOG_ERROR("%s: packet is too short", __func__);
+    return std::nullopt;
+  }
   return open;
 }
 
-LookAt getLookAt(KnownContainers* container_ids, network::IncomingPacket* packet)
+std::optional<LookAt> getLookAt(KnownContainers* container_ids, network::IncomingPacket* packet)
 {
+  RawLookAt raw{};
+  if (!RawLookAtSchema::decode(packet, &raw))
+  {
+    LOG_ERROR("%s: packet is too short", __func__);
+    return std::nullopt;
+  }
+
   LookAt look;
-  look.item_position = getItemPosition(container_ids, packet);
+  look.item_position = { getGamePosition(container_ids, raw.x, raw.y, raw.z), raw.item_type_id, raw.stackpos };
   return look;
 }
 
-Say getSay(network::IncomingPacket* packet)
+std::optional<Say> getSay(network::IncomingPacket* packet)
 {
-  Say say;
-  packet->get(&say.type);
-  switch (say.type)
+  Say say{};
+  if (!SaySchema::decode(packet, &say))
   {
-    case 0x06:  // PRIVATE
-    case 0x0B:  // PRIVATE RED
-      packet->get(&say.receiver);
-      break;
-    case 0x07:  // CHANNEL_Y
-    case 0x0A:  // CHANNEL_R1
-      packet->get(&say.channel_id);
-      break;
-    default:
-      break;
+    LOG_ERROR("%s: packet is too short", __func__);
+    return std::nullopt;
   }
-  packet->get(&say.message);
   return say;
 }
 
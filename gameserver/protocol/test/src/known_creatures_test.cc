@@ -0,0 +1,237 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "protocol_common.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <list>
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace protocol
+{
+
+namespace
+{
+
+// Same as KnownCreatures::hash, used to find CreatureIds that collide in the table
+std::size_t getSlot(common::CreatureId creature_id)
+{
+  return static_cast<std::uint32_t>(creature_id * 2654435769U) >> (32 - 7);
+}
+
+// Returns count CreatureIds, starting from first_id, that all have the given slot
+std::vector<common::CreatureId> getCreatureIdsWithSlot(std::size_t slot, std::size_t count, common::CreatureId first_id)
+{
+  std::vector<common::CreatureId> creature_ids;
+  for (auto creature_id = first_id; creature_ids.size() < count; creature_id++)
+  {
+    if (getSlot(creature_id) == slot)
+    {
+      creature_ids.push_back(creature_id);
+    }
+  }
+  return creature_ids;
+}
+
+}  // namespace
+
+TEST(KnownCreaturesTest, AddAndTouch)
+{
+  KnownCreatures known_creatures;
+  ASSERT_EQ(0U, known_creatures.size());
+  ASSERT_FALSE(known_creatures.contains(1U));
+  ASSERT_FALSE(known_creatures.touch(1U));
+
+  ASSERT_EQ(common::Creature::INVALID_ID, known_creatures.add(1U));
+  ASSERT_EQ(common::Creature::INVALID_ID, known_creatures.add(2U));
+  ASSERT_EQ(2U, known_creatures.size());
+  ASSERT_TRUE(known_creatures.contains(1U));
+  ASSERT_TRUE(known_creatures.touch(2U));
+  ASSERT_FALSE(known_creatures.contains(3U));
+
+  known_creatures.clear();
+  ASSERT_EQ(0U, known_creatures.size());
+  ASSERT_FALSE(known_creatures.contains(1U));
+  ASSERT_FALSE(known_creatures.contains(2U));
+}
+
+TEST(KnownCreaturesTest, EvictLeastRecentlyUsed)
+{
+  KnownCreatures known_creatures;
+  for (auto creature_id = 1U; creature_id <= KnownCreatures::MAX_SIZE; creature_id++)
+  {
+    ASSERT_EQ(common::Creature::INVALID_ID, known_creatures.add(creature_id));
+  }
+  ASSERT_EQ(KnownCreatures::MAX_SIZE, known_creatures.size());
+
+  // 1 is the least recently used, unless it is touched
+  ASSERT_TRUE(known_creatures.touch(1U));
+
+  // The evicted CreatureId is returned, so that it can be sent as "creature id to remove"
+  ASSERT_EQ(2U, known_creatures.add(100U));
+  ASSERT_FALSE(known_creatures.contains(2U));
+  ASSERT_TRUE(known_creatures.contains(100U));
+  ASSERT_EQ(KnownCreatures::MAX_SIZE, known_creatures.size());
+
+  ASSERT_EQ(3U, known_creatures.add(101U));
+  ASSERT_EQ(4U, known_creatures.add(102U));
+
+  // Touching the least recently used moves it to the front
+  ASSERT_TRUE(known_creatures.touch(5U));
+  ASSERT_EQ(6U, known_creatures.add(103U));
+
+  // The added creatures are evicted last, after 1 and 5
+  for (auto creature_id = 7U; creature_id <= KnownCreatures::MAX_SIZE; creature_id++)
+  {
+    ASSERT_EQ(creature_id, known_creatures.add(1000U + creature_id));
+  }
+  ASSERT_EQ(1U, known_creatures.add(200U));
+  ASSERT_EQ(100U, known_creatures.add(201U));
+  ASSERT_EQ(101U, known_creatures.add(202U));
+  ASSERT_EQ(102U, known_creatures.add(203U));
+  ASSERT_EQ(5U, known_creatures.add(204U));
+  ASSERT_EQ(103U, known_creatures.add(205U));
+}
+
+TEST(KnownCreaturesTest, Collisions)
+{
+  // Creatures that all want the same slot, the first in the table so that none of them wrap around
+  const auto creature_ids = getCreatureIdsWithSlot(0U, 4U, 1U);
+
+  KnownCreatures known_creatures;
+  for (const auto creature_id : creature_ids)
+  {
+    known_creatures.add(creature_id);
+  }
+  for (const auto creature_id : creature_ids)
+  {
+    ASSERT_TRUE(known_creatures.contains(creature_id));
+  }
+
+  // Fill up so that the colliding creatures are evicted one at a time, oldest first
+  for (auto creature_id = 1U; known_creatures.size() < KnownCreatures::MAX_SIZE; creature_id++)
+  {
+    if (std::find(creature_ids.cbegin(), creature_ids.cend(), creature_id) == creature_ids.cend())
+    {
+      known_creatures.add(creature_id);
+    }
+  }
+  for (auto i = 0U; i < creature_ids.size(); i++)
+  {
+    ASSERT_EQ(creature_ids[i], known_creatures.add(0x10000000U + i));
+
+    // The remaining colliding creatures must still be found after the erase
+    for (auto j = i + 1; j < creature_ids.size(); j++)
+    {
+      ASSERT_TRUE(known_creatures.contains(creature_ids[j]));
+    }
+    ASSERT_FALSE(known_creatures.contains(creature_ids[i]));
+  }
+}
+
+TEST(KnownCreaturesTest, CollisionsWrapAround)
+{
+  // Creatures that all want the last slot in the table, so that the probing wraps around to the
+  // first slot, and a creature that wants the first slot
+  const auto creature_ids = getCreatureIdsWithSlot(127U, 3U, 1U);
+  const auto creature_id_first_slot = getCreatureIdsWithSlot(0U, 1U, 1U)[0];
+
+  KnownCreatures known_creatures;
+  for (const auto creature_id : creature_ids)
+  {
+    known_creatures.add(creature_id);
+  }
+  known_creatures.add(creature_id_first_slot);
+  for (const auto creature_id : creature_ids)
+  {
+    ASSERT_TRUE(known_creatures.contains(creature_id));
+  }
+  ASSERT_TRUE(known_creatures.contains(creature_id_first_slot));
+
+  // Evict the creatures in the order they were added, the others must still be found
+  for (auto creature_id = 1U; known_creatures.size() < KnownCreatures::MAX_SIZE; creature_id++)
+  {
+    if (std::find(creature_ids.cbegin(), creature_ids.cend(), creature_id) == creature_ids.cend() &&
+        creature_id != creature_id_first_slot)
+    {
+      known_creatures.add(creature_id);
+    }
+  }
+  for (auto i = 0U; i < creature_ids.size(); i++)
+  {
+    ASSERT_EQ(creature_ids[i], known_creatures.add(0x10000000U + i));
+    for (auto j = i + 1; j < creature_ids.size(); j++)
+    {
+      ASSERT_TRUE(known_creatures.contains(creature_ids[j]));
+    }
+    ASSERT_TRUE(known_creatures.contains(creature_id_first_slot));
+  }
+  ASSERT_EQ(creature_id_first_slot, known_creatures.add(0x20000000U));
+}
+
+TEST(KnownCreaturesTest, CompareWithList)
+{
+  // Random adds and touches, compared with a simple least recently used list
+  std::mt19937 random_engine(1234);
+  std::uniform_int_distribution<common::CreatureId> random_creature_id(1U, 200U);
+
+  KnownCreatures known_creatures;
+  std::list<common::CreatureId> expected;  // Most recently used first
+  for (auto i = 0; i < 10000; i++)
+  {
+    const auto creature_id = random_creature_id(random_engine);
+    const auto it = std::find(expected.begin(), expected.end(), creature_id);
+    if (it != expected.end())
+    {
+      ASSERT_TRUE(known_creatures.touch(creature_id));
+      expected.erase(it);
+      expected.push_front(creature_id);
+      continue;
+    }
+
+    auto expected_removed = common::Creature::INVALID_ID;
+    if (expected.size() == KnownCreatures::MAX_SIZE)
+    {
+      expected_removed = expected.back();
+      expected.pop_back();
+    }
+    expected.push_front(creature_id);
+
+    ASSERT_FALSE(known_creatures.touch(creature_id));
+    ASSERT_EQ(expected_removed, known_creatures.add(creature_id));
+    ASSERT_EQ(expected.size(), known_creatures.size());
+  }
+
+  for (auto creature_id = 1U; creature_id <= 200U; creature_id++)
+  {
+    const auto is_expected = std::find(expected.cbegin(), expected.cend(), creature_id) != expected.cend();
+    ASSERT_EQ(is_expected, known_creatures.contains(creature_id));
+  }
+}
+
+}  // namespace protocol
@@ -0,0 +1,195 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "protocol_codec.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "incoming_packet.h"
+#include "outgoing_packet.h"
+
+namespace protocol::codec
+{
+
+namespace
+{
+
+struct FixedMessage
+{
+  std::uint8_t u8;
+  std::uint16_t u16;
+  std::uint32_t u32;
+};
+
+using FixedMessageSchema = Schema<FixedMessage,
+                                  Field<&FixedMessage::u8>,
+                                  Field<&FixedMessage::u16>,
+                                  Field<&FixedMessage::u32>>;
+
+struct StringMessage
+{
+  std::uint8_t type;
+  std::string text;
+  std::uint16_t value;
+};
+
+using StringMessageSchema = Schema<StringMessage,
+                                   Field<&StringMessage::type>,
+                                   Field<&StringMessage::text>,
+                                   Field<&StringMessage::value>>;
+
+struct ConditionalMessage
+{
+  std::uint8_t type;
+  std::uint32_t id;
+  std::uint16_t value;
+};
+
+constexpr bool hasId(const ConditionalMessage& message)
+{
+  return message.type == 1U;
+}
+
+using ConditionalMessageSchema = Schema<ConditionalMessage,
+                                        Field<&ConditionalMessage::type>,
+                                        FieldIf<&ConditionalMessage::id, hasId>,
+                                        Field<&ConditionalMessage::value>>;
+
+// The size of messages with only fixed size fields is known at compile time
+static_assert(FixedMessageSchema::IS_FIXED_SIZE);
+static_assert(FixedMessageSchema::FIXED_SIZE == 7U);
+static_assert(!StringMessageSchema::IS_FIXED_SIZE);
+static_assert(StringMessageSchema::FIXED_SIZE == 5U);
+static_assert(!ConditionalMessageSchema::IS_FIXED_SIZE);
+static_assert(ConditionalMessageSchema::FIXED_SIZE == 3U);
+
+std::vector<std::uint8_t> getBytes(const network::OutgoingPacket& packet)
+{
+  return std::vector<std::uint8_t>(packet.getBuffer(), packet.getBuffer() + packet.getLength());
+}
+
+}  // namespace
+
+TEST(ProtocolCodecTest, FixedSizeFields)
+{
+  network::OutgoingPacket packet;
+  ASSERT_TRUE(FixedMessageSchema::encode({ 0x12U, 0x3456U, 0x789ABCDEU }, &packet));
+
+  // Little endian, in field order
+  const std::vector<std::uint8_t> expected = { 0x12, 0x56, 0x34, 0xDE, 0xBC, 0x9A, 0x78 };
+  ASSERT_EQ(expected, getBytes(packet));
+
+  network::IncomingPacket incoming(expected.data(), expected.size());
+  FixedMessage message;
+  ASSERT_TRUE(FixedMessageSchema::decode(&incoming, &message));
+  EXPECT_EQ(0x12U, message.u8);
+  EXPECT_EQ(0x3456U, message.u16);
+  EXPECT_EQ(0x789ABCDEU, message.u32);
+  EXPECT_TRUE(incoming.isEmpty());
+}
+
+TEST(ProtocolCodecTest, StringField)
+{
+  const StringMessage message{ 0x01U, "Hello", 0x0203U };
+  ASSERT_EQ(StringMessageSchema::FIXED_SIZE + 5U, StringMessageSchema::size(message));
+
+  network::OutgoingPacket packet;
+  ASSERT_TRUE(StringMessageSchema::encode(message, &packet));
+  const std::vector<std::uint8_t> expected = { 0x01, 0x05, 0x00, 'H', 'e', 'l', 'l', 'o', 0x03, 0x02 };
+  ASSERT_EQ(expected, getBytes(packet));
+
+  network::IncomingPacket incoming(expected.data(), expected.size());
+  StringMessage decoded;
+  ASSERT_TRUE(StringMessageSchema::decode(&incoming, &decoded));
+  EXPECT_EQ(message.type, decoded.type);
+  EXPECT_EQ(message.text, decoded.text);
+  EXPECT_EQ(message.value, decoded.value);
+  EXPECT_TRUE(incoming.isEmpty());
+}
+
+TEST(ProtocolCodecTest, ConditionalField)
+{
+  // Condition true, id is sent
+  network::OutgoingPacket packet;
+  ASSERT_TRUE(ConditionalMessageSchema::encode({ 1U, 0x04030201U, 0x0605U }, &packet));
+  const std::vector<std::uint8_t> expected_with_id = { 0x01, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06 };
+  ASSERT_EQ(expected_with_id, getBytes(packet));
+
+  network::IncomingPacket incoming_with_id(expected_with_id.data(), expected_with_id.size());
+  ConditionalMessage decoded{ 0U, 0U, 0U };
+  ASSERT_TRUE(ConditionalMessageSchema::decode(&incoming_with_id, &decoded));
+  EXPECT_EQ(0x04030201U, decoded.id);
+  EXPECT_EQ(0x0605U, decoded.value);
+
+  // Condition false, id is not sent nor read
+  network::OutgoingPacket packet_without_id;
+  ASSERT_TRUE(ConditionalMessageSchema::encode({ 2U, 0x04030201U, 0x0605U }, &packet_without_id));
+  const std::vector<std::uint8_t> expected_without_id = { 0x02, 0x05, 0x06 };
+  ASSERT_EQ(expected_without_id, getBytes(packet_without_id));
+
+  network::IncomingPacket incoming_without_id(expected_without_id.data(), expected_without_id.size());
+  decoded = ConditionalMessage{ 0U, 0U, 0U };
+  ASSERT_TRUE(ConditionalMessageSchema::decode(&incoming_without_id, &decoded));
+  EXPECT_EQ(2U, decoded.type);
+  EXPECT_EQ(0U, decoded.id);
+  EXPECT_EQ(0x0605U, decoded.value);
+}
+
+TEST(ProtocolCodecTest, TruncatedInput)
+{
+  // Every prefix of a complete message must fail to decode, without reading past the end
+  const std::vector<std::uint8_t> fixed = { 0x12, 0x56, 0x34, 0xDE, 0xBC, 0x9A, 0x78 };
+  const std::vector<std::uint8_t> string = { 0x01, 0x05, 0x00, 'H', 'e', 'l', 'l', 'o', 0x03, 0x02 };
+  const std::vector<std::uint8_t> conditional = { 0x01, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06 };
+  for (auto length = 0U; length < fixed.size(); length++)
+  {
+    network::IncomingPacket incoming(fixed.data(), length);
+    FixedMessage message;
+    EXPECT_FALSE(FixedMessageSchema::decode(&incoming, &message)) << "length: " << length;
+  }
+  for (auto length = 0U; length < string.size(); length++)
+  {
+    network::IncomingPacket incoming(string.data(), length);
+    StringMessage message;
+    EXPECT_FALSE(StringMessageSchema::decode(&incoming, &message)) << "length: " << length;
+  }
+  for (auto length = 0U; length < conditional.size(); length++)
+  {
+    network::IncomingPacket incoming(conditional.data(), length);
+    ConditionalMessage message;
+    EXPECT_FALSE(ConditionalMessageSchema::decode(&incoming, &message)) << "length: " << length;
+  }
+
+  // A string length that is larger than the rest of the packet
+  const std::vector<std::uint8_t> bad_length = { 0x01, 0xFF, 0x00, 'H', 'i', 0x03, 0x02 };
+  network::IncomingPacket incoming(bad_length.data(), bad_length.size());
+  StringMessage message;
+  EXPECT_FALSE(StringMessageSchema::decode(&incoming, &message));
+}
+
+}  // namespace protocol::codec
@@ -0,0 +1,201 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "protocol_server.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "creature.h"
+#include "incoming_packet.h"
+#include "item.h"
+#include "outgoing_packet.h"
+#include "position.h"
+#include "protocol_common.h"
+#include "tile.h"
+
+namespace protocol::server
+{
+
+namespace
+{
+
+class ItemStub : public common::Item
+{
+ public:
+  ItemStub(common::ItemUniqueId item_unique_id, common::ItemTypeId item_type_id)
+    : m_item_unique_id(item_unique_id)
+  {
+    m_item_type.id = item_type_id;
+  }
+
+  common::ItemUniqueId getItemUniqueId() const override { return m_item_unique_id; }
+  common::ItemTypeId getItemTypeId() const override { return m_item_type.id; }
+
+  const common::ItemType& getItemType() const override { return m_item_type; }
+
+  std::uint8_t getCount() const override { return 1U; }
+  void setCount(std::uint8_t) override {}
+
+ private:
+  common::ItemUniqueId m_item_unique_id;
+  common::ItemType m_item_type;
+};
+
+// Encodes each thing on the tile on its own, without the cached encoding
+std::vector<std::uint8_t> encodeThings(const world::Tile& tile, KnownCreatures* known_creatures)
+{
+  network::OutgoingPacket packet;
+  for (const auto& thing : tile.getThings())
+  {
+    addThing(thing, known_creatures, &packet);
+  }
+  return { packet.getBuffer(), packet.getBuffer() + packet.getLength() };
+}
+
+std::vector<std::uint8_t> encodeTile(const world::Tile& tile, TileCache* tile_cache, KnownCreatures* known_creatures)
+{
+  network::OutgoingPacket packet;
+  addTileData(tile, tile_cache, known_creatures, &packet);
+  return { packet.getBuffer(), packet.getBuffer() + packet.getLength() };
+}
+
+}  // namespace
+
+TEST(ProtocolServerTest, TileDataWithCreatures)
+{
+  ItemStub ground(1U, 100U);
+  ItemStub item(2U, 101U);
+  world::Tile tile(&ground);
+  tile.addThing(&item);
+
+  TileCache tile_cache;
+  KnownCreatures known_creatures;
+  KnownCreatures expected_known_creatures;
+  ASSERT_EQ(encodeThings(tile, &expected_known_creatures), encodeTile(tile, &tile_cache, &known_creatures));
+  ASSERT_EQ(1U, tile_cache.size());
+
+  // A creature doesn't change the version, but is placed between the ground and the item
+  common::Creature creature(1U, "Creature");
+  tile.addThing(&creature);
+  ASSERT_EQ(&item, tile.getItem(2));
+  ASSERT_EQ(encodeThings(tile, &expected_known_creatures), encodeTile(tile, &tile_cache, &known_creatures));
+
+  // Two creatures, and the creature is now known
+  common::Creature other_creature(2U, "OtherCreature");
+  tile.addThing(&other_creature);
+  ASSERT_EQ(encodeThings(tile, &expected_known_creatures), encodeTile(tile, &tile_cache, &known_creatures));
+
+  ASSERT_TRUE(tile.removeThing(1));
+  ASSERT_TRUE(tile.removeThing(1));
+  ASSERT_EQ(encodeThings(tile, &expected_known_creatures), encodeTile(tile, &tile_cache, &known_creatures));
+
+  // Changing the items encodes the tile again, in the same entry
+  ASSERT_TRUE(tile.removeThing(1));
+  ASSERT_EQ(encodeThings(tile, &expected_known_creatures), encodeTile(tile, &tile_cache, &known_creatures));
+  ASSERT_EQ(1U, tile_cache.size());
+}
+
+TEST(ProtocolServerTest, TalkThatDoesNotFit)
+{
+  // E.g. a Say from a client that doesn't follow the protocol
+  network::OutgoingPacket packet;
+  packet.addU8(0x01);
+  addTalk("Creature",
+          1U,
+          common::Position(192, 192, 7),
+          std::string(network::OutgoingPacket::MAX_LENGTH, 'a'),
+          nullptr,
+          &packet);
+  ASSERT_FALSE(packet.hasOverflowed());
+  ASSERT_EQ(1U, packet.getLength());
+
+  addTalk("Creature", 1U, common::Position(192, 192, 7), "Hello", nullptr, &packet);
+  ASSERT_FALSE(packet.hasOverflowed());
+  ASSERT_EQ(1U + 1U + 2U + 8U + 1U + 5U + 2U + 5U, packet.getLength());
+}
+
+TEST(ProtocolServerTest, ShortLogin)
+{
+  // The password is cut short
+  const std::vector<std::uint8_t> buffer = { 0x00, 0x02, 0xF8, 0x02, 0x00, 0x01, 0x00, 'a', 0x05, 0x00, 'p', 'a' };
+  network::IncomingPacket short_packet(buffer.data(), buffer.size());
+  ASSERT_FALSE(getLogin(&short_packet).has_value());
+
+  const std::vector<std::uint8_t> complete = { 0x00, 0x02, 0xF8, 0x02, 0x00, 0x01, 0x00, 'a', 0x02, 0x00, 'p', 'a' };
+  network::IncomingPacket complete_packet(complete.data(), complete.size());
+  const auto login = getLogin(&complete_packet);
+  ASSERT_TRUE(login.has_value());
+  EXPECT_EQ(760U, login->client_version);
+  EXPECT_EQ("a", login->character_name);
+  EXPECT_EQ("pa", login->password);
+}
+
+TEST(ProtocolServerTest, ShortSay)
+{
+  // A private message without the message itself
+  const std::vector<std::uint8_t> buffer = { 0x06, 0x01, 0x00, 'a' };
+  network::IncomingPacket packet(buffer.data(), buffer.size());
+  ASSERT_FALSE(getSay(&packet).has_value());
+}
+
+TEST(ProtocolServerTest, MoveItem)
+{
+  KnownContainers container_ids;
+  container_ids.fill(common::Item::INVALID_UNIQUE_ID);
+  container_ids[2] = 1234U;
+
+  // From (200, 201, 7) stackpos 1 to slot 3 in container 2
+  const std::vector<std::uint8_t> buffer = { 0xC8, 0x00, 0xC9, 0x00, 0x07, 0x64, 0x00, 0x01,
+                                             0xFF, 0xFF, 0x42, 0x00, 0x03, 0x05 };
+  network::IncomingPacket packet(buffer.data(), buffer.size());
+  const auto move = getMoveItem(&container_ids, &packet);
+  ASSERT_TRUE(move.has_value());
+  EXPECT_EQ(common::ItemPosition(common::GamePosition(common::Position(200, 201, 7)), 100U, 1),
+            move->from_item_position);
+  EXPECT_EQ(common::GamePosition(1234U, 3), move->to_game_position);
+  EXPECT_EQ(5U, move->count);
+
+  // Without the count
+  network::IncomingPacket short_packet(buffer.data(), buffer.size() - 1U);
+  ASSERT_FALSE(getMoveItem(&container_ids, &short_packet).has_value());
+}
+
+TEST(ProtocolServerTest, ShortUseItemAndLookAt)
+{
+  KnownContainers container_ids;
+  container_ids.fill(common::Item::INVALID_UNIQUE_ID);
+
+  // Without the stackpos
+  const std::vector<std::uint8_t> buffer = { 0xC8, 0x00, 0xC9, 0x00, 0x07, 0x64, 0x00 };
+  network::IncomingPacket use_packet(buffer.data(), buffer.size());
+  ASSERT_FALSE(getUseItem(&container_ids, &use_packet).has_value());
+  network::IncomingPacket look_packet(buffer.data(), buffer.size());
+  ASSERT_FALSE(getLookAt(&container_ids, &look_packet).has_value());
+}
+
+}  // namespace protocol::server
@@ -0,0 +1,139 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "protocol_server.h"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "outgoing_packet.h"
+
+namespace protocol::server
+{
+
+TEST(TrafficStatsTest, Add)
+{
+  TrafficStats traffic_stats;
+  traffic_stats.add(TrafficStats::Direction::INCOMING, 0x65, 1U);
+  traffic_stats.add(TrafficStats::Direction::INCOMING, 0x65, 1U);
+  traffic_stats.add(TrafficStats::Direction::INCOMING, 0x96, 10U);
+  traffic_stats.add(TrafficStats::Direction::OUTGOING, 0x64, 1000U);
+
+  EXPECT_EQ(2U, traffic_stats.get(TrafficStats::Direction::INCOMING, 0x65).messages);
+  EXPECT_EQ(2U, traffic_stats.get(TrafficStats::Direction::INCOMING, 0x65).bytes);
+  EXPECT_EQ(1U, traffic_stats.get(TrafficStats::Direction::INCOMING, 0x96).messages);
+  EXPECT_EQ(10U, traffic_stats.get(TrafficStats::Direction::INCOMING, 0x96).bytes);
+
+  // The directions are counted separately
+  EXPECT_EQ(0U, traffic_stats.get(TrafficStats::Direction::OUTGOING, 0x65).messages);
+  EXPECT_EQ(0U, traffic_stats.get(TrafficStats::Direction::INCOMING, 0x64).messages);
+  EXPECT_EQ(1U, traffic_stats.get(TrafficStats::Direction::OUTGOING, 0x64).messages);
+  EXPECT_EQ(1000U, traffic_stats.get(TrafficStats::Direction::OUTGOING, 0x64).bytes);
+}
+
+TEST(TrafficStatsTest, Total)
+{
+  TrafficStats traffic_stats;
+  EXPECT_EQ(0U, traffic_stats.getTotal(TrafficStats::Direction::INCOMING).messages);
+  EXPECT_EQ(0U, traffic_stats.getTotal(TrafficStats::Direction::INCOMING).bytes);
+
+  traffic_stats.add(TrafficStats::Direction::INCOMING, 0x00, 3U);
+  traffic_stats.add(TrafficStats::Direction::INCOMING, 0xFF, 4U);
+  traffic_stats.add(TrafficStats::Direction::OUTGOING, 0x64, 1000U);
+
+  const auto incoming = traffic_stats.getTotal(TrafficStats::Direction::INCOMING);
+  EXPECT_EQ(2U, incoming.messages);
+  EXPECT_EQ(7U, incoming.bytes);
+  const auto outgoing = traffic_stats.getTotal(TrafficStats::Direction::OUTGOING);
+  EXPECT_EQ(1U, outgoing.messages);
+  EXPECT_EQ(1000U, outgoing.bytes);
+}
+
+TEST(TrafficStatsTest, ForEach)
+{
+  TrafficStats traffic_stats;
+  traffic_stats.add(TrafficStats::Direction::OUTGOING, 0xB4, 5U);
+  traffic_stats.add(TrafficStats::Direction::OUTGOING, 0x0A, 7U);
+  traffic_stats.add(TrafficStats::Direction::OUTGOING, 0xB4, 5U);
+  traffic_stats.add(TrafficStats::Direction::INCOMING, 0x14, 1U);
+
+  // Only opcodes with messages, in opcode order
+  std::vector<std::pair<std::uint8_t, std::uint64_t>> opcodes;
+  traffic_stats.forEach(TrafficStats::Direction::OUTGOING,
+                        [&opcodes](std::uint8_t opcode, const TrafficStats::Counters& counters)
+                        {
+                          opcodes.emplace_back(opcode, counters.bytes);
+                        });
+  const std::vector<std::pair<std::uint8_t, std::uint64_t>> expected = { { 0x0A, 7U }, { 0xB4, 10U } };
+  EXPECT_EQ(expected, opcodes);
+}
+
+TEST(TrafficStatsTest, Reset)
+{
+  TrafficStats traffic_stats;
+  traffic_stats.add(TrafficStats::Direction::INCOMING, 0x65, 1U);
+  traffic_stats.add(TrafficStats::Direction::OUTGOING, 0x64, 1000U);
+  traffic_stats.reset();
+
+  EXPECT_EQ(0U, traffic_stats.getTotal(TrafficStats::Direction::INCOMING).messages);
+  EXPECT_EQ(0U, traffic_stats.getTotal(TrafficStats::Direction::OUTGOING).bytes);
+
+  auto calls = 0;
+  traffic_stats.forEach(TrafficStats::Direction::OUTGOING,
+                        [&calls](std::uint8_t, const TrafficStats::Counters&)
+                        {
+                          calls += 1;
+                        });
+  EXPECT_EQ(0, calls);
+}
+
+TEST(TrafficStatsTest, ConnectionTraffic)
+{
+  resetTrafficStats();
+  TrafficStats connection_traffic;
+
+  // Messages are counted both process-wide and for the connection
+  network::OutgoingPacket packet;
+  addTextMessage(0x13, "Hello", &connection_traffic, &packet);
+  countIncoming(0x96, 10U, &connection_traffic);
+  EXPECT_EQ(1U, connection_traffic.get(TrafficStats::Direction::OUTGOING, 0xB4).messages);
+  EXPECT_EQ(packet.getLength(), connection_traffic.get(TrafficStats::Direction::OUTGOING, 0xB4).bytes);
+  EXPECT_EQ(1U, connection_traffic.get(TrafficStats::Direction::INCOMING, 0x96).messages);
+  EXPECT_EQ(10U, connection_traffic.get(TrafficStats::Direction::INCOMING, 0x96).bytes);
+  EXPECT_EQ(1U, getTrafficStats().get(TrafficStats::Direction::OUTGOING, 0xB4).messages);
+  EXPECT_EQ(1U, getTrafficStats().get(TrafficStats::Direction::INCOMING, 0x96).messages);
+
+  // Without a connection only the process-wide counters are updated
+  addTextMessage(0x13, "Hello", nullptr, &packet);
+  countIncoming(0x96, 10U, nullptr);
+  EXPECT_EQ(1U, connection_traffic.get(TrafficStats::Direction::OUTGOING, 0xB4).messages);
+  EXPECT_EQ(1U, connection_traffic.get(TrafficStats::Direction::INCOMING, 0x96).messages);
+  EXPECT_EQ(2U, getTrafficStats().get(TrafficStats::Direction::OUTGOING, 0xB4).messages);
+  EXPECT_EQ(2U, getTrafficStats().get(TrafficStats::Direction::INCOMING, 0x96).messages);
+}
+
+}  // namespace protocol::server
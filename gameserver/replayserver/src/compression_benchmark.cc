@@ -0,0 +1,221 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Replays the packets in a recorded replay file through the same deflate
+// settings as websocketpp's permessage-deflate extension (raw deflate, 15 bit
+// window, context takeover, sync flush per message) and prints the wire bytes
+// and the CPU time spent compressing for a range of compression thresholds.
+//
+// Each packet is sent the way the worldserver sends it (ConnectionImpl::init with
+// skip_send_packet_header = false): first the 2 byte packet length as a websocket
+// message of its own, then the packet data as a second websocket message. Both
+// messages go through the same compression threshold and compression context.
+//
+// Usage: compression_benchmark <replay file> [iterations]
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+// utils
+#include "logger.h"
+
+// replayserver
+#include "replay_reader.h"
+
+namespace
+{
+
+struct Result
+{
+  std::uint64_t messages = 0U;
+  std::uint64_t compressed_messages = 0U;
+  std::uint64_t payload_bytes = 0U;
+  std::uint64_t wire_bytes = 0U;
+  std::chrono::nanoseconds cpu_time = std::chrono::nanoseconds::zero();
+};
+
+// Size of the websocket frame header for a server to client frame (not masked)
+std::size_t getFrameHeaderSize(std::size_t payload_length)
+{
+  if (payload_length < 126U)
+  {
+    return 2U;
+  }
+  else if (payload_length <= 0xFFFFU)
+  {
+    return 4U;
+  }
+  return 10U;
+}
+
+// Compresses the message and sets length to the compressed length, as it would be sent on the wire
+bool deflateMessage(z_stream* stream,
+                    const std::vector<std::uint8_t>& message,
+                    std::vector<std::uint8_t>* buffer,
+                    std::size_t* length)
+{
+  buffer->resize(deflateBound(stream, message.size()) + 64U);
+
+  stream->next_in = const_cast<Bytef*>(message.data());
+  stream->avail_in = message.size();
+  stream->next_out = buffer->data();
+  stream->avail_out = buffer->size();
+  if (deflate(stream, Z_SYNC_FLUSH) != Z_OK || stream->avail_in != 0U || stream->avail_out == 0U)
+  {
+    return false;
+  }
+
+  // The trailing 0x00 0x00 0xFF 0xFF from the sync flush is not sent (RFC 7692)
+  *length = buffer->size() - stream->avail_out - 4U;
+  return true;
+}
+
+bool runBenchmark(const std::vector<std::vector<std::uint8_t>>& packets,
+                  std::size_t compression_threshold,
+                  int iterations,
+                  Result* result)
+{
+  z_stream stream {};
+  if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+  {
+    return false;
+  }
+
+  std::vector<std::uint8_t> buffer;
+  std::vector<std::uint8_t> header(2U);
+  for (auto i = 0; i < iterations; i++)
+  {
+    // Each iteration is a new connection, with a new compression context
+    deflateReset(&stream);
+
+    for (const auto& packet : packets)
+    {
+      // See ConnectionImpl::sendPacketInternal
+      header[0] = static_cast<std::uint8_t>(packet.size());
+      header[1] = static_cast<std::uint8_t>(packet.size() >> 8);
+      const std::array<const std::vector<std::uint8_t>*, 2> messages = { &header, &packet };
+      for (const auto* message : messages)
+      {
+        auto length = message->size();
+        const auto compress = compression_threshold != 0U && message->size() >= compression_threshold;
+        if (compress)
+        {
+          const auto start = std::chrono::steady_clock::now();
+          if (!deflateMessage(&stream, *message, &buffer, &length))
+          {
+            deflateEnd(&stream);
+            return false;
+          }
+          result->cpu_time += std::chrono::steady_clock::now() - start;
+          result->compressed_messages += 1U;
+        }
+
+        result->messages += 1U;
+        result->payload_bytes += message->size();
+        result->wire_bytes += getFrameHeaderSize(length) + length;
+      }
+    }
+  }
+
+  deflateEnd(&stream);
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+  if (argc < 2 || argc > 3)
+  {
+    printf("Usage: %s <replay file> [iterations]\n", argv[0]);
+    return 1;
+  }
+
+  utils::Logger::setLevel("network", "ERROR");
+
+  const std::string filename = argv[1];
+  const auto iterations = argc == 3 ? std::atoi(argv[2]) : 10;
+  if (iterations <= 0)
+  {
+    printf("Invalid number of iterations: %s\n", argv[2]);
+    return 1;
+  }
+
+  Replay replay;
+  if (!replay.load(filename))
+  {
+    printf("Could not load replay file: %s: %s\n", filename.c_str(), replay.getErrorStr().c_str());
+    return 1;
+  }
+
+  std::vector<std::vector<std::uint8_t>> packets;
+  while (replay.getNumberOfPacketsLeft() > 0U)
+  {
+    const auto packet = replay.getNextPacket();
+    packets.emplace_back(packet.getBuffer(), packet.getBuffer() + packet.getLength());
+  }
+
+  printf("Replay: %s, packets: %zu (websocket messages: %zu), iterations: %d\n",
+         filename.c_str(),
+         packets.size(),
+         packets.size() * 2U,
+         iterations);
+  printf("%10s %14s %14s %8s %12s %14s\n", "threshold", "compressed", "wire bytes", "ratio", "cpu time", "ns/compressed");
+
+  // Threshold 0 is compression disabled, used as the baseline
+  std::uint64_t baseline_wire_bytes = 0U;
+  for (const auto threshold : { 0U, 1U, 32U, 64U, 128U, 256U, 512U, 1024U, 4096U })
+  {
+    Result result;
+    if (!runBenchmark(packets, threshold, iterations, &result))
+    {
+      printf("Could not compress packets with threshold: %u\n", threshold);
+      return 1;
+    }
+
+    if (threshold == 0U)
+    {
+      baseline_wire_bytes = result.wire_bytes;
+    }
+
+    const auto cpu_time_us = std::chrono::duration_cast<std::chrono::microseconds>(result.cpu_time).count();
+    printf("%10u %14llu %14llu %8.3f %10lldus %14.1f\n",
+           threshold,
+           static_cast<unsigned long long>(result.compressed_messages),
+           static_cast<unsigned long long>(result.wire_bytes),
+           static_cast<double>(result.wire_bytes) / baseline_wire_bytes,
+           static_cast<long long>(cpu_time_us),
+           result.compressed_messages > 0U ?
+             static_cast<double>(result.cpu_time.count()) / result.compressed_messages : 0.0);
+  }
+
+  return 0;
+}
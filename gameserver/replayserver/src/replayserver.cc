@@ -113,7 +113,7 @@ int main()
   server = network::ServerFactory::createServer(&io_context, server_port, &onClientConnected);
 
   // Create websocket server
-  websocket_server = network::ServerFactory::createWebsocketServer(&io_context, ws_server_port, &onClientConnected);
+  websocket_server = network::ServerFactory::createWebsocketServer(&io_context, ws_server_port, 0U, &onClientConnected);
 
   LOG_INFO("ReplayServer started!");
 
@@ -0,0 +1,303 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef UTILS_EXPORT_SLOT_MAP_H_
+#define UTILS_EXPORT_SLOT_MAP_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace utils
+{
+
+/**
+ * class SlotMap
+ *
+ * Generational slot map, maps keys to values without hashing.
+ *
+ * A key encodes both the slot that holds the value (lower INDEX_BITS bits) and
+ * the generation of that slot (the remaining upper bits). The generation of a slot
+ * is increased each time a value is erased from it, so that keys to erased values
+ * are never valid again, even though the slot itself is reused.
+ *
+ * Slot 0 is never used, so that key 0 can be used as an invalid key.
+ *
+ * Free slots are reused in FIFO order, and only when more than MIN_FREE_INDEXES slots
+ * are free, so that the same key is not handed out again until its slot has been
+ * erased from GENERATION_MASK + 1 times, which takes MIN_FREE_INDEXES times longer
+ * than reusing the most recently freed slot would.
+ *
+ * Slots are allocated in pages of PAGE_SIZE slots and pages are never moved, so
+ * pointers and references to values are valid until the value is erased.
+ *
+ * Keys are either created by the SlotMap (newKey) or by someone else, e.g. when two
+ * SlotMaps should map the same keys. In both cases the key is passed to emplace().
+ */
+template <typename T, typename Key = std::uint32_t, int INDEX_BITS = 20>
+class SlotMap
+{
+  static_assert(std::is_unsigned<Key>::value, "Key must be an unsigned integer type");
+  static_assert(INDEX_BITS > 0 && INDEX_BITS < static_cast<int>(sizeof(Key) * 8), "Invalid INDEX_BITS");
+
+ public:
+  using KeyType = Key;
+
+  static constexpr Key INVALID_KEY = 0U;
+  static constexpr Key INDEX_MASK = (Key(1) << INDEX_BITS) - 1;
+  static constexpr Key GENERATION_MASK = static_cast<Key>(~Key(0)) >> INDEX_BITS;
+  static constexpr std::size_t MIN_FREE_INDEXES = INDEX_MASK / 2U < 1024U ? INDEX_MASK / 2U : 1024U;
+
+  SlotMap() = default;
+
+  // Delete copy constructors
+  SlotMap(const SlotMap&) = delete;
+  SlotMap& operator=(const SlotMap&) = delete;
+
+  // Move is OK
+  SlotMap(SlotMap&&) noexcept = default;
+  SlotMap& operator=(SlotMap&&) noexcept = default;
+
+  static constexpr Key getIndex(Key key) { return key & INDEX_MASK; }
+  static constexpr Key getGeneration(Key key) { return key >> INDEX_BITS; }
+  static constexpr Key makeKey(Key index, Key generation)
+  {
+    return ((generation & GENERATION_MASK) << INDEX_BITS) | (index & INDEX_MASK);
+  }
+
+  // Returns the key that should be used for the next value
+  // The key is not reserved until it has been passed to emplace()
+  Key newKey()
+  {
+    // Slots in the free list might have been taken by emplace() with a key created
+    // outside of this SlotMap, so skip those
+    while (!m_free_indexes.empty() && getSlot(m_free_indexes.front()).value)
+    {
+      getSlot(m_free_indexes.front()).in_free_list = false;
+      m_free_indexes.pop_front();
+    }
+
+    // First slot (index 0) is never used
+    const auto index = m_num_slots == 0U ? Key(1) : static_cast<Key>(m_num_slots);
+    if (m_free_indexes.size() > MIN_FREE_INDEXES || (!m_free_indexes.empty() && index > INDEX_MASK))
+    {
+      const auto free_index = m_free_indexes.front();
+      return makeKey(free_index, getSlot(free_index).generation);
+    }
+
+    if (index > INDEX_MASK)
+    {
+      return INVALID_KEY;
+    }
+    return makeKey(index, 0U);
+  }
+
+  // Constructs the value in the slot that key points to
+  // Returns false if the key is invalid or if the slot is already in use
+  template <typename... Args>
+  bool emplace(Key key, Args&&... args)
+  {
+    const auto index = getIndex(key);
+    if (index == 0U)
+    {
+      return false;
+    }
+
+    // Slots between the current last slot and the new slot are put in the free list
+    while (m_num_slots <= index)
+    {
+      addSlot();
+      if (m_num_slots - 1U != 0U && m_num_slots - 1U != index)
+      {
+        pushFreeIndex(static_cast<Key>(m_num_slots - 1U));
+      }
+    }
+
+    auto& slot = getSlot(index);
+    if (slot.value)
+    {
+      return false;
+    }
+
+    // The slot is taken from the free list if it's next in line, i.e. the key is from newKey()
+    // Otherwise it stays in the free list and is skipped by newKey() while it is in use
+    if (!m_free_indexes.empty() && m_free_indexes.front() == index)
+    {
+      slot.in_free_list = false;
+      m_free_indexes.pop_front();
+    }
+
+    slot.generation = getGeneration(key);
+    slot.value.emplace(std::forward<Args>(args)...);
+    ++m_size;
+    return true;
+  }
+
+  bool erase(Key key)
+  {
+    if (!contains(key))
+    {
+      return false;
+    }
+
+    const auto index = getIndex(key);
+    auto& slot = getSlot(index);
+    slot.value.reset();
+    slot.generation = (slot.generation + 1U) & GENERATION_MASK;
+    pushFreeIndex(index);
+    --m_size;
+    return true;
+  }
+
+  bool contains(Key key) const
+  {
+    const auto index = getIndex(key);
+    if (index == 0U || index >= m_num_slots)
+    {
+      return false;
+    }
+
+    const auto& slot = getSlot(index);
+    return slot.value && slot.generation == getGeneration(key);
+  }
+
+  // Returns nullptr if there is no value with the given key
+  T* get(Key key)
+  {
+    // According to https://stackoverflow.com/a/123995/969365
+    const auto* value = static_cast<const SlotMap*>(this)->get(key);
+    return const_cast<T*>(value);
+  }
+
+  const T* get(Key key) const
+  {
+    return contains(key) ? &(*getSlot(getIndex(key)).value) : nullptr;
+  }
+
+  // Throws std::out_of_range if there is no value with the given key (like std::unordered_map::at)
+  T& at(Key key)
+  {
+    auto* value = get(key);
+    if (!value)
+    {
+      throw std::out_of_range("SlotMap::at: invalid key");
+    }
+    return *value;
+  }
+
+  const T& at(Key key) const
+  {
+    const auto* value = get(key);
+    if (!value)
+    {
+      throw std::out_of_range("SlotMap::at: invalid key");
+    }
+    return *value;
+  }
+
+  std::size_t size() const { return m_size; }
+  bool empty() const { return m_size == 0U; }
+
+  // Number of entries in the free list, never more than the number of slots
+  std::size_t numFreeIndexes() const { return m_free_indexes.size(); }
+
+  // Calls func(key, value) for each value, in slot order
+  template <typename Func>
+  void forEach(Func&& func)
+  {
+    for (auto index = Key(1); index < m_num_slots && m_size > 0U; ++index)
+    {
+      auto& slot = getSlot(index);
+      if (slot.value)
+      {
+        func(makeKey(index, slot.generation), *slot.value);
+      }
+    }
+  }
+
+  template <typename Func>
+  void forEach(Func&& func) const
+  {
+    for (auto index = Key(1); index < m_num_slots && m_size > 0U; ++index)
+    {
+      const auto& slot = getSlot(index);
+      if (slot.value)
+      {
+        func(makeKey(index, slot.generation), *slot.value);
+      }
+    }
+  }
+
+ private:
+  static constexpr std::size_t PAGE_SIZE = 256U;
+
+  struct Slot
+  {
+    Key generation = 0U;
+    bool in_free_list = false;
+    std::optional<T> value;
+  };
+  using Page = std::array<Slot, PAGE_SIZE>;
+
+  Slot& getSlot(Key index) { return (*m_pages[index / PAGE_SIZE])[index % PAGE_SIZE]; }
+  const Slot& getSlot(Key index) const { return (*m_pages[index / PAGE_SIZE])[index % PAGE_SIZE]; }
+
+  // A slot is never in the free list more than once
+  void pushFreeIndex(Key index)
+  {
+    auto& slot = getSlot(index);
+    if (!slot.in_free_list)
+    {
+      slot.in_free_list = true;
+      m_free_indexes.push_back(index);
+    }
+  }
+
+  void addSlot()
+  {
+    if (m_num_slots % PAGE_SIZE == 0U)
+    {
+      m_pages.push_back(std::make_unique<Page>());
+    }
+    ++m_num_slots;
+  }
+
+  std::vector<std::unique_ptr<Page>> m_pages;
+  std::size_t m_num_slots{0};
+  std::size_t m_size{0};
+
+  // Indexes of free slots, the next slot to use is at the front
+  std::deque<Key> m_free_indexes;
+};
+
+}  // namespace utils
+
+#endif  // UTILS_EXPORT_SLOT_MAP_H_
@@ -0,0 +1,107 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef UTILS_EXPORT_TIMER_WHEEL_H_
+#define UTILS_EXPORT_TIMER_WHEEL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "slot_map.h"
+
+namespace utils
+{
+
+/**
+ * class TimerWheel
+ *
+ * Hashed timer wheel for a large number of coarse timers, e.g. one idle timeout per
+ * connection, driven by a single external timer that calls advance() once per tick.
+ *
+ * Adding, resetting and removing a timer is O(1). Resetting a timer to a later deadline,
+ * which is the common case for idle timeouts, only updates the timer: the timer is moved
+ * to the correct slot when its old slot comes up.
+ *
+ * Callbacks are called from advance(), and are allowed to add, reset and remove timers,
+ * but not to call advance().
+ */
+class TimerWheel
+{
+ public:
+  using TimerId = std::uint32_t;
+  using Callback = std::function<void(void)>;
+
+  static constexpr TimerId INVALID_TIMER_ID = 0U;
+
+  explicit TimerWheel(std::size_t num_slots);
+
+  // Delete copy constructors
+  TimerWheel(const TimerWheel&) = delete;
+  TimerWheel& operator=(const TimerWheel&) = delete;
+
+  // Calls callback when advance() has been called ticks more times (at least once)
+  // Returns INVALID_TIMER_ID if there are too many timers
+  TimerId add(std::uint64_t ticks, Callback callback);
+
+  // Changes the deadline of the timer to ticks from now
+  // Returns false if the timer has already expired or been removed
+  bool reset(TimerId timer_id, std::uint64_t ticks);
+
+  // Returns false if the timer has already expired or been removed
+  bool remove(TimerId timer_id);
+
+  // Moves the wheel forward one tick and calls the callbacks of the expired timers
+  void advance();
+
+  std::size_t size() const { return m_timers.size(); }
+  std::uint64_t getNow() const { return m_now; }
+
+ private:
+  struct Timer
+  {
+    std::uint64_t deadline;
+    std::uint64_t slot_deadline;  // The deadline of the latest entry in m_slots
+    Callback callback;
+  };
+
+  // Entries are stale, and skipped, if the timer has been removed or put in another slot
+  struct Entry
+  {
+    TimerId timer_id;
+    std::uint64_t slot_deadline;
+  };
+
+  void insert(TimerId timer_id, Timer* timer, std::uint64_t deadline);
+
+  SlotMap<Timer, TimerId> m_timers;
+  std::vector<std::vector<Entry>> m_slots;
+  std::vector<Entry> m_current_slot;
+  std::uint64_t m_now = 0U;
+};
+
+}  // namespace utils
+
+#endif  // UTILS_EXPORT_TIMER_WHEEL_H_
@@ -0,0 +1,93 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef UTILS_EXPORT_TOKEN_BUCKET_H_
+#define UTILS_EXPORT_TOKEN_BUCKET_H_
+
+#include <algorithm>
+#include <cstdint>
+
+namespace utils
+{
+
+/**
+ * class TokenBucket
+ *
+ * Rate limiter that allows rate events per second on average, and bursts of up to
+ * burst events. The bucket starts full.
+ *
+ * Time is given by the caller in milliseconds, e.g. utils::Tick::now(), so that many
+ * buckets can share a single clock read.
+ *
+ * A bucket with rate 0 is unlimited.
+ */
+class TokenBucket
+{
+ public:
+  TokenBucket() = default;
+
+  TokenBucket(int rate, int burst)
+    : m_rate(std::max(rate, 0)),
+      m_burst(std::max(burst, 1)),
+      m_tokens(m_burst * MS_PER_SECOND)
+  {
+  }
+
+  // Takes a token and returns true, or returns false if the bucket is empty
+  bool consume(std::int64_t now)
+  {
+    if (m_rate == 0)
+    {
+      return true;
+    }
+
+    // Tokens are counted in 1/1000 to avoid floating point, each millisecond adds rate of them
+    if (now > m_last_refill)
+    {
+      m_tokens = std::min(m_tokens + (now - m_last_refill) * m_rate, m_burst * MS_PER_SECOND);
+    }
+    m_last_refill = std::max(now, m_last_refill);
+
+    if (m_tokens < MS_PER_SECOND)
+    {
+      return false;
+    }
+    m_tokens -= MS_PER_SECOND;
+    return true;
+  }
+
+  bool isUnlimited() const { return m_rate == 0; }
+
+ private:
+  static constexpr std::int64_t MS_PER_SECOND = 1000;
+
+  std::int64_t m_rate = 0;
+  std::int64_t m_burst = 1;
+  std::int64_t m_tokens = 0;
+  std::int64_t m_last_refill = 0;
+};
+
+}  // namespace utils
+
+#endif  // UTILS_EXPORT_TOKEN_BUCKET_H_
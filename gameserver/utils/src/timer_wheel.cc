@@ -0,0 +1,122 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "timer_wheel.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace utils
+{
+
+TimerWheel::TimerWheel(std::size_t num_slots)
+  : m_slots(std::max(num_slots, std::size_t(1)))
+{
+}
+
+TimerWheel::TimerId TimerWheel::add(std::uint64_t ticks, Callback callback)
+{
+  const auto timer_id = m_timers.newKey();
+  if (!m_timers.emplace(timer_id, Timer{ 0U, 0U, std::move(callback) }))
+  {
+    return INVALID_TIMER_ID;
+  }
+
+  insert(timer_id, m_timers.get(timer_id), m_now + std::max(ticks, std::uint64_t(1)));
+  return timer_id;
+}
+
+bool TimerWheel::reset(TimerId timer_id, std::uint64_t ticks)
+{
+  auto* timer = m_timers.get(timer_id);
+  if (!timer)
+  {
+    return false;
+  }
+
+  const auto deadline = m_now + std::max(ticks, std::uint64_t(1));
+  if (deadline < timer->slot_deadline)
+  {
+    // The timer would be found too late in its current slot
+    insert(timer_id, timer, deadline);
+  }
+  else
+  {
+    // advance() moves the timer when its current slot comes up
+    timer->deadline = deadline;
+  }
+  return true;
+}
+
+bool TimerWheel::remove(TimerId timer_id)
+{
+  // The entry in m_slots becomes stale
+  return m_timers.erase(timer_id);
+}
+
+void TimerWheel::advance()
+{
+  ++m_now;
+
+  // Callbacks may add entries to this slot, so iterate over a copy
+  auto& slot = m_slots[m_now % m_slots.size()];
+  m_current_slot.swap(slot);
+
+  for (const auto& entry : m_current_slot)
+  {
+    auto* timer = m_timers.get(entry.timer_id);
+    if (!timer || timer->slot_deadline != entry.slot_deadline)
+    {
+      continue;
+    }
+
+    if (entry.slot_deadline > m_now)
+    {
+      // Not this round
+      slot.push_back(entry);
+    }
+    else if (timer->deadline > m_now)
+    {
+      // Timer was reset since it was put in this slot
+      insert(entry.timer_id, timer, timer->deadline);
+    }
+    else
+    {
+      auto callback = std::move(timer->callback);
+      m_timers.erase(entry.timer_id);
+      callback();
+    }
+  }
+
+  m_current_slot.clear();
+}
+
+void TimerWheel::insert(TimerId timer_id, Timer* timer, std::uint64_t deadline)
+{
+  timer->deadline = deadline;
+  timer->slot_deadline = deadline;
+  m_slots[deadline % m_slots.size()].push_back(Entry{ timer_id, deadline });
+}
+
+}  // namespace utils
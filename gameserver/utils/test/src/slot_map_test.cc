@@ -0,0 +1,233 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "slot_map.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace utils
+{
+
+TEST(SlotMapTest, EmplaceAndGet)
+{
+  SlotMap<std::string> slot_map;
+  ASSERT_TRUE(slot_map.empty());
+
+  const auto key_a = slot_map.newKey();
+  ASSERT_NE(SlotMap<std::string>::INVALID_KEY, key_a);
+  ASSERT_TRUE(slot_map.emplace(key_a, "a"));
+
+  const auto key_b = slot_map.newKey();
+  ASSERT_NE(key_a, key_b);
+  ASSERT_TRUE(slot_map.emplace(key_b, "b"));
+
+  ASSERT_EQ(2U, slot_map.size());
+  ASSERT_TRUE(slot_map.contains(key_a));
+  ASSERT_TRUE(slot_map.contains(key_b));
+  ASSERT_EQ("a", *slot_map.get(key_a));
+  ASSERT_EQ("b", slot_map.at(key_b));
+
+  // Slot is already in use
+  ASSERT_FALSE(slot_map.emplace(key_a, "c"));
+
+  // Key 0 is never valid
+  ASSERT_FALSE(slot_map.emplace(SlotMap<std::string>::INVALID_KEY, "c"));
+  ASSERT_FALSE(slot_map.contains(SlotMap<std::string>::INVALID_KEY));
+  ASSERT_EQ(nullptr, slot_map.get(SlotMap<std::string>::INVALID_KEY));
+}
+
+TEST(SlotMapTest, EraseInvalidatesKey)
+{
+  SlotMap<int> slot_map;
+
+  const auto key_a = slot_map.newKey();
+  ASSERT_TRUE(slot_map.emplace(key_a, 1));
+  ASSERT_TRUE(slot_map.erase(key_a));
+  ASSERT_FALSE(slot_map.erase(key_a));
+  ASSERT_FALSE(slot_map.contains(key_a));
+  ASSERT_EQ(nullptr, slot_map.get(key_a));
+  ASSERT_THROW(slot_map.at(key_a), std::out_of_range);
+  ASSERT_TRUE(slot_map.empty());
+
+  // The slot is not reused until more than MIN_FREE_INDEXES slots are free
+  for (auto i = 0U; i < SlotMap<int>::MIN_FREE_INDEXES; i++)
+  {
+    const auto key = slot_map.newKey();
+    ASSERT_NE(SlotMap<int>::getIndex(key_a), SlotMap<int>::getIndex(key));
+    ASSERT_TRUE(slot_map.emplace(key, 0));
+    ASSERT_TRUE(slot_map.erase(key));
+  }
+
+  // Then the slot should be reused, but with a new generation
+  const auto key_b = slot_map.newKey();
+  ASSERT_NE(key_a, key_b);
+  ASSERT_EQ(SlotMap<int>::getIndex(key_a), SlotMap<int>::getIndex(key_b));
+  ASSERT_TRUE(slot_map.emplace(key_b, 2));
+  ASSERT_FALSE(slot_map.contains(key_a));
+  ASSERT_EQ(2, slot_map.at(key_b));
+}
+
+TEST(SlotMapTest, FreeListIsBounded)
+{
+  SlotMap<int> slot_map;
+
+  // Keys from newKey
+  for (auto i = 0; i < 10000; i++)
+  {
+    const auto key = slot_map.newKey();
+    ASSERT_TRUE(slot_map.emplace(key, i));
+    ASSERT_TRUE(slot_map.erase(key));
+    ASSERT_LE(slot_map.numFreeIndexes(), SlotMap<int>::MIN_FREE_INDEXES + 1U);
+  }
+
+  // External keys, e.g. World::m_creature_data, nothing is taken from the free list
+  // by newKey, but a slot is still never in the free list more than once
+  SlotMap<int> external_slot_map;
+  for (auto i = 0U; i < 1000U; i++)
+  {
+    const auto key = SlotMap<int>::makeKey(1U + (i % 2U), i);
+    ASSERT_TRUE(external_slot_map.emplace(key, 0));
+    ASSERT_TRUE(external_slot_map.erase(key));
+    ASSERT_LE(external_slot_map.numFreeIndexes(), 2U);
+  }
+}
+
+TEST(SlotMapTest, KeysAreNotReusedSoon)
+{
+  // E.g. a player logging in and out over and over again
+  SlotMap<int> slot_map;
+  std::vector<SlotMap<int>::KeyType> keys;
+  const auto cycles = (SlotMap<int>::GENERATION_MASK + 1U) * SlotMap<int>::MIN_FREE_INDEXES;
+  for (auto i = 0U; i < cycles; i++)
+  {
+    const auto key = slot_map.newKey();
+    if (i < 16U)
+    {
+      keys.push_back(key);
+    }
+    else
+    {
+      ASSERT_EQ(keys.end(), std::find(keys.begin(), keys.end(), key));
+    }
+    ASSERT_TRUE(slot_map.emplace(key, 0));
+    ASSERT_TRUE(slot_map.erase(key));
+  }
+}
+
+TEST(SlotMapTest, ExternalKeys)
+{
+  SlotMap<int> slot_map;
+
+  // Keys created outside of the SlotMap
+  ASSERT_TRUE(slot_map.emplace(3U, 3));
+  ASSERT_TRUE(slot_map.emplace(1000U, 1000));
+  ASSERT_EQ(2U, slot_map.size());
+  ASSERT_EQ(3, slot_map.at(3U));
+  ASSERT_EQ(1000, slot_map.at(1000U));
+  ASSERT_FALSE(slot_map.contains(2U));
+
+  // newKey should return keys to unused slots
+  for (auto i = 0; i < 100; i++)
+  {
+    const auto key = slot_map.newKey();
+    ASSERT_FALSE(slot_map.contains(key));
+    ASSERT_TRUE(slot_map.emplace(key, i));
+  }
+  ASSERT_EQ(102U, slot_map.size());
+  ASSERT_EQ(3, slot_map.at(3U));
+  ASSERT_EQ(1000, slot_map.at(1000U));
+}
+
+TEST(SlotMapTest, PointerStability)
+{
+  SlotMap<int> slot_map;
+
+  const auto key = slot_map.newKey();
+  ASSERT_TRUE(slot_map.emplace(key, 42));
+  const auto* value = slot_map.get(key);
+
+  // Add a lot of values, which should not move the first value
+  for (auto i = 0; i < 10000; i++)
+  {
+    ASSERT_TRUE(slot_map.emplace(slot_map.newKey(), i));
+  }
+  ASSERT_EQ(value, slot_map.get(key));
+  ASSERT_EQ(42, *value);
+}
+
+TEST(SlotMapTest, ForEach)
+{
+  SlotMap<int> slot_map;
+  std::vector<SlotMap<int>::KeyType> keys;
+  for (auto i = 0; i < 10; i++)
+  {
+    keys.push_back(slot_map.newKey());
+    ASSERT_TRUE(slot_map.emplace(keys.back(), i));
+  }
+  ASSERT_TRUE(slot_map.erase(keys[3]));
+  ASSERT_TRUE(slot_map.erase(keys[7]));
+
+  auto sum = 0;
+  auto count = 0;
+  slot_map.forEach([&sum, &count](SlotMap<int>::KeyType key, int value)
+  {
+    (void)key;
+    sum += value;
+    count += 1;
+  });
+  ASSERT_EQ(8, count);
+  ASSERT_EQ(45 - 3 - 7, sum);
+}
+
+TEST(SlotMapTest, WideKeys)
+{
+  // E.g. ItemManager, with 32 bits each for index and generation
+  using WideSlotMap = SlotMap<int, std::uint64_t, 32>;
+  WideSlotMap slot_map;
+
+  const auto key_a = slot_map.newKey();
+  ASSERT_TRUE(slot_map.emplace(key_a, 1));
+  ASSERT_TRUE(slot_map.erase(key_a));
+  for (auto i = 0U; i < WideSlotMap::MIN_FREE_INDEXES; i++)
+  {
+    const auto key = slot_map.newKey();
+    ASSERT_TRUE(slot_map.emplace(key, 0));
+    ASSERT_TRUE(slot_map.erase(key));
+  }
+
+  const auto key_b = slot_map.newKey();
+  ASSERT_EQ(WideSlotMap::getIndex(key_a), WideSlotMap::getIndex(key_b));
+  ASSERT_EQ(1U, WideSlotMap::getGeneration(key_b));
+  ASSERT_EQ((std::uint64_t(1) << 32) | WideSlotMap::getIndex(key_b), key_b);
+  ASSERT_TRUE(slot_map.emplace(key_b, 2));
+  ASSERT_FALSE(slot_map.contains(key_a));
+  ASSERT_EQ(2, *slot_map.get(key_b));
+}
+
+}  // namespace utils
@@ -0,0 +1,150 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "timer_wheel.h"
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace utils
+{
+
+TEST(TimerWheelTest, Expire)
+{
+  TimerWheel timer_wheel(8U);
+  std::vector<int> expired;
+
+  timer_wheel.add(1U, [&expired]() { expired.push_back(1); });
+  timer_wheel.add(3U, [&expired]() { expired.push_back(3); });
+  ASSERT_EQ(2U, timer_wheel.size());
+
+  timer_wheel.advance();
+  ASSERT_EQ(std::vector<int>({ 1 }), expired);
+  ASSERT_EQ(1U, timer_wheel.size());
+
+  timer_wheel.advance();
+  ASSERT_EQ(std::vector<int>({ 1 }), expired);
+
+  timer_wheel.advance();
+  ASSERT_EQ(std::vector<int>({ 1, 3 }), expired);
+  ASSERT_EQ(0U, timer_wheel.size());
+
+  // A timer always expires on the next advance at the earliest
+  timer_wheel.add(0U, [&expired]() { expired.push_back(0); });
+  timer_wheel.advance();
+  ASSERT_EQ(std::vector<int>({ 1, 3, 0 }), expired);
+}
+
+TEST(TimerWheelTest, MoreTicksThanSlots)
+{
+  TimerWheel timer_wheel(4U);
+  auto expired = false;
+
+  timer_wheel.add(10U, [&expired]() { expired = true; });
+  for (auto i = 0; i < 9; i++)
+  {
+    timer_wheel.advance();
+    ASSERT_FALSE(expired);
+  }
+  timer_wheel.advance();
+  ASSERT_TRUE(expired);
+}
+
+TEST(TimerWheelTest, Reset)
+{
+  TimerWheel timer_wheel(4U);
+  auto expired = 0;
+
+  // Later deadline
+  const auto timer_id = timer_wheel.add(2U, [&expired]() { expired++; });
+  timer_wheel.advance();
+  ASSERT_TRUE(timer_wheel.reset(timer_id, 7U));
+  for (auto i = 0; i < 6; i++)
+  {
+    timer_wheel.advance();
+    ASSERT_EQ(0, expired);
+  }
+  timer_wheel.advance();
+  ASSERT_EQ(1, expired);
+
+  // Can't reset an expired timer
+  ASSERT_FALSE(timer_wheel.reset(timer_id, 1U));
+
+  // Earlier deadline
+  const auto timer_id2 = timer_wheel.add(6U, [&expired]() { expired++; });
+  ASSERT_TRUE(timer_wheel.reset(timer_id2, 1U));
+  timer_wheel.advance();
+  ASSERT_EQ(2, expired);
+  for (auto i = 0; i < 8; i++)
+  {
+    timer_wheel.advance();
+  }
+  ASSERT_EQ(2, expired);
+}
+
+TEST(TimerWheelTest, Remove)
+{
+  TimerWheel timer_wheel(4U);
+  auto expired = false;
+
+  const auto timer_id = timer_wheel.add(1U, [&expired]() { expired = true; });
+  ASSERT_TRUE(timer_wheel.remove(timer_id));
+  ASSERT_FALSE(timer_wheel.remove(timer_id));
+  ASSERT_FALSE(timer_wheel.reset(timer_id, 1U));
+  ASSERT_EQ(0U, timer_wheel.size());
+
+  timer_wheel.advance();
+  ASSERT_FALSE(expired);
+}
+
+TEST(TimerWheelTest, CallbackAddsAndRemovesTimers)
+{
+  TimerWheel timer_wheel(4U);
+  std::vector<int> expired;
+
+  TimerWheel::TimerId timer_id_b = TimerWheel::INVALID_TIMER_ID;
+  timer_wheel.add(1U, [&]()
+  {
+    expired.push_back(1);
+    timer_wheel.remove(timer_id_b);
+    timer_wheel.add(4U, [&expired]() { expired.push_back(2); });
+  });
+  timer_id_b = timer_wheel.add(1U, [&expired]() { expired.push_back(3); });
+
+  timer_wheel.advance();
+  ASSERT_EQ(std::vector<int>({ 1 }), expired);
+
+  for (auto i = 0; i < 3; i++)
+  {
+    timer_wheel.advance();
+  }
+  ASSERT_EQ(std::vector<int>({ 1 }), expired);
+
+  timer_wheel.advance();
+  ASSERT_EQ(std::vector<int>({ 1, 2 }), expired);
+  ASSERT_EQ(0U, timer_wheel.size());
+}
+
+}  // namespace utils
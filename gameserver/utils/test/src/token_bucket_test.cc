@@ -0,0 +1,75 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "token_bucket.h"
+
+#include "gtest/gtest.h"
+
+namespace utils
+{
+
+TEST(TokenBucketTest, Burst)
+{
+  TokenBucket token_bucket(10, 3);
+
+  ASSERT_TRUE(token_bucket.consume(0));
+  ASSERT_TRUE(token_bucket.consume(0));
+  ASSERT_TRUE(token_bucket.consume(0));
+  ASSERT_FALSE(token_bucket.consume(0));
+}
+
+TEST(TokenBucketTest, Refill)
+{
+  TokenBucket token_bucket(10, 2);
+
+  ASSERT_TRUE(token_bucket.consume(1000));
+  ASSERT_TRUE(token_bucket.consume(1000));
+  ASSERT_FALSE(token_bucket.consume(1000));
+
+  // 10 per second is one token per 100ms
+  ASSERT_FALSE(token_bucket.consume(1099));
+  ASSERT_TRUE(token_bucket.consume(1100));
+  ASSERT_FALSE(token_bucket.consume(1100));
+
+  // Never more than burst tokens
+  ASSERT_TRUE(token_bucket.consume(60000));
+  ASSERT_TRUE(token_bucket.consume(60000));
+  ASSERT_FALSE(token_bucket.consume(60000));
+
+  // Time going backwards doesn't add tokens
+  ASSERT_FALSE(token_bucket.consume(50000));
+}
+
+TEST(TokenBucketTest, Unlimited)
+{
+  TokenBucket token_bucket;
+  ASSERT_TRUE(token_bucket.isUnlimited());
+
+  for (auto i = 0; i < 1000; i++)
+  {
+    ASSERT_TRUE(token_bucket.consume(0));
+  }
+}
+
+}  // namespace utils
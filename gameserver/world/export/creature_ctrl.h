@@ -25,13 +25,16 @@
 #ifndef WORLD_EXPORT_CREATURE_CTRL_H_
 #define WORLD_EXPORT_CREATURE_CTRL_H_
 
+#include <cstdint>
 #include <string>
+#include <vector>
+
+#include "position.h"
 
 namespace common
 {
 
 class Creature;
-class Position;
 class Tile;
 class Item;
 
@@ -40,6 +43,15 @@ class Item;
 namespace world
 {
 
+// A move of a single creature, see CreatureCtrl::onCreatureMoves
+struct CreatureMoveEvent
+{
+  const common::Creature* creature;
+  common::Position old_position;
+  std::uint8_t old_stackpos;
+  common::Position new_position;
+};
+
 class CreatureCtrl
 {
  public:
@@ -61,6 +73,19 @@ class CreatureCtrl
                               std::uint8_t old_stackpos,
                               const common::Position& new_position) = 0;
 
+  // Called when one or more creatures have moved in the same batch (see World::creatureMove)
+  // The moves are given in the order they were applied
+  // If this creature moved in the batch then its own move is the last one given, and the moves
+  // before it were visible from the position this creature had before moving
+  // Default implementation calls onCreatureMove for each move
+  virtual void onCreatureMoves(const std::vector<CreatureMoveEvent>& moves)
+  {
+    for (const auto& move : moves)
+    {
+      onCreatureMove(*move.creature, move.old_position, move.old_stackpos, move.new_position);
+    }
+  }
+
   // Called when a creature has turned
   virtual void onCreatureTurn(const common::Creature& creature,
                               const common::Position& position,
@@ -25,6 +25,7 @@
 #ifndef WORLD_EXPORT_TILE_H_
 #define WORLD_EXPORT_TILE_H_
 
+#include <cstdint>
 #include <functional>
 #include <vector>
 
@@ -56,6 +57,10 @@ class Tile
   // Thing management
   void addThing(const common::Thing& thing);
   bool removeThing(int stackpos);
+
+  // Replaces the item at stackpos with the given item, which must stay in the same region
+  // (ground, onTop or other items) as the item it replaces
+  bool replaceItem(int stackpos, const common::Item* item);
   const std::vector<common::Thing>& getThings() const { return m_things; }
   std::size_t getNumberOfThings() const { return m_things.size(); }
 
@@ -64,14 +69,37 @@ class Tile
 
   // Helpers
   bool isBlocking() const;
+
+  // Linear in the number of creatures on this tile, the onTop and other items are skipped
+  // The region offsets are O(1), but finding the creature within its region is not
   int getCreatureStackpos(common::CreatureId creature_id) const;
+  int getNumberOfCreatures() const { return m_num_creatures; }
+
+  // Changed each time an item is added to, removed from or replaced on this tile
+  // Not changed for creatures, so data that depends on the items must not depend on stackpos
+  // Versions are unique across all tiles, so that a version never matches a different tile
+  // Can be used to cache data that depends on the items on this tile, a tile never has version 0
+  std::uint64_t getVersion() const { return m_version; }
 
  private:
+  static std::uint64_t getNextVersion();
+
+  // First stackpos of each region in m_things
+  int getFirstOnTopStackpos() const { return 1; }
+  int getFirstCreatureStackpos() const { return 1 + m_num_on_top; }
+  int getFirstItemStackpos() const { return 1 + m_num_on_top + m_num_creatures; }
+
   // First ground
   // Then onTop items
   // Then creatures
   // Then other items
   std::vector<common::Thing> m_things;
+
+  // Size of the onTop items and creatures regions, updated in addThing and removeThing
+  int m_num_on_top{0};
+  int m_num_creatures{0};
+
+  std::uint64_t m_version{getNextVersion()};
 };
 
 }  // namespace world
@@ -27,7 +27,6 @@
 
 #include <memory>
 #include <string>
-#include <unordered_map>
 #include <vector>
 
 #include "creature.h"
@@ -35,6 +34,7 @@
 #include "item.h"
 #include "tile.h"
 #include "position.h"
+#include "slot_map.h"
 
 namespace world
 {
@@ -54,6 +54,23 @@ enum class ReturnCode
   OTHER_ERROR,
 };
 
+// Used with World::getItemsInRect
+struct TileItem
+{
+  common::Position position;
+  int stackpos;
+  const common::Item* item;
+};
+
+// Used with World::creatureMove to move several creatures at once
+// Note: GameEngine does not batch moves yet, each walk task moves its creature on its own, so
+// this is only used by tests until moves that are due in the same tick are collected
+struct CreatureMove
+{
+  common::CreatureId creature_id;
+  common::Position to_position;
+};
+
 class World
 {
  public:
@@ -72,6 +89,7 @@ class World
   bool creatureExists(common::CreatureId creature_id) const;
   ReturnCode creatureMove(common::CreatureId creature_id, common::Direction direction);
   ReturnCode creatureMove(common::CreatureId creature_id, const common::Position& to_position);
+  void creatureMove(const std::vector<CreatureMove>& moves, std::vector<ReturnCode>* return_codes);
   void creatureTurn(common::CreatureId creature_id, common::Direction direction);
   void creatureSay(common::CreatureId creature_id, const std::string& message);
   const common::Position* getCreaturePosition(common::CreatureId creature_id) const;
@@ -82,6 +100,10 @@ class World
   bool canAddItem(const common::Item& item, const common::Position& position) const;
   ReturnCode addItem(const common::Item& item, const common::Position& position);
   ReturnCode removeItem(common::ItemTypeId item_type_id, int count, const common::Position& position, int stackpos);
+  // Replaces the item at position and stackpos with the given item, e.g. a shared item with
+  // its promoted unique item, see gameengine::ItemManager::promoteTileItem
+  // Creatures that can see the position only get onTileUpdate if the item looks different
+  ReturnCode replaceItem(const common::Item& item, const common::Position& position, int stackpos);
   ReturnCode moveItem(common::CreatureId creature_id,
                       const common::Position& from_position,
                       int from_stackpos,
@@ -92,6 +114,21 @@ class World
   // Tile management
   const Tile* getTile(const common::Position& position) const;
 
+  // Spatial queries
+  // The rectangle is from from_position to to_position, inclusive, on from_position's floor
+  // Results are appended to the given vector, which is never cleared, so that the caller
+  // can reuse the same vector (and its capacity) for many queries
+  void getCreatureIdsInRect(const common::Position& from_position,
+                            const common::Position& to_position,
+                            std::vector<common::CreatureId>* creature_ids) const;
+  void getCreatureIdsInRadius(const common::Position& position,
+                              int radius,
+                              std::vector<common::CreatureId>* creature_ids) const;
+  void getItemsInRect(const common::Position& from_position,
+                      const common::Position& to_position,
+                      common::ItemTypeId item_type_id,
+                      std::vector<TileItem>* items) const;
+
  private:
   // Functions to use instead of accessing the containers directly
   Tile* getTile(const common::Position& position);
@@ -99,6 +136,19 @@ class World
   CreatureCtrl& getCreatureCtrl(common::CreatureId creature_id);
 
   // Helper functions
+  bool clipRect(const common::Position& from_position,
+                const common::Position& to_position,
+                int* x_min,
+                int* y_min,
+                int* x_max,
+                int* y_max) const;
+  const Tile& getTileUnchecked(int x, int y) const
+  {
+    return m_tiles[((x - POSITION_OFFSET) * m_world_size_y) + (y - POSITION_OFFSET)];
+  }
+  ReturnCode applyCreatureMove(common::CreatureId creature_id,
+                               const common::Position& to_position,
+                               CreatureMoveEvent* move_event);
   std::vector<common::CreatureId> getCreatureIdsThatCanSeePosition(const common::Position& position) const;
   int getCreatureStackpos(const common::Position& position, common::CreatureId creature_id) const;
 
@@ -126,7 +176,8 @@ class World
     CreatureCtrl* creature_ctrl;
     common::Position position;
   };
-  std::unordered_map<common::CreatureId, CreatureData> m_creature_data;
+  // CreatureIds are used as keys directly, see utils::SlotMap
+  utils::SlotMap<CreatureData, common::CreatureId> m_creature_data;
 };
 
 }  // namespace world
@@ -33,29 +33,38 @@ namespace world
 
 void Tile::addThing(const common::Thing& thing)
 {
-  // Add the new thing before the first thing with the
-  // same or greater prio than the new thing
-  // 0 = item top
-  // 1 = creature
-  // 2 = item bottom
+  // Add the new thing first in its region, i.e. before all things
+  // with the same or lower prio than the new thing
+  // 1 = item top
+  // 2 = creature
+  // 3 = item bottom
   // TODO(simon): not correct anymore? see wsclient/graphics.cc
-  const auto thing_prio = thing.item() ? (thing.item()->getItemType().is_on_top ? 1 : 3) : 2;
-  auto it = m_things.cbegin() + 1;
-  while (it != m_things.cend())
+  int stackpos;
+  if (thing.hasCreature())
   {
-    const auto it_prio = it->item() ? (it->item()->getItemType().is_on_top ? 1 : 3) : 2;
-    if (it_prio >= thing_prio)
-    {
-      break;
-    }
-    ++it;
+    stackpos = getFirstCreatureStackpos();
+    m_num_creatures += 1;
+  }
+  else if (thing.item()->getItemType().is_on_top)
+  {
+    stackpos = getFirstOnTopStackpos();
+    m_num_on_top += 1;
+  }
+  else
+  {
+    stackpos = getFirstItemStackpos();
+  }
+  m_things.insert(m_things.cbegin() + stackpos, thing);
+
+  if (!thing.hasCreature())
+  {
+    m_version = getNextVersion();
   }
-  m_things.insert(it, thing);
 }
 
 bool Tile::removeThing(int stackpos)
 {
-  if (stackpos == 0 || static_cast<int>(m_things.size()) < stackpos)
+  if (stackpos <= 0 || static_cast<int>(m_things.size()) <= stackpos)
   {
     LOG_ERROR("%s: invalid stackpos: %d with m_things.size(): %d",
               __func__,
@@ -64,10 +73,56 @@ bool Tile::removeThing(int stackpos)
     return false;
   }
 
+  if (stackpos >= getFirstItemStackpos())
+  {
+    // Item bottom, no region to update
+    m_version = getNextVersion();
+  }
+  else if (stackpos >= getFirstCreatureStackpos())
+  {
+    m_num_creatures -= 1;
+  }
+  else
+  {
+    m_num_on_top -= 1;
+    m_version = getNextVersion();
+  }
+
   m_things.erase(m_things.cbegin() + stackpos);
   return true;
 }
 
+bool Tile::replaceItem(int stackpos, const common::Item* item)
+{
+  if (stackpos < 0 || static_cast<int>(m_things.size()) <= stackpos)
+  {
+    LOG_ERROR("%s: invalid stackpos: %d with m_things.size(): %d",
+              __func__,
+              stackpos,
+              m_things.size());
+    return false;
+  }
+
+  const auto* old_item = m_things[stackpos].item();
+  if (!old_item)
+  {
+    LOG_ERROR("%s: thing at stackpos: %d is not an item", __func__, stackpos);
+    return false;
+  }
+
+  if (stackpos > 0 && old_item->getItemType().is_on_top != item->getItemType().is_on_top)
+  {
+    LOG_ERROR("%s: item at stackpos: %d can not be replaced with an item of another region",
+              __func__,
+              stackpos);
+    return false;
+  }
+
+  m_things[stackpos] = item;
+  m_version = getNextVersion();
+  return true;
+}
+
 const common::Creature* Tile::getCreature(int stackpos) const
 {
   if (static_cast<int>(m_things.size()) < stackpos)
@@ -98,13 +153,13 @@ const common::Item* Tile::getItem(int stackpos) const
 
 bool Tile::isBlocking() const
 {
-  for (const auto& thing : m_things)
+  if (m_num_creatures > 0)
   {
-    if (thing.hasCreature())
-    {
-      return true;
-    }
+    return true;
+  }
 
+  for (const auto& thing : m_things)
+  {
     if (thing.item()->getItemType().is_blocking)
     {
       return true;
@@ -113,24 +168,26 @@ bool Tile::isBlocking() const
   return false;
 }
 
+std::uint64_t Tile::getNextVersion()
+{
+  // 0 is reserved, so that a cache entry with version 0 is never valid
+  static std::uint64_t next_version = 1;
+  return next_version++;
+}
+
 int Tile::getCreatureStackpos(common::CreatureId creature_id) const
 {
-  auto it = m_things.cbegin() + 1;
-  while (it != m_things.cend())
+  // Only the creature region needs to be searched, which is usually one creature or a few
+  const auto first = getFirstCreatureStackpos();
+  for (auto stackpos = first; stackpos < first + m_num_creatures; ++stackpos)
   {
-    if (it->creature() && it->creature()->getCreatureId() == creature_id)
+    if (m_things[stackpos].creature()->getCreatureId() == creature_id)
     {
-      break;
+      return stackpos;
     }
-    ++it;
-  }
-
-  if (it == m_things.cend())
-  {
-    return 255;  // TODO(simon): invalid stackpos?
   }
 
-  return std::distance(m_things.cbegin(), it);
+  return 255;  // TODO(simon): invalid stackpos?
 }
 
 }  // namespace world
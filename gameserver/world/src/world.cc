@@ -31,6 +31,7 @@
 #include <random>
 #include <sstream>
 #include <tuple>
+#include <unordered_map>
 #include <utility>
 
 #include "logger.h"
@@ -111,9 +112,7 @@ ReturnCode World::addCreature(common::Creature* creature, CreatureCtrl* creature
     LOG_INFO("%s: spawning creature: %d at position: %s", __func__, creature_id, adjusted_position.toString().c_str());
     tile->addThing(creature);
 
-    m_creature_data.emplace(std::piecewise_construct,
-                           std::forward_as_tuple(creature_id),
-                           std::forward_as_tuple(creature, creature_ctrl, adjusted_position));
+    m_creature_data.emplace(creature_id, creature, creature_ctrl, adjusted_position);
 
     // Tell near creatures that a creature has spawned
     // Including the spawned creature!
@@ -175,7 +174,7 @@ void World::removeCreature(common::CreatureId creature_id)
 
 bool World::creatureExists(common::CreatureId creature_id) const
 {
-  return creature_id != common::Creature::INVALID_ID && m_creature_data.count(creature_id) == 1;
+  return m_creature_data.contains(creature_id);
 }
 
 ReturnCode World::creatureMove(common::CreatureId creature_id, common::Direction direction)
@@ -191,93 +190,14 @@ ReturnCode World::creatureMove(common::CreatureId creature_id, common::Direction
 
 ReturnCode World::creatureMove(common::CreatureId creature_id, const common::Position& to_position)
 {
-  if (!creatureExists(creature_id))
-  {
-    LOG_ERROR("%s: called with non-existent CreatureId", __func__);
-    return ReturnCode::INVALID_CREATURE;
-  }
-
-  auto* to_tile = getTile(to_position);
-  if (!to_tile)
-  {
-    LOG_ERROR("%s: no tile found at to_position: %s", __func__, to_position.toString().c_str());
-    return ReturnCode::INVALID_POSITION;
-  }
-
-  // Get Creature
-  auto* creature = getCreature(creature_id);
-  if (!creature)
-  {
-    LOG_ERROR("%s: invalid creature id: %u", __func__, creature_id);
-    return ReturnCode::INVALID_CREATURE;
-  }
-
-  // Check if Creature may move at this time
-  auto current_tick = utils::Tick::now();
-  if (creature->getNextWalkTick() > current_tick)
-  {
-    LOG_DEBUG("%s: current_tick = %d nextWalkTick = %d => MAY_NOT_MOVE_YET",
-              __func__,
-              current_tick,
-              creature->getNextWalkTick());
-    return ReturnCode::MAY_NOT_MOVE_YET;
-  }
-
-  // Check if to_tile is blocking or not
-  if (to_tile->isBlocking())
-  {
-    LOG_DEBUG("%s: to_tile is blocking", __func__);
-    return ReturnCode::THERE_IS_NO_ROOM;
-  }
-
-  // Move the actual creature
-  const auto* tmp_position = getCreaturePosition(creature_id);
-  if (!tmp_position)
+  CreatureMoveEvent move_event{nullptr, to_position, 0U, to_position};
+  const auto rc = applyCreatureMove(creature_id, to_position, &move_event);
+  if (rc != ReturnCode::OK)
   {
-    LOG_ERROR("%s: invalid position", __func__);
-    return ReturnCode::INVALID_POSITION;
+    return rc;
   }
-  // Copy the old position
-  const auto from_position = *tmp_position;
-  auto* from_tile = getTile(from_position);
-  auto from_stackpos = getCreatureStackpos(from_position, creature_id);
-  from_tile->removeThing(from_stackpos);
 
-  to_tile->addThing(creature);
-  m_creature_data.at(creature_id).position = to_position;
-
-  // Set new nextWalkTime for this Creature
-  auto ground_speed = from_tile->getItem(0)->getItemType().speed;
-  auto creature_speed = creature->getSpeed();
-  auto duration = (1000 * ground_speed) / creature_speed;
-
-  // Walking diagonally?
-  if (from_position.getX() != to_position.getX() &&
-      from_position.getY() != to_position.getY())
-  {
-    // Or is it times 3?
-    duration *= 2;
-  }
-
-  creature->setNextWalkTick(current_tick + duration);
-
-  // Update direction
-  if (from_position.getY() > to_position.getY())
-  {
-    creature->setDirection(common::Direction::NORTH);
-  }
-  else if (from_position.getY() < to_position.getY())
-  {
-    creature->setDirection(common::Direction::SOUTH);
-  }
-  if (from_position.getX() > to_position.getX())
-  {
-    creature->setDirection(common::Direction::WEST);
-  }
-  else if (from_position.getX() < to_position.getX())
-  {
-    creature->setDirection(common::Direction::EAST);
-  }
+  const auto& from_position = move_event.old_position;
 
   // Call onCreatureMove on all creatures that can see the movement
   // including the moving creature itself
@@ -306,11 +226,11 @@ ReturnCode World::creatureMove(common::CreatureId creature_id, const common::Pos
       {
         if (thing.hasCreature())
         {
-          const auto creature_id = thing.creature()->getCreatureId();
-          getCreatureCtrl(creature_id).onCreatureMove(*creature,
-                                                      from_position,
-                                                      from_stackpos,
-                                                      to_position);
+          const auto near_creature_id = thing.creature()->getCreatureId();
+          getCreatureCtrl(near_creature_id).onCreatureMove(*move_event.creature,
+                                                           from_position,
+                                                           move_event.old_stackpos,
+                                                           to_position);
         }
       }
     }
@@ -318,7 +238,7 @@ ReturnCode World::creatureMove(common::CreatureId creature_id, const common::Pos
 
   // The client can only show ground + 9 Items/Creatures, so if the number of things on the from_tile
   // is >= 10 then some items on the tile is unknown to the client, so update the Tile for each nearby Creature
-  if (from_tile->getNumberOfThings() >= 10)
+  if (getTile(from_position)->getNumberOfThings() >= 10)
   {
     auto near_creature_ids = getCreatureIdsThatCanSeePosition(from_position);
     for (const auto& near_creature_id : near_creature_ids)
@@ -330,6 +250,122 @@ ReturnCode World::creatureMove(common::CreatureId creature_id, const common::Pos
   return ReturnCode::OK;
 }
 
+void World::creatureMove(const std::vector<CreatureMove>& moves, std::vector<ReturnCode>* return_codes)
+{
+  return_codes->clear();
+  return_codes->reserve(moves.size());
+
+  // Apply the moves in the given order and collect, per viewer, the moves it can see from the
+  // position it has at the time of each move
+  // A viewer that moves itself is notified right after its own move has been applied, so that
+  // its CreatureCtrl sees the world as it was at that moment (e.g. when sending new map data),
+  // remaining viewers are notified once after all moves have been applied
+  std::vector<CreatureMoveEvent> move_events;
+  move_events.reserve(moves.size());
+  std::unordered_map<common::CreatureId, std::vector<std::size_t>> viewers;  // creature id -> indexes in move_events
+  std::vector<common::CreatureId> viewer_order;  // in the order they first saw a move, to notify them in that order
+  std::vector<CreatureMoveEvent> viewer_move_events;
+  const auto notify_viewer = [this, &move_events, &viewer_move_events](common::CreatureId viewer_id,
+                                                                        const std::vector<std::size_t>& indexes)
+  {
+    viewer_move_events.clear();
+    for (const auto index : indexes)
+    {
+      viewer_move_events.push_back(move_events[index]);
+    }
+    getCreatureCtrl(viewer_id).onCreatureMoves(viewer_move_events);
+  };
+
+  for (const auto& move : moves)
+  {
+    CreatureMoveEvent move_event{nullptr, move.to_position, 0U, move.to_position};
+    const auto rc = applyCreatureMove(move.creature_id, move.to_position, &move_event);
+    return_codes->push_back(rc);
+    if (rc != ReturnCode::OK)
+    {
+      continue;
+    }
+    move_events.push_back(move_event);
+    const auto index = move_events.size() - 1U;
+
+    // Find all creatures that can see this move, see creatureMove above for the constants
+    const auto& from_position = move_event.old_position;
+    const auto& to_position = move_event.new_position;
+    const auto x_min = std::min(from_position.getX(), to_position.getX());
+    const auto x_max = std::max(from_position.getX(), to_position.getX());
+    const auto y_min = std::min(from_position.getY(), to_position.getY());
+    const auto y_max = std::max(from_position.getY(), to_position.getY());
+    for (auto x = x_min - 9; x <= x_max + 8; x++)
+    {
+      for (auto y = y_min - 7; y <= y_max + 6; y++)
+      {
+        const auto* tile = getTile(common::Position(x, y, 7));
+        if (!tile)
+        {
+          continue;
+        }
+
+        for (const auto& thing : tile->getThings())
+        {
+          if (thing.hasCreature())
+          {
+            const auto viewer_id = thing.creature()->getCreatureId();
+            const auto [it, inserted] = viewers.try_emplace(viewer_id);
+            if (inserted)
+            {
+              viewer_order.push_back(viewer_id);
+            }
+            it->second.push_back(index);
+          }
+        }
+      }
+    }
+
+    // The moving creature always sees its own move, flush it now
+    const auto it = viewers.find(move.creature_id);
+    if (it != viewers.end())
+    {
+      notify_viewer(it->first, it->second);
+      viewers.erase(it);
+    }
+  }
+
+  // A viewer that has been notified already is no longer in viewers, and a viewer that has been
+  // added again after that is in viewer_order twice, so erase each viewer once it has been notified
+  for (const auto viewer_id : viewer_order)
+  {
+    const auto it = viewers.find(viewer_id);
+    if (it != viewers.end())
+    {
+      notify_viewer(it->first, it->second);
+      viewers.erase(it);
+    }
+  }
+
+  // See creatureMove above
+  std::vector<common::Position> tile_update_positions;
+  for (const auto& move_event : move_events)
+  {
+    const auto& position = move_event.old_position;
+    if (getTile(position)->getNumberOfThings() >= 10 &&
+        std::find(tile_update_positions.cbegin(),
+                  tile_update_positions.cend(),
+                  position) == tile_update_positions.cend())
+    {
+      tile_update_positions.push_back(position);
+    }
+  }
+
+  for (const auto& position : tile_update_positions)
+  {
+    auto near_creature_ids = getCreatureIdsThatCanSeePosition(position);
+    for (const auto& near_creature_id : near_creature_ids)
+    {
+      getCreatureCtrl(near_creature_id).onTileUpdate(position);
+    }
+  }
+}
+
 void World::creatureTurn(common::CreatureId creature_id, common::Direction direction)
 {
   if (!creatureExists(creature_id))
@@ -344,6 +380,12 @@ void World::creatureTurn(common::CreatureId creature_id, common::Direction direc
     LOG_ERROR("%s: invalid creature id: %u", __func__, creature_id);
     return;
   }
+
+  // Clients repeat turns while the key is held down, skip those that would not change anything
+  if (creature->getDirection() == direction)
+  {
+    return;
+  }
   creature->setDirection(direction);
 
   // Call onCreatureTurn on all creatures that can see the turn
@@ -391,12 +433,13 @@ void World::creatureSay(common::CreatureId creature_id, const std::string& messa
 
 const common::Position* World::getCreaturePosition(common::CreatureId creature_id) const
 {
-  if (!creatureExists(creature_id))
+  const auto* creature_data = m_creature_data.get(creature_id);
+  if (!creature_data)
   {
     LOG_ERROR("getCreaturePosition called with non-existent CreatureId");
     return nullptr;
   }
-  return &(m_creature_data.at(creature_id).position);
+  return &(creature_data->position);
 }
 
 bool World::creatureCanThrowTo(common::CreatureId creature_id, const common::Position& position) const
@@ -504,6 +547,42 @@ ReturnCode World::removeItem(common::ItemTypeId item_type_id, int count, const c
   return ReturnCode::OK;
 }
 
+ReturnCode World::replaceItem(const common::Item& item, const common::Position& position, int stackpos)
+{
+  auto* tile = getTile(position);
+  if (!tile)
+  {
+    LOG_ERROR("%s: no tile found at position: %s", __func__, position.toString().c_str());
+    return ReturnCode::INVALID_POSITION;
+  }
+
+  const auto num_things = static_cast<int>(tile->getNumberOfThings());
+  const auto* old_item = (stackpos >= 0 && stackpos < num_things) ? tile->getItem(stackpos) : nullptr;
+  if (!old_item)
+  {
+    LOG_ERROR("%s: no item at stackpos: %d at position: %s", __func__, stackpos, position.toString().c_str());
+    return ReturnCode::ITEM_NOT_FOUND;
+  }
+  const auto looks_same = old_item->getItemTypeId() == item.getItemTypeId() &&
+                          old_item->getCount() == item.getCount();
+
+  if (!tile->replaceItem(stackpos, &item))
+  {
+    return ReturnCode::OTHER_ERROR;
+  }
+
+  if (!looks_same)
+  {
+    const auto near_creature_ids = getCreatureIdsThatCanSeePosition(position);
+    for (const auto& near_creature_id : near_creature_ids)
+    {
+      getCreatureCtrl(near_creature_id).onTileUpdate(position);
+    }
+  }
+
+  return ReturnCode::OK;
+}
+
 ReturnCode World::moveItem(common::CreatureId creature_id,
                                   const common::Position& from_position,
                                   int from_stackpos,
@@ -636,48 +715,255 @@ Tile* World::getTile(const common::Position& position)
 
 common::Creature* World::getCreature(common::CreatureId creature_id)
 {
-  if (!creatureExists(creature_id))
+  auto* creature_data = m_creature_data.get(creature_id);
+  if (!creature_data)
   {
     LOG_ERROR("%s: called with non-existent CreatureId: %d", __func__, creature_id);
     return nullptr;
   }
-  return m_creature_data.at(creature_id).creature;
+  return creature_data->creature;
 }
 
 CreatureCtrl& World::getCreatureCtrl(common::CreatureId creature_id)
 {
-  if (!creatureExists(creature_id))
+  auto* creature_data = m_creature_data.get(creature_id);
+  if (!creature_data)
   {
     LOG_ERROR("getCreatureCtrl called with non-existent CreatureId");
+
+    // Throws std::out_of_range
+    return *(m_creature_data.at(creature_id).creature_ctrl);
   }
-  return *(m_creature_data.at(creature_id).creature_ctrl);
+  return *(creature_data->creature_ctrl);
 }
 
-std::vector<common::CreatureId> World::getCreatureIdsThatCanSeePosition(const common::Position& position) const
+ReturnCode World::applyCreatureMove(common::CreatureId creature_id,
+                                    const common::Position& to_position,
+                                    CreatureMoveEvent* move_event)
 {
-  std::vector<common::CreatureId> creature_ids;
+  auto* creature_data = m_creature_data.get(creature_id);
+  if (!creature_data)
+  {
+    LOG_ERROR("%s: called with non-existent CreatureId", __func__);
+    return ReturnCode::INVALID_CREATURE;
+  }
 
-  // TODO(simon): fix these constants (see creatureMove)
-  for (int x = position.getX() - 9; x <= position.getX() + 8; ++x)
+  auto* to_tile = getTile(to_position);
+  if (!to_tile)
+  {
+    LOG_ERROR("%s: no tile found at to_position: %s", __func__, to_position.toString().c_str());
+    return ReturnCode::INVALID_POSITION;
+  }
+
+  // Get Creature
+  auto* creature = creature_data->creature;
+
+  // Check if Creature may move at this time
+  auto current_tick = utils::Tick::now();
+  if (creature->getNextWalkTick() > current_tick)
+  {
+    LOG_DEBUG("%s: current_tick = %d nextWalkTick = %d => MAY_NOT_MOVE_YET",
+              __func__,
+              current_tick,
+              creature->getNextWalkTick());
+    return ReturnCode::MAY_NOT_MOVE_YET;
+  }
+
+  // Check if to_tile is blocking or not
+  if (to_tile->isBlocking())
+  {
+    LOG_DEBUG("%s: to_tile is blocking", __func__);
+    return ReturnCode::THERE_IS_NO_ROOM;
+  }
+
+  // Move the actual creature
+  // Copy the old position
+  const auto from_position = creature_data->position;
+  auto* from_tile = getTile(from_position);
+  auto from_stackpos = getCreatureStackpos(from_position, creature_id);
+  from_tile->removeThing(from_stackpos);
+
+  to_tile->addThing(creature);
+  creature_data->position = to_position;
+
+  // Set new nextWalkTime for this Creature
+  auto ground_speed = from_tile->getItem(0)->getItemType().speed;
+  auto creature_speed = creature->getSpeed();
+  auto duration = (1000 * ground_speed) / creature_speed;
+
+  // Walking diagonally?
+  if (from_position.getX() != to_position.getX() &&
+      from_position.getY() != to_position.getY())
+  {
+    // Or is it times 3?
+    duration *= 2;
+  }
+
+  creature->setNextWalkTick(current_tick + duration);
+
+  // Update direction
+  if (from_position.getY() > to_position.getY())
+  {
+    creature->setDirection(common::Direction::NORTH);
+  }
+  else if (from_position.getY() < to_position.getY())
+  {
+    creature->setDirection(common::Direction::SOUTH);
+  }
+  if (from_position.getX() > to_position.getX())
+  {
+    creature->setDirection(common::Direction::WEST);
+  }
+  else if (from_position.getX() < to_position.getX())
+  {
+    creature->setDirection(common::Direction::EAST);
+  }
+
+  move_event->creature = creature;
+  move_event->old_position = from_position;
+  move_event->old_stackpos = from_stackpos;
+  move_event->new_position = to_position;
+
+  return ReturnCode::OK;
+}
+
+void World::getCreatureIdsInRect(const common::Position& from_position,
+                                 const common::Position& to_position,
+                                 std::vector<common::CreatureId>* creature_ids) const
+{
+  int x_min, y_min, x_max, y_max;
+  if (!clipRect(from_position, to_position, &x_min, &y_min, &x_max, &y_max))
+  {
+    return;
+  }
+
+  for (auto x = x_min; x <= x_max; x++)
   {
-    for (int y = position.getY() - 7; y <= position.getY() + 6; ++y)
+    for (auto y = y_min; y <= y_max; y++)
     {
-      const auto* tile = getTile(common::Position(x, y, position.getZ()));
-      if (!tile)
+      const auto& tile = getTileUnchecked(x, y);
+      if (tile.getNumberOfCreatures() == 0)
       {
         continue;
       }
 
-      for (const auto& thing : tile->getThings())
+      for (const auto& thing : tile.getThings())
       {
         if (thing.hasCreature())
         {
-          creature_ids.push_back(thing.creature()->getCreatureId());
+          creature_ids->push_back(thing.creature()->getCreatureId());
         }
       }
     }
   }
+}
+
+void World::getCreatureIdsInRadius(const common::Position& position,
+                                   int radius,
+                                   std::vector<common::CreatureId>* creature_ids) const
+{
+  // Check all tiles in the bounding square, but only the ones with a distance
+  // (euclidean) from position that is less than or equal to radius
+  int x_min, y_min, x_max, y_max;
+  if (radius < 0 ||
+      !clipRect(common::Position(std::max(position.getX() - radius, 0),
+                                 std::max(position.getY() - radius, 0),
+                                 position.getZ()),
+                common::Position(std::min(position.getX() + radius, 0xFFFF),
+                                 std::min(position.getY() + radius, 0xFFFF),
+                                 position.getZ()),
+                &x_min,
+                &y_min,
+                &x_max,
+                &y_max))
+  {
+    return;
+  }
+
+  for (auto x = x_min; x <= x_max; x++)
+  {
+    const auto dx = x - position.getX();
+    for (auto y = y_min; y <= y_max; y++)
+    {
+      const auto dy = y - position.getY();
+      if ((dx * dx) + (dy * dy) > radius * radius)
+      {
+        continue;
+      }
+
+      const auto& tile = getTileUnchecked(x, y);
+      if (tile.getNumberOfCreatures() == 0)
+      {
+        continue;
+      }
 
+      for (const auto& thing : tile.getThings())
+      {
+        if (thing.hasCreature())
+        {
+          creature_ids->push_back(thing.creature()->getCreatureId());
+        }
+      }
+    }
+  }
+}
+
+void World::getItemsInRect(const common::Position& from_position,
+                           const common::Position& to_position,
+                           common::ItemTypeId item_type_id,
+                           std::vector<TileItem>* items) const
+{
+  int x_min, y_min, x_max, y_max;
+  if (!clipRect(from_position, to_position, &x_min, &y_min, &x_max, &y_max))
+  {
+    return;
+  }
+
+  for (auto x = x_min; x <= x_max; x++)
+  {
+    for (auto y = y_min; y <= y_max; y++)
+    {
+      const auto& things = getTileUnchecked(x, y).getThings();
+      for (auto stackpos = 0; stackpos < static_cast<int>(things.size()); stackpos++)
+      {
+        const auto* item = things[stackpos].item();
+        if (item && item->getItemTypeId() == item_type_id)
+        {
+          items->push_back({ common::Position(x, y, from_position.getZ()), stackpos, item });
+        }
+      }
+    }
+  }
+}
+
+bool World::clipRect(const common::Position& from_position,
+                     const common::Position& to_position,
+                     int* x_min,
+                     int* y_min,
+                     int* x_max,
+                     int* y_max) const
+{
+  // No z axis yet
+  if (from_position.getZ() != 7)
+  {
+    return false;
+  }
+
+  *x_min = std::max<int>(from_position.getX(), POSITION_OFFSET);
+  *y_min = std::max<int>(from_position.getY(), POSITION_OFFSET);
+  *x_max = std::min<int>(to_position.getX(), POSITION_OFFSET + m_world_size_x - 1);
+  *y_max = std::min<int>(to_position.getY(), POSITION_OFFSET + m_world_size_y - 1);
+  return *x_min <= *x_max && *y_min <= *y_max;
+}
+
+std::vector<common::CreatureId> World::getCreatureIdsThatCanSeePosition(const common::Position& position) const
+{
+  std::vector<common::CreatureId> creature_ids;
+
+  // TODO(simon): fix these constants (see creatureMove)
+  getCreatureIdsInRect(common::Position(position.getX() - 9, position.getY() - 7, position.getZ()),
+                       common::Position(position.getX() + 8, position.getY() + 6, position.getZ()),
+                       &creature_ids);
   return creature_ids;
 }
 
@@ -134,4 +134,104 @@ TEST_F(TileTest, AddRemoveItems)
   ASSERT_EQ(tile.getNumberOfThings(), 1u + 0u);
 }
 
+TEST_F(TileTest, CreatureStackpos)
+{
+  common::ItemType groundItemType;
+  ItemMock groundItem;
+  auto tile = Tile(&groundItem);
+
+  common::ItemType itemTypeOnTop;
+  itemTypeOnTop.is_on_top = true;
+  ItemMock itemOnTop;
+  EXPECT_CALL(itemOnTop, getItemType()).WillRepeatedly(ReturnRef(itemTypeOnTop));
+
+  common::ItemType itemTypeBottom;
+  ItemMock itemBottom;
+  EXPECT_CALL(itemBottom, getItemType()).WillRepeatedly(ReturnRef(itemTypeBottom));
+
+  CreatureMock creatureA(1);
+  CreatureMock creatureB(2);
+
+  // Add things in an order that does not match the order on the tile
+  tile.addThing(&itemBottom);
+  tile.addThing(&creatureA);
+  tile.addThing(&itemOnTop);
+  tile.addThing(&creatureB);
+  ASSERT_EQ(1u + 4u, tile.getNumberOfThings());
+  ASSERT_EQ(2, tile.getNumberOfCreatures());
+
+  // Ground, onTop item, creatureB, creatureA, bottom item
+  ASSERT_EQ(&itemOnTop, tile.getItem(1));
+  ASSERT_EQ(2, tile.getCreatureStackpos(2));
+  ASSERT_EQ(3, tile.getCreatureStackpos(1));
+  ASSERT_EQ(&itemBottom, tile.getItem(4));
+  ASSERT_EQ(255, tile.getCreatureStackpos(3));
+
+  // Remove the onTop item, creatures should move down one stackpos
+  ASSERT_TRUE(tile.removeThing(1));
+  ASSERT_EQ(1, tile.getCreatureStackpos(2));
+  ASSERT_EQ(2, tile.getCreatureStackpos(1));
+
+  // Remove creatureB
+  ASSERT_TRUE(tile.removeThing(1));
+  ASSERT_EQ(1, tile.getNumberOfCreatures());
+  ASSERT_EQ(1, tile.getCreatureStackpos(1));
+  ASSERT_EQ(255, tile.getCreatureStackpos(2));
+
+  // Invalid stackpos
+  ASSERT_FALSE(tile.removeThing(0));
+  ASSERT_FALSE(tile.removeThing(3));
+  ASSERT_EQ(1u + 2u, tile.getNumberOfThings());
+}
+
+TEST_F(TileTest, Version)
+{
+  ItemMock groundItem;
+  auto tileA = Tile(&groundItem);
+  auto tileB = Tile(&groundItem);
+
+  // Versions are unique across tiles
+  ASSERT_NE(tileA.getVersion(), tileB.getVersion());
+
+  // No tile has version 0
+  ASSERT_NE(0U, tileA.getVersion());
+  ASSERT_NE(0U, tileB.getVersion());
+
+  common::ItemType itemType;
+  ItemMock item;
+  EXPECT_CALL(item, getItemType()).WillRepeatedly(ReturnRef(itemType));
+  CreatureMock creature(1);
+
+  // Adding or removing items changes the version
+  auto version = tileA.getVersion();
+  tileA.addThing(&item);
+  ASSERT_NE(version, tileA.getVersion());
+
+  // But not creatures, even though they change the stackpos of the items after them, as data
+  // cached by version must be indexed by item and not by stackpos
+  version = tileA.getVersion();
+  tileA.addThing(&creature);
+  ASSERT_EQ(version, tileA.getVersion());
+  ASSERT_EQ(nullptr, tileA.getItem(1));
+  ASSERT_EQ(&item, tileA.getItem(2));
+  ASSERT_TRUE(tileA.removeThing(1));
+  ASSERT_EQ(version, tileA.getVersion());
+  ASSERT_EQ(&item, tileA.getItem(1));
+
+  ASSERT_TRUE(tileA.removeThing(1));
+  ASSERT_NE(version, tileA.getVersion());
+
+  // Replacing an item changes the version, replacing a creature is not possible
+  version = tileA.getVersion();
+  ASSERT_TRUE(tileA.replaceItem(0, &item));
+  ASSERT_EQ(&item, tileA.getItem(0));
+  ASSERT_NE(version, tileA.getVersion());
+
+  version = tileA.getVersion();
+  tileA.addThing(&creature);
+  ASSERT_FALSE(tileA.replaceItem(1, &item));
+  ASSERT_FALSE(tileA.replaceItem(2, &item));
+  ASSERT_EQ(version, tileA.getVersion());
+}
+
 }  // namespace world
@@ -24,6 +24,7 @@
 
 #include <memory>
 #include <unordered_map>
+#include <vector>
 
 #include "gtest/gtest.h"
 #include "gmock/gmock.h"
@@ -39,8 +40,10 @@
 namespace world
 {
 
+using ::testing::Return;
 using ::testing::ReturnRef;
 using ::testing::AtLeast;
+using ::testing::InSequence;
 using ::testing::_;
 
 class WorldTest : public ::testing::Test
@@ -225,4 +228,267 @@ TEST_F(WorldTest, CreatureMoveSingleCreature)
   EXPECT_EQ(position, *(cworld->getCreaturePosition(creatureOne.getCreatureId())));
 }
 
+TEST_F(WorldTest, CreatureTurn)
+{
+  common::Creature creatureOne(1U, "TestCreatureOne");
+  MockCreatureCtrl creatureCtrlOne;
+  common::Position creaturePositionOne(192, 192, 7);
+  EXPECT_CALL(creatureCtrlOne, onCreatureSpawn(_, _));
+  world->addCreature(&creatureOne, &creatureCtrlOne, creaturePositionOne);
+
+  EXPECT_CALL(creatureCtrlOne, onCreatureTurn(_, creaturePositionOne, _));
+  world->creatureTurn(creatureOne.getCreatureId(), common::Direction::NORTH);
+  EXPECT_EQ(common::Direction::NORTH, creatureOne.getDirection());
+
+  // Repeated turns to the same direction are not sent to anyone
+  EXPECT_CALL(creatureCtrlOne, onCreatureTurn(_, _, _)).Times(0);
+  world->creatureTurn(creatureOne.getCreatureId(), common::Direction::NORTH);
+}
+
+TEST_F(WorldTest, CreatureMoveBatch)
+{
+  // creatureOne and creatureTwo can see each other, creatureThree cannot see anyone
+  common::Creature creatureOne(1U, "TestCreatureOne");
+  common::Creature creatureTwo(2U, "TestCreatureTwo");
+  common::Creature creatureThree(3U, "TestCreatureThree");
+
+  MockCreatureCtrl creatureCtrlOne;
+  MockCreatureCtrl creatureCtrlTwo;
+  MockCreatureCtrl creatureCtrlThree;
+
+  common::Position creaturePositionOne(192, 192, 7);
+  common::Position creaturePositionTwo(193, 193, 7);
+  common::Position creaturePositionThree(202, 193, 7);
+
+  EXPECT_CALL(creatureCtrlOne, onCreatureSpawn(_, _)).Times(2);
+  EXPECT_CALL(creatureCtrlTwo, onCreatureSpawn(_, _)).Times(2);
+  EXPECT_CALL(creatureCtrlThree, onCreatureSpawn(_, _)).Times(1);
+  world->addCreature(&creatureOne, &creatureCtrlOne, creaturePositionOne);
+  world->addCreature(&creatureTwo, &creatureCtrlTwo, creaturePositionTwo);
+  world->addCreature(&creatureThree, &creatureCtrlThree, creaturePositionThree);
+
+  // Move creatureOne and creatureTwo south, and a non-existent creature
+  const std::vector<CreatureMove> moves
+  {
+    { creatureOne.getCreatureId(), common::Position(192, 193, 7) },
+    { creatureTwo.getCreatureId(), common::Position(193, 194, 7) },
+    { 4U, common::Position(194, 194, 7) },
+  };
+
+  EXPECT_CALL(creatureCtrlOne, onCreatureMove(creatureOne, creaturePositionOne, _, moves[0].to_position));
+  EXPECT_CALL(creatureCtrlOne, onCreatureMove(creatureTwo, creaturePositionTwo, _, moves[1].to_position));
+  EXPECT_CALL(creatureCtrlTwo, onCreatureMove(creatureOne, creaturePositionOne, _, moves[0].to_position));
+  EXPECT_CALL(creatureCtrlTwo, onCreatureMove(creatureTwo, creaturePositionTwo, _, moves[1].to_position));
+  EXPECT_CALL(creatureCtrlThree, onCreatureMove(_, _, _, _)).Times(0);
+
+  std::vector<ReturnCode> return_codes;
+  world->creatureMove(moves, &return_codes);
+
+  ASSERT_EQ(3U, return_codes.size());
+  EXPECT_EQ(ReturnCode::OK, return_codes[0]);
+  EXPECT_EQ(ReturnCode::OK, return_codes[1]);
+  EXPECT_EQ(ReturnCode::INVALID_CREATURE, return_codes[2]);
+  EXPECT_EQ(moves[0].to_position, *(cworld->getCreaturePosition(creatureOne.getCreatureId())));
+  EXPECT_EQ(moves[1].to_position, *(cworld->getCreaturePosition(creatureTwo.getCreatureId())));
+}
+
+TEST_F(WorldTest, CreatureMoveBatchViewerMoves)
+{
+  // creatureOne can see creatureTwo but not creatureThree, until creatureOne has moved east
+  common::Creature creatureOne(1U, "TestCreatureOne");
+  common::Creature creatureTwo(2U, "TestCreatureTwo");
+  common::Creature creatureThree(3U, "TestCreatureThree");
+
+  MockCreatureCtrl creatureCtrlOne;
+  MockCreatureCtrl creatureCtrlTwo;
+  MockCreatureCtrl creatureCtrlThree;
+
+  common::Position creaturePositionOne(196, 193, 7);
+  common::Position creaturePositionTwo(194, 193, 7);
+  common::Position creaturePositionThree(206, 194, 7);
+
+  EXPECT_CALL(creatureCtrlOne, onCreatureSpawn(_, _)).Times(2);
+  EXPECT_CALL(creatureCtrlTwo, onCreatureSpawn(_, _)).Times(1);
+  EXPECT_CALL(creatureCtrlThree, onCreatureSpawn(_, _)).Times(1);
+  world->addCreature(&creatureOne, &creatureCtrlOne, creaturePositionOne);
+  world->addCreature(&creatureTwo, &creatureCtrlTwo, creaturePositionTwo);
+  world->addCreature(&creatureThree, &creatureCtrlThree, creaturePositionThree);
+
+  // creatureThree moves while creatureOne can't see it, and creatureOne moves last
+  const std::vector<CreatureMove> moves
+  {
+    { creatureTwo.getCreatureId(), common::Position(194, 194, 7) },
+    { creatureThree.getCreatureId(), common::Position(207, 194, 7) },
+    { creatureOne.getCreatureId(), common::Position(197, 193, 7) },
+  };
+
+  {
+    InSequence sequence;
+    EXPECT_CALL(creatureCtrlOne, onCreatureMove(creatureTwo, creaturePositionTwo, _, moves[0].to_position));
+    EXPECT_CALL(creatureCtrlOne, onCreatureMove(creatureOne, creaturePositionOne, _, moves[2].to_position));
+  }
+  EXPECT_CALL(creatureCtrlOne, onCreatureMove(creatureThree, _, _, _)).Times(0);
+  EXPECT_CALL(creatureCtrlTwo, onCreatureMove(creatureTwo, creaturePositionTwo, _, moves[0].to_position));
+  EXPECT_CALL(creatureCtrlTwo, onCreatureMove(creatureOne, creaturePositionOne, _, moves[2].to_position));
+  EXPECT_CALL(creatureCtrlTwo, onCreatureMove(creatureThree, _, _, _)).Times(0);
+  EXPECT_CALL(creatureCtrlThree, onCreatureMove(creatureThree, creaturePositionThree, _, moves[1].to_position));
+  EXPECT_CALL(creatureCtrlThree, onCreatureMove(creatureOne, _, _, _)).Times(0);
+  EXPECT_CALL(creatureCtrlThree, onCreatureMove(creatureTwo, _, _, _)).Times(0);
+
+  std::vector<ReturnCode> return_codes;
+  world->creatureMove(moves, &return_codes);
+
+  ASSERT_EQ(3U, return_codes.size());
+  EXPECT_EQ(ReturnCode::OK, return_codes[0]);
+  EXPECT_EQ(ReturnCode::OK, return_codes[1]);
+  EXPECT_EQ(ReturnCode::OK, return_codes[2]);
+}
+
+TEST_F(WorldTest, CreatureMoveBatchViewerOrder)
+{
+  // creatureOne moves near viewerTwo and creatureThree moves near viewerFour, viewers that did not
+  // move are notified in the order they first saw a move
+  common::Creature creatureOne(1U, "TestCreatureOne");
+  common::Creature creatureTwo(2U, "TestCreatureTwo");
+  common::Creature creatureThree(3U, "TestCreatureThree");
+  common::Creature creatureFour(4U, "TestCreatureFour");
+
+  MockCreatureCtrl creatureCtrlOne;
+  MockCreatureCtrl creatureCtrlTwo;
+  MockCreatureCtrl creatureCtrlThree;
+  MockCreatureCtrl creatureCtrlFour;
+
+  common::Position creaturePositionOne(192, 192, 7);
+  common::Position creaturePositionTwo(193, 193, 7);
+  common::Position creaturePositionThree(207, 207, 7);
+  common::Position creaturePositionFour(206, 206, 7);
+
+  EXPECT_CALL(creatureCtrlOne, onCreatureSpawn(_, _)).Times(2);
+  EXPECT_CALL(creatureCtrlTwo, onCreatureSpawn(_, _)).Times(1);
+  EXPECT_CALL(creatureCtrlThree, onCreatureSpawn(_, _)).Times(2);
+  EXPECT_CALL(creatureCtrlFour, onCreatureSpawn(_, _)).Times(1);
+  world->addCreature(&creatureOne, &creatureCtrlOne, creaturePositionOne);
+  world->addCreature(&creatureTwo, &creatureCtrlTwo, creaturePositionTwo);
+  world->addCreature(&creatureThree, &creatureCtrlThree, creaturePositionThree);
+  world->addCreature(&creatureFour, &creatureCtrlFour, creaturePositionFour);
+
+  const std::vector<CreatureMove> moves
+  {
+    { creatureThree.getCreatureId(), common::Position(207, 206, 7) },
+    { creatureOne.getCreatureId(), common::Position(192, 193, 7) },
+  };
+
+  {
+    InSequence sequence;
+    EXPECT_CALL(creatureCtrlThree, onCreatureMove(creatureThree, creaturePositionThree, _, moves[0].to_position));
+    EXPECT_CALL(creatureCtrlOne, onCreatureMove(creatureOne, creaturePositionOne, _, moves[1].to_position));
+    EXPECT_CALL(creatureCtrlFour, onCreatureMove(creatureThree, creaturePositionThree, _, moves[0].to_position));
+    EXPECT_CALL(creatureCtrlTwo, onCreatureMove(creatureOne, creaturePositionOne, _, moves[1].to_position));
+  }
+
+  std::vector<ReturnCode> return_codes;
+  world->creatureMove(moves, &return_codes);
+
+  ASSERT_EQ(2U, return_codes.size());
+  EXPECT_EQ(ReturnCode::OK, return_codes[0]);
+  EXPECT_EQ(ReturnCode::OK, return_codes[1]);
+}
+
+TEST_F(WorldTest, SpatialQueries)
+{
+  common::Creature creatureOne(1U, "TestCreatureOne");
+  common::Creature creatureTwo(2U, "TestCreatureTwo");
+  common::Creature creatureThree(3U, "TestCreatureThree");
+
+  MockCreatureCtrl creatureCtrlOne;
+  MockCreatureCtrl creatureCtrlTwo;
+  MockCreatureCtrl creatureCtrlThree;
+
+  EXPECT_CALL(creatureCtrlOne, onCreatureSpawn(_, _)).Times(AtLeast(1));
+  EXPECT_CALL(creatureCtrlTwo, onCreatureSpawn(_, _)).Times(AtLeast(1));
+  EXPECT_CALL(creatureCtrlThree, onCreatureSpawn(_, _)).Times(AtLeast(1));
+  world->addCreature(&creatureOne, &creatureCtrlOne, common::Position(192, 192, 7));
+  world->addCreature(&creatureTwo, &creatureCtrlTwo, common::Position(195, 196, 7));
+  world->addCreature(&creatureThree, &creatureCtrlThree, common::Position(207, 207, 7));
+
+  // Rectangle, partly outside the world
+  std::vector<common::CreatureId> creature_ids;
+  cworld->getCreatureIdsInRect(common::Position(190, 190, 7), common::Position(195, 196, 7), &creature_ids);
+  ASSERT_EQ(2U, creature_ids.size());
+  EXPECT_EQ(1U, creature_ids[0]);
+  EXPECT_EQ(2U, creature_ids[1]);
+
+  // Results are appended
+  cworld->getCreatureIdsInRect(common::Position(207, 207, 7), common::Position(300, 300, 7), &creature_ids);
+  ASSERT_EQ(3U, creature_ids.size());
+  EXPECT_EQ(3U, creature_ids[2]);
+
+  // Wrong floor or completely outside the world
+  creature_ids.clear();
+  cworld->getCreatureIdsInRect(common::Position(192, 192, 6), common::Position(207, 207, 6), &creature_ids);
+  cworld->getCreatureIdsInRect(common::Position(100, 100, 7), common::Position(191, 191, 7), &creature_ids);
+  EXPECT_TRUE(creature_ids.empty());
+
+  // Radius, creatureTwo is at distance 5 from creatureOne
+  cworld->getCreatureIdsInRadius(common::Position(192, 192, 7), 4, &creature_ids);
+  ASSERT_EQ(1U, creature_ids.size());
+  EXPECT_EQ(1U, creature_ids[0]);
+
+  creature_ids.clear();
+  cworld->getCreatureIdsInRadius(common::Position(192, 192, 7), 5, &creature_ids);
+  ASSERT_EQ(2U, creature_ids.size());
+
+  // Items, all tiles have the same ground item
+  EXPECT_CALL(itemMock_, getItemTypeId()).WillRepeatedly(Return(100));
+  std::vector<TileItem> items;
+  cworld->getItemsInRect(common::Position(192, 192, 7), common::Position(194, 194, 7), 100, &items);
+  ASSERT_EQ(9U, items.size());
+  EXPECT_EQ(common::Position(192, 192, 7), items[0].position);
+  EXPECT_EQ(0, items[0].stackpos);
+  EXPECT_EQ(&itemMock_, items[0].item);
+
+  items.clear();
+  cworld->getItemsInRect(common::Position(192, 192, 7), common::Position(194, 194, 7), 101, &items);
+  EXPECT_TRUE(items.empty());
+}
+
+TEST_F(WorldTest, ReplaceItem)
+{
+  common::Creature creature(1U, "TestCreature");
+  MockCreatureCtrl creatureCtrl;
+  EXPECT_CALL(creatureCtrl, onCreatureSpawn(_, _));
+  world->addCreature(&creature, &creatureCtrl, common::Position(192, 192, 7));
+
+  const common::Position position(193, 193, 7);
+  EXPECT_CALL(itemMock_, getItemTypeId()).WillRepeatedly(Return(100));
+  EXPECT_CALL(itemMock_, getCount()).WillRepeatedly(Return(1));
+
+  // Same ItemTypeId and count, e.g. a promoted shared item, the client doesn't need an update
+  ItemMock sameItem;
+  EXPECT_CALL(sameItem, getItemType()).WillRepeatedly(ReturnRef(itemType_));
+  EXPECT_CALL(sameItem, getItemTypeId()).WillRepeatedly(Return(100));
+  EXPECT_CALL(sameItem, getCount()).WillRepeatedly(Return(1));
+  EXPECT_CALL(creatureCtrl, onTileUpdate(_)).Times(0);
+
+  auto version = cworld->getTile(position)->getVersion();
+  EXPECT_EQ(ReturnCode::OK, world->replaceItem(sameItem, position, 0));
+  EXPECT_EQ(&sameItem, cworld->getTile(position)->getItem(0));
+  EXPECT_NE(version, cworld->getTile(position)->getVersion());
+  EXPECT_EQ(&itemMock_, cworld->getTile(common::Position(194, 194, 7))->getItem(0));
+
+  // Another ItemTypeId
+  ItemMock otherItem;
+  EXPECT_CALL(otherItem, getItemType()).WillRepeatedly(ReturnRef(itemType_));
+  EXPECT_CALL(otherItem, getItemTypeId()).WillRepeatedly(Return(101));
+  EXPECT_CALL(otherItem, getCount()).WillRepeatedly(Return(1));
+  EXPECT_CALL(creatureCtrl, onTileUpdate(position));
+
+  EXPECT_EQ(ReturnCode::OK, world->replaceItem(otherItem, position, 0));
+  EXPECT_EQ(&otherItem, cworld->getTile(position)->getItem(0));
+
+  // Invalid position and stackpos
+  EXPECT_EQ(ReturnCode::INVALID_POSITION, world->replaceItem(sameItem, common::Position(100, 100, 7), 0));
+  EXPECT_EQ(ReturnCode::ITEM_NOT_FOUND, world->replaceItem(sameItem, position, 1));
+}
+
 }  // namespace world
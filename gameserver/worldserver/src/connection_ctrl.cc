@@ -27,6 +27,7 @@
 #include <cstdio>
 
 #include <algorithm>
+#include <chrono>
 #include <deque>
 #include <utility>
 
@@ -47,6 +48,7 @@
 
 // utils
 #include "logger.h"
+#include "tick.h"
 
 // account
 #include "account.h"
@@ -60,16 +62,29 @@ using namespace protocol::server;  // NOLINT yes we want it all
 ConnectionCtrl::ConnectionCtrl(std::function<void(void)> close_protocol,
                                std::unique_ptr<network::Connection>&& connection,
                                const world::World* world,
+                               protocol::server::TileCache* tile_cache,
                                gameengine::GameEngineQueue* game_engine_queue,
-                               account::AccountReader* account_reader)
+                               account::AccountReader* account_reader,
+                               const SlowClientConfig& slow_client_config,
+                               utils::TimerWheel* timer_wheel,
+                               const TimeoutConfig& timeout_config,
+                               const RateLimitConfig& rate_limit_config)
     : m_close_protocol(std::move(close_protocol)),
       m_connection(std::move(connection)),
       m_world(world),
+      m_tile_cache(tile_cache),
       m_game_engine_queue(game_engine_queue),
       m_account_reader(account_reader),
-      m_player_id(common::Creature::INVALID_ID)
+      m_player_id(common::Creature::INVALID_ID),
+      m_slow_client_policy(slow_client_config.policy),
+      m_timer_wheel(timer_wheel),
+      m_timeout_config(timeout_config),
+      m_input_limits({ utils::TokenBucket(rate_limit_config.movement.rate, rate_limit_config.movement.burst),
+                       utils::TokenBucket(rate_limit_config.action.rate, rate_limit_config.action.burst),
+                       utils::TokenBucket(rate_limit_config.chat.rate, rate_limit_config.chat.burst),
+                       utils::TokenBucket(rate_limit_config.control.rate, rate_limit_config.control.burst) }),
+      m_flood_limit(rate_limit_config.flood.rate, rate_limit_config.flood.burst)
 {
-  m_known_creatures.fill(common::Creature::INVALID_ID);
   m_container_ids.fill(common::Item::INVALID_UNIQUE_ID);
 
   network::Connection::Callbacks callbacks
@@ -89,6 +104,15 @@ ConnectionCtrl::ConnectionCtrl(std::function<void(void)> close_protocol,
     }
   };
   m_connection->init(callbacks, false);
+  m_connection->setQueueLimits(slow_client_config.queue_limits);
+
+  setTimeout(m_timeout_config.login_timeout);
+}
+
+ConnectionCtrl::~ConnectionCtrl()
+{
+  m_timer_wheel->remove(m_timer_id);
+  m_timer_wheel->remove(m_congestion_timer_id);
 }
 
 void ConnectionCtrl::onCreatureSpawn(const common::Creature& creature, const common::Position& position)
@@ -98,34 +122,41 @@ void ConnectionCtrl::onCreatureSpawn(const common::Creature& creature, const com
     return;
   }
 
+  if (creature.getCreatureId() != m_player_id && !canSendUpdate(UpdateType::MAP))
+  {
+    return;
+  }
+
   network::OutgoingPacket packet;
 
   if (creature.getCreatureId() == m_player_id)
   {
     // We are spawning!
+    setTimeout(m_timeout_config.idle_timeout);
+
     const auto& player = static_cast<const gameengine::Player&>(creature);
     const auto server_beat = 50;  // TODO(simon): customizable?
 
     // TODO(simon): Check if any of these can be reordered, e.g. move addWorldLight down
-    addLogin(m_player_id, server_beat, &packet);
-    addMapFull(*m_world, position, &m_known_creatures, &packet);
-    addMagicEffect(position, 0x0A, &packet);
-    addPlayerStats(player, &packet);
-    addWorldLight(0x64, 0xD7, &packet);
-    addPlayerSkills(player, &packet);
+    addLogin(m_player_id, server_beat, &m_traffic_stats, &packet);
+    addMapFull(*m_world, m_tile_cache, position, &m_known_creatures, &m_traffic_stats, &packet);
+    addMagicEffect(position, 0x0A, &m_traffic_stats, &packet);
+    addPlayerStats(player, &m_traffic_stats, &packet);
+    addWorldLight(0x64, 0xD7, &m_traffic_stats, &packet);
+    addPlayerSkills(player, &m_traffic_stats, &packet);
     for (auto i = 1; i <= 10; i++)
     {
-      addEquipmentUpdated(player.getEquipment(), i, &packet);
+      addEquipmentUpdated(player.getEquipment(), i, &m_traffic_stats, &packet);
     }
   }
   else
   {
     // Someone else spawned
-    addThingAdded(position, &creature, &m_known_creatures, &packet);
-    addMagicEffect(position, 0x0A, &packet);
+    addThingAdded(position, &creature, &m_known_creatures, &m_traffic_stats, &packet);
+    addMagicEffect(position, 0x0A, &m_traffic_stats, &packet);
   }
 
-  m_connection->sendPacket(std::move(packet));
+  sendPacket(std::move(packet));
 }
 
 void ConnectionCtrl::onCreatureDespawn(const common::Creature& creature, const common::Position& position, std::uint8_t stackpos)
@@ -141,10 +172,15 @@ void ConnectionCtrl::onCreatureDespawn(const common::Creature& creature, const c
     return;
   }
 
+  if (creature.getCreatureId() != m_player_id && !canSendUpdate(UpdateType::MAP))
+  {
+    return;
+  }
+
   network::OutgoingPacket packet;
-  addMagicEffect(position, 0x02, &packet);
-  addThingRemoved(position, stackpos, &packet);
-  m_connection->sendPacket(std::move(packet));
+  addMagicEffect(position, 0x02, &m_traffic_stats, &packet);
+  addThingRemoved(position, stackpos, &m_traffic_stats, &packet);
+  sendPacket(std::move(packet));
 
   if (creature.getCreatureId() == m_player_id)
   {
@@ -152,7 +188,10 @@ void ConnectionCtrl::onCreatureDespawn(const common::Creature& creature, const c
     // The protocol will be deleted as soon as the connection has been closed
     // (via onConnectionClosed callback)
     m_player_id = common::Creature::INVALID_ID;
-    m_connection->close(false);
+    if (isConnected())
+    {
+      m_connection->close(false);
+    }
   }
 }
 
@@ -161,46 +200,118 @@ void ConnectionCtrl::onCreatureMove(const common::Creature& creature,
                               std::uint8_t old_stackpos,
                               const common::Position& new_position)
 {
-  if (!isConnected())
+  if (!isConnected() || !canSendUpdate(UpdateType::MAP))
+  {
+    return;
+  }
+
+  const auto* player_position = m_world->getCreaturePosition(m_player_id);
+  if (!player_position)
   {
+    LOG_ERROR("%s: invalid player_position", __func__);
     return;
   }
 
   // Build outgoing packet
   network::OutgoingPacket packet;
+  if (addCreatureMove(*player_position, creature, old_position, old_stackpos, new_position, &packet))
+  {
+    sendPacket(std::move(packet));
+  }
+}
 
-  const auto* player_position = m_world->getCreaturePosition(m_player_id);
-  if (!player_position)
+void ConnectionCtrl::onCreatureMoves(const std::vector<world::CreatureMoveEvent>& moves)
+{
+  if (!isConnected() || !canSendUpdate(UpdateType::MAP))
+  {
+    return;
+  }
+
+  // The moves are given in the order they were made, so if this player moved in the same batch
+  // the moves before that must be judged from where the player was before its own move
+  const auto* world_position = m_world->getCreaturePosition(m_player_id);
+  if (!world_position)
   {
     LOG_ERROR("%s: invalid player_position", __func__);
     return;
   }
+  auto player_position = *world_position;
+  const auto own_move = std::find_if(moves.cbegin(),
+                                     moves.cend(),
+                                     [this](const world::CreatureMoveEvent& move)
+                                     {
+                                       return move.creature->getCreatureId() == m_player_id;
+                                     });
+  if (own_move != moves.cend())
+  {
+    player_position = own_move->old_position;
+  }
 
-  bool can_see_old_pos = canSee(*player_position, old_position);
-  bool can_see_new_pos = canSee(*player_position, new_position);
+  // Build one outgoing packet with all moves, but send it once it has grown past 4096 bytes
+  // so that a batch with many moves and map rows doesn't end up as one huge packet
+  network::OutgoingPacket packet;
+  for (const auto& move : moves)
+  {
+    if (move.creature->getCreatureId() == m_player_id)
+    {
+      player_position = move.new_position;
+    }
+
+    if (!addCreatureMove(player_position,
+                         *move.creature,
+                         move.old_position,
+                         move.old_stackpos,
+                         move.new_position,
+                         &packet))
+    {
+      return;
+    }
+
+    if (packet.getLength() > 4096U)
+    {
+      sendPacket(std::move(packet));
+      packet = network::OutgoingPacket();
+    }
+  }
+
+  if (packet.getLength() > 0U)
+  {
+    sendPacket(std::move(packet));
+  }
+}
+
+bool ConnectionCtrl::addCreatureMove(const common::Position& player_position,
+                                     const common::Creature& creature,
+                                     const common::Position& old_position,
+                                     std::uint8_t old_stackpos,
+                                     const common::Position& new_position,
+                                     network::OutgoingPacket* packet)
+{
+  bool can_see_old_pos = canSee(player_position, old_position);
+  bool can_see_new_pos = canSee(player_position, new_position);
 
   if (can_see_old_pos && can_see_new_pos)
   {
-    addThingMoved(old_position, old_stackpos, new_position, &packet);
+    addThingMoved(old_position, old_stackpos, new_position, &m_traffic_stats, packet);
   }
   else if (can_see_old_pos)
   {
-    addThingRemoved(old_position, old_stackpos, &packet);
+    addThingRemoved(old_position, old_stackpos, &m_traffic_stats, packet);
   }
   else if (can_see_new_pos)
   {
-    addThingAdded(new_position, &creature, &m_known_creatures, &packet);
+    addThingAdded(new_position, &creature, &m_known_creatures, &m_traffic_stats, packet);
   }
   else
   {
     LOG_ERROR("%s: called, but this player cannot see neither old_position nor new_position: "
               "player_position: %s, old_position: %s, new_position: %s",
               __func__,
-              player_position->toString().c_str(),
+              player_position.toString().c_str(),
               old_position.toString().c_str(),
               new_position.toString().c_str());
     disconnect();
-    return;
+    return false;
   }
 
   if (creature.getCreatureId() == m_player_id)
@@ -210,26 +321,26 @@ void ConnectionCtrl::onCreatureMove(const common::Creature& creature,
     {
       LOG_ERROR("%s: changing level is not supported!", __func__);
       disconnect();
-      return;
+      return false;
     }
 
     // This player moved, send new map data
-    addMap(*m_world, old_position, new_position, &m_known_creatures, &packet);
+    addMap(*m_world, m_tile_cache, old_position, new_position, &m_known_creatures, &m_traffic_stats, packet);
   }
 
-  m_connection->sendPacket(std::move(packet));
+  return true;
 }
 
 void ConnectionCtrl::onCreatureTurn(const common::Creature& creature, const common::Position& position, std::uint8_t stackpos)
 {
-  if (!isConnected())
+  if (!isConnected() || !canSendUpdate(UpdateType::COSMETIC))
   {
     return;
   }
 
   network::OutgoingPacket packet;
-  addThingChanged(position, stackpos, &creature, &m_known_creatures, &packet);
-  m_connection->sendPacket(std::move(packet));
+  addThingChanged(position, stackpos, &creature, &m_known_creatures, &m_traffic_stats, &packet);
+  sendPacket(std::move(packet));
 }
 
 void ConnectionCtrl::onCreatureSay(const common::Creature& creature, const common::Position& position, const std::string& message)
@@ -239,45 +350,50 @@ void ConnectionCtrl::onCreatureSay(const common::Creature& creature, const commo
     return;
   }
 
+  if (creature.getCreatureId() != m_player_id && !canSendUpdate(UpdateType::COSMETIC))
+  {
+    return;
+  }
+
   network::OutgoingPacket packet;
-  addTalk(creature.getName(), 0x01, position, message, &packet);
-  m_connection->sendPacket(std::move(packet));
+  addTalk(creature.getName(), 0x01, position, message, &m_traffic_stats, &packet);
+  sendPacket(std::move(packet));
 }
 
 void ConnectionCtrl::onItemRemoved(const common::Position& position, std::uint8_t stackpos)
 {
-  if (!isConnected())
+  if (!isConnected() || !canSendUpdate(UpdateType::MAP))
   {
     return;
   }
 
   network::OutgoingPacket packet;
-  addThingRemoved(position, stackpos, &packet);
-  m_connection->sendPacket(std::move(packet));
+  addThingRemoved(position, stackpos, &m_traffic_stats, &packet);
+  sendPacket(std::move(packet));
 }
 
 void ConnectionCtrl::onItemAdded(const common::Item& item, const common::Position& position)
 {
-  if (!isConnected())
+  if (!isConnected() || !canSendUpdate(UpdateType::MAP))
   {
     return;
   }
 
   network::OutgoingPacket packet;
-  addThingAdded(position, &item, nullptr, &packet);
-  m_connection->sendPacket(std::move(packet));
+  addThingAdded(position, &item, nullptr, &m_traffic_stats, &packet);
+  sendPacket(std::move(packet));
 }
 
 void ConnectionCtrl::onTileUpdate(const common::Position& position)
 {
-  if (!isConnected())
+  if (!isConnected() || !canSendUpdate(UpdateType::MAP))
   {
     return;
   }
 
   network::OutgoingPacket packet;
-  addTileUpdated(position, *m_world, &m_known_creatures, &packet);
-  m_connection->sendPacket(std::move(packet));
+  addTileUpdated(position, *m_world, m_tile_cache, &m_known_creatures, &m_traffic_stats, &packet);
+  sendPacket(std::move(packet));
 }
 
 void ConnectionCtrl::onEquipmentUpdated(const gameengine::Player& player, std::uint8_t inventory_index)
@@ -288,8 +404,8 @@ void ConnectionCtrl::onEquipmentUpdated(const gameengine::Player& player, std::u
   }
 
   network::OutgoingPacket packet;
-  addEquipmentUpdated(player.getEquipment(), inventory_index, &packet);
-  m_connection->sendPacket(std::move(packet));
+  addEquipmentUpdated(player.getEquipment(), inventory_index, &m_traffic_stats, &packet);
+  sendPacket(std::move(packet));
 }
 
 void ConnectionCtrl::onOpenContainer(std::uint8_t new_container_id, const gameengine::Container& container, const common::Item& item)
@@ -311,9 +427,9 @@ void ConnectionCtrl::onOpenContainer(std::uint8_t new_container_id, const gameen
 
   LOG_DEBUG("%s: new_container_id: %u", __func__, new_container_id);
 
-  network::OutgoingPacket packet;
-  addContainerOpen(new_container_id, &item, container, &packet);
-  m_connection->sendPacket(std::move(packet));
+  network::OutgoingPacket packet(getContainerOpenSize(&item, container));
+  addContainerOpen(new_container_id, &item, container, &m_traffic_stats, &packet);
+  sendPacket(std::move(packet));
 }
 
 void ConnectionCtrl::onCloseContainer(common::ItemUniqueId container_item_unique_id, bool reset_container_id)
@@ -340,8 +456,8 @@ void ConnectionCtrl::onCloseContainer(common::ItemUniqueId container_item_unique
   LOG_DEBUG("%s: container_item_unique_id: %u -> container_id: %d", __func__, container_item_unique_id, container_id);
 
   network::OutgoingPacket packet;
-  addContainerClose(container_id, &packet);
-  m_connection->sendPacket(std::move(packet));
+  addContainerClose(container_id, &m_traffic_stats, &packet);
+  sendPacket(std::move(packet));
 }
 
 void ConnectionCtrl::onContainerAddItem(common::ItemUniqueId container_item_unique_id, const common::Item& item)
@@ -366,8 +482,8 @@ void ConnectionCtrl::onContainerAddItem(common::ItemUniqueId container_item_uniq
             item.getItemTypeId());
 
   network::OutgoingPacket packet;
-  addContainerAddItem(container_id, &item, &packet);
-  m_connection->sendPacket(std::move(packet));
+  addContainerAddItem(container_id, &item, &m_traffic_stats, &packet);
+  sendPacket(std::move(packet));
 }
 
 void ConnectionCtrl::onContainerUpdateItem(common::ItemUniqueId container_item_unique_id, std::uint8_t container_slot, const common::Item& item)
@@ -393,8 +509,8 @@ void ConnectionCtrl::onContainerUpdateItem(common::ItemUniqueId container_item_u
             item.getItemTypeId());
 
   network::OutgoingPacket packet;
-  addContainerUpdateItem(container_id, container_slot, &item, &packet);
-  m_connection->sendPacket(std::move(packet));
+  addContainerUpdateItem(container_id, container_slot, &item, &m_traffic_stats, &packet);
+  sendPacket(std::move(packet));
 }
 
 void ConnectionCtrl::onContainerRemoveItem(common::ItemUniqueId container_item_unique_id, std::uint8_t container_slot)
@@ -419,8 +535,8 @@ void ConnectionCtrl::onContainerRemoveItem(common::ItemUniqueId container_item_u
             container_slot);
 
   network::OutgoingPacket packet;
-  addContainerRemoveItem(container_id, container_slot, &packet);
-  m_connection->sendPacket(std::move(packet));
+  addContainerRemoveItem(container_id, container_slot, &m_traffic_stats, &packet);
+  sendPacket(std::move(packet));
 }
 
 // 0x13 default text, 0x11 login text
@@ -432,8 +548,8 @@ void ConnectionCtrl::sendTextMessage(std::uint8_t message_type, const std::strin
   }
 
   network::OutgoingPacket packet;
-  addTextMessage(message_type, message, &packet);
-  m_connection->sendPacket(std::move(packet));
+  addTextMessage(message_type, message, &m_traffic_stats, &packet);
+  sendPacket(std::move(packet));
 }
 
 void ConnectionCtrl::sendCancel(const std::string& message)
@@ -444,8 +560,8 @@ void ConnectionCtrl::sendCancel(const std::string& message)
   }
 
   network::OutgoingPacket packet;
-  addTextMessage(0x14, message, &packet);
-  m_connection->sendPacket(std::move(packet));
+  addTextMessage(0x14, message, &m_traffic_stats, &packet);
+  sendPacket(std::move(packet));
 }
 
 void ConnectionCtrl::cancelMove()
@@ -456,8 +572,8 @@ void ConnectionCtrl::cancelMove()
   }
 
   network::OutgoingPacket packet;
-  addCancelMove(&packet);
-  m_connection->sendPacket(std::move(packet));
+  addCancelMove(&m_traffic_stats, &packet);
+  sendPacket(std::move(packet));
 }
 
 bool ConnectionCtrl::hasContainerOpen(common::ItemUniqueId item_unique_id) const
@@ -493,6 +609,7 @@ void ConnectionCtrl::parsePacket(network::IncomingPacket* packet)
     if (packet_type == 0x0A)
     {
       parseLogin(packet);
+      countIncoming(packet_type, packet->getPosition(), &m_traffic_stats);
     }
     else
     {
@@ -503,119 +620,183 @@ void ConnectionCtrl::parsePacket(network::IncomingPacket* packet)
     return;
   }
 
+  // The client is alive
+  setTimeout(m_timeout_config.idle_timeout);
+
+  auto* dispatcher = getOpcodeDispatcher();
+  const auto now = utils::Tick::now();
   while (!packet->isEmpty())
   {
-    const auto packet_id = packet->getU8();
-    switch (packet_id)
+    const auto position = packet->getPosition();
+    const auto opcode = packet->getU8();
+    if (!checkRateLimit(opcode, now))
     {
-      case 0x14:
-      {
-        m_game_engine_queue->addTask(m_player_id, [this](gameengine::GameEngine* game_engine)
-        {
-          game_engine->despawn(m_player_id);
-        });
-        break;
-      }
-
-      case 0x64:
-      {
-        parseMoveClick(packet);
-        break;
-      }
-
-      case 0x65:  // Player move, North = 0
-      case 0x66:  // East  = 1
-      case 0x67:  // South = 2
-      case 0x68:  // West  = 3
-      {
-        m_game_engine_queue->addTask(m_player_id, [this, packet_id](gameengine::GameEngine* game_engine)
-        {
-          game_engine->move(m_player_id, static_cast<common::Direction>(packet_id - 0x65));
-        });
-        break;
-      }
+      // A message can't be skipped without parsing it, so drop the rest of the packet as well
+      countIncoming(opcode, 1U + packet->bytesLeft(), &m_traffic_stats);
+      return;
+    }
 
-      case 0x69:
-      {
-        m_game_engine_queue->addTask(m_player_id, [this](gameengine::GameEngine* game_engine)
-        {
-          game_engine->cancelMove(m_player_id);
-        });
-        break;
-      }
+    if (!dispatcher->dispatch(this, opcode, packet))
+    {
+      LOG_ERROR("Unknown packet from player id: %d, packet id: 0x%X", m_player_id, opcode);
+      countIncoming(opcode, 1U + packet->bytesLeft(), &m_traffic_stats);
+      return;  // Don't read any more, even though there might be more packets that we can parse
+    }
+    countIncoming(opcode, packet->getPosition() - position, &m_traffic_stats);
+  }
+}
 
-      case 0x6F:  // Player turn, North = 0
-      case 0x70:  // East  = 1
-      case 0x71:  // South = 2
-      case 0x72:  // West  = 3
-      {
-        m_game_engine_queue->addTask(m_player_id, [this, packet_id](gameengine::GameEngine* game_engine)
-        {
-          game_engine->turn(m_player_id, static_cast<common::Direction>(packet_id - 0x6F));
-        });
-        break;
-      }
+void ConnectionCtrl::sendPacket(network::OutgoingPacket&& packet)
+{
+  if (!isConnected())
+  {
+    // The connection was closed while sending an earlier packet in the same call
+    return;
+  }
 
-      case 0x78:
-      {
-        parseMoveItem(packet);
-        break;
-      }
+  m_connection->sendPacket(std::move(packet));  // Note that the connection might be closed during this call
+  checkCongestion();
+}
 
-      case 0x82:
-      {
-        parseUseItem(packet);
-        break;
-      }
+void ConnectionCtrl::logOpcodeStats()
+{
+  getOpcodeDispatcher()->forEach([](std::uint8_t opcode, const OpcodeDispatcher<ConnectionCtrl>::OpcodeHandler& handler)
+  {
+    if (handler.stats.calls == 0)
+    {
+      return;
+    }
 
-      case 0x87:
-      {
-        parseCloseContainer(packet);
-        break;
-      }
+    const auto handler_time_us = std::chrono::duration_cast<std::chrono::microseconds>(handler.stats.handler_time).count();
+    LOG_INFO("%s: opcode: 0x%02X (%s) calls: %llu handler time: %lldus (%.2fus/call)",
+             __func__,
+             opcode,
+             handler.name,
+             static_cast<unsigned long long>(handler.stats.calls),
+             static_cast<long long>(handler_time_us),
+             static_cast<double>(handler_time_us) / handler.stats.calls);
+  });
+}
 
-      case 0x88:
-      {
-        parseOpenParentContainer(packet);
-        break;
-      }
+void ConnectionCtrl::logTrafficStats(const TrafficStats& traffic_stats)
+{
+  for (const auto direction : { TrafficStats::Direction::INCOMING, TrafficStats::Direction::OUTGOING })
+  {
+    const auto* direction_name = direction == TrafficStats::Direction::INCOMING ? "incoming" : "outgoing";
+    const auto total = traffic_stats.getTotal(direction);
+    LOG_INFO("%s: %s messages: %llu bytes: %llu",
+             __func__,
+             direction_name,
+             static_cast<unsigned long long>(total.messages),
+             static_cast<unsigned long long>(total.bytes));
+
+    traffic_stats.forEach(direction, [direction_name, &total](std::uint8_t opcode, const TrafficStats::Counters& counters)
+    {
+      LOG_INFO("%s: %s opcode: 0x%02X messages: %llu bytes: %llu (%.1f%%)",
+               __func__,
+               direction_name,
+               opcode,
+               static_cast<unsigned long long>(counters.messages),
+               static_cast<unsigned long long>(counters.bytes),
+               100.0 * static_cast<double>(counters.bytes) / static_cast<double>(total.bytes));
+    });
+  }
+}
 
-      case 0x8C:
-      {
-        parseLookAt(packet);
-        break;
-      }
+OpcodeDispatcher<ConnectionCtrl>* ConnectionCtrl::getOpcodeDispatcher()
+{
+  static OpcodeDispatcher<ConnectionCtrl> dispatcher = []()
+  {
+    OpcodeDispatcher<ConnectionCtrl> dispatcher;
 
-      case 0x96:
+    const auto add = [&dispatcher](std::uint8_t opcode, const char* name, void (ConnectionCtrl::*parse)(network::IncomingPacket*))
+    {
+      dispatcher.add(opcode, name, [parse](ConnectionCtrl* connection_ctrl, std::uint8_t, network::IncomingPacket* packet)
       {
-        parseSay(packet);
-        break;
-      }
+        (connection_ctrl->*parse)(packet);
+      });
+    };
 
-      case 0xBE:
+    const auto add_direction = [&dispatcher](std::uint8_t first_opcode, const char* name, void (ConnectionCtrl::*parse)(common::Direction))
+    {
+      // North = 0, East = 1, South = 2, West = 3
+      for (auto i = 0; i < 4; i++)
       {
-        // Note: this packet more likely means "stop all actions", not only moving
-        //       so, maybe we should cancel all player's task here?
-        m_game_engine_queue->addTask(m_player_id, [this](gameengine::GameEngine* game_engine)
+        dispatcher.add(first_opcode + i, name, [parse, first_opcode](ConnectionCtrl* connection_ctrl, std::uint8_t opcode, network::IncomingPacket*)
         {
-          game_engine->cancelMove(m_player_id);
+          (connection_ctrl->*parse)(static_cast<common::Direction>(opcode - first_opcode));
         });
-        break;
       }
-
-      default:
-      {
-        LOG_ERROR("Unknown packet from player id: %d, packet id: 0x%X", m_player_id, packet_id);
-        return;  // Don't read any more, even though there might be more packets that we can parse
-      }
-    }
-  }
+    };
+
+    add(0x14, "Logout", &ConnectionCtrl::parseLogout);
+    add(0x64, "MoveClick", &ConnectionCtrl::parseMoveClick);
+    add_direction(0x65, "Move", &ConnectionCtrl::parseMove);
+    add(0x69, "CancelMove", &ConnectionCtrl::parseCancelMove);
+    add_direction(0x6F, "Turn", &ConnectionCtrl::parseTurn);
+    add(0x78, "MoveItem", &ConnectionCtrl::parseMoveItem);
+    add(0x82, "UseItem", &ConnectionCtrl::parseUseItem);
+    add(0x87, "CloseContainer", &ConnectionCtrl::parseCloseContainer);
+    add(0x88, "OpenParentContainer", &ConnectionCtrl::parseOpenParentContainer);
+    add(0x8C, "LookAt", &ConnectionCtrl::parseLookAt);
+    add(0x96, "Say", &ConnectionCtrl::parseSay);
+    add(0xBE, "StopActions", &ConnectionCtrl::parseStopActions);
+
+    return dispatcher;
+  }();
+  return &dispatcher;
 }
 
 void ConnectionCtrl::onDisconnected()
 {
+  const auto& queue_stats = m_connection->updateQueueStats();
+  if (queue_stats.times_congested > 0U)
+  {
+    LOG_INFO("%s: player id: %d, peak queue: %u packets %u bytes, times congested: %llu, dropped updates: %llu",
+             __func__,
+             m_player_id,
+             queue_stats.peak_packets,
+             queue_stats.peak_bytes,
+             static_cast<unsigned long long>(queue_stats.times_congested),
+             static_cast<unsigned long long>(m_dropped_updates));
+  }
+
+  if (m_dropped_inputs > 0U)
+  {
+    LOG_INFO("%s: player id: %d, dropped messages due to rate limit: %llu",
+             __func__,
+             m_player_id,
+             static_cast<unsigned long long>(m_dropped_inputs));
+  }
+
+  const auto incoming = m_traffic_stats.getTotal(TrafficStats::Direction::INCOMING);
+  const auto outgoing = m_traffic_stats.getTotal(TrafficStats::Direction::OUTGOING);
+  LOG_DEBUG("%s: player id: %d, incoming: %llu messages %llu bytes, outgoing: %llu messages %llu bytes",
+            __func__,
+            m_player_id,
+            static_cast<unsigned long long>(incoming.messages),
+            static_cast<unsigned long long>(incoming.bytes),
+            static_cast<unsigned long long>(outgoing.messages),
+            static_cast<unsigned long long>(outgoing.bytes));
+  for (const auto direction : { TrafficStats::Direction::INCOMING, TrafficStats::Direction::OUTGOING })
+  {
+    const auto* direction_name = direction == TrafficStats::Direction::INCOMING ? "incoming" : "outgoing";
+    m_traffic_stats.forEach(direction, [this, direction_name](std::uint8_t opcode, const TrafficStats::Counters& counters)
+    {
+      LOG_DEBUG("onDisconnected: player id: %d, %s opcode: 0x%02X messages: %llu bytes: %llu",
+                m_player_id,
+                direction_name,
+                opcode,
+                static_cast<unsigned long long>(counters.messages),
+                static_cast<unsigned long long>(counters.bytes));
+    });
+  }
+
   // We are no longer connected, so erase the connection
   m_connection.reset();
+  setTimeout(0);
+  m_timer_wheel->remove(m_congestion_timer_id);
+  m_congestion_timer_id = utils::TimerWheel::INVALID_TIMER_ID;
 
   // If we are not logged in to the gameworld then we can erase the protocol
   if (!isLoggedIn())
@@ -632,9 +813,202 @@ void ConnectionCtrl::onDisconnected()
   }
 }
 
+void ConnectionCtrl::setTimeout(int ticks)
+{
+  if (ticks <= 0)
+  {
+    m_timer_wheel->remove(m_timer_id);
+    m_timer_id = utils::TimerWheel::INVALID_TIMER_ID;
+    return;
+  }
+
+  // Resetting the existing timer is cheap, so this is done for every packet
+  if (!m_timer_wheel->reset(m_timer_id, ticks))
+  {
+    m_timer_id = m_timer_wheel->add(ticks, [this]()
+    {
+      m_timer_id = utils::TimerWheel::INVALID_TIMER_ID;
+      onTimeout();
+    });
+  }
+}
+
+void ConnectionCtrl::onTimeout()
+{
+  if (!isConnected())
+  {
+    return;
+  }
+
+  LOG_INFO("%s: player id: %d, %s timeout, closing connection",
+           __func__,
+           m_player_id,
+           (isLoggedIn() ? "idle" : "login"));
+
+  // The client might not read anymore (e.g. half-open connection), so don't wait for the
+  // queued packets to be sent. onDisconnected callback will handle the rest
+  m_connection->close(true);
+}
+
+ConnectionCtrl::InputClass ConnectionCtrl::getInputClass(std::uint8_t opcode)
+{
+  switch (opcode)
+  {
+    case 0x64:  // MoveClick
+    case 0x65:  // Move
+    case 0x66:
+    case 0x67:
+    case 0x68:
+    case 0x6F:  // Turn
+    case 0x70:
+    case 0x71:
+    case 0x72:
+      return InputClass::MOVEMENT;
+
+    case 0x78:  // MoveItem
+    case 0x82:  // UseItem
+    case 0x87:  // CloseContainer
+    case 0x88:  // OpenParentContainer
+    case 0x8C:  // LookAt
+      return InputClass::ACTION;
+
+    case 0x96:  // Say
+      return InputClass::CHAT;
+
+    case 0x14:  // Logout
+    case 0x69:  // CancelMove
+    case 0xBE:  // StopActions
+      // Not in MOVEMENT, so that they are never starved by a full movement bucket
+      return InputClass::CONTROL;
+
+    default:
+      // Unknown opcodes, which are rejected anyway
+      return InputClass::UNLIMITED;
+  }
+}
+
+bool ConnectionCtrl::checkRateLimit(std::uint8_t opcode, std::int64_t now)
+{
+  const auto input_class = getInputClass(opcode);
+  if (input_class == InputClass::UNLIMITED ||
+      m_input_limits[static_cast<std::size_t>(input_class)].consume(now))
+  {
+    return true;
+  }
+
+  m_dropped_inputs += 1U;
+  LOG_DEBUG("%s: player id: %d, dropped opcode: 0x%02X", __func__, m_player_id, opcode);
+
+  if (!m_flood_limit.consume(now))
+  {
+    LOG_INFO("%s: player id: %d, flooding (%llu dropped messages), disconnecting",
+             __func__,
+             m_player_id,
+             static_cast<unsigned long long>(m_dropped_inputs));
+    disconnect();
+  }
+  return false;
+}
+
+bool ConnectionCtrl::canSendUpdate(UpdateType update_type)
+{
+  if (!m_congested)
+  {
+    return true;
+  }
+
+  switch (m_slow_client_policy)
+  {
+    case SlowClientPolicy::DROP_UPDATES:
+      if (update_type == UpdateType::MAP)
+      {
+        return true;
+      }
+      break;
+
+    case SlowClientPolicy::RESYNC_MAP:
+      m_map_resync_pending = true;
+      break;
+
+    case SlowClientPolicy::DISCONNECT:
+      // We are disconnecting, no need to send anything
+      break;
+  }
+
+  m_dropped_updates += 1U;
+  return false;
+}
+
+void ConnectionCtrl::checkCongestion()
+{
+  if (!isConnected())
+  {
+    return;
+  }
+
+  const auto& queue_stats = m_connection->updateQueueStats();
+  if (queue_stats.congested != m_congested)
+  {
+    m_congested = queue_stats.congested;
+    LOG_INFO("%s: player id: %d, congested: %s, packets in queue: %u, bytes in queue: %u",
+             __func__,
+             m_player_id,
+             (m_congested ? "true" : "false"),
+             queue_stats.packets,
+             queue_stats.bytes);
+
+    if (m_congested && m_slow_client_policy == SlowClientPolicy::DISCONNECT)
+    {
+      disconnect();
+      return;
+    }
+
+    if (!m_congested && m_map_resync_pending)
+    {
+      // Map updates were dropped, send the full map so that the client is in sync again
+      // sendFullMap calls this function again, which starts polling if the map congests us again
+      m_map_resync_pending = false;
+      sendFullMap();
+      return;
+    }
+  }
+
+  // Updates might be dropped until the queue drains, and nothing else might be sent to the
+  // client during that time, so keep polling
+  if (m_congested && m_congestion_timer_id == utils::TimerWheel::INVALID_TIMER_ID)
+  {
+    m_congestion_timer_id = m_timer_wheel->add(1U, [this]()
+    {
+      m_congestion_timer_id = utils::TimerWheel::INVALID_TIMER_ID;
+      checkCongestion();
+    });
+  }
+}
+
+void ConnectionCtrl::sendFullMap()
+{
+  const auto* player_position = m_world->getCreaturePosition(m_player_id);
+  if (!player_position)
+  {
+    LOG_ERROR("%s: invalid player_position", __func__);
+    return;
+  }
+
+  // addMapFull reserves the size of the map itself
+  network::OutgoingPacket packet;
+  addMapFull(*m_world, m_tile_cache, *player_position, &m_known_creatures, &m_traffic_stats, &packet);
+  sendPacket(std::move(packet));
+}
+
 void ConnectionCtrl::parseLogin(network::IncomingPacket* packet)
 {
-  const auto login = getLogin(packet);
+  const auto login_message = getLogin(packet);
+  if (!login_message)
+  {
+    disconnect();
+    return;
+  }
+  const auto& login = *login_message;
 
   LOG_DEBUG("Client OS: %d Client version: %d Character: %s Password: %s",
             login.client_os,
@@ -642,13 +1016,29 @@ void ConnectionCtrl::parseLogin(network::IncomingPacket* packet)
             login.character_name.c_str(),
             login.password.c_str());
 
+  // Another process has taken over, the player should log in there instead
+  if (m_refuse_logins)
+  {
+    network::OutgoingPacket packet;
+    addLoginFailed("The server is restarting, please try again.", &m_traffic_stats, &packet);
+    sendPacket(std::move(packet));
+    if (isConnected())
+    {
+      m_connection->close(false);
+    }
+    return;
+  }
+
   // Check if character exists
   if (!m_account_reader->characterExists(login.character_name))
   {
     network::OutgoingPacket packet;
-    addLoginFailed("Invalid character.", &packet);
-    m_connection->sendPacket(std::move(packet));
-    m_connection->close(false);
+    addLoginFailed("Invalid character.", &m_traffic_stats, &packet);
+    sendPacket(std::move(packet));
+    if (isConnected())
+    {
+      m_connection->close(false);
+    }
     return;
   }
 
@@ -656,9 +1046,12 @@ void ConnectionCtrl::parseLogin(network::IncomingPacket* packet)
   if (!m_account_reader->verifyPassword(login.character_name, login.password))
   {
     network::OutgoingPacket packet;
-    addLoginFailed("Invalid password.", &packet);
-    m_connection->sendPacket(std::move(packet));
-    m_connection->close(false);
+    addLoginFailed("Invalid password.", &m_traffic_stats, &packet);
+    sendPacket(std::move(packet));
+    if (isConnected())
+    {
+      m_connection->close(false);
+    }
     return;
   }
 
@@ -668,13 +1061,58 @@ void ConnectionCtrl::parseLogin(network::IncomingPacket* packet)
     if (!game_engine->spawn(character_name, this))
     {
       network::OutgoingPacket packet;
-      addLoginFailed("Could not spawn player.", &packet);
-      m_connection->sendPacket(std::move(packet));
-      m_connection->close(false);
+      addLoginFailed("Could not spawn player.", &m_traffic_stats, &packet);
+      sendPacket(std::move(packet));
+      if (isConnected())
+      {
+        m_connection->close(false);
+      }
     }
   });
 }
 
+void ConnectionCtrl::parseLogout(network::IncomingPacket*)
+{
+  m_game_engine_queue->addTask(m_player_id, [this](gameengine::GameEngine* game_engine)
+  {
+    game_engine->despawn(m_player_id);
+  });
+}
+
+void ConnectionCtrl::parseMove(common::Direction direction)
+{
+  m_game_engine_queue->addTask(m_player_id, [this, direction](gameengine::GameEngine* game_engine)
+  {
+    game_engine->move(m_player_id, direction);
+  });
+}
+
+void ConnectionCtrl::parseCancelMove(network::IncomingPacket*)
+{
+  m_game_engine_queue->addTask(m_player_id, [this](gameengine::GameEngine* game_engine)
+  {
+    game_engine->cancelMove(m_player_id);
+  });
+}
+
+void ConnectionCtrl::parseTurn(common::Direction direction)
+{
+  m_game_engine_queue->addTask(m_player_id, [this, direction](gameengine::GameEngine* game_engine)
+  {
+    game_engine->turn(m_player_id, direction);
+  });
+}
+
+void ConnectionCtrl::parseStopActions(network::IncomingPacket*)
+{
+  // Note: this packet more likely means "stop all actions", not only moving
+  //       so, maybe we should cancel all player's task here?
+  m_game_engine_queue->addTask(m_player_id, [this](gameengine::GameEngine* game_engine)
+  {
+    game_engine->cancelMove(m_player_id);
+  });
+}
+
 void ConnectionCtrl::parseMoveClick(network::IncomingPacket* packet)
 {
   auto move = getMoveClick(packet);
@@ -693,7 +1131,13 @@ void ConnectionCtrl::parseMoveClick(network::IncomingPacket* packet)
 
 void ConnectionCtrl::parseMoveItem(network::IncomingPacket* packet)
 {
-  const auto move = getMoveItem(&m_container_ids, packet);
+  const auto move_message = getMoveItem(&m_container_ids, packet);
+  if (!move_message)
+  {
+    disconnect();
+    return;
+  }
+  const auto& move = *move_message;
 
   LOG_DEBUG("%s: from: %s, to: %s, count: %u",
             __func__,
@@ -709,7 +1153,13 @@ void ConnectionCtrl::parseMoveItem(network::IncomingPacket* packet)
 
 void ConnectionCtrl::parseUseItem(network::IncomingPacket* packet)
 {
-  const auto use_item = getUseItem(&m_container_ids, packet);
+  const auto use_item_message = getUseItem(&m_container_ids, packet);
+  if (!use_item_message)
+  {
+    disconnect();
+    return;
+  }
+  const auto& use_item = *use_item_message;
 
   LOG_DEBUG("%s: item_position: %s, new_container_id: %u",
             __func__,
@@ -724,7 +1174,13 @@ void ConnectionCtrl::parseUseItem(network::IncomingPacket* packet)
 
 void ConnectionCtrl::parseCloseContainer(network::IncomingPacket* packet)
 {
-  const auto close = getCloseContainer(packet);
+  const auto close_message = getCloseContainer(packet);
+  if (!close_message)
+  {
+    disconnect();
+    return;
+  }
+  const auto& close = *close_message;
   const auto item_unique_id = getContainerItemUniqueId(close.container_id);
   if (item_unique_id == common::Item::INVALID_UNIQUE_ID)
   {
@@ -743,7 +1199,13 @@ void ConnectionCtrl::parseCloseContainer(network::IncomingPacket* packet)
 
 void ConnectionCtrl::parseOpenParentContainer(network::IncomingPacket* packet)
 {
-  const auto open_parent = getOpenParentContainer(packet);
+  const auto open_parent_message = getOpenParentContainer(packet);
+  if (!open_parent_message)
+  {
+    disconnect();
+    return;
+  }
+  const auto& open_parent = *open_parent_message;
   const auto item_unique_id = getContainerItemUniqueId(open_parent.container_id);
   if (item_unique_id == common::Item::INVALID_UNIQUE_ID)
   {
@@ -762,7 +1224,13 @@ void ConnectionCtrl::parseOpenParentContainer(network::IncomingPacket* packet)
 
 void ConnectionCtrl::parseLookAt(network::IncomingPacket* packet)
 {
-  const auto look_at = getLookAt(&m_container_ids, packet);
+  const auto look_at_message = getLookAt(&m_container_ids, packet);
+  if (!look_at_message)
+  {
+    disconnect();
+    return;
+  }
+  const auto& look_at = *look_at_message;
 
   LOG_DEBUG("%s: item_position: %s", __func__, look_at.item_position.toString().c_str());
 
@@ -774,7 +1242,18 @@ void ConnectionCtrl::parseLookAt(network::IncomingPacket* packet)
 
 void ConnectionCtrl::parseSay(network::IncomingPacket* packet)
 {
-  const auto say = getSay(packet);
+  const auto say_message = getSay(packet);
+  if (!say_message)
+  {
+    disconnect();
+    return;
+  }
+  const auto& say = *say_message;
+  if (say.message.length() > Say::MAX_MESSAGE_LENGTH)
+  {
+    LOG_ERROR("%s: player id: %d, message too long: %lu", __func__, m_player_id, say.message.length());
+    return;
+  }
 
   m_game_engine_queue->addTask(m_player_id, [this, say](gameengine::GameEngine* game_engine)
   {
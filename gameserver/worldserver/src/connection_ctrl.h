@@ -29,6 +29,7 @@
 #include <functional>
 #include <string>
 #include <memory>
+#include <vector>
 
 // gameengine
 #include "player_ctrl.h"
@@ -36,11 +37,26 @@
 #include "game_position.h"
 #include "container.h"
 
+// network
+#include "connection.h"
+
+// protocol
+#include "protocol_common.h"
+#include "protocol_server.h"
+
 // world
 #include "creature.h"
+#include "creature_ctrl.h"
 #include "position.h"
 #include "item.h"
 
+// utils
+#include "timer_wheel.h"
+#include "token_bucket.h"
+
+// worldserver
+#include "opcode_dispatcher.h"
+
 namespace account
 {
 class AccountReader;
@@ -53,8 +69,8 @@ class GameEngineQueue;
 
 namespace network
 {
-class Connection;
 class IncomingPacket;
+class OutgoingPacket;
 }
 
 namespace world
@@ -65,11 +81,59 @@ class World;
 class ConnectionCtrl : public gameengine::PlayerCtrl
 {
  public:
+  // What to do with a client that doesn't read its packets as fast as they are queued
+  enum class SlowClientPolicy
+  {
+    DROP_UPDATES,  // Drop non-essential updates (creature turns and talk) while congested
+    RESYNC_MAP,    // Drop all map updates while congested, then send the full map
+    DISCONNECT,    // Disconnect the client as soon as it is congested
+  };
+
+  struct SlowClientConfig
+  {
+    network::Connection::QueueLimits queue_limits;
+    SlowClientPolicy policy = SlowClientPolicy::RESYNC_MAP;
+  };
+
+  // Connections are closed if the client has not logged in within login_timeout, or if
+  // a logged in client has not sent anything within idle_timeout
+  // Timeouts are in ticks of the TimerWheel, 0 disables the timeout
+  struct TimeoutConfig
+  {
+    int login_timeout = 0;
+    int idle_timeout = 0;
+  };
+
+  // Limits, in messages per second, of what a logged in client may send, per class of opcodes
+  // Messages above the limit are dropped, and a client that keeps flooding is disconnected
+  // A rate of 0 disables the limit
+  struct RateLimit
+  {
+    int rate = 0;
+    int burst = 0;
+  };
+
+  struct RateLimitConfig
+  {
+    RateLimit movement;  // Move, turn and move click
+    RateLimit action;    // Item and container actions and look at
+    RateLimit chat;      // Say
+    RateLimit control;   // Logout, cancel move and stop actions, should be generous as they stop movement
+    RateLimit flood;     // Dropped messages, the client is disconnected when this is exceeded
+  };
+
   ConnectionCtrl(std::function<void(void)> close_protocol,
                  std::unique_ptr<network::Connection>&& connection,
                  const world::World* world,
+                 protocol::server::TileCache* tile_cache,
                  gameengine::GameEngineQueue* game_engine_queue,
-                 account::AccountReader* account_reader);
+                 account::AccountReader* account_reader,
+                 const SlowClientConfig& slow_client_config,
+                 utils::TimerWheel* timer_wheel,
+                 const TimeoutConfig& timeout_config,
+                 const RateLimitConfig& rate_limit_config);
+
+  ~ConnectionCtrl() override;
 
   // Delete copy constructors
   ConnectionCtrl(const ConnectionCtrl&) = delete;
@@ -85,6 +149,7 @@ class ConnectionCtrl : public gameengine::PlayerCtrl
                       const common::Position& old_position,
                       std::uint8_t old_stackpos,
                       const common::Position& new_position) override;
+  void onCreatureMoves(const std::vector<world::CreatureMoveEvent>& moves) override;
   void onCreatureTurn(const common::Creature& creature,
                       const common::Position& position,
                       std::uint8_t stackpos) override;
@@ -116,6 +181,19 @@ class ConnectionCtrl : public gameengine::PlayerCtrl
   const std::array<common::ItemUniqueId, 64>& getContainerIds() const override { return m_container_ids; }
   bool hasContainerOpen(common::ItemUniqueId item_unique_id) const override;
 
+  // Login attempts on this connection fail from now on, used while draining after a handoff
+  void refuseLogins() { m_refuse_logins = true; }
+
+  // Logs the per-opcode counters, shared by all connections
+  static void logOpcodeStats();
+
+  // Per-opcode counters of this connection, see protocol::server::getTrafficStats for the
+  // per-opcode counters of all connections, and TrafficStats::getTotal for the totals
+  const protocol::server::TrafficStats& getTrafficStats() const { return m_traffic_stats; }
+
+  // Logs the given counters, e.g. protocol::server::getTrafficStats()
+  static void logTrafficStats(const protocol::server::TrafficStats& traffic_stats);
+
  private:
   bool isLoggedIn() const { return m_player_id != common::Creature::INVALID_ID; }
   bool isConnected() const { return static_cast<bool>(m_connection); }
@@ -125,8 +203,45 @@ class ConnectionCtrl : public gameengine::PlayerCtrl
   void parsePacket(network::IncomingPacket* packet);
   void onDisconnected();
 
+  // Login and idle timeout handling
+  void setTimeout(int ticks);
+  void onTimeout();
+
+  // Rate limiting of messages from the client
+  // Returns false if the message should be dropped, and disconnects flooding clients
+  enum class InputClass
+  {
+    MOVEMENT,
+    ACTION,
+    CHAT,
+    CONTROL,
+    UNLIMITED,
+  };
+  static InputClass getInputClass(std::uint8_t opcode);
+  bool checkRateLimit(std::uint8_t opcode, std::int64_t now);
+
+  // Slow client handling
+  // Returns false if the update should be dropped, due to the slow client policy
+  enum class UpdateType
+  {
+    MAP,
+    COSMETIC,
+  };
+  bool canSendUpdate(UpdateType update_type);
+  void sendFullMap();
+
+  // Polls the outgoing queue of the connection, after each sent packet and each tick while
+  // congested, and applies the slow client policy when the connection becomes (un)congested
+  // Note that the connection might be closed during this call
+  void checkCongestion();
+
   // Functions to parse IncomingPackets
   void parseLogin(network::IncomingPacket* packet);
+  void parseLogout(network::IncomingPacket* packet);
+  void parseMove(common::Direction direction);
+  void parseCancelMove(network::IncomingPacket* packet);
+  void parseTurn(common::Direction direction);
+  void parseStopActions(network::IncomingPacket* packet);
   void parseMoveClick(network::IncomingPacket* packet);
   void parseMoveItem(network::IncomingPacket* packet);
   void parseUseItem(network::IncomingPacket* packet);
@@ -135,6 +250,22 @@ class ConnectionCtrl : public gameengine::PlayerCtrl
   void parseLookAt(network::IncomingPacket* packet);
   void parseSay(network::IncomingPacket* packet);
 
+  // Opcode -> parse function table used by parsePacket when logged in
+  static OpcodeDispatcher<ConnectionCtrl>* getOpcodeDispatcher();
+
+  // All packets to the client are sent with sendPacket
+  void sendPacket(network::OutgoingPacket&& packet);
+
+  // Helper function for onCreatureMove and onCreatureMoves
+  // player_position is the position this player had when the move was made
+  // Returns false if the connection was closed
+  bool addCreatureMove(const common::Position& player_position,
+                       const common::Creature& creature,
+                       const common::Position& old_position,
+                       std::uint8_t old_stackpos,
+                       const common::Position& new_position,
+                       network::OutgoingPacket* packet);
+
   // Helper functions for containerId
   void setContainerId(std::uint8_t container_id, common::ItemUniqueId item_unique_id);
   std::uint8_t getContainerId(common::ItemUniqueId item_unique_id) const;
@@ -146,12 +277,31 @@ class ConnectionCtrl : public gameengine::PlayerCtrl
   std::function<void(void)> m_close_protocol;
   std::unique_ptr<network::Connection> m_connection;
   const world::World* m_world;
+  protocol::server::TileCache* m_tile_cache;
   gameengine::GameEngineQueue* m_game_engine_queue;
   account::AccountReader* m_account_reader;
 
   common::CreatureId m_player_id;
 
-  std::array<common::CreatureId, 64> m_known_creatures;
+  protocol::KnownCreatures m_known_creatures;
+
+  SlowClientPolicy m_slow_client_policy;
+  bool m_congested = false;
+  bool m_refuse_logins = false;
+  bool m_map_resync_pending = false;
+  utils::TimerWheel::TimerId m_congestion_timer_id = utils::TimerWheel::INVALID_TIMER_ID;
+  std::uint64_t m_dropped_updates = 0U;
+
+  // Messages are counted by the protocol::server writers and by parsePacket, see countIncoming
+  protocol::server::TrafficStats m_traffic_stats;
+
+  utils::TimerWheel* m_timer_wheel;
+  TimeoutConfig m_timeout_config;
+  utils::TimerWheel::TimerId m_timer_id = utils::TimerWheel::INVALID_TIMER_ID;
+
+  std::array<utils::TokenBucket, 4> m_input_limits;  // Indexed by InputClass
+  utils::TokenBucket m_flood_limit;
+  std::uint64_t m_dropped_inputs = 0U;
 
   // Known/opened containers
   // clientContainerId maps to a container's ItemUniqueId
@@ -0,0 +1,126 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef WORLDSERVER_SRC_OPCODE_DISPATCHER_H_
+#define WORLDSERVER_SRC_OPCODE_DISPATCHER_H_
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <utility>
+
+// network
+#include "incoming_packet.h"
+
+// utils
+#include "logger.h"
+
+// Table of opcode handlers for packets sent by the client
+// Each handler keeps counters of how many times it has been called and how much time it
+// has spent (decoding and handling the message), so that hot opcodes can be found
+// The number of bytes per opcode is counted by protocol::server::countIncoming
+// The counters are shared by all connections that use the same OpcodeDispatcher
+template <typename Owner>
+class OpcodeDispatcher
+{
+ public:
+  using Handler = std::function<void(Owner* owner, std::uint8_t opcode, network::IncomingPacket* packet)>;
+
+  struct Stats
+  {
+    std::uint64_t calls = 0;
+    std::chrono::nanoseconds handler_time = std::chrono::nanoseconds::zero();
+  };
+
+  struct OpcodeHandler
+  {
+    const char* name = nullptr;
+    Handler handler;
+    Stats stats;
+  };
+
+  // Registers the handler for the given opcode, returns false if the opcode
+  // already has a handler
+  bool add(std::uint8_t opcode, const char* name, Handler handler)
+  {
+    auto& opcode_handler = m_handlers[opcode];
+    if (opcode_handler.handler)
+    {
+      LOG_ERROR("%s: opcode 0x%X already registered as %s", __func__, opcode, opcode_handler.name);
+      return false;
+    }
+
+    opcode_handler.name = name;
+    opcode_handler.handler = std::move(handler);
+    return true;
+  }
+
+  // Calls the handler for the given opcode, which should already have been read from
+  // the packet. Returns false if there is no handler for the opcode
+  bool dispatch(Owner* owner, std::uint8_t opcode, network::IncomingPacket* packet)
+  {
+    auto& opcode_handler = m_handlers[opcode];
+    if (!opcode_handler.handler)
+    {
+      return false;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    opcode_handler.handler(owner, opcode, packet);
+
+    opcode_handler.stats.calls += 1;
+    opcode_handler.stats.handler_time += std::chrono::steady_clock::now() - start;
+    return true;
+  }
+
+  const OpcodeHandler& get(std::uint8_t opcode) const { return m_handlers[opcode]; }
+
+  // Calls func(opcode, opcode_handler) for each registered opcode
+  template <typename Func>
+  void forEach(const Func& func) const
+  {
+    for (auto opcode = 0u; opcode < m_handlers.size(); opcode++)
+    {
+      if (m_handlers[opcode].handler)
+      {
+        func(static_cast<std::uint8_t>(opcode), m_handlers[opcode]);
+      }
+    }
+  }
+
+  void resetStats()
+  {
+    for (auto& opcode_handler : m_handlers)
+    {
+      opcode_handler.stats = Stats();
+    }
+  }
+
+ private:
+  std::array<OpcodeHandler, 256> m_handlers;
+};
+
+#endif  // WORLDSERVER_SRC_OPCODE_DISPATCHER_H_
@@ -25,17 +25,22 @@
 #include <deque>
 #include <functional>
 #include <memory>
+#include <string>
+#include <chrono>
 #include <unordered_map>
+#include <vector>
 #include <asio.hpp>
 
 // utils
 #include "config_parser.h"
 #include "logger.h"
+#include "timer_wheel.h"
 
 // account
 #include "account.h"
 
 // network
+#include "handoff.h"
 #include "server_factory.h"
 #include "server.h"
 #include "connection.h"
@@ -44,6 +49,9 @@
 #include "game_engine.h"
 #include "game_engine_queue.h"
 
+// protocol
+#include "protocol_server.h"
+
 // worldserver
 #include "connection_ctrl.h"
 
@@ -52,9 +60,22 @@
 // static things (like Logger) gets deallocated
 static std::unique_ptr<gameengine::GameEngineQueue> game_engine_queue;
 static std::unique_ptr<gameengine::GameEngine> game_engine;
+static std::unique_ptr<protocol::server::TileCache> tile_cache;  // Of the World in game_engine
 static std::unique_ptr<account::AccountReader> account_reader;
 static std::unique_ptr<network::Server> server;
 static std::unique_ptr<network::Server> websocket_server;
+static std::unique_ptr<network::Handoff> handoff;
+static std::unique_ptr<asio::steady_timer> drain_timer;
+static ConnectionCtrl::SlowClientConfig slow_client_config;
+static ConnectionCtrl::TimeoutConfig timeout_config;
+static ConnectionCtrl::RateLimitConfig rate_limit_config;
+
+// Login and idle timeouts of all connections, advanced once per second
+static std::unique_ptr<utils::TimerWheel> timer_wheel;
+static std::unique_ptr<asio::steady_timer> timer_wheel_timer;
+
+// One slot per second, longer timeouts go around the wheel more than once
+constexpr std::size_t TIMER_WHEEL_SLOTS = 64U;
 
 using ConnectionId = int;
 static std::unordered_map<ConnectionId, std::unique_ptr<ConnectionCtrl>> connections;
@@ -73,18 +94,104 @@ void onClientConnected(std::unique_ptr<network::Connection>&& connection)
   {
     LOG_DEBUG("onCloseProtocol: protocol_id: %d", connection_id);
     connections.erase(connection_id);
+
+    // Stop as soon as the last connection is closed after a handoff, see onHandoff
+    if (drain_timer && connections.empty())
+    {
+      drain_timer->cancel();
+    }
   };
   auto connection_ctrl = std::make_unique<ConnectionCtrl>(on_close,
                                                           std::move(connection),
                                                           game_engine->getWorld(),
+                                                          tile_cache.get(),
                                                           game_engine_queue.get(),
-                                                          account_reader.get());
+                                                          account_reader.get(),
+                                                          slow_client_config,
+                                                          timer_wheel.get(),
+                                                          timeout_config,
+                                                          rate_limit_config);
+
+  // Connections that were already being accepted when the sockets were handed off
+  if (drain_timer)
+  {
+    connection_ctrl->refuseLogins();
+  }
 
   connections.emplace(std::piecewise_construct,
                       std::forward_as_tuple(connection_id),
                       std::forward_as_tuple(std::move(connection_ctrl)));
 }
 
+// Called when a new process has taken over the listening sockets
+// Stop accepting connections and logins, and stop when the remaining connections are closed
+// or the drain timeout expires, whichever happens first
+// The servers own the sockets of the remaining connections, so they are only stopped
+// here and deallocated after io_context has stopped
+static void onHandoff(asio::io_context* io_context, int drain_seconds)
+{
+  LOG_INFO("%s: handed off listening sockets, draining %d connections",
+           __func__,
+           static_cast<int>(connections.size()));
+
+  server->stopAccepting();
+  websocket_server->stopAccepting();
+  handoff.reset();
+
+  // Connections that have not logged in yet must log in on the new process
+  for (auto& connection : connections)
+  {
+    connection.second->refuseLogins();
+  }
+
+  drain_timer = std::make_unique<asio::steady_timer>(*io_context);
+  drain_timer->expires_after(std::chrono::seconds(connections.empty() ? 0 : drain_seconds));
+  drain_timer->async_wait([io_context](const std::error_code& error)
+  {
+    LOG_INFO("onHandoff: %s, %d connections left, stopping io_context",
+             (error ? "all connections closed" : "drain timeout"),
+             static_cast<int>(connections.size()));
+    io_context->stop();
+  });
+}
+
+static void startTimerWheelTimer()
+{
+  timer_wheel_timer->expires_after(std::chrono::seconds(1));
+  timer_wheel_timer->async_wait([](const std::error_code& error)
+  {
+    if (error)
+    {
+      // Cancelled
+      return;
+    }
+
+    timer_wheel->advance();
+    startTimerWheelTimer();
+  });
+}
+
+static bool parseSlowClientPolicy(const std::string& policy, ConnectionCtrl::SlowClientPolicy* result)
+{
+  if (policy == "drop_updates")
+  {
+    *result = ConnectionCtrl::SlowClientPolicy::DROP_UPDATES;
+  }
+  else if (policy == "resync_map")
+  {
+    *result = ConnectionCtrl::SlowClientPolicy::RESYNC_MAP;
+  }
+  else if (policy == "disconnect")
+  {
+    *result = ConnectionCtrl::SlowClientPolicy::DISCONNECT;
+  }
+  else
+  {
+    return false;
+  }
+  return true;
+}
+
 int main()
 {
   // Read configuration
@@ -97,7 +204,34 @@ int main()
 
   // Read [server] settings
   const auto server_port = config.getInteger("server", "port", 7172);
+  const auto server_backend = config.getString("server", "backend", "asio");
+  const auto acceptor_threads = config.getInteger("server", "acceptor_threads", 1);
   const auto ws_server_port = server_port + 1000;
+  const auto ws_compression_threshold = config.getInteger("server", "websocket_compression_threshold", 256);
+  const auto queue_high_bytes   = config.getInteger("server", "queue_high_watermark_bytes",   256 * 1024);
+  const auto queue_low_bytes    = config.getInteger("server", "queue_low_watermark_bytes",     64 * 1024);
+  const auto queue_high_packets = config.getInteger("server", "queue_high_watermark_packets", 1024);
+  const auto queue_low_packets  = config.getInteger("server", "queue_low_watermark_packets",   256);
+  const auto slow_client_policy = config.getString("server",  "slow_client_policy",          "resync_map");
+  const auto login_timeout      = config.getInteger("server", "login_timeout_seconds",       10);
+  const auto idle_timeout       = config.getInteger("server", "idle_timeout_seconds",        900);
+  const auto handoff_socket     = config.getString("server",  "handoff_socket",              "");
+  // Note: the processes don't share any state, so a character that is still online in the old
+  // process while it drains can log in on the new process as well, and is then online twice
+  // Keep the drain timeout short if that matters, the old process refuses logins while draining
+  const auto handoff_drain      = config.getInteger("server", "handoff_drain_seconds",       300);
+
+  // Read [rate_limit] settings, in messages per second
+  const auto movement_rate  = config.getInteger("rate_limit", "movement_rate",  20);
+  const auto movement_burst = config.getInteger("rate_limit", "movement_burst", 40);
+  const auto action_rate    = config.getInteger("rate_limit", "action_rate",    10);
+  const auto action_burst   = config.getInteger("rate_limit", "action_burst",   20);
+  const auto chat_rate      = config.getInteger("rate_limit", "chat_rate",      2);
+  const auto chat_burst     = config.getInteger("rate_limit", "chat_burst",     5);
+  const auto control_rate   = config.getInteger("rate_limit", "control_rate",   10);
+  const auto control_burst  = config.getInteger("rate_limit", "control_burst",  20);
+  const auto flood_rate     = config.getInteger("rate_limit", "flood_rate",     1);
+  const auto flood_burst    = config.getInteger("rate_limit", "flood_burst",    50);
 
   // Read [world] settings
   const auto login_message     = config.getString("world", "login_message", "Welcome to LoginServer!");
@@ -129,7 +263,24 @@ int main()
   printf("WorldServer configuration\n");
   printf("--------------------------------------------------------------------------------\n");
   printf("Server port:               %d\n", server_port);
+  printf("Server backend:            %s\n", server_backend.c_str());
+  printf("Acceptor threads:          %d\n", acceptor_threads);
   printf("Websocket server port:     %d\n", ws_server_port);
+  printf("Websocket compression:     %s\n", (ws_compression_threshold > 0 ? "enabled" : "disabled"));
+  printf("Compression threshold:     %d bytes\n", ws_compression_threshold);
+  printf("Queue high watermark:      %d bytes, %d packets\n", queue_high_bytes, queue_high_packets);
+  printf("Queue low watermark:       %d bytes, %d packets\n", queue_low_bytes, queue_low_packets);
+  printf("Slow client policy:        %s\n", slow_client_policy.c_str());
+  printf("Login timeout:             %d seconds\n", login_timeout);
+  printf("Idle timeout:              %d seconds\n", idle_timeout);
+  printf("Handoff socket:            %s\n", (handoff_socket.empty() ? "disabled" : handoff_socket.c_str()));
+  printf("Handoff drain timeout:     %d seconds\n", handoff_drain);
+  printf("\n");
+  printf("Movement rate limit:       %d/s, burst %d\n", movement_rate, movement_burst);
+  printf("Action rate limit:         %d/s, burst %d\n", action_rate, action_burst);
+  printf("Chat rate limit:           %d/s, burst %d\n", chat_rate, chat_burst);
+  printf("Control rate limit:        %d/s, burst %d\n", control_rate, control_burst);
+  printf("Flood limit:               %d/s, burst %d\n", flood_rate, flood_burst);
   printf("\n");
   printf("Login message:             %s\n", login_message.c_str());
   printf("Accounts filename:         %s\n", accounts_filename.c_str());
@@ -146,6 +297,29 @@ int main()
   printf("Worldserver logging:       %s\n", logger_worldserver.c_str());
   printf("--------------------------------------------------------------------------------\n");
 
+  // Set slow client settings
+  if (!parseSlowClientPolicy(slow_client_policy, &slow_client_config.policy))
+  {
+    LOG_ERROR("Invalid slow_client_policy: %s (expected drop_updates, resync_map or disconnect)",
+              slow_client_policy.c_str());
+    return 1;
+  }
+  slow_client_config.queue_limits.high_watermark_bytes   = queue_high_bytes;
+  slow_client_config.queue_limits.low_watermark_bytes    = queue_low_bytes;
+  slow_client_config.queue_limits.high_watermark_packets = queue_high_packets;
+  slow_client_config.queue_limits.low_watermark_packets  = queue_low_packets;
+
+  // Set timeout settings, the timer wheel is advanced once per second
+  timeout_config.login_timeout = login_timeout;
+  timeout_config.idle_timeout  = idle_timeout;
+
+  // Set rate limit settings
+  rate_limit_config.movement = { movement_rate, movement_burst };
+  rate_limit_config.action   = { action_rate,   action_burst };
+  rate_limit_config.chat     = { chat_rate,     chat_burst };
+  rate_limit_config.control  = { control_rate,  control_burst };
+  rate_limit_config.flood    = { flood_rate,    flood_burst };
+
   LOG_INFO("Starting WorldServer!");
 
   asio::io_context io_context;
@@ -163,22 +337,86 @@ int main()
     return 1;
   }
 
+  // The encoded tiles are cached for as long as the World exists
+  tile_cache = std::make_unique<protocol::server::TileCache>();
+
   // Create and load AccountReader
   account_reader = std::make_unique<account::AccountReader>();
   if (!account_reader->load(accounts_filename))
   {
     LOG_ERROR("Could not load accounts file: %s", accounts_filename.c_str());
     account_reader.reset();
+    tile_cache.reset();
     game_engine.reset();
     game_engine_queue.reset();
     return 1;
   }
 
+  // Create TimerWheel
+  timer_wheel = std::make_unique<utils::TimerWheel>(TIMER_WHEEL_SLOTS);
+  timer_wheel_timer = std::make_unique<asio::steady_timer>(io_context);
+  startTimerWheelTimer();
+
+  // Take over the listening sockets from a running WorldServer, if any
+  // This blocks until the old process has stopped accepting connections
+  std::vector<int> listening_sockets;
+  if (!handoff_socket.empty() && network::Handoff::receive(handoff_socket, &listening_sockets))
+  {
+    if (server_backend != "asio")
+    {
+      LOG_INFO("Using asio backend for handed off sockets");
+    }
+    server = network::ServerFactory::createServerFromSockets(&io_context, listening_sockets, &onClientConnected);
+  }
+
   // Create Server
-  server = network::ServerFactory::createServer(&io_context, server_port, &onClientConnected);
+  if (server)
+  {
+    // Already created from handed off sockets
+  }
+  else if (server_backend == "io_uring")
+  {
+    server = network::ServerFactory::createIoUringServer(&io_context, server_port, &onClientConnected);
+    if (!server)
+    {
+      LOG_ERROR("Could not create io_uring server, falling back to asio");
+    }
+  }
+  else if (server_backend != "asio")
+  {
+    LOG_ERROR("Invalid backend: %s (expected asio or io_uring), using asio", server_backend.c_str());
+  }
+
+  if (!server)
+  {
+    // With more than one acceptor thread the port is opened once per thread using SO_REUSEPORT
+    if (acceptor_threads > 1)
+    {
+      server = network::ServerFactory::createMultiAcceptorServer(&io_context,
+                                                                 server_port,
+                                                                 acceptor_threads,
+                                                                 &onClientConnected);
+    }
+    else
+    {
+      server = network::ServerFactory::createServer(&io_context, server_port, &onClientConnected);
+    }
+  }
 
   // Create websocket server
-  websocket_server = network::ServerFactory::createWebsocketServer(&io_context, ws_server_port, &onClientConnected);
+  websocket_server = network::ServerFactory::createWebsocketServer(&io_context,
+                                                                   ws_server_port,
+                                                                   ws_compression_threshold,
+                                                                   &onClientConnected);
+
+  // Let the next WorldServer take over the listening sockets
+  if (!handoff_socket.empty())
+  {
+    handoff = network::Handoff::listen(&io_context,
+                                       handoff_socket,
+                                       []() { return server->getListeningSockets(); },
+                                       [&io_context, handoff_drain]() { onHandoff(&io_context, handoff_drain); });
+  }
 
   LOG_INFO("WorldServer started!");
 
@@ -196,11 +434,19 @@ int main()
 
   LOG_INFO("Stopping WorldServer!");
 
+  ConnectionCtrl::logOpcodeStats();
+  ConnectionCtrl::logTrafficStats(protocol::server::getTrafficStats());
+
   // Deallocate things (in reverse order of construction)
   connections.clear();
+  timer_wheel_timer.reset();
+  timer_wheel.reset();
+  drain_timer.reset();
+  handoff.reset();
   websocket_server.reset();
   server.reset();
   account_reader.reset();
+  tile_cache.reset();
   game_engine.reset();
   game_engine_queue.reset();
 
@@ -0,0 +1,117 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "opcode_dispatcher.h"
+
+#include <cstdint>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "incoming_packet.h"
+
+namespace
+{
+
+struct Owner
+{
+  std::vector<std::uint8_t> opcodes;
+  std::vector<std::uint8_t> values;
+};
+
+void readValue(Owner* owner, std::uint8_t opcode, network::IncomingPacket* packet)
+{
+  owner->opcodes.push_back(opcode);
+  owner->values.push_back(packet->getU8());
+}
+
+}  // namespace
+
+TEST(OpcodeDispatcherTest, Register)
+{
+  OpcodeDispatcher<Owner> dispatcher;
+  ASSERT_TRUE(dispatcher.add(0x10, "first", &readValue));
+  ASSERT_TRUE(dispatcher.add(0x20, "second", &readValue));
+
+  // An opcode can only be registered once
+  ASSERT_FALSE(dispatcher.add(0x10, "again", &readValue));
+  ASSERT_STREQ("first", dispatcher.get(0x10).name);
+
+  std::vector<std::uint8_t> opcodes;
+  dispatcher.forEach([&opcodes](std::uint8_t opcode, const OpcodeDispatcher<Owner>::OpcodeHandler&)
+  {
+    opcodes.push_back(opcode);
+  });
+  ASSERT_EQ(std::vector<std::uint8_t>({ 0x10, 0x20 }), opcodes);
+}
+
+TEST(OpcodeDispatcherTest, Dispatch)
+{
+  OpcodeDispatcher<Owner> dispatcher;
+  ASSERT_TRUE(dispatcher.add(0x10, "first", &readValue));
+  ASSERT_TRUE(dispatcher.add(0x20, "second", &readValue));
+
+  // The opcode has already been read from the packet when dispatch is called
+  const std::vector<std::uint8_t> data = { 0x10, 0x01, 0x20, 0x02, 0x10, 0x03, 0x30, 0x04 };
+  network::IncomingPacket packet(data.data(), data.size());
+  Owner owner;
+  ASSERT_TRUE(dispatcher.dispatch(&owner, packet.getU8(), &packet));
+  ASSERT_TRUE(dispatcher.dispatch(&owner, packet.getU8(), &packet));
+  ASSERT_TRUE(dispatcher.dispatch(&owner, packet.getU8(), &packet));
+
+  // Unknown opcode, the packet is left as is
+  ASSERT_FALSE(dispatcher.dispatch(&owner, packet.getU8(), &packet));
+  ASSERT_EQ(1U, packet.bytesLeft());
+
+  ASSERT_EQ(std::vector<std::uint8_t>({ 0x10, 0x20, 0x10 }), owner.opcodes);
+  ASSERT_EQ(std::vector<std::uint8_t>({ 0x01, 0x02, 0x03 }), owner.values);
+}
+
+TEST(OpcodeDispatcherTest, Stats)
+{
+  OpcodeDispatcher<Owner> dispatcher;
+  ASSERT_TRUE(dispatcher.add(0x10, "first", &readValue));
+  ASSERT_TRUE(dispatcher.add(0x20, "second", &readValue));
+
+  const std::vector<std::uint8_t> data = { 0x01, 0x02, 0x03 };
+  network::IncomingPacket packet(data.data(), data.size());
+  Owner owner;
+  dispatcher.dispatch(&owner, 0x10, &packet);
+  dispatcher.dispatch(&owner, 0x10, &packet);
+  dispatcher.dispatch(&owner, 0x20, &packet);
+  dispatcher.dispatch(&owner, 0x30, &packet);
+
+  EXPECT_EQ(2U, dispatcher.get(0x10).stats.calls);
+  EXPECT_EQ(1U, dispatcher.get(0x20).stats.calls);
+  EXPECT_EQ(0U, dispatcher.get(0x30).stats.calls);
+  EXPECT_LE(std::chrono::nanoseconds::zero(), dispatcher.get(0x10).stats.handler_time);
+
+  dispatcher.resetStats();
+  EXPECT_EQ(0U, dispatcher.get(0x10).stats.calls);
+  EXPECT_EQ(0U, dispatcher.get(0x20).stats.calls);
+  EXPECT_EQ(std::chrono::nanoseconds::zero(), dispatcher.get(0x10).stats.handler_time);
+
+  // Handlers are kept
+  ASSERT_TRUE(dispatcher.get(0x10).handler);
+}
@@ -0,0 +1,569 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Headless load generator for the worldserver. Logs in a number of characters over
+// the websocket port and lets each of them walk random paths, say things and move
+// items on the ground around them. The time from sending an action until the server
+// responds to it is recorded, and latency percentiles per action are printed at the end.
+//
+// Usage: botclient [bots] [seconds] [character name] [password] [uri]
+//
+// The character name may contain %d, which is replaced by the bot index (starting at 0),
+// and all characters must exist in the worldserver's accounts file.
+//
+// Note that walk latency includes the time the server waits before the character is
+// allowed to move again, so it depends on the character's speed and the ground type.
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <asio.hpp>
+
+// network
+#include "client_factory.h"
+#include "connection.h"
+#include "outgoing_packet.h"
+#include "incoming_packet.h"
+
+// protocol
+#include "protocol_common.h"
+#include "protocol_client.h"
+#include "protocol_schemas.h"
+
+// utils
+#include "data_loader.h"
+#include "logger.h"
+
+// common
+#include "position.h"
+
+// wsclient
+#include "packet_dispatcher.h"
+#include "wsworld.h"
+
+namespace wsclient::bot
+{
+
+constexpr auto DATA_FILENAME = "files/data.dat";
+
+// Time between receiving the response to an action and sending the next one
+constexpr auto THINK_TIME_MIN_MS = 100;
+constexpr auto THINK_TIME_MAX_MS = 1000;
+
+// An action without a response within this time is counted as timed out
+// Note that the server does not respond at all to some invalid actions, e.g. moving
+// an item to a tile where it does not fit
+constexpr auto ACTION_TIMEOUT_MS = 5000;
+
+enum class Action
+{
+  LOGIN,
+  WALK,
+  SAY,
+  MOVE_ITEM,
+  NUM_ACTIONS
+};
+
+constexpr std::array<const char*, static_cast<std::size_t>(Action::NUM_ACTIONS)> ACTION_NAMES =
+{
+  "login",
+  "walk",
+  "say",
+  "move item",
+};
+
+constexpr std::array<const char*, 5> MESSAGES =
+{
+  "hello",
+  "anyone here?",
+  "nice weather today",
+  "where is the depot?",
+  "selling stuff, cheap!",
+};
+
+class Stats
+{
+ public:
+  void addLatency(Action action, std::chrono::microseconds latency)
+  {
+    m_actions[static_cast<std::size_t>(action)].latencies.push_back(latency.count());
+  }
+
+  void addTimeout(Action action)
+  {
+    ++m_actions[static_cast<std::size_t>(action)].timeouts;
+  }
+
+  void addFailure(Action action)
+  {
+    ++m_actions[static_cast<std::size_t>(action)].failures;
+  }
+
+  void print(double elapsed_seconds)
+  {
+    printf("%-10s %8s %8s %8s %8s %10s %10s %10s %10s\n",
+           "action", "count", "per sec", "timeout", "failed", "p50 (ms)", "p90 (ms)", "p99 (ms)", "max (ms)");
+    for (auto i = 0U; i < m_actions.size(); ++i)
+    {
+      auto& latencies = m_actions[i].latencies;
+      std::sort(latencies.begin(), latencies.end());
+      const auto percentile = [&latencies](double p)
+      {
+        if (latencies.empty())
+        {
+          return 0.0;
+        }
+        return static_cast<double>(latencies[static_cast<std::size_t>(p * static_cast<double>(latencies.size() - 1U))]) / 1000.0;
+      };
+
+      printf("%-10s %8zu %8.1f %8u %8u %10.2f %10.2f %10.2f %10.2f\n",
+             ACTION_NAMES[i],
+             latencies.size(),
+             static_cast<double>(latencies.size()) / elapsed_seconds,
+             m_actions[i].timeouts,
+             m_actions[i].failures,
+             percentile(0.50),
+             percentile(0.90),
+             percentile(0.99),
+             percentile(1.00));
+    }
+  }
+
+ private:
+  struct ActionStats
+  {
+    std::vector<std::int64_t> latencies;  // us
+    unsigned timeouts = 0U;
+    unsigned failures = 0U;
+  };
+
+  std::array<ActionStats, static_cast<std::size_t>(Action::NUM_ACTIONS)> m_actions;
+};
+
+class Bot : public PacketHandler
+{
+ public:
+  Bot(asio::io_context* io_context,
+      const utils::data_loader::ItemTypes* itemtypes,
+      std::string uri,
+      std::string name,
+      std::string password,
+      Stats* stats)
+      : m_io_context(io_context),
+        m_uri(std::move(uri)),
+        m_name(std::move(name)),
+        m_password(std::move(password)),
+        m_stats(stats),
+        m_think_timer(*io_context),
+        m_timeout_timer(*io_context),
+        m_random(std::random_device()())
+  {
+    m_map.setItemTypes(itemtypes);
+  }
+
+  // Bots are referenced from asio handlers, so they must not be copied or moved
+  Bot(const Bot&) = delete;
+  Bot& operator=(const Bot&) = delete;
+
+  void start()
+  {
+    network::ClientFactory::Callbacks callbacks =
+    {
+      [this](std::unique_ptr<network::Connection>&& connection) { onConnected(std::move(connection)); },
+      [this]()
+      {
+        LOG_ERROR("%s: %s: could not connect", __func__, m_name.c_str());
+        m_stats->addFailure(Action::LOGIN);
+      },
+    };
+    if (!network::ClientFactory::createWebsocketClient(m_io_context, m_uri, callbacks))
+    {
+      LOG_ERROR("%s: %s: could not create connection", __func__, m_name.c_str());
+      m_stats->addFailure(Action::LOGIN);
+    }
+  }
+
+  void stop()
+  {
+    m_stopping = true;
+    m_think_timer.cancel();
+    m_timeout_timer.cancel();
+    if (m_connection)
+    {
+      m_connection->close(false);
+    }
+  }
+
+ private:
+  void onConnected(std::unique_ptr<network::Connection>&& connection)
+  {
+    m_connection = std::move(connection);
+    network::Connection::Callbacks callbacks =
+    {
+      [this](network::IncomingPacket* packet) { handlePacket(packet); },
+      [this]() { onDisconnected(); },
+    };
+    m_connection->init(callbacks, false);
+
+    if (m_stopping)
+    {
+      m_connection->close(false);
+      return;
+    }
+
+    network::OutgoingPacket packet;
+    packet.addU8(0x0A);
+    protocol::server::LoginSchema::encode({ 0U, 2U, 760U, 0U, m_name, m_password }, &packet);
+    beginAction(Action::LOGIN);
+    m_connection->sendPacket(std::move(packet));
+  }
+
+  void onDisconnected()
+  {
+    if (!m_stopping)
+    {
+      LOG_ERROR("%s: %s: disconnected", __func__, m_name.c_str());
+    }
+    m_think_timer.cancel();
+    m_timeout_timer.cancel();
+    m_connection.reset();
+  }
+
+  void beginAction(Action action)
+  {
+    m_pending_action = action;
+    m_action_start = std::chrono::steady_clock::now();
+    m_timeout_timer.expires_after(std::chrono::milliseconds(ACTION_TIMEOUT_MS));
+    m_timeout_timer.async_wait([this](const asio::error_code& ec)
+    {
+      if (ec || m_stopping || !m_pending_action)
+      {
+        return;
+      }
+      m_stats->addTimeout(*m_pending_action);
+      m_pending_action.reset();
+      scheduleAction();
+    });
+  }
+
+  void endAction(Action action)
+  {
+    if (m_pending_action != action)
+    {
+      return;
+    }
+
+    const auto latency = std::chrono::steady_clock::now() - m_action_start;
+    m_stats->addLatency(action, std::chrono::duration_cast<std::chrono::microseconds>(latency));
+    m_pending_action.reset();
+    m_timeout_timer.cancel();
+    scheduleAction();
+  }
+
+  void scheduleAction()
+  {
+    if (m_stopping || !m_connection)
+    {
+      return;
+    }
+
+    std::uniform_int_distribution<int> think_time(THINK_TIME_MIN_MS, THINK_TIME_MAX_MS);
+    m_think_timer.expires_after(std::chrono::milliseconds(think_time(m_random)));
+    m_think_timer.async_wait([this](const asio::error_code& ec)
+    {
+      if (ec || m_stopping || !m_connection)
+      {
+        return;
+      }
+
+      // Mostly walk, but say something or move an item now and then
+      // Fall back to walking if there is no item to move
+      std::uniform_int_distribution<int> dist(0, 9);
+      const auto roll = dist(m_random);
+      if ((roll == 0 && sendSay()) || (roll <= 2 && sendMoveItem()))
+      {
+        return;
+      }
+      sendWalk();
+    });
+  }
+
+  bool sendWalk()
+  {
+    // Keep walking in the same direction for a while to get longer paths
+    std::uniform_int_distribution<int> dist(0, 3);
+    if (dist(m_random) == 0)
+    {
+      m_direction = static_cast<common::Direction>(dist(m_random));
+    }
+
+    network::OutgoingPacket packet;
+    packet.addU8(0x65 + static_cast<std::uint8_t>(m_direction));
+    beginAction(Action::WALK);
+    m_connection->sendPacket(std::move(packet));
+    return true;
+  }
+
+  bool sendSay()
+  {
+    std::uniform_int_distribution<std::size_t> dist(0U, MESSAGES.size() - 1U);
+
+    network::OutgoingPacket packet;
+    packet.addU8(0x96);
+    protocol::server::SaySchema::encode({ 0x01, "", 0U, MESSAGES[dist(m_random)] }, &packet);
+    beginAction(Action::SAY);
+    m_connection->sendPacket(std::move(packet));
+    return true;
+  }
+
+  bool sendMoveItem()
+  {
+    // Find a movable item on the top of a tile next to (or below) the player
+    // and move it to a random tile next to the player
+    const auto& player_position = m_map.getPlayerPosition();
+    std::vector<std::pair<common::Position, std::uint8_t>> candidates;
+    for (auto dx = -1; dx <= 1; ++dx)
+    {
+      for (auto dy = -1; dy <= 1; ++dy)
+      {
+        const common::Position position(player_position.getX() + dx,
+                                        player_position.getY() + dy,
+                                        player_position.getZ());
+        const auto* tile = m_map.getTile(position);
+        if (!tile || tile->things.empty())
+        {
+          continue;
+        }
+
+        // Only the item with the highest stackpos can be moved without looking
+        // below creatures and other items, so check the last thing
+        const auto& thing = tile->things.back();
+        if (!std::holds_alternative<wsworld::Item>(thing))
+        {
+          continue;
+        }
+        const auto* type = std::get<wsworld::Item>(thing).type;
+        if (type->is_ground || type->is_immovable)
+        {
+          continue;
+        }
+        candidates.emplace_back(position, static_cast<std::uint8_t>(tile->things.size() - 1U));
+      }
+    }
+
+    if (candidates.empty())
+    {
+      return false;
+    }
+
+    std::uniform_int_distribution<std::size_t> candidate(0U, candidates.size() - 1U);
+    const auto& [from_position, stackpos] = candidates[candidate(m_random)];
+    const auto* tile = m_map.getTile(from_position);
+    const auto* type = std::get<wsworld::Item>(tile->things.back()).type;
+
+    std::uniform_int_distribution<int> offset(-1, 1);
+    const common::Position to_position(player_position.getX() + offset(m_random),
+                                       player_position.getY() + offset(m_random),
+                                       player_position.getZ());
+    if (to_position == from_position)
+    {
+      return false;
+    }
+
+    network::OutgoingPacket packet;
+    packet.addU8(0x78);
+    protocol::addPosition(from_position, &packet);
+    packet.add(type->id);
+    packet.add(stackpos);
+    protocol::addPosition(to_position, &packet);
+    packet.addU8(1U);  // count
+    m_move_item_from = from_position;
+    beginAction(Action::MOVE_ITEM);
+    m_connection->sendPacket(std::move(packet));
+    return true;
+  }
+
+  void handlePacket(network::IncomingPacket* packet)
+  {
+    if (!dispatchPacket(packet, &m_map, this))
+    {
+      // The rest of the packet can't be parsed, so the map is no longer
+      // in sync with the server and the bot has to give up
+      LOG_ERROR("%s: %s: could not handle packet", __func__, m_name.c_str());
+      stop();
+    }
+  }
+
+  // PacketHandler
+  void onLogin(const protocol::client::Login& login) override
+  {
+    (void)login;
+    endAction(Action::LOGIN);
+  }
+
+  void onLoginFailed(const protocol::client::LoginFailed& failed) override
+  {
+    LOG_ERROR("%s: %s: could not login: %s", __func__, m_name.c_str(), failed.reason.c_str());
+    m_pending_action.reset();
+    m_stats->addFailure(Action::LOGIN);
+    stop();
+  }
+
+  void onPartialMap(common::Direction direction) override
+  {
+    (void)direction;
+    endAction(Action::WALK);
+  }
+
+  void onThingMoved(const protocol::client::ThingMoved& thing_moved) override
+  {
+    if (thing_moved.old_position == m_move_item_from)
+    {
+      endAction(Action::MOVE_ITEM);
+    }
+  }
+
+  void onThingRemoved(const protocol::client::ThingRemoved& thing_removed) override
+  {
+    if (thing_removed.position == m_move_item_from)
+    {
+      endAction(Action::MOVE_ITEM);
+    }
+  }
+
+  void onTalk(const std::string& talker, const std::string& text) override
+  {
+    (void)text;
+    if (talker == m_name)
+    {
+      endAction(Action::SAY);
+    }
+  }
+
+  void onCancelWalk() override
+  {
+    // The server responded but the player did not move
+    endAction(Action::WALK);
+  }
+
+  asio::io_context* m_io_context;
+  std::string m_uri;
+  std::string m_name;
+  std::string m_password;
+  Stats* m_stats;
+
+  std::unique_ptr<network::Connection> m_connection;
+  wsworld::Map m_map;
+  bool m_stopping = false;
+
+  asio::steady_timer m_think_timer;
+  asio::steady_timer m_timeout_timer;
+  std::optional<Action> m_pending_action;
+  std::chrono::steady_clock::time_point m_action_start;
+
+  std::mt19937 m_random;
+  common::Direction m_direction = common::Direction::NORTH;
+  common::Position m_move_item_from = { 0, 0, 0 };
+};
+
+}  // namespace wsclient::bot
+
+int main(int argc, char* argv[])
+{
+  if (argc > 1 && (std::string(argv[1]) == "-h" || std::string(argv[1]) == "--help"))
+  {
+    fprintf(stderr, "Usage: %s [bots] [seconds] [character name] [password] [uri]\n", argv[0]);
+    return 1;
+  }
+
+  const auto num_bots = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10UL;
+  const auto seconds = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 60UL;
+  const std::string name_format = argc > 3 ? argv[3] : "Bot %d";
+  const std::string password = argc > 4 ? argv[4] : "1";
+  const std::string uri = argc > 5 ? argv[5] : "ws://localhost:8172";
+
+  utils::Logger::setLevel("network", utils::Logger::Level::INFO);
+
+  utils::data_loader::ItemTypes itemtypes;
+  if (!utils::data_loader::load(wsclient::bot::DATA_FILENAME, &itemtypes, nullptr, nullptr))
+  {
+    LOG_ERROR("%s: could not load data file: %s", __func__, wsclient::bot::DATA_FILENAME);
+    return 1;
+  }
+  protocol::setItemTypes(&itemtypes);
+
+  asio::io_context io_context;
+  wsclient::bot::Stats stats;
+
+  std::vector<std::unique_ptr<wsclient::bot::Bot>> bots;
+  for (auto i = 0UL; i < num_bots; ++i)
+  {
+    // The name is not used as a format string, as it comes from the command line
+    auto name = name_format;
+    const auto index_position = name.find("%d");
+    if (index_position != std::string::npos)
+    {
+      name.replace(index_position, 2U, std::to_string(i));
+    }
+    bots.push_back(std::make_unique<wsclient::bot::Bot>(&io_context, &itemtypes, uri, name, password, &stats));
+    bots.back()->start();
+  }
+
+  asio::steady_timer stop_timer(io_context);
+  stop_timer.expires_after(std::chrono::seconds(seconds));
+  stop_timer.async_wait([&bots](const asio::error_code& ec)
+  {
+    if (ec)
+    {
+      return;
+    }
+
+    LOG_INFO("%s: stopping bots", __func__);
+    for (auto& bot : bots)
+    {
+      bot->stop();
+    }
+  });
+
+  const auto start = std::chrono::steady_clock::now();
+  io_context.run();
+  const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  printf("bots:    %lu\n", num_bots);
+  printf("elapsed: %.1f s\n", elapsed);
+  stats.print(elapsed);
+
+  return 0;
+}
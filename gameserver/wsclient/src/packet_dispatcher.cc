@@ -0,0 +1,344 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "packet_dispatcher.h"
+
+#include "incoming_packet.h"
+#include "logger.h"
+#include "position.h"
+#include "protocol_common.h"
+
+namespace wsclient
+{
+
+namespace
+{
+
+// Number of floors sent in a floor change (0xBE up, 0xBF down) when the player is at z
+// Moved up from underground to sea level:     read 6 floors
+// Moved up from underground to underground:   read 1 floor
+// Moved down from sea level to underground:   read 3 floors
+// Moved down from underground to underground: read 1 floor, unless we are on z=14 or z=15 then read 0 floors
+// Moved up/down from sea level to sea level:  read 0 floors
+int getFloorChangeNumFloors(bool up, int z)
+{
+  return (( up && z == 8) ? 6 :
+         (( up && z  > 8) ? 1 :
+         ((!up && z == 7) ? 3 :
+         ((!up && z  > 7 && z < 13) ? 1 : (0)))));
+}
+
+}  // namespace
+
+bool dispatchPacket(network::IncomingPacket* packet, wsworld::Map* map, PacketHandler* handler)
+{
+  while (!packet->isEmpty())
+  {
+    const auto type = packet->getU8();
+    LOG_DEBUG("%s: type: 0x%02X", __func__, type);
+    switch (type)
+    {
+      case 0x0A:
+      {
+        const auto login = protocol::client::getLogin(packet);
+        map->setPlayerId(login.player_id);
+        handler->onLogin(login);
+        break;
+      }
+
+      case 0x0B:
+        // GM actions
+        for (auto i = 0; i < 32; ++i)
+        {
+          packet->getU8();
+        }
+        break;
+
+      case 0x14:
+        handler->onLoginFailed(protocol::client::getLoginFailed(packet));
+        break;
+
+      case 0x64:
+        map->parseFullMap(packet);
+        break;
+
+      case 0x65:
+      case 0x66:
+      case 0x67:
+      case 0x68:
+      {
+        const auto direction = static_cast<common::Direction>(type - 0x65);
+        map->parsePartialMap(direction, packet);
+        handler->onPartialMap(direction);
+        break;
+      }
+
+      case 0x69:
+        map->updateTile(protocol::client::getTileUpdate(packet));
+        break;
+
+      case 0x6A:
+      {
+        const auto thing_added = protocol::client::getThingAdded(packet);
+        map->addProtocolThing(thing_added.position, thing_added.thing);
+        break;
+      }
+
+      case 0x6B:
+      {
+        const auto thing_changed = protocol::client::getThingChanged(packet);
+        map->updateThing(thing_changed.position, thing_changed.stackpos, thing_changed.thing);
+        break;
+      }
+
+      case 0x6C:
+      {
+        const auto thing_removed = protocol::client::getThingRemoved(packet);
+        map->removeThing(thing_removed.position, thing_removed.stackpos);
+        handler->onThingRemoved(thing_removed);
+        break;
+      }
+
+      case 0x6D:
+      {
+        const auto thing_moved = protocol::client::getThingMoved(packet);
+        map->moveThing(thing_moved.old_position, thing_moved.old_stackpos, thing_moved.new_position);
+        handler->onThingMoved(thing_moved);
+        break;
+      }
+
+      case 0x6E:
+      {
+        // open container
+        packet->getU8();  // container id
+        protocol::getItem(packet);  // container item
+        packet->getString();  // container name
+        packet->getU8();  // capacity / slots
+        packet->getU8();  // 0 = no parent, else has parent
+        auto num_items = packet->getU8();
+        while (num_items-- > 0)
+        {
+          protocol::getItem(packet);
+        }
+        break;
+      }
+
+      case 0x6F:
+        // close container
+        packet->getU8();  // container id
+        break;
+
+      case 0x70:
+        // container add item
+        packet->getU8();  // container id
+        protocol::getItem(packet);
+        break;
+
+      case 0x71:
+        // container update item
+        packet->getU8();  // container id
+        packet->getU8();  // slot
+        protocol::getItem(packet);
+        break;
+
+      case 0x72:
+        // container remove item
+        packet->getU8();  // container id
+        packet->getU8();  // slot
+        break;
+
+      case 0x78:
+      case 0x79:
+        protocol::client::getEquipment(type == 0x78, packet);
+        break;
+
+      case 0x82:
+        protocol::client::getWorldLight(packet);
+        break;
+
+      case 0x83:
+        protocol::client::getMagicEffect(packet);
+        break;
+
+      case 0x84:
+        // animated text
+        protocol::getPosition(packet);
+        packet->getU8();  // color
+        packet->getString();  // text
+        break;
+
+      case 0x85:
+        // missile
+        protocol::getPosition(packet);  // from
+        protocol::getPosition(packet);  // to
+        packet->getU8();  // missile id
+        break;
+
+      case 0x86:
+        // mark creature
+        packet->getU32();  // creature id
+        packet->getU8();  // color
+        break;
+
+      case 0x8C:
+        // creature health
+        packet->getU32();  // creature id
+        packet->getU8();  // health percent
+        break;
+
+      case 0x8D:
+        // creature light
+        packet->getU32();  // creature id
+        packet->getU8();  // light intensity
+        packet->getU8();  // light color
+        break;
+
+      case 0x8F:
+        // creature speed
+        packet->getU32();  // creature id
+        packet->getU16();  // speed
+        break;
+
+      case 0x90:
+      {
+        const auto creature_skull = protocol::client::getCreatureSkull(packet);
+        map->setCreatureSkull(creature_skull.creature_id, creature_skull.skull);
+        break;
+      }
+
+      case 0x91:
+        // player shield icon
+        packet->getU32();  // creature id
+        packet->getU8();  // shield icon
+        break;
+
+      case 0xA0:
+        protocol::client::getPlayerStats(packet);
+        break;
+
+      case 0xA1:
+        protocol::client::getPlayerSkills(packet);
+        break;
+
+      case 0xA2:
+        // player state
+        packet->getU8();
+        break;
+
+      case 0xA3:
+        // cancel attack
+        break;
+
+      case 0xAA:
+      {
+        // talk
+        const auto talker = packet->getString();
+        const auto talk_type = packet->getU8();
+        switch (talk_type)
+        {
+          case 1:  // say
+          case 2:  // whisper
+          case 3:  // yell
+          case 16:  // monster?
+          case 17:  // monster?
+            protocol::getPosition(packet);
+            break;
+
+          case 5:   // channel
+          case 10:  // gm?
+          case 14:  // ??
+            packet->getU16();  // channel id?
+            break;
+
+          case 4:  // whisper?
+            break;
+
+          default:
+            LOG_ERROR("%s: unknown talk type: %u", __func__, talk_type);
+            break;
+        }
+        const auto text = packet->getString();
+        handler->onTalk(talker, text);
+        break;
+      }
+
+      case 0xAC:
+      {
+        // open channel
+        const auto channel_id = packet->getU16();
+        const auto name = packet->getString();
+        handler->onOpenChannel(channel_id, name);
+        break;
+      }
+
+      case 0xAD:
+        // open private channel
+        packet->getString();
+        break;
+
+      case 0xB4:
+        handler->onTextMessage(protocol::client::getTextMessage(packet));
+        break;
+
+      case 0xB5:
+        // cancel walk
+        packet->getU8();  // direction -> change player to this direction
+        handler->onCancelWalk();
+        break;
+
+      case 0xBE:
+      case 0xBF:
+      {
+        const auto up = type == 0xBE;
+        const auto num_floors = getFloorChangeNumFloors(up, map->getPlayerPosition().getZ());
+        map->parseFloorChange(up, num_floors, packet);
+        break;
+      }
+
+      case 0xD2:
+        // add name to VIP list
+        packet->getU32();  // id
+        packet->getString();  // name
+        packet->getU8();  // status
+        break;
+
+      case 0xD4:
+        // vip logout
+        packet->getU32();  // vip id
+        break;
+
+      default:
+        LOG_ERROR("%s: unknown packet type: 0x%X at position %u (position %u with packet header)",
+                  __func__,
+                  type,
+                  packet->getPosition() - 1,
+                  packet->getPosition() + 1);
+        return false;
+    }
+  }
+
+  return true;
+}
+
+}  // namespace wsclient
@@ -0,0 +1,72 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef WSCLIENT_SRC_PACKET_DISPATCHER_H_
+#define WSCLIENT_SRC_PACKET_DISPATCHER_H_
+
+#include <cstdint>
+#include <string>
+
+#include "protocol_client.h"
+#include "wsworld.h"
+
+namespace network
+{
+class IncomingPacket;
+}
+
+namespace wsclient
+{
+
+/**
+ * class PacketHandler
+ *
+ * Notified by dispatchPacket about the messages that a client may want to act on.
+ * Messages that change the map are applied to the wsworld::Map before the handler is
+ * called, and messages that are only parsed to get past them are not passed on at all.
+ */
+class PacketHandler
+{
+ public:
+  virtual ~PacketHandler() = default;
+
+  virtual void onLogin(const protocol::client::Login& login) { (void)login; }
+  virtual void onLoginFailed(const protocol::client::LoginFailed& failed) { (void)failed; }
+  virtual void onPartialMap(common::Direction direction) { (void)direction; }
+  virtual void onThingMoved(const protocol::client::ThingMoved& thing_moved) { (void)thing_moved; }
+  virtual void onThingRemoved(const protocol::client::ThingRemoved& thing_removed) { (void)thing_removed; }
+  virtual void onOpenChannel(std::uint16_t channel_id, const std::string& name) { (void)channel_id; (void)name; }
+  virtual void onTalk(const std::string& talker, const std::string& text) { (void)talker; (void)text; }
+  virtual void onTextMessage(const protocol::client::TextMessage& message) { (void)message; }
+  virtual void onCancelWalk() {}
+};
+
+// Parses all messages in the packet, applies them to map and notifies handler
+// Returns false if the packet contains an unknown message, then the rest of the packet
+// can't be parsed and the map is no longer in sync with the server
+bool dispatchPacket(network::IncomingPacket* packet, wsworld::Map* map, PacketHandler* handler);
+
+}  // namespace wsclient
+
+#endif  // WSCLIENT_SRC_PACKET_DISPATCHER_H_
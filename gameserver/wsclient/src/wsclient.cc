@@ -55,6 +55,7 @@
 
 // wsclient
 #include "graphics.h"
+#include "packet_dispatcher.h"
 #include "wsworld.h"
 #include "types.h"
 
@@ -66,90 +67,31 @@ utils::data_loader::ItemTypes itemtypes;
 wsworld::Map map;
 int num_received_packets = 0;
 
-void handleLoginPacket(const protocol::client::Login& login)
+// Logs the messages that are not shown in the client
+class LoggingPacketHandler : public PacketHandler
 {
-  map.setPlayerId(login.player_id);
-}
-
-void handleLoginFailedPacket(const protocol::client::LoginFailed& failed)
-{
-  LOG_ERROR("Could not login: %s", failed.reason.c_str());
-}
-
-void handleFullMapPacket(const protocol::client::FullMap& map_data)
-{
-  map.setFullMapData(map_data);
-}
-
-void handlePartialMapPacket(const protocol::client::PartialMap& map_data)
-{
-  map.setPartialMapData(map_data);
-}
-
-void handleTileUpdatePacket(const protocol::client::TileUpdate& tile_update)
-{
-  map.updateTile(tile_update);
-}
-
-void handleFloorChange(bool up, const protocol::client::FloorChange& floor_change)
-{
-  map.handleFloorChange(up, floor_change);
-}
-
-void handleMagicEffect(const protocol::client::MagicEffect& effect)
-{
-  (void)effect;
-}
-
-void handlePlayerStats(const protocol::client::PlayerStats& stats)
-{
-  (void)stats;
-}
-
-void handleWorldLight(const protocol::client::WorldLight& light)
-{
-  (void)light;
-}
-
-void handlePlayerSkills(const protocol::client::PlayerSkills& skills)
-{
-  (void)skills;
-}
-
-void handleEquipmentUpdate(const protocol::client::Equipment& equipment)
-{
-  (void)equipment;
-}
-
-void handleTextMessage(const protocol::client::TextMessage& message)
-{
-  LOG_INFO("%s: message: %s", __func__, message.message.c_str());
-}
-
-void handleThingAdded(const protocol::client::ThingAdded& thing_added)
-{
-  map.addProtocolThing(thing_added.position, thing_added.thing);
-}
-
-void handleThingChanged(const protocol::client::ThingChanged& thing_changed)
-{
-  map.updateThing(thing_changed.position, thing_changed.stackpos, thing_changed.thing);
-}
+ public:
+  void onLoginFailed(const protocol::client::LoginFailed& failed) override
+  {
+    LOG_ERROR("Could not login: %s", failed.reason.c_str());
+  }
 
-void handleThingMoved(const protocol::client::ThingMoved& thing_moved)
-{
-  map.moveThing(thing_moved.old_position, thing_moved.old_stackpos, thing_moved.new_position);
-}
+  void onOpenChannel(std::uint16_t channel_id, const std::string& name) override
+  {
+    LOG_INFO("%s: open channel %u -> %s", __func__, channel_id, name.c_str());
+  }
 
-void handleThingRemoved(const protocol::client::ThingRemoved& thing_removed)
-{
-  map.removeThing(thing_removed.position, thing_removed.stackpos);
-}
+  void onTalk(const std::string& talker, const std::string& text) override
+  {
+    LOG_INFO("%s: %s said \"%s\"", __func__, talker.c_str(), text.c_str());
+  }
 
-void handleCreatureSkull(const protocol::client::CreatureSkull& creature_skull)
-{
-  map.setCreatureSkull(creature_skull.creature_id, creature_skull.skull);
-}
+  void onTextMessage(const protocol::client::TextMessage& message) override
+  {
+    LOG_INFO("%s: message: %s", __func__, message.message.c_str());
+  }
+};
+LoggingPacketHandler packet_handler;
 
 void handlePacket(network::IncomingPacket* packet)
 {
@@ -157,292 +99,10 @@ void handlePacket(network::IncomingPacket* packet)
 
   LOG_INFO("%s: handling packet number %d", __func__, num_received_packets);
 
-  while (!packet->isEmpty())
+  if (!dispatchPacket(packet, &map, &packet_handler))
   {
-    const auto type = packet->getU8();
-    LOG_DEBUG("%s: type: 0x%02X", __func__, type);
-    switch (type)
-    {
-      case 0x0A:
-        handleLoginPacket(protocol::client::getLogin(packet));
-        break;
-
-      case 0x0B:
-      {
-        // handleGMActions?
-        for (auto i = 0; i < 32; ++i)
-        {
-          packet->getU8();
-        }
-        break;
-      }
-
-      case 0x14:
-        handleLoginFailedPacket(protocol::client::getLoginFailed(packet));
-        break;
-
-      case 0x64:
-        handleFullMapPacket(protocol::client::getFullMap(packet));
-        break;
-
-      case 0x65:
-      case 0x66:
-      case 0x67:
-      case 0x68:
-        handlePartialMapPacket(protocol::client::getPartialMap(map.getPlayerPosition().getZ(),
-                                                               static_cast<common::Direction>(type - 0x65),
-                                                               packet));
-        break;
-
-      case 0x69:
-        handleTileUpdatePacket(protocol::client::getTileUpdate(packet));
-        break;
-
-      case 0x6A:
-        handleThingAdded(protocol::client::getThingAdded(packet));
-        break;
-
-      case 0x6B:
-        handleThingChanged(protocol::client::getThingChanged(packet));
-        break;
-
-      case 0x6D:
-        handleThingMoved(protocol::client::getThingMoved(packet));
-        break;
-
-      case 0x6C:
-        handleThingRemoved(protocol::client::getThingRemoved(packet));
-        break;
-
-      case 0x83:
-        handleMagicEffect(protocol::client::getMagicEffect(packet));
-        break;
-
-      case 0x84:
-      {
-        // animatedText
-        protocol::getPosition(packet);
-        packet->getU8();  // color
-        packet->getString();  // text
-        break;
-      }
-      case 0xA0:
-        handlePlayerStats(protocol::client::getPlayerStats(packet));
-        break;
-
-      case 0x82:
-        handleWorldLight(protocol::client::getWorldLight(packet));
-        break;
-
-      case 0xA1:
-        handlePlayerSkills(protocol::client::getPlayerSkills(packet));
-        break;
-
-      case 0xAC:
-      {
-        // open channel
-        const auto id = packet->getU16();
-        const auto name = packet->getString();
-        LOG_INFO("%s: open channel %u -> %s", __func__, id, name.c_str());
-        break;
-      }
-
-      case 0x6F:
-      {
-        // close container
-        packet->getU8();  // cid
-        break;
-      }
-
-      case 0x70:
-      {
-        // container add item
-        packet->getU8();  // cid
-        protocol::getItem(packet);  // item (container item?)
-        break;
-      }
-
-      case 0x71:
-      {
-        // container update item
-        packet->getU8();  // cid
-        packet->getU8();  // slot
-        protocol::getItem(packet);
-        break;
-      }
-
-      case 0x72:
-      {
-        // container remove item
-        packet->getU8();  // cid
-        packet->getU8();  // slot
-        break;
-      }
-
-      case 0x78:
-      case 0x79:
-        handleEquipmentUpdate(protocol::client::getEquipment(type == 0x78, packet));
-        break;
-
-      case 0xB4:
-        handleTextMessage(protocol::client::getTextMessage(packet));
-        break;
-
-      case 0x8C:
-        // update creature health
-        packet->getU32();  // creature id
-        packet->getU8();  // health perc
-        break;
-
-      case 0x8D:
-        // creature light
-        packet->getU32();  // creature id
-        packet->getU8(); // light intensity
-        packet->getU8(); // light color
-        break;
-
-      case 0xD2:
-        // add name to VIP list
-        packet->getU32();  // id
-        packet->getString();  // name
-        packet->getU8();  // status
-        break;
-
-      case 0x6E:
-      {
-        // open container
-        packet->getU8();  // container id
-        protocol::getItem(packet);  // container item
-        packet->getString();  // container name
-        packet->getU8();  // capacity / slots
-        packet->getU8();  // 0 = no parent, else has parent
-        auto num_items = packet->getU8();
-        while (num_items-- > 0)
-        {
-          protocol::getItem(packet);
-        }
-        break;
-      }
-
-      case 0xAA:
-      {
-        // talk
-        const auto talker = packet->getString();  // talker
-        const auto type = packet->getU8();  // type
-        switch (type)
-        {
-          case 1:  // say
-          case 2:  // whisper
-          case 3:  // yell
-          case 16:  // monster?
-          case 17:  // monster?
-            protocol::getPosition(packet);
-            break;
-
-          case 5:   // channel
-          case 10:  // gm?
-          case 14:  // ??
-            packet->getU16();  // channel id?
-            break;
-
-          case 4:  // whisper?
-            break;
-
-          default:
-            LOG_ERROR("%s: unknown talk type: %u", __func__, type);
-            break;
-        }
-        const auto text = packet->getString();  // text
-
-        LOG_INFO("%s: %s said \"%s\"", __func__, talker.c_str(), text.c_str());
-
-        break;
-      }
-
-      case 0xAD:
-        // Open private channel
-        packet->getString();
-        break;
-
-      case 0xB5:
-        // cancel walk
-        packet->getU8();  // dir -> change player to this dir
-        break;
-
-      case 0xA2:
-        // player state
-        packet->getU8();
-        break;
-
-      case 0x8F:
-        // creature speed
-        packet->getU32();  // creature id
-        packet->getU16();  // new speed
-        break;
-
-      case 0xBE:
-      case 0xBF:
-      {
-        const auto up = type == 0xBE;
-        // Moved up from underground to sea level:     read 6 floors
-        // Moved up from underground to underground:   read 1 floor
-        // Moved down from sea level to underground:   read 3 floors
-        // Moved down from underground to underground: read 1 floor, unless we are on z=14 or z=15 then read 0 floors
-        // Moved up/down from sea level to sea level:  read 0 floors
-        const auto num_floors = (( up && map.getPlayerPosition().getZ() == 8) ? 6 :
-                                (( up && map.getPlayerPosition().getZ()  > 8) ? 1 :
-                                ((!up && map.getPlayerPosition().getZ() == 7) ? 3 :
-                                ((!up && map.getPlayerPosition().getZ()  > 7 && map.getPlayerPosition().getZ() < 13) ? 1 : (0)))));
-        handleFloorChange(up, protocol::client::getFloorChange(num_floors,
-                                                               consts::KNOWN_TILES_X,
-                                                               consts::KNOWN_TILES_Y,
-                                                               packet));
-        break;
-      }
-
-      case 0xA3:
-        // cancel attack
-        break;
-
-      case 0x85:
-        // missile
-        protocol::getPosition(packet);  // from
-        protocol::getPosition(packet);  // to
-        packet->getU8();  // missile id
-        break;
-
-      case 0x90:
-        handleCreatureSkull(protocol::client::getCreatureSkull(packet));
-        break;
-
-      case 0x86:
-        // mark creature
-        packet->getU32();  // creature id
-        packet->getU8();  // color
-        // show for 1000ms?
-        break;
-
-      case 0xD4:
-        // vip logout
-        packet->getU32();  // vip id
-        break;
-
-      case 0x91:
-        // player shield icon
-        packet->getU32();  // creature id
-        packet->getU8();  // shield icon
-        break;
-
-      default:
-        LOG_ERROR("%s: unknown packet type: 0x%X at position %u (position %u with packet header) num recv packets: %d",
-                  __func__,
-                  type,
-                  packet->getPosition() - 1,
-                  packet->getPosition() + 1,
-                  num_received_packets);
-        abort();
-        return;
-    }
+    LOG_ERROR("%s: could not handle packet, num recv packets: %d", __func__, num_received_packets);
+    abort();
   }
 }
 
@@ -26,11 +26,65 @@
 
 #include <algorithm>
 
+#include "incoming_packet.h"
 #include "logger.h"
 
 namespace wsclient::wsworld
 {
 
+class Map::TileWriter : public protocol::client::TileVisitor
+{
+ public:
+  // Received tiles are written with start as the local position of the first tile, or
+  // discarded if map is nullptr
+  TileWriter(Map* map, int start_x, int start_y, int start_z)
+      : m_map(map),
+        m_start_x(start_x),
+        m_start_y(start_y),
+        m_start_z(start_z),
+        m_tile(nullptr)
+  {
+  }
+
+  void onTile(int floor, int x, int y, bool) override
+  {
+    if (!m_map)
+    {
+      return;
+    }
+
+    // Note that clear() keeps the capacity of the vector, so the same memory is reused
+    m_tile = m_map->m_tiles.getTileLocalPos(m_start_x + x, m_start_y + y, m_start_z + floor);
+    if (m_tile)
+    {
+      m_tile->things.clear();
+    }
+  }
+
+  void onCreature(const protocol::Creature& creature) override
+  {
+    if (m_tile)
+    {
+      m_tile->things.emplace_back(m_map->parseCreature(creature));
+    }
+  }
+
+  void onItem(const protocol::Item& item) override
+  {
+    if (m_tile)
+    {
+      m_tile->things.emplace_back(m_map->parseItem(item));
+    }
+  }
+
+ private:
+  Map* m_map;
+  int m_start_x;
+  int m_start_y;
+  int m_start_z;
+  Tile* m_tile;
+};
+
 void Map::setFullMapData(const protocol::client::FullMap& map_data)
 {
   // Full map data is width=18, height=14
@@ -54,63 +108,23 @@ void Map::setFullMapData(const protocol::client::FullMap& map_data)
 
 void Map::setPartialMapData(const protocol::client::PartialMap& map_data)
 {
-  // Set new map position
-  const auto old_position = m_tiles.getMapPosition();
-  const auto x_diff = map_data.direction == common::Direction::EAST ? 1 : (map_data.direction == common::Direction::WEST ? -1 : 0);
-  const auto y_diff = map_data.direction == common::Direction::SOUTH ? 1 : (map_data.direction == common::Direction::NORTH ? -1 : 0);
-  const auto new_position = common::Position(old_position.getX() + x_diff,
-                                             old_position.getY() + y_diff,
-                                             old_position.getZ());
-  m_tiles.setMapPosition(new_position);
-  LOG_INFO("%s: updated map position from %s to %s",
-           __func__,
-           old_position.toString().c_str(),
-           new_position.toString().c_str());
-
-  // Shift Tiles
-  m_tiles.shiftTiles(map_data.direction);
+  const auto start = moveMap(map_data.direction);
 
-  // Add new Tiles
+  // Add new Tiles, either one row (north, south) or one column (east, west) per floor
+  const auto row = map_data.direction == common::Direction::NORTH || map_data.direction == common::Direction::SOUTH;
+  const auto width = row ? consts::KNOWN_TILES_X : 1;
+  const auto height = row ? 1 : consts::KNOWN_TILES_Y;
   auto it = map_data.tiles.begin();
   for (auto z = 0; z < m_tiles.getNumFloors(); z++)
   {
-    switch (map_data.direction)
+    for (auto x = 0; x < width; x++)
     {
-      case common::Direction::NORTH:
-        for (auto x = 0; x < consts::KNOWN_TILES_X; x++)
-        {
-          auto* tile = m_tiles.getTileLocalPos(x, 0, z);
-          setTile(*it, tile);
-          ++it;
-        }
-        break;
-
-      case common::Direction::EAST:
-        for (auto y = 0; y < consts::KNOWN_TILES_Y; y++)
-        {
-          auto* tile = m_tiles.getTileLocalPos(consts::KNOWN_TILES_X - 1, y, z);
-          setTile(*it, tile);
-          ++it;
-        }
-        break;
-
-      case common::Direction::SOUTH:
-        for (auto x = 0; x < consts::KNOWN_TILES_X; x++)
-        {
-          auto* tile = m_tiles.getTileLocalPos(x, consts::KNOWN_TILES_Y - 1, z);
-          setTile(*it, tile);
-          ++it;
-        }
-        break;
-
-      case common::Direction::WEST:
-        for (auto y = 0; y < consts::KNOWN_TILES_Y; y++)
-        {
-          auto* tile = m_tiles.getTileLocalPos(0, y, z);
-          setTile(*it, tile);
-          ++it;
-        }
-        break;
+      for (auto y = 0; y < height; y++)
+      {
+        auto* tile = m_tiles.getTileLocalPos(start.getX() + x, start.getY() + y, z);
+        setTile(*it, tile);
+        ++it;
+      }
     }
   }
 }
@@ -123,99 +137,52 @@ void Map::updateTile(const protocol::client::TileUpdate& tile_update)
 
 void Map::handleFloorChange(bool up, const protocol::client::FloorChange& floor_change)
 {
-  // Save number of floors _before_ changing map position
-  const auto num_floors = m_tiles.getNumFloors();
-
-  const auto current_position = m_tiles.getMapPosition();
-  m_tiles.setMapPosition(common::Position(current_position.getX() + (up ? 1 : -1),
-                                          current_position.getY() + (up ? 1 : -1),
-                                          current_position.getZ() + (up ? -1 : 1)));
-
-
-  if (up && m_tiles.getMapPosition().getZ() == 7)
-  {
-    // Moved up from underground to sea level
-    // We have floors: 6 7 8 9 10
-    // and received floors: 5 4 3 2 1 0
-    // End result should be: 7 6 5 4 3 2 1 0
-    // Swap floor[0] and floor[1], then insert new tiles at floor[2]
-    m_tiles.swapFloors(0, 1);
-    auto it = floor_change.tiles.cbegin();
-    for (auto z = 2; z < 8; ++z)
-    {
-      for (auto x = 0; x < consts::KNOWN_TILES_X; ++x)
-      {
-        for (auto y = 0; y < consts::KNOWN_TILES_Y; ++y)
-        {
-          setTile(*it, m_tiles.getTileLocalPos(x, y, z));
-          ++it;
-        }
-      }
-    }
-  }
-  else if (up && m_tiles.getMapPosition().getZ() == 7)
-  {
-    // Move up from underground to underground
-    // We have 5 to 3 floors (depending on old z)
-    // and received one floor
-    // Shift all floors forward one step (but max 5 floors)
-    // and insert the new floor at [0]
-    // e.g. from 12 13 14 15 to 11 12 13 14 15
-    // or from 7 8 9 10 11 to 6 7 8 9 10
-    m_tiles.shiftFloorForwards(num_floors);
-    auto it = floor_change.tiles.cbegin();
-    for (auto x = 0; x < consts::KNOWN_TILES_X; ++x)
-    {
-      for (auto y = 0; y < consts::KNOWN_TILES_Y; ++y)
-      {
-        setTile(*it, m_tiles.getTileLocalPos(x, y, 0));
-        ++it;
-      }
-    }
-  }
-  else if (!up && m_tiles.getMapPosition().getZ() == 8)
+  const auto z_start = changeFloor(up);
+  if (z_start < 0)
   {
-    // Moved down from sea level to underground
-    // We have floors: 7 6 5 4 3 2 1 0
-    // and received floors: 8 9 10 (order?)
-    // End result should be: 6 7 8 9 10
-    // Swap floor[0] and floor[1], then insert new tiles at floor[2]
-    m_tiles.swapFloors(0, 1);
-    auto it = floor_change.tiles.cbegin();
-    for (auto z = 2; z < 5; ++z)
-    {
-      for (auto x = 0; x < consts::KNOWN_TILES_X; ++x)
-      {
-        for (auto y = 0; y < consts::KNOWN_TILES_Y; ++y)
-        {
-          setTile(*it, m_tiles.getTileLocalPos(x, y, z));
-          ++it;
-        }
-      }
-    }
+    return;
   }
-  else if (!up && m_tiles.getMapPosition().getZ() == 1)
+
+  // Tiles are received floor by floor
+  auto it = floor_change.tiles.cbegin();
+  for (auto z = z_start; it != floor_change.tiles.cend(); ++z)
   {
-    // Moved down from underground to underground
-    // We have 5 to 3 floors (depending on old z)
-    // and received one or zero floors
-    // Shift all floors backwards one step
-    // and insert the new floor at the end (index depend on new z)
-    // e.g. from 7 8 9 10 11 to 8 9 10 11 12
-    // or 12 13 14 15 to 13 14 15
-    m_tiles.shiftFloorBackwards(num_floors);
-    auto it = floor_change.tiles.cbegin();
     for (auto x = 0; x < consts::KNOWN_TILES_X; ++x)
     {
       for (auto y = 0; y < consts::KNOWN_TILES_Y; ++y)
       {
-        setTile(*it, m_tiles.getTileLocalPos(x, y, num_floors - 1));
+        setTile(*it, m_tiles.getTileLocalPos(x, y, z));
         ++it;
       }
     }
   }
 }
 
+void Map::parseFullMap(network::IncomingPacket* packet)
+{
+  TileWriter writer(this, 0, 0, 0);
+  const auto position = protocol::client::parseFullMap(packet, &writer);
+  m_tiles.setMapPosition(position);
+  m_ready = true;
+}
+
+void Map::parsePartialMap(common::Direction direction, network::IncomingPacket* packet)
+{
+  // Note that the number of floors is based on the position before moving, but
+  // z doesn't change when moving to a neighbouring tile
+  const auto start = moveMap(direction);
+  TileWriter writer(this, start.getX(), start.getY(), 0);
+  protocol::client::parsePartialMap(m_tiles.getMapPosition().getZ(), direction, packet, &writer);
+}
+
+void Map::parseFloorChange(bool up, int num_floors, network::IncomingPacket* packet)
+{
+  // The received tiles must be parsed even if they are not used
+  const auto z_start = changeFloor(up);
+  TileWriter writer(z_start < 0 ? nullptr : this, 0, 0, z_start);
+  protocol::client::parseFloorChange(num_floors, consts::KNOWN_TILES_X, consts::KNOWN_TILES_Y, packet, &writer);
+}
+
 void Map::addProtocolThing(const common::Position& position, const protocol::Thing& thing)
 {
   addThing(position, parseThing(thing));
@@ -444,72 +411,78 @@ Thing Map::parseThing(const protocol::Thing& thing)
 {
   if (std::holds_alternative<protocol::Creature>(thing))
   {
-    const auto& creature = std::get<protocol::Creature>(thing);
-    if (creature.update != protocol::Creature::Update::NEW)
+    return parseCreature(std::get<protocol::Creature>(thing));
+  }
+  return parseItem(std::get<protocol::Item>(thing));
+}
+
+Thing Map::parseCreature(const protocol::Creature& creature)
+{
+  if (creature.update != protocol::Creature::Update::NEW)
+  {
+    // FULL or DIRECTION
+    auto* known_creature = getCreature(creature.id);
+    if (!known_creature)
     {
-      // FULL or DIRECTION
-      auto* known_creature = getCreature(creature.id);
-      if (!known_creature)
-      {
-        LOG_ERROR("%s: received creature id %u that is not known", __func__, creature.id);
-        return Thing();
-      }
+      LOG_ERROR("%s: received creature id %u that is not known", __func__, creature.id);
+      return Thing();
+    }
 
-      known_creature->direction = creature.direction;
+    known_creature->direction = creature.direction;
 
-      if (creature.update == protocol::Creature::Update::FULL)
-      {
-        known_creature->health_percent = creature.health_percent;
-        known_creature->outfit = creature.outfit;
-        known_creature->speed = creature.speed;
-      }
+    if (creature.update == protocol::Creature::Update::FULL)
+    {
+      known_creature->health_percent = creature.health_percent;
+      known_creature->outfit = creature.outfit;
+      known_creature->speed = creature.speed;
     }
-    else
+  }
+  else
+  {
+    // Remove known creature if set
+    if (creature.id_to_remove != 0U)
     {
-      // Remove known creature if set
-      if (creature.id_to_remove != 0U)
+      auto it = std::find_if(m_known_creatures.begin(),
+                             m_known_creatures.end(),
+                             [id_to_remove = creature.id_to_remove](const Creature& creature)
       {
-        auto it = std::find_if(m_known_creatures.begin(),
-                               m_known_creatures.end(),
-                               [id_to_remove = creature.id_to_remove](const Creature& creature)
-        {
-          return id_to_remove == creature.id;
-        });
-        if (it == m_known_creatures.end())
-        {
-          LOG_ERROR("%s: received CreatureId to remove %u but we do not know a Creature with that id",
-                    __func__,
-                    creature.id_to_remove);
-        }
-        else
-        {
-          LOG_DEBUG("%s: removing known Creature with id %u", __func__, creature.id_to_remove);
-          m_known_creatures.erase(it);
-        }
+        return id_to_remove == creature.id;
+      });
+      if (it == m_known_creatures.end())
+      {
+        LOG_ERROR("%s: received CreatureId to remove %u but we do not know a Creature with that id",
+                  __func__,
+                  creature.id_to_remove);
       }
-
-      // Add new creature
-      m_known_creatures.emplace_back();
-      m_known_creatures.back().id = creature.id;
-      m_known_creatures.back().name = creature.name;
-      m_known_creatures.back().health_percent = creature.health_percent;
-      m_known_creatures.back().direction = creature.direction;
-      m_known_creatures.back().outfit = creature.outfit;
-      m_known_creatures.back().speed = creature.speed;
-
-      if (creature.id == m_player_id)
+      else
       {
-        LOG_INFO("%s: we are %s!", __func__, creature.name.c_str());
+        LOG_DEBUG("%s: removing known Creature with id %u", __func__, creature.id_to_remove);
+        m_known_creatures.erase(it);
       }
     }
 
-    LOG_INFO("%s: parsed creature with id %u", __func__, creature.id);
+    // Add new creature
+    m_known_creatures.emplace_back();
+    m_known_creatures.back().id = creature.id;
+    m_known_creatures.back().name = creature.name;
+    m_known_creatures.back().health_percent = creature.health_percent;
+    m_known_creatures.back().direction = creature.direction;
+    m_known_creatures.back().outfit = creature.outfit;
+    m_known_creatures.back().speed = creature.speed;
 
-    return creature.id;
+    if (creature.id == m_player_id)
+    {
+      LOG_INFO("%s: we are %s!", __func__, creature.name.c_str());
+    }
   }
 
-  // Item
-  const auto& protocol_item = std::get<protocol::Item>(thing);
+  LOG_INFO("%s: parsed creature with id %u", __func__, creature.id);
+
+  return creature.id;
+}
+
+Thing Map::parseItem(const protocol::Item& protocol_item)
+{
   const auto& itemtype = (*m_itemtypes)[protocol_item.item_type_id];
   Item item;
   item.type = &itemtype;
@@ -532,6 +505,100 @@ void Map::setTile(const protocol::Tile& protocol_tile, Tile* world_tile)
   }
 }
 
+common::Position Map::moveMap(common::Direction direction)
+{
+  // Set new map position
+  const auto old_position = m_tiles.getMapPosition();
+  const auto x_diff = direction == common::Direction::EAST ? 1 : (direction == common::Direction::WEST ? -1 : 0);
+  const auto y_diff = direction == common::Direction::SOUTH ? 1 : (direction == common::Direction::NORTH ? -1 : 0);
+  const auto new_position = common::Position(old_position.getX() + x_diff,
+                                             old_position.getY() + y_diff,
+                                             old_position.getZ());
+  m_tiles.setMapPosition(new_position);
+  LOG_INFO("%s: updated map position from %s to %s",
+           __func__,
+           old_position.toString().c_str(),
+           new_position.toString().c_str());
+
+  // Shift Tiles
+  m_tiles.shiftTiles(direction);
+
+  // New Tiles are received for the row or column that was shifted in
+  switch (direction)
+  {
+    case common::Direction::EAST:
+      return common::Position(consts::KNOWN_TILES_X - 1, 0, 0);
+
+    case common::Direction::SOUTH:
+      return common::Position(0, consts::KNOWN_TILES_Y - 1, 0);
+
+    case common::Direction::NORTH:
+    case common::Direction::WEST:
+    default:
+      return common::Position(0, 0, 0);
+  }
+}
+
+int Map::changeFloor(bool up)
+{
+  // Save number of floors _before_ changing map position
+  const auto num_floors = m_tiles.getNumFloors();
+
+  const auto current_position = m_tiles.getMapPosition();
+  m_tiles.setMapPosition(common::Position(current_position.getX() + (up ? 1 : -1),
+                                          current_position.getY() + (up ? 1 : -1),
+                                          current_position.getZ() + (up ? -1 : 1)));
+
+
+  if (up && m_tiles.getMapPosition().getZ() == 7)
+  {
+    // Moved up from underground to sea level
+    // We have floors: 6 7 8 9 10
+    // and received floors: 5 4 3 2 1 0
+    // End result should be: 7 6 5 4 3 2 1 0
+    // Swap floor[0] and floor[1], then insert new tiles at floor[2]
+    m_tiles.swapFloors(0, 1);
+    return 2;
+  }
+  else if (up && m_tiles.getMapPosition().getZ() == 7)
+  {
+    // Move up from underground to underground
+    // We have 5 to 3 floors (depending on old z)
+    // and received one floor
+    // Shift all floors forward one step (but max 5 floors)
+    // and insert the new floor at [0]
+    // e.g. from 12 13 14 15 to 11 12 13 14 15
+    // or from 7 8 9 10 11 to 6 7 8 9 10
+    m_tiles.shiftFloorForwards(num_floors);
+    return 0;
+  }
+  else if (!up && m_tiles.getMapPosition().getZ() == 8)
+  {
+    // Moved down from sea level to underground
+    // We have floors: 7 6 5 4 3 2 1 0
+    // and received floors: 8 9 10 (order?)
+    // End result should be: 6 7 8 9 10
+    // Swap floor[0] and floor[1], then insert new tiles at floor[2]
+    m_tiles.swapFloors(0, 1);
+    return 2;
+  }
+  else if (!up && m_tiles.getMapPosition().getZ() == 1)
+  {
+    // Moved down from underground to underground
+    // We have 5 to 3 floors (depending on old z)
+    // and received one or zero floors
+    // Shift all floors backwards one step
+    // and insert the new floor at the end (index depend on new z)
+    // e.g. from 7 8 9 10 11 to 8 9 10 11 12
+    // or 12 13 14 15 to 13 14 15
+    m_tiles.shiftFloorBackwards(num_floors);
+    return num_floors - 1;
+  }
+
+  // The received tiles are not used
+  return -1;
+}
+
 Creature* Map::getCreature(common::CreatureId creature_id)
 {
   // According to https://stackoverflow.com/a/123995/969365
@@ -38,6 +38,11 @@
 
 #include "types.h"
 
+namespace network
+{
+class IncomingPacket;
+}
+
 namespace wsclient::wsworld
 {
 
@@ -64,6 +69,11 @@ class Map
   void handleFloorChange(bool up, const protocol::client::FloorChange& floor_change);
   void addProtocolThing(const common::Position& position, const protocol::Thing& thing);
 
+  // Methods that parse map packets directly into the map, without creating protocol objects
+  void parseFullMap(network::IncomingPacket* packet);
+  void parsePartialMap(common::Direction direction, network::IncomingPacket* packet);
+  void parseFloorChange(bool up, int num_floors, network::IncomingPacket* packet);
+
   // Methods that does not work with protocol objects
   void addThing(const common::Position& position, Thing thing);
   void removeThing(const common::Position& position, std::uint8_t stackpos);
@@ -84,10 +94,19 @@ class Map
   bool ready() const { return m_ready; }
 
  private:
+  // Writes tiles from the streaming map parsing, see protocol::client::TileVisitor
+  class TileWriter;
+
   // Methods that work protocol objects
   Thing parseThing(const protocol::Thing& thing);
+  Thing parseCreature(const protocol::Creature& creature);
+  Thing parseItem(const protocol::Item& item);
   void setTile(const protocol::Tile& protocol_tile, Tile* world_tile);
 
+  // Helpers for map updates, returns the local position where the received tiles start
+  common::Position moveMap(common::Direction direction);
+  int changeFloor(bool up);
+
   // Methods that does not work with protocol objects
   Creature* getCreature(common::CreatureId creature_id);
   Thing getThing(const common::Position& position, std::uint8_t stackpos);
@@ -0,0 +1,86 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "../../src/packet_dispatcher.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "incoming_packet.h"
+
+namespace wsclient
+{
+
+namespace
+{
+
+class PacketHandlerStub : public PacketHandler
+{
+ public:
+  void onLogin(const protocol::client::Login& login) override { player_id = login.player_id; }
+  void onTalk(const std::string& talker, const std::string& text) override { talks.push_back(talker + ": " + text); }
+  void onCancelWalk() override { cancel_walks += 1; }
+
+  common::CreatureId player_id = 0U;
+  std::vector<std::string> talks;
+  int cancel_walks = 0;
+};
+
+}  // namespace
+
+TEST(PacketDispatcherTest, MultipleMessages)
+{
+  const std::vector<std::uint8_t> buffer =
+  {
+    0x0A, 0x78, 0x56, 0x34, 0x12, 0x32, 0x00, 0x00,            // login
+    0xAA, 0x01, 0x00, 'a', 0x01, 0xC0, 0x00, 0xC0, 0x00, 0x07,  // talk (say)
+          0x02, 0x00, 'h', 'i',
+    0xB5, 0x00,                                                // cancel walk
+  };
+  network::IncomingPacket packet(buffer.data(), buffer.size());
+  wsworld::Map map;
+  PacketHandlerStub handler;
+  ASSERT_TRUE(dispatchPacket(&packet, &map, &handler));
+
+  EXPECT_EQ(0x12345678U, handler.player_id);
+  EXPECT_EQ(std::vector<std::string>{ "a: hi" }, handler.talks);
+  EXPECT_EQ(1, handler.cancel_walks);
+  EXPECT_TRUE(packet.isEmpty());
+}
+
+TEST(PacketDispatcherTest, UnknownMessage)
+{
+  // The cancel walk after the unknown message is not parsed
+  const std::vector<std::uint8_t> buffer = { 0x01, 0xB5, 0x00 };
+  network::IncomingPacket packet(buffer.data(), buffer.size());
+  wsworld::Map map;
+  PacketHandlerStub handler;
+  ASSERT_FALSE(dispatchPacket(&packet, &map, &handler));
+  EXPECT_EQ(0, handler.cancel_walks);
+}
+
+}  // namespace wsclient